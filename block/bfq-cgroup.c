@@ -191,6 +191,11 @@ static struct bfq_group *bfqq_group(struct bfq_queue *bfqq)
 			      bfqq->bfqd->root_group;
 }
 
+static enum bfq_app_class bfqq_app_class(struct bfq_queue *bfqq)
+{
+	return READ_ONCE(bfqq_group(bfqq)->app_class);
+}
+
 /*
  * The following two functions handle get and put of a bfq_group by
  * wrapping the related blk-cgroup hooks.
@@ -413,6 +418,7 @@ static void bfq_pd_init(struct blkg_policy_data *pd)
 	d = blkcg_to_bfqgd(blkg->blkcg);
 
 	entity->orig_weight = entity->weight = entity->new_weight = d->weight;
+	bfqg->app_class = d->app_class;
 	entity->my_sched_data = &bfqg->sched_data;
 	bfqg->my_entity = entity; /*
 				   * the root_group's will be set to NULL
@@ -871,6 +877,56 @@ static ssize_t bfq_io_set_weight(struct kernfs_open_file *of,
 	return bfq_io_set_weight_legacy(of_css(of), NULL, weight);
 }
 
+static int bfq_io_show_class(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct bfq_group_data *bfqgd = blkcg_to_bfqgd(blkcg);
+	enum bfq_app_class class = BFQ_APP_CLASS_NONE;
+	int i;
+
+	if (bfqgd)
+		class = bfqgd->app_class;
+
+	for (i = 0; i < BFQ_APP_CLASSES; i++)
+		seq_printf(sf, i == class ? "%s[%s]" : "%s%s", i ? " " : "",
+			   bfq_app_class_names[i]);
+	seq_putc(sf, '\n');
+
+	return 0;
+}
+
+/*
+ * The class is picked up by the queues of the group on their next
+ * activation, see bfq_bfqq_handle_idle_busy_switch().
+ */
+static ssize_t bfq_io_set_class(struct kernfs_open_file *of,
+				char *buf, size_t nbytes,
+				loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct bfq_group_data *bfqgd = blkcg_to_bfqgd(blkcg);
+	struct blkcg_gq *blkg;
+	int class;
+
+	for (class = 0; class < BFQ_APP_CLASSES; class++)
+		if (sysfs_streq(buf, bfq_app_class_names[class]))
+			break;
+	if (class == BFQ_APP_CLASSES)
+		return -EINVAL;
+
+	spin_lock_irq(&blkcg->lock);
+	bfqgd->app_class = class;
+	hlist_for_each_entry(blkg, &blkcg->blkg_list, blkcg_node) {
+		struct bfq_group *bfqg = blkg_to_bfqg(blkg);
+
+		if (bfqg)
+			WRITE_ONCE(bfqg->app_class, class);
+	}
+	spin_unlock_irq(&blkcg->lock);
+
+	return nbytes;
+}
+
 static int bfqg_print_stat(struct seq_file *sf, void *v)
 {
 	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_stat,
@@ -995,6 +1051,11 @@ static struct cftype bfq_blkcg_legacy_files[] = {
 		.seq_show = bfq_io_show_weight,
 		.write_u64 = bfq_io_set_weight_legacy,
 	},
+	{
+		.name = "bfq.class",
+		.seq_show = bfq_io_show_class,
+		.write = bfq_io_set_class,
+	},
 	/* statistics, covers only the tasks in the bfqg */
 	{
 		.name = "bfq.time",
@@ -1110,6 +1171,11 @@ static struct cftype bfq_blkg_files[] = {
 		.seq_show = bfq_io_show_weight,
 		.write = bfq_io_set_weight,
 	},
+	{
+		.name = "bfq.class",
+		.seq_show = bfq_io_show_class,
+		.write = bfq_io_set_class,
+	},
 	{} /* terminate */
 };
 
@@ -1167,6 +1233,11 @@ static struct bfq_group *bfqq_group(struct bfq_queue *bfqq)
 	return bfqq->bfqd->root_group;
 }
 
+static enum bfq_app_class bfqq_app_class(struct bfq_queue *bfqq)
+{
+	return BFQ_APP_CLASS_NONE;
+}
+
 static struct bfq_group *
 bfq_create_group_hierarchy(struct bfq_data *bfqd, int node)
 {
@@ -1291,6 +1291,7 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 					     struct request *rq,
 					     bool *interactive)
 {
+	enum bfq_app_class class = bfqq_app_class(bfqq);
 	bool soft_rt, in_burst,	wr_or_deserves_wr,
 		bfqq_wants_to_preempt,
 		idle_for_long_time = bfq_bfqq_idle_for_long_time(bfqd, bfqq),
@@ -1324,18 +1325,25 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 	 * - it does not belong to a large burst,
 	 * - it has been idle for enough time or is soft real-time,
 	 * - is linked to a bfq_io_cq (it is not shared in any sense)
+	 * The application class of its group, if any, takes precedence:
+	 * queues of foreground groups are raised as interactive on every
+	 * activation, even with low_latency off, and queues of background
+	 * groups are never raised.
 	 */
 	in_burst = bfq_bfqq_in_large_burst(bfqq);
 	soft_rt = bfqd->bfq_wr_max_softrt_rate > 0 &&
+		class != BFQ_APP_CLASS_BG &&
 		!in_burst &&
 		time_is_before_jiffies(bfqq->soft_rt_next_start);
-	*interactive =
-		!in_burst &&
-		idle_for_long_time;
-	wr_or_deserves_wr = bfqd->low_latency &&
-		(bfqq->wr_coeff > 1 ||
-		 (bfq_bfqq_sync(bfqq) &&
-		  bfqq->bic && (*interactive || soft_rt)));
+	*interactive = class == BFQ_APP_CLASS_FG ||
+		(class != BFQ_APP_CLASS_BG &&
+		 !in_burst &&
+		 idle_for_long_time);
+	wr_or_deserves_wr = class == BFQ_APP_CLASS_FG ||
+		(bfqd->low_latency && class != BFQ_APP_CLASS_BG &&
+		 (bfqq->wr_coeff > 1 ||
+		  (bfq_bfqq_sync(bfqq) &&
+		   bfqq->bic && (*interactive || soft_rt))));
 
 	bfq_log_bfqq(bfqd, bfqq,
 		     "bfq_add_request: "
@@ -1391,13 +1399,19 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 			     bfqq->requests_within_timer);
 	}
 
-	if (bfqd->low_latency) {
+	if (class == BFQ_APP_CLASS_BG && old_wr_coeff > 1) {
+		/* the group has just been moved to the background */
+		bfqq->wr_coeff = 1;
+		bfqq->wr_cur_max_time = 0;
+		bfqq->entity.prio_changed = 1;
+	} else if (bfqd->low_latency || class == BFQ_APP_CLASS_FG) {
 		if (unlikely(time_is_after_jiffies(bfqq->split_time)))
 			/* wraparound */
 			bfqq->split_time =
 				jiffies - bfqd->bfq_wr_min_idle_time - 1;
 
-		if (time_is_before_jiffies(bfqq->split_time +
+		if (class == BFQ_APP_CLASS_FG ||
+		    time_is_before_jiffies(bfqq->split_time +
 					   bfqd->bfq_wr_min_idle_time)) {
 			bfq_update_bfqq_wr_on_rq_arrival(bfqd, bfqq,
 							 old_wr_coeff,
@@ -1482,6 +1496,7 @@ static void bfq_add_request(struct request *rq)
 						 rq, &interactive);
 	else {
 		if (bfqd->low_latency && old_wr_coeff == 1 && !rq_is_sync(rq) &&
+		    bfqq_app_class(bfqq) != BFQ_APP_CLASS_BG &&
 		    time_is_before_jiffies(
 				bfqq->last_wr_start_finish +
 				bfqd->bfq_wr_min_inter_arr_async)) {
@@ -1527,7 +1542,8 @@ static void bfq_add_request(struct request *rq)
 	 * this is already done in bfq_bfqq_handle_idle_busy_switch if
 	 * needed.
 	 */
-	if (bfqd->low_latency &&
+	if ((bfqd->low_latency ||
+	     bfqq_app_class(bfqq) == BFQ_APP_CLASS_FG) &&
 		(old_wr_coeff == 1 || bfqq->wr_coeff == 1 || interactive))
 		bfqq->last_wr_start_finish = jiffies;
 }
@@ -3328,6 +3344,21 @@ static bool bfq_bfqq_may_idle(struct bfq_queue *bfqq)
 	   bfq_class_idle(bfqq))
 		return false;
 
+	/*
+	 * The application class of the group overrides the heuristics
+	 * below: the device is always idled for the sync queues of
+	 * foreground groups, so that they keep it while they issue
+	 * their next request, and never for background groups.
+	 */
+	switch (bfqq_app_class(bfqq)) {
+	case BFQ_APP_CLASS_FG:
+		return true;
+	case BFQ_APP_CLASS_BG:
+		return false;
+	default:
+		break;
+	}
+
 	bfqq_sequential_and_IO_bound = !BFQQ_SEEKY(bfqq) &&
 		bfq_bfqq_IO_bound(bfqq) && bfq_bfqq_has_short_ttime(bfqq);
 	/*
@@ -3667,6 +3698,8 @@ keep_queue:
 static void bfq_update_wr_data(struct bfq_data *bfqd, struct bfq_queue *bfqq)
 {
 	struct bfq_entity *entity = &bfqq->entity;
+	enum bfq_app_class class = bfqq_app_class(bfqq);
+
 	if (bfqq->wr_coeff > 1) { /* queue is being weight-raised */
 		BUG_ON(bfqq->wr_cur_max_time == bfqd->bfq_wr_rt_max_time &&
 		       time_is_after_jiffies(bfqq->last_wr_start_finish));
@@ -3687,10 +3720,15 @@ static void bfq_update_wr_data(struct bfq_data *bfqd, struct bfq_queue *bfqq)
 		 * If the queue was activated in a burst, or too much
 		 * time has elapsed from the beginning of this
 		 * weight-raising period, then end weight raising.
+		 * Foreground queues instead stay raised for as long as
+		 * they are backlogged, and background ones lose raising
+		 * as soon as their group is moved to the background.
 		 */
-		if (bfq_bfqq_in_large_burst(bfqq))
+		if (class == BFQ_APP_CLASS_BG ||
+		    (class != BFQ_APP_CLASS_FG && bfq_bfqq_in_large_burst(bfqq)))
 			bfq_bfqq_end_wr(bfqq);
-		else if (time_is_before_jiffies(bfqq->last_wr_start_finish +
+		else if (class != BFQ_APP_CLASS_FG &&
+			 time_is_before_jiffies(bfqq->last_wr_start_finish +
 					   bfqq->wr_cur_max_time)) {
 			if (bfqq->wr_cur_max_time != bfqd->bfq_wr_rt_max_time ||
 			time_is_before_jiffies(bfqq->wr_start_at_switch_to_srt +
@@ -3837,6 +3875,9 @@ static int bfq_dispatch_requests(struct request_queue *q, int force)
 
 	bfq_log(bfqd, "dispatch requests: %d busy queues", bfqd->busy_queues);
 
+	if (unlikely(force))
+		bfq_bg_unpark(bfqd, true);
+
 	if (bfqd->busy_queues == 0)
 		return 0;
 
@@ -4332,13 +4373,10 @@ static void bfq_rq_enqueued(struct bfq_data *bfqd, struct bfq_queue *bfqq,
 	}
 }
 
-static void bfq_insert_request(struct request_queue *q, struct request *rq)
+static void __bfq_insert_request(struct bfq_data *bfqd, struct request *rq)
 {
-	struct bfq_data *bfqd = q->elevator->elevator_data;
 	struct bfq_queue *bfqq = RQ_BFQQ(rq), *new_bfqq;
 
-	assert_spin_locked(bfqd->queue->queue_lock);
-
 	/*
 	 * An unplug may trigger a requeue of a request from the device
 	 * driver: make sure we are in process context while trying to
@@ -4378,6 +4416,107 @@ static void bfq_insert_request(struct request_queue *q, struct request *rq)
 	bfq_rq_enqueued(bfqd, bfqq, rq);
 }
 
+/* length of a window of the background throughput cap */
+#define BFQ_BG_WINDOW		(HZ / 10)
+
+/*
+ * Charge @rq to the current window of the background cap, if the
+ * window is not used up yet.  What the last request let through
+ * overshoots is carried over to the next window, so that the cap
+ * holds on average whatever the request size.
+ */
+static bool bfq_bg_charge(struct bfq_data *bfqd, struct request *rq)
+{
+	u64 budget = div_u64((u64)bfqd->bfq_bg_max_rate * 1024 *
+			     BFQ_BG_WINDOW, HZ);
+
+	if (time_after_eq(jiffies, bfqd->bg_window_start + BFQ_BG_WINDOW)) {
+		if (time_before(jiffies,
+				bfqd->bg_window_start + 2 * BFQ_BG_WINDOW) &&
+		    bfqd->bg_window_bytes > budget)
+			bfqd->bg_window_bytes -= budget;
+		else
+			bfqd->bg_window_bytes = 0;
+		bfqd->bg_window_start = jiffies;
+	}
+
+	if (bfqd->bg_window_bytes >= budget)
+		return false;
+
+	bfqd->bg_window_bytes += blk_rq_bytes(rq);
+	return true;
+}
+
+static bool bfq_bg_capped(struct bfq_data *bfqd, struct request *rq)
+{
+	return bfqd->bfq_bg_max_rate &&
+		bfqq_app_class(RQ_BFQQ(rq)) == BFQ_APP_CLASS_BG;
+}
+
+/*
+ * Hand the parked requests of background groups over to their queues,
+ * in arrival order, for as long as the cap allows, or all of them if
+ * @force is set.
+ */
+static void bfq_bg_unpark(struct bfq_data *bfqd, bool force)
+{
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, &bfqd->bg_parked, queuelist) {
+		if (!force && bfq_bg_capped(bfqd, rq) &&
+		    !bfq_bg_charge(bfqd, rq))
+			break;
+		list_del_init(&rq->queuelist);
+		__bfq_insert_request(bfqd, rq);
+	}
+}
+
+static void bfq_bg_timer(unsigned long data)
+{
+	struct bfq_data *bfqd = (struct bfq_data *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(bfqd->queue->queue_lock, flags);
+
+	bfq_bg_unpark(bfqd, false);
+	if (!list_empty(&bfqd->bg_parked))
+		mod_timer(&bfqd->bg_timer,
+			  bfqd->bg_window_start + BFQ_BG_WINDOW);
+	bfq_schedule_dispatch(bfqd);
+
+	spin_unlock_irqrestore(bfqd->queue->queue_lock, flags);
+}
+
+static void bfq_insert_request(struct request_queue *q, struct request *rq)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+
+	assert_spin_locked(bfqd->queue->queue_lock);
+
+	/*
+	 * Requests of background groups over the cap are kept away
+	 * from their queue, and so from the service trees, until the
+	 * next window of the cap.  Until then, the device is entirely
+	 * left to the other queues, and bfq_bfqq_may_idle() never
+	 * waits for these requests.  Bios must not be merged into
+	 * them either, as they are not in any sort list.
+	 */
+	if (bfq_bg_capped(bfqd, rq) &&
+	    (!list_empty(&bfqd->bg_parked) || !bfq_bg_charge(bfqd, rq))) {
+		bfq_log_bfqq(bfqd, RQ_BFQQ(rq), "bg cap: parking rq %p", rq);
+		if (q->last_merge == rq)
+			q->last_merge = NULL;
+		elv_rqhash_del(q, rq);
+		list_add_tail(&rq->queuelist, &bfqd->bg_parked);
+		if (!timer_pending(&bfqd->bg_timer))
+			mod_timer(&bfqd->bg_timer,
+				  bfqd->bg_window_start + BFQ_BG_WINDOW);
+		return;
+	}
+
+	__bfq_insert_request(bfqd, rq);
+}
+
 static void bfq_update_hw_tag(struct bfq_data *bfqd)
 {
 	bfqd->max_rq_in_driver = max_t(int, bfqd->max_rq_in_driver,
@@ -4403,6 +4542,21 @@ static void bfq_update_hw_tag(struct bfq_data *bfqd)
 	bfqd->hw_tag_samples = 0;
 }
 
+/*
+ * Account the time @rq took from its allocation to its completion in
+ * the latency histogram of the application class of @bfqq.  Bucket i
+ * counts the latencies below 2^i usecs and not below 2^(i-1), the last
+ * bucket all the longer ones.
+ */
+static void bfq_update_class_lat(struct bfq_data *bfqd,
+				 struct bfq_queue *bfqq, u64 lat_ns)
+{
+	u64 lat_us = div_u64(lat_ns, NSEC_PER_USEC);
+	int bucket = min_t(int, fls64(lat_us), BFQ_LAT_BUCKETS - 1);
+
+	bfqd->class_lat[bfqq_app_class(bfqq)][bucket]++;
+}
+
 static void bfq_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct bfq_queue *bfqq = RQ_BFQQ(rq);
@@ -4442,6 +4596,11 @@ static void bfq_completed_request(struct request_queue *q, struct request *rq)
 
 	RQ_BIC(rq)->ttime.last_end_request = now_ns;
 
+	if (rq_is_sync(rq) && rq_start_time_ns(rq) &&
+	    now_ns > rq_start_time_ns(rq))
+		bfq_update_class_lat(bfqd, bfqq,
+				     now_ns - rq_start_time_ns(rq));
+
 	/*
 	 * Using us instead of ns, to get a reasonable precision in
 	 * computing rate in next check.
@@ -4783,6 +4942,7 @@ schedule_dispatch:
 static void bfq_shutdown_timer_wq(struct bfq_data *bfqd)
 {
 	hrtimer_cancel(&bfqd->idle_slice_timer);
+	del_timer_sync(&bfqd->bg_timer);
 	cancel_work_sync(&bfqd->unplug_work);
 }
 
@@ -4918,6 +5078,10 @@ static int bfq_init_queue(struct request_queue *q, struct elevator_type *e)
 		     HRTIMER_MODE_REL);
 	bfqd->idle_slice_timer.function = bfq_idle_slice_timer;
 
+	INIT_LIST_HEAD(&bfqd->bg_parked);
+	setup_timer(&bfqd->bg_timer, bfq_bg_timer, (unsigned long)bfqd);
+	bfqd->bg_window_start = jiffies;
+
 	bfqd->queue_weights_tree = RB_ROOT;
 	bfqd->group_weights_tree = RB_ROOT;
 
@@ -5057,6 +5221,49 @@ static ssize_t bfq_weights_show(struct elevator_queue *e, char *page)
 	return num_char;
 }
 
+static ssize_t bfq_class_latency_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	ssize_t num_char = 0;
+	int i, class;
+
+	num_char += sprintf(page, "%10s", "usecs <");
+	for (class = 0; class < BFQ_APP_CLASSES; class++)
+		num_char += sprintf(page + num_char, " %10s",
+				    bfq_app_class_names[class]);
+	num_char += sprintf(page + num_char, "\n");
+
+	spin_lock_irq(bfqd->queue->queue_lock);
+
+	for (i = 0; i < BFQ_LAT_BUCKETS; i++) {
+		if (i < BFQ_LAT_BUCKETS - 1)
+			num_char += sprintf(page + num_char, "%10lu", 1UL << i);
+		else
+			num_char += sprintf(page + num_char, "%10s", "inf");
+		for (class = 0; class < BFQ_APP_CLASSES; class++)
+			num_char += sprintf(page + num_char, " %10llu",
+				(unsigned long long)bfqd->class_lat[class][i]);
+		num_char += sprintf(page + num_char, "\n");
+	}
+
+	spin_unlock_irq(bfqd->queue->queue_lock);
+
+	return num_char;
+}
+
+/* any write clears the histogram */
+static ssize_t bfq_class_latency_store(struct elevator_queue *e,
+				       const char *page, size_t count)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+
+	spin_lock_irq(bfqd->queue->queue_lock);
+	memset(bfqd->class_lat, 0, sizeof(bfqd->class_lat));
+	spin_unlock_irq(bfqd->queue->queue_lock);
+
+	return count;
+}
+
 #define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
 static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
 {									\
@@ -5083,6 +5290,7 @@ SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
 SHOW_FUNCTION(bfq_wr_min_inter_arr_async_show, bfqd->bfq_wr_min_inter_arr_async,
 	1);
 SHOW_FUNCTION(bfq_wr_max_softrt_rate_show, bfqd->bfq_wr_max_softrt_rate, 0);
+SHOW_FUNCTION(bfq_bg_max_rate_show, bfqd->bfq_bg_max_rate, 0);
 #undef SHOW_FUNCTION
 
 #define USEC_SHOW_FUNCTION(__FUNC, __VAR)				\
@@ -5133,6 +5341,7 @@ STORE_FUNCTION(bfq_wr_min_inter_arr_async_store,
 		&bfqd->bfq_wr_min_inter_arr_async, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate, 0,
 		INT_MAX, 0);
+STORE_FUNCTION(bfq_bg_max_rate_store, &bfqd->bfq_bg_max_rate, 0, INT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define USEC_STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -5257,6 +5466,8 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(wr_min_inter_arr_async),
 	BFQ_ATTR(wr_max_softrt_rate),
 	BFQ_ATTR(weights),
+	BFQ_ATTR(bg_max_rate),
+	BFQ_ATTR(class_latency),
 	__ATTR_NULL
 };
 
@@ -385,6 +385,27 @@ enum bfq_device_speed {
 	BFQ_BFQD_SLOW,
 };
 
+/*
+ * Application class of a group, set through the bfq.class cgroup file.
+ * Queues of foreground groups are always weight-raised and idled for,
+ * queues of background groups never are, and share a throughput cap.
+ */
+enum bfq_app_class {
+	BFQ_APP_CLASS_NONE,
+	BFQ_APP_CLASS_FG,
+	BFQ_APP_CLASS_BG,
+	BFQ_APP_CLASSES
+};
+
+static const char * const bfq_app_class_names[] = {
+	[BFQ_APP_CLASS_NONE]	= "none",
+	[BFQ_APP_CLASS_FG]	= "foreground",
+	[BFQ_APP_CLASS_BG]	= "background",
+};
+
+/* log2 buckets of the per-class completion latency, in usecs */
+#define BFQ_LAT_BUCKETS		20
+
 /**
  * struct bfq_data - per-device data structure.
  *
@@ -596,6 +617,22 @@ struct bfq_data {
 	/* device-speed class for the low-latency heuristic */
 	enum bfq_device_speed device_speed;
 
+	/*
+	 * Cap on the throughput of background groups, in KiB/sec, 0
+	 * for no cap.  Their requests are charged to the current
+	 * window of the cap when inserted; once the window is used
+	 * up, they are parked on bg_parked until bg_timer starts the
+	 * next one.
+	 */
+	unsigned long bfq_bg_max_rate;
+	unsigned long bg_window_start;
+	u64 bg_window_bytes;
+	struct list_head bg_parked;
+	struct timer_list bg_timer;
+
+	/* completion latency of sync requests, per application class */
+	u64 class_lat[BFQ_APP_CLASSES][BFQ_LAT_BUCKETS];
+
 	/* fallback dummy bfqq for extreme OOM conditions */
 	struct bfq_queue oom_bfqq;
 };
@@ -783,12 +820,14 @@ struct bfqg_stats {
  *
  * @ps: @blkcg_policy_storage that this structure inherits
  * @weight: weight of the bfq_group
+ * @app_class: application class of the bfq_group
  */
 struct bfq_group_data {
 	/* must be the first member */
 	struct blkcg_policy_data pd;
 
 	unsigned int weight;
+	enum bfq_app_class app_class;
 };
 
 /**
@@ -812,6 +851,8 @@ struct bfq_group_data {
  * @rq_pos_tree: rbtree sorted by next_request position, used when
  *               determining if two or more queues have interleaving
  *               requests (see bfq_find_close_cooperator()).
+ * @app_class: application class of the queues of the group, copied
+ *             from the blkcg (see bfq_bfqq_handle_idle_busy_switch()).
  *
  * Each (device, cgroup) pair has its own bfq_group, i.e., for each cgroup
  * there is a set of bfq_groups, each one collecting the lower-level
@@ -840,6 +881,8 @@ struct bfq_group {
 
 	struct rb_root rq_pos_tree;
 
+	enum bfq_app_class app_class;
+
 	struct bfqg_stats stats;
 };
 
@@ -906,12 +906,43 @@ static int blkcg_print_stat(struct seq_file *sf, void *v)
 	return 0;
 }
 
+static int blkcg_print_inflight(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct blkcg_gq *blkg;
+
+	rcu_read_lock();
+
+	hlist_for_each_entry_rcu(blkg, &blkcg->blkg_list, blkcg_node) {
+		const char *dname;
+		int reads, writes;
+
+		dname = blkg_dev_name(blkg);
+		if (!dname)
+			continue;
+
+		reads = atomic_read(&blkg->nr_inflight[READ]);
+		writes = atomic_read(&blkg->nr_inflight[WRITE]);
+		if (reads || writes)
+			seq_printf(sf, "%s read=%d write=%d\n",
+				   dname, reads, writes);
+	}
+
+	rcu_read_unlock();
+	return 0;
+}
+
 struct cftype blkcg_files[] = {
 	{
 		.name = "stat",
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.seq_show = blkcg_print_stat,
 	},
+	{
+		.name = "inflight",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = blkcg_print_inflight,
+	},
 	{ }	/* terminate */
 };
 
@@ -920,6 +951,10 @@ struct cftype blkcg_legacy_files[] = {
 		.name = "reset_stats",
 		.write_u64 = blkcg_reset_stats,
 	},
+	{
+		.name = "inflight",
+		.seq_show = blkcg_print_inflight,
+	},
 	{ }	/* terminate */
 };
 
@@ -51,6 +51,7 @@
 
 #include "blk.h"
 #include "blk-mq.h"
+#include "blk-stat.h"
 
 #include <linux/math64.h>
 
@@ -145,6 +146,7 @@ void blk_rq_init(struct request_queue *q, struct request *rq)
 	rq->cmd = rq->__cmd;
 	rq->cmd_len = BLK_MAX_CDB;
 	rq->tag = -1;
+	rq->internal_tag = -1;
 	rq->start_time = jiffies;
 	set_start_time_ns(rq);
 	rq->part = NULL;
@@ -705,9 +707,12 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	if (!q->bio_split)
 		goto fail_id;
 
+	if (blk_stat_alloc(q))
+		goto fail_split;
+
 	q->backing_dev_info = bdi_alloc_node(gfp_mask, node_id);
 	if (!q->backing_dev_info)
-		goto fail_split;
+		goto fail_stats;
 
 	q->backing_dev_info->ra_pages =
 			(VM_MAX_READAHEAD * 1024) / PAGE_CACHE_SIZE;
@@ -746,6 +751,9 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	q->bypass_depth = 1;
 	__set_bit(QUEUE_FLAG_BYPASS, &q->queue_flags);
 
+	/* classic polling until told otherwise through io_poll_delay */
+	q->poll_nsec = -1;
+
 	init_waitqueue_head(&q->mq_freeze_wq);
 
 	/*
@@ -766,6 +774,8 @@ fail_ref:
 	percpu_ref_exit(&q->q_usage_counter);
 fail_bdi:
 	bdi_put(q->backing_dev_info);
+fail_stats:
+	blk_stat_free(q);
 fail_split:
 	bioset_free(q->bio_split);
 fail_id:
@@ -3021,6 +3031,7 @@ void blk_start_request(struct request *req)
 
 	BUG_ON(test_bit(REQ_ATOM_COMPLETE, &req->atomic_flags));
 	blk_add_timer(req);
+	blk_stat_set_issue(req);
 }
 EXPORT_SYMBOL(blk_start_request);
 
@@ -3252,6 +3263,7 @@ void blk_finish_request(struct request *req, int error)
 	if (req->cmd_flags & REQ_DONTPREP)
 		blk_unprep_request(req);
 
+	blk_stat_add(req);
 	blk_account_io_done(req);
 
 	if (req->end_io)
@@ -3842,6 +3854,50 @@ void blk_finish_plug(struct blk_plug *plug)
 }
 EXPORT_SYMBOL(blk_finish_plug);
 
+/*
+ * Hybrid polling: sleep through the first part of the wait for @rq, half
+ * its expected completion time or the fixed io_poll_delay, and only spin
+ * for the rest.  Only done once per request, returns whether we slept.
+ */
+static bool blk_poll_hybrid_sleep(struct request_queue *q,
+				  struct request *rq)
+{
+	struct hrtimer_sleeper hs;
+	enum hrtimer_mode mode;
+	u64 nsecs;
+
+	if (test_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags))
+		return false;
+
+	if (q->poll_nsec > 0)
+		nsecs = q->poll_nsec;
+	else
+		nsecs = blk_stat_poll_mean(q, rq) / 2;
+	if (!nsecs)
+		return false;
+
+	set_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags);
+
+	mode = HRTIMER_MODE_REL;
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, mode);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	hrtimer_init_sleeper(&hs, current);
+	do {
+		if (test_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags))
+			break;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		hrtimer_start_expires(&hs.timer, mode);
+		if (hs.task)
+			io_schedule();
+		hrtimer_cancel(&hs.timer);
+		mode = HRTIMER_MODE_ABS;
+	} while (hs.task && !signal_pending(current));
+
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
 bool blk_poll(struct request_queue *q, blk_qc_t cookie)
 {
 	struct blk_plug *plug;
@@ -3855,6 +3911,20 @@ bool blk_poll(struct request_queue *q, blk_qc_t cookie)
 	if (plug)
 		blk_flush_plug_list(plug, false);
 
+	/*
+	 * Back to the caller after sleeping, it rechecks for completion and
+	 * polls again, this time spinning.
+	 */
+	if (q->poll_nsec >= 0) {
+		unsigned int queue_num = blk_qc_t_to_queue_num(cookie);
+		struct blk_mq_hw_ctx *hctx = q->queue_hw_ctx[queue_num];
+		struct request *rq;
+
+		rq = blk_mq_tag_to_rq(hctx->tags, blk_qc_t_to_tag(cookie));
+		if (blk_poll_hybrid_sleep(q, rq))
+			return true;
+	}
+
 	state = current->state;
 	while (!need_resched()) {
 		unsigned int queue_num = blk_qc_t_to_queue_num(cookie);
@@ -0,0 +1,290 @@
+/*
+ * blk-mq I/O scheduler support
+ *
+ * An elevator with mq_ops owns the requests of a blk-mq queue from bio
+ * submission until dispatch.  Those requests are allocated from per
+ * hardware queue scheduler tags, sized by nr_requests, and only get a
+ * driver tag once the scheduler hands them out.  The scheduler thus sees
+ * many more requests than the device can hold, and can merge and reorder
+ * them, without the driver having to grow its queue depth.
+ *
+ * Flushes and passthrough requests allocate driver tags directly and skip
+ * the scheduler.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blk-mq.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+#include "blk-mq-tag.h"
+
+static void blk_mq_sched_free_tags(struct request_queue *q)
+{
+	struct blk_mq_tag_set *set = q->tag_set;
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (hctx->sched_tags) {
+			blk_mq_free_rq_map(set, hctx->sched_tags, i);
+			hctx->sched_tags = NULL;
+		}
+	}
+}
+
+/*
+ * Give the scheduler twice the driver depth to sort through, capped like
+ * the request pools of the legacy path.  The driver tags go back to their
+ * full depth, as nr_requests now sizes the scheduler tags.
+ */
+static int blk_mq_sched_alloc_tags(struct request_queue *q)
+{
+	struct blk_mq_tag_set *set = q->tag_set;
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	q->nr_requests = 2 * min_t(unsigned int, set->queue_depth,
+				   BLKDEV_MAX_RQ);
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		blk_mq_tag_update_depth(hctx->tags, set->queue_depth);
+		hctx->sched_tags = blk_mq_init_rq_map(set, i, q->nr_requests,
+						      0);
+		if (!hctx->sched_tags) {
+			blk_mq_sched_free_tags(q);
+			q->nr_requests = set->queue_depth;
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Called with the queue frozen.  Consumes the module reference on @e
+ * whether it succeeds or not.  A NULL @e leaves the queue without a
+ * scheduler.
+ */
+int blk_mq_init_sched(struct request_queue *q, struct elevator_type *e)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct elevator_queue *eq;
+	unsigned int i, nr;
+	int ret;
+
+	q->last_merge = NULL;
+
+	if (!e) {
+		q->elevator = NULL;
+		return 0;
+	}
+
+	ret = blk_mq_sched_alloc_tags(q);
+	if (ret)
+		goto err_put;
+
+	ret = e->mq_ops.init_sched(q, e);
+	if (ret)
+		goto err_free_tags;
+
+	if (e->mq_ops.init_hctx) {
+		queue_for_each_hw_ctx(q, hctx, i) {
+			ret = e->mq_ops.init_hctx(hctx, i);
+			if (ret)
+				goto err_exit_hctx;
+		}
+	}
+
+	return 0;
+
+err_exit_hctx:
+	nr = i;
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (i == nr)
+			break;
+		if (e->mq_ops.exit_hctx)
+			e->mq_ops.exit_hctx(hctx, i);
+	}
+	eq = q->elevator;
+	q->elevator = NULL;
+	/* drops the module reference through the elevator kobject */
+	elevator_exit(eq);
+	blk_mq_sched_free_tags(q);
+	q->nr_requests = q->tag_set->queue_depth;
+	return ret;
+err_free_tags:
+	blk_mq_sched_free_tags(q);
+	q->nr_requests = q->tag_set->queue_depth;
+err_put:
+	module_put(e->elevator_owner);
+	return ret;
+}
+
+/*
+ * Called with the queue frozen, so no request holds a scheduler tag.
+ * A hardware queue run may still be about to call into the scheduler
+ * though: runs look at q->elevator once and either have preemption
+ * disabled or come from the run and delay works, so clear it and wait
+ * for both.
+ */
+void blk_mq_exit_sched(struct request_queue *q, struct elevator_queue *e)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	WRITE_ONCE(q->elevator, NULL);
+	synchronize_sched();
+	queue_for_each_hw_ctx(q, hctx, i) {
+		flush_delayed_work(&hctx->run_work);
+		flush_delayed_work(&hctx->delay_work);
+	}
+
+	if (e->type->mq_ops.exit_hctx) {
+		queue_for_each_hw_ctx(q, hctx, i)
+			e->type->mq_ops.exit_hctx(hctx, i);
+	}
+
+	q->last_merge = NULL;
+	elevator_exit(e);
+	blk_mq_sched_free_tags(q);
+	q->nr_requests = q->tag_set->queue_depth;
+}
+
+/*
+ * Try to merge @bio into a request the scheduler holds, through the
+ * elevator merge hash and the scheduler's own sorted lookup.  Must be
+ * called with the scheduler lock held, which also protects q->last_merge
+ * and the hash.
+ */
+bool blk_mq_sched_try_merge(struct request_queue *q, struct bio *bio)
+{
+	struct request *rq;
+
+	switch (elv_merge(q, &rq, bio)) {
+	case ELEVATOR_BACK_MERGE:
+		if (!bio_attempt_back_merge(q, rq, bio))
+			return false;
+		if (!attempt_back_merge(q, rq))
+			elv_merged_request(q, rq, ELEVATOR_BACK_MERGE);
+		return true;
+	case ELEVATOR_FRONT_MERGE:
+		if (!bio_attempt_front_merge(q, rq, bio))
+			return false;
+		if (!attempt_front_merge(q, rq))
+			elv_merged_request(q, rq, ELEVATOR_FRONT_MERGE);
+		return true;
+	default:
+		return false;
+	}
+}
+EXPORT_SYMBOL_GPL(blk_mq_sched_try_merge);
+
+bool __blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio)
+{
+	struct elevator_queue *e = q->elevator;
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	bool ret = false;
+
+	if (!e->type->mq_ops.bio_merge)
+		return false;
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	ret = e->type->mq_ops.bio_merge(hctx, bio);
+	if (ret)
+		ctx->rq_merged++;
+	blk_mq_put_ctx(ctx);
+
+	return ret;
+}
+
+/*
+ * Requests that already hold a driver tag (flushes, passthrough and
+ * requeued requests) go straight to the dispatch list.
+ */
+static bool blk_mq_sched_bypass_insert(struct blk_mq_hw_ctx *hctx,
+				       struct request *rq, bool at_head)
+{
+	if (rq->tag == -1)
+		return false;
+
+	spin_lock(&hctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &hctx->dispatch);
+	else
+		list_add_tail(&rq->queuelist, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+	return true;
+}
+
+void blk_mq_sched_insert_request(struct blk_mq_hw_ctx *hctx,
+				 struct request *rq, bool at_head)
+{
+	struct elevator_queue *e = hctx->queue->elevator;
+	LIST_HEAD(list);
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	if (blk_mq_sched_bypass_insert(hctx, rq, at_head))
+		return;
+
+	list_add(&rq->queuelist, &list);
+	e->type->mq_ops.insert_requests(hctx, &list, at_head);
+}
+
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct blk_mq_ctx *ctx,
+				  struct list_head *list)
+{
+	struct elevator_queue *e = hctx->queue->elevator;
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, list, queuelist) {
+		rq->mq_ctx = ctx;
+		trace_block_rq_insert(hctx->queue, rq);
+		if (rq->tag != -1) {
+			list_del_init(&rq->queuelist);
+			blk_mq_sched_bypass_insert(hctx, rq, false);
+		}
+	}
+
+	if (!list_empty(list))
+		e->type->mq_ops.insert_requests(hctx, list, false);
+}
+
+void blk_mq_sched_dispatch_requests(struct blk_mq_hw_ctx *hctx,
+				    struct elevator_queue *e)
+{
+	struct request *rq;
+	LIST_HEAD(rq_list);
+
+	/*
+	 * Requests the driver couldn't take last time go first, and the
+	 * scheduler isn't asked for more until all of them are issued.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		if (!list_empty(&hctx->dispatch))
+			list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	if (!list_empty(&rq_list) && !blk_mq_dispatch_rq_list(hctx, &rq_list))
+		return;
+
+	/*
+	 * Pull one request at a time, so the scheduler keeps its say over
+	 * everything the driver can't accept yet.
+	 */
+	do {
+		rq = e->type->mq_ops.dispatch_request(hctx);
+		if (!rq)
+			break;
+		list_add(&rq->queuelist, &rq_list);
+	} while (blk_mq_dispatch_rq_list(hctx, &rq_list));
+}
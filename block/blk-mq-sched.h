@@ -0,0 +1,98 @@
+#ifndef BLK_MQ_SCHED_H
+#define BLK_MQ_SCHED_H
+
+#include "blk-mq.h"
+#include "blk-mq-tag.h"
+
+int blk_mq_init_sched(struct request_queue *q, struct elevator_type *e);
+void blk_mq_exit_sched(struct request_queue *q, struct elevator_queue *e);
+
+bool blk_mq_sched_try_merge(struct request_queue *q, struct bio *bio);
+bool __blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio);
+
+void blk_mq_sched_insert_request(struct blk_mq_hw_ctx *hctx,
+				 struct request *rq, bool at_head);
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct blk_mq_ctx *ctx,
+				  struct list_head *list);
+void blk_mq_sched_dispatch_requests(struct blk_mq_hw_ctx *hctx,
+				    struct elevator_queue *e);
+
+static inline bool
+blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio)
+{
+	if (!q->elevator || blk_queue_nomerges(q) || !bio_mergeable(bio))
+		return false;
+
+	return __blk_mq_sched_bio_merge(q, bio);
+}
+
+static inline void blk_mq_sched_prepare_request(struct request *rq,
+						struct bio *bio)
+{
+	struct elevator_queue *e = rq->q->elevator;
+
+	rq->elv.icq = NULL;
+	rq->elv.priv[0] = NULL;
+	rq->elv.priv[1] = NULL;
+
+	if (e->type->mq_ops.prepare_request)
+		e->type->mq_ops.prepare_request(rq, bio);
+}
+
+static inline void blk_mq_sched_completed_request(struct request *rq)
+{
+	struct elevator_queue *e = rq->q->elevator;
+
+	if (e->type->mq_ops.completed_request)
+		e->type->mq_ops.completed_request(rq);
+}
+
+static inline void blk_mq_sched_started_request(struct request *rq)
+{
+	struct elevator_queue *e = rq->q->elevator;
+
+	if (e->type->mq_ops.started_request)
+		e->type->mq_ops.started_request(rq);
+}
+
+static inline void blk_mq_sched_requeue_request(struct request *rq)
+{
+	struct elevator_queue *e = rq->q->elevator;
+
+	if (e->type->mq_ops.requeue_request)
+		e->type->mq_ops.requeue_request(rq);
+}
+
+/*
+ * May be called without the queue frozen, so the scheduler is only looked
+ * at once.  See blk_mq_exit_sched().
+ */
+static inline bool blk_mq_sched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e = READ_ONCE(hctx->queue->elevator);
+
+	if (e && e->type->mq_ops.has_work)
+		return e->type->mq_ops.has_work(hctx);
+
+	return false;
+}
+
+/*
+ * Dispatch ran out of driver tags: have the next freed tag run the queue
+ * again.  Pairs with blk_mq_sched_restart().
+ */
+static inline void blk_mq_sched_mark_restart(struct blk_mq_hw_ctx *hctx)
+{
+	if (!test_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state))
+		set_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state);
+}
+
+static inline void blk_mq_sched_restart(struct blk_mq_hw_ctx *hctx)
+{
+	if (test_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state) &&
+	    test_and_clear_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state))
+		blk_mq_run_hw_queue(hctx, true);
+}
+
+#endif
@@ -40,7 +40,14 @@ struct blk_mq_tags {
 	struct blk_mq_bitmap_tags bitmap_tags;
 	struct blk_mq_bitmap_tags breserved_tags;
 
+	/*
+	 * rqs maps busy tags to the request they are attached to, while
+	 * static_rqs holds the preallocated requests.  The two differ
+	 * for driver tags once a scheduler is attached, since the request
+	 * then comes from the scheduler tags.
+	 */
 	struct request **rqs;
+	struct request **static_rqs;
 	struct list_head page_list;
 
 	int alloc_policy;
@@ -52,7 +59,8 @@ extern struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, unsigned int r
 extern void blk_mq_free_tags(struct blk_mq_tags *tags);
 
 extern unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data);
-extern void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag, unsigned int *last_tag);
+extern void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, struct blk_mq_tags *tags,
+			   unsigned int tag, unsigned int *last_tag);
 extern bool blk_mq_has_free_tags(struct blk_mq_tags *tags);
 extern ssize_t blk_mq_tag_sysfs_show(struct blk_mq_tags *tags, char *page);
 extern void blk_mq_tag_init_last_tag(struct blk_mq_tags *tags, unsigned int *last_tag);
@@ -29,24 +29,33 @@
 #include "blk.h"
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
+#include "blk-mq-sched.h"
+#include "blk-stat.h"
 
 static DEFINE_MUTEX(all_q_mutex);
 static LIST_HEAD(all_q_list);
 
 static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx);
+static int blk_mq_hctx_next_cpu(struct blk_mq_hw_ctx *hctx);
 
 /*
- * Check if any of the ctx's have pending work in this hardware queue
+ * Check if any of the ctx's, or the I/O scheduler, have pending work in
+ * this hardware queue
  */
 static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
 {
 	unsigned int i;
+	bool ret;
 
 	for (i = 0; i < hctx->ctx_map.size; i++)
 		if (hctx->ctx_map.map[i].word)
 			return true;
 
-	return false;
+	/* see blk_mq_exit_sched() */
+	rcu_read_lock_sched();
+	ret = blk_mq_sched_has_work(hctx);
+	rcu_read_unlock_sched();
+	return ret;
 }
 
 static inline struct blk_align_bitmap *get_bm(struct blk_mq_hw_ctx *hctx,
@@ -176,6 +185,8 @@ static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 	rq->rq_disk = NULL;
 	rq->part = NULL;
 	rq->start_time = jiffies;
+	rq->issue_time_ns = 0;
+	rq->issue_bytes = 0;
 #ifdef CONFIG_BLK_CGROUP
 	rq->rl = NULL;
 	set_start_time_ns(rq);
@@ -209,19 +220,28 @@ static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 static struct request *
 __blk_mq_alloc_request(struct blk_mq_alloc_data *data, int rw)
 {
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
 	struct request *rq;
 	unsigned int tag;
 
 	tag = blk_mq_get_tag(data);
 	if (tag != BLK_MQ_TAG_FAIL) {
-		rq = data->hctx->tags->rqs[tag];
-
-		if (blk_mq_tag_busy(data->hctx)) {
-			rq->cmd_flags = REQ_MQ_INFLIGHT;
-			atomic_inc(&data->hctx->nr_active);
+		rq = tags->static_rqs[tag];
+
+		if (data->internal) {
+			/* the driver tag is assigned at dispatch time */
+			rq->tag = -1;
+			rq->internal_tag = tag;
+		} else {
+			if (blk_mq_tag_busy(data->hctx)) {
+				rq->cmd_flags = REQ_MQ_INFLIGHT;
+				atomic_inc(&data->hctx->nr_active);
+			}
+			rq->tag = tag;
+			rq->internal_tag = -1;
+			tags->rqs[tag] = rq;
 		}
 
-		rq->tag = tag;
 		blk_mq_rq_ctx_init(data->q, data->ctx, rq, rw);
 		return rq;
 	}
@@ -272,14 +292,24 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 				  struct blk_mq_ctx *ctx, struct request *rq)
 {
 	const int tag = rq->tag;
+	const int sched_tag = rq->internal_tag;
 	struct request_queue *q = rq->q;
 
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
+	if (rq->cmd_flags & REQ_ELVPRIV)
+		blk_mq_sched_completed_request(rq);
 	rq->cmd_flags = 0;
 
 	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
-	blk_mq_put_tag(hctx, tag, &ctx->last_tag);
+	clear_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags);
+	if (tag != -1)
+		blk_mq_put_tag(hctx, hctx->tags, tag, &ctx->last_tag);
+	if (sched_tag != -1)
+		blk_mq_put_tag(hctx, hctx->sched_tags, sched_tag,
+			       &ctx->last_sched_tag);
+	if (tag != -1)
+		blk_mq_sched_restart(hctx);
 	blk_queue_exit(q);
 }
 
@@ -305,6 +335,7 @@ EXPORT_SYMBOL_GPL(blk_mq_free_request);
 
 inline void __blk_mq_end_request(struct request *rq, int error)
 {
+	blk_stat_add(rq);
 	blk_account_io_done(rq);
 
 	if (rq->end_io) {
@@ -399,6 +430,9 @@ void blk_mq_start_request(struct request *rq)
 {
 	struct request_queue *q = rq->q;
 
+	if (rq->cmd_flags & REQ_ELVPRIV)
+		blk_mq_sched_started_request(rq);
+
 	trace_block_rq_issue(q, rq);
 
 	rq->resid_len = blk_rq_bytes(rq);
@@ -406,6 +440,7 @@ void blk_mq_start_request(struct request *rq)
 		rq->next_rq->resid_len = blk_rq_bytes(rq->next_rq);
 
 	blk_add_timer(rq);
+	blk_stat_set_issue(rq);
 
 	/*
 	 * Ensure that ->deadline is visible before set the started
@@ -449,6 +484,8 @@ static void __blk_mq_requeue_request(struct request *rq)
 
 void blk_mq_requeue_request(struct request *rq)
 {
+	if (rq->cmd_flags & REQ_ELVPRIV)
+		blk_mq_sched_requeue_request(rq);
 	__blk_mq_requeue_request(rq);
 
 	BUG_ON(blk_queued_rq(rq));
@@ -645,17 +682,17 @@ static void blk_mq_rq_timer(unsigned long priv)
 }
 
 /*
- * Reverse check our software queue for entries that we could potentially
- * merge with. Currently includes a hand-wavy stop count of 8, to not spend
- * too much time checking for merges.
+ * Reverse check a list of queued requests for entries that we could
+ * potentially merge with. Currently includes a hand-wavy stop count of 8,
+ * to not spend too much time checking for merges.
  */
-static bool blk_mq_attempt_merge(struct request_queue *q,
-				 struct blk_mq_ctx *ctx, struct bio *bio)
+bool blk_mq_bio_list_merge(struct request_queue *q, struct list_head *list,
+			   struct bio *bio)
 {
 	struct request *rq;
 	int checked = 8;
 
-	list_for_each_entry_reverse(rq, &ctx->rq_list, queuelist) {
+	list_for_each_entry_reverse(rq, list, queuelist) {
 		int el_ret;
 
 		if (!checked--)
@@ -666,16 +703,12 @@ static bool blk_mq_attempt_merge(struct request_queue *q,
 
 		el_ret = blk_try_merge(rq, bio);
 		if (el_ret == ELEVATOR_BACK_MERGE) {
-			if (bio_attempt_back_merge(q, rq, bio)) {
-				ctx->rq_merged++;
+			if (bio_attempt_back_merge(q, rq, bio))
 				return true;
-			}
 			break;
 		} else if (el_ret == ELEVATOR_FRONT_MERGE) {
-			if (bio_attempt_front_merge(q, rq, bio)) {
-				ctx->rq_merged++;
+			if (bio_attempt_front_merge(q, rq, bio))
 				return true;
-			}
 			break;
 		}
 	}
@@ -683,6 +716,17 @@ static bool blk_mq_attempt_merge(struct request_queue *q,
 	return false;
 }
 
+static bool blk_mq_attempt_merge(struct request_queue *q,
+				 struct blk_mq_ctx *ctx, struct bio *bio)
+{
+	if (blk_mq_bio_list_merge(q, &ctx->rq_list, bio)) {
+		ctx->rq_merged++;
+		return true;
+	}
+
+	return false;
+}
+
 /*
  * Process software queues that have been marked busy, splicing them
  * to the for-dispatch
@@ -717,43 +761,62 @@ static void flush_busy_ctxs(struct blk_mq_hw_ctx *hctx, struct list_head *list)
 	}
 }
 
-/*
- * Run this hardware queue, pulling any software queues mapped to it in.
- * Note that this function currently has various problems around ordering
- * of IO. In particular, we'd like FIFO behaviour on handling existing
- * items on the hctx->dispatch list. Ignore that for now.
- */
-static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+bool blk_mq_get_driver_tag(struct request *rq, struct blk_mq_hw_ctx *hctx)
 {
-	struct request_queue *q = hctx->queue;
-	struct request *rq;
-	LIST_HEAD(rq_list);
-	LIST_HEAD(driver_list);
-	struct list_head *dptr;
-	int queued;
+	struct blk_mq_alloc_data data;
+	unsigned int tag;
 
-	WARN_ON(!cpumask_test_cpu(raw_smp_processor_id(), hctx->cpumask));
+	if (rq->tag != -1)
+		return true;
 
-	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
-		return;
+	blk_mq_set_alloc_data(&data, rq->q, GFP_ATOMIC, false, rq->mq_ctx,
+			hctx);
+	tag = blk_mq_get_tag(&data);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return false;
 
-	hctx->run++;
+	if (blk_mq_tag_busy(hctx)) {
+		rq->cmd_flags |= REQ_MQ_INFLIGHT;
+		atomic_inc(&hctx->nr_active);
+	}
+	rq->tag = tag;
+	hctx->tags->rqs[tag] = rq;
+	return true;
+}
 
-	/*
-	 * Touch any software queue that has pending entries.
-	 */
-	flush_busy_ctxs(hctx, &rq_list);
+/*
+ * Requests allocated from the scheduler tags give their driver tag back
+ * when the driver can't take them, so that it can't be held by a request
+ * waiting on hctx->dispatch.  Everything else keeps its tag for life.
+ */
+static void blk_mq_put_driver_tag(struct blk_mq_hw_ctx *hctx,
+				  struct request *rq)
+{
+	if (rq->tag == -1 || rq->internal_tag == -1)
+		return;
 
-	/*
-	 * If we have previous entries on our dispatch list, grab them
-	 * and stuff them at the front for more fair dispatch.
-	 */
-	if (!list_empty_careful(&hctx->dispatch)) {
-		spin_lock(&hctx->lock);
-		if (!list_empty(&hctx->dispatch))
-			list_splice_init(&hctx->dispatch, &rq_list);
-		spin_unlock(&hctx->lock);
+	blk_mq_put_tag(hctx, hctx->tags, rq->tag, &rq->mq_ctx->last_tag);
+	rq->tag = -1;
+
+	if (rq->cmd_flags & REQ_MQ_INFLIGHT) {
+		rq->cmd_flags &= ~REQ_MQ_INFLIGHT;
+		atomic_dec(&hctx->nr_active);
 	}
+}
+
+/*
+ * Send the requests on @list to the driver, in order. Returns false if
+ * the driver or the driver tags ran out before the list was drained, in
+ * which case the remaining requests are moved to hctx->dispatch.
+ */
+bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx, struct list_head *list)
+{
+	struct request_queue *q = hctx->queue;
+	struct request *rq;
+	LIST_HEAD(driver_list);
+	struct list_head *dptr;
+	bool no_tag = false;
+	int queued, ret = BLK_MQ_RQ_QUEUE_OK;
 
 	/*
 	 * Start off with dptr being NULL, so we start the first request
@@ -765,16 +828,28 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	 * Now process all the entries, sending them to the driver.
 	 */
 	queued = 0;
-	while (!list_empty(&rq_list)) {
+	while (!list_empty(list)) {
 		struct blk_mq_queue_data bd;
-		int ret;
 
-		rq = list_first_entry(&rq_list, struct request, queuelist);
+		rq = list_first_entry(list, struct request, queuelist);
+		if (!blk_mq_get_driver_tag(rq, hctx)) {
+			/*
+			 * Have the next driver tag release rerun us, and
+			 * retry once in case it happened before the restart
+			 * bit was visible.
+			 */
+			blk_mq_sched_mark_restart(hctx);
+			smp_mb();
+			if (!blk_mq_get_driver_tag(rq, hctx)) {
+				no_tag = true;
+				break;
+			}
+		}
 		list_del_init(&rq->queuelist);
 
 		bd.rq = rq;
 		bd.list = dptr;
-		bd.last = list_empty(&rq_list);
+		bd.last = list_empty(list);
 
 		ret = q->mq_ops->queue_rq(hctx, &bd);
 		switch (ret) {
@@ -782,7 +857,8 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 			queued++;
 			break;
 		case BLK_MQ_RQ_QUEUE_BUSY:
-			list_add(&rq->queuelist, &rq_list);
+			blk_mq_put_driver_tag(hctx, rq);
+			list_add(&rq->queuelist, list);
 			__blk_mq_requeue_request(rq);
 			break;
 		default:
@@ -800,7 +876,7 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 		 * We've done the first request. If we have more than 1
 		 * left in the list, set dptr to defer issue.
 		 */
-		if (!dptr && rq_list.next != rq_list.prev)
+		if (!dptr && list->next != list->prev)
 			dptr = &driver_list;
 	}
 
@@ -813,21 +889,77 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	 * Any items that need requeuing? Stuff them into hctx->dispatch,
 	 * that is where we will continue on next queue run.
 	 */
-	if (!list_empty(&rq_list)) {
-		spin_lock(&hctx->lock);
-		list_splice(&rq_list, &hctx->dispatch);
-		spin_unlock(&hctx->lock);
+	if (list_empty(list))
+		return true;
+
+	spin_lock(&hctx->lock);
+	list_splice_init(list, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+
+	if (!no_tag) {
 		/*
-		 * the queue is expected stopped with BLK_MQ_RQ_QUEUE_BUSY, but
-		 * it's possible the queue is stopped and restarted again
-		 * before this. Queue restart will dispatch requests. And since
-		 * requests in rq_list aren't added into hctx->dispatch yet,
-		 * the requests in rq_list might get lost.
+		 * the queue is expected stopped with BLK_MQ_RQ_QUEUE_BUSY,
+		 * but it's possible the queue is stopped and restarted again
+		 * before this. Queue restart will dispatch requests. And
+		 * since requests in the list aren't added into
+		 * hctx->dispatch yet, the requests might get lost.
 		 *
 		 * blk_mq_run_hw_queue() already checks the STOPPED bit
 		 **/
 		blk_mq_run_hw_queue(hctx, true);
+	} else if (hctx->flags & BLK_MQ_F_TAG_SHARED) {
+		/*
+		 * Driver tags shared with other queues may be freed by
+		 * their completions, which only restart their own queues.
+		 */
+		kblockd_schedule_delayed_work_on(blk_mq_hctx_next_cpu(hctx),
+				&hctx->run_work, 1);
 	}
+	return false;
+}
+
+/*
+ * Run this hardware queue, pulling any software queues mapped to it in.
+ * Note that this function currently has various problems around ordering
+ * of IO. In particular, we'd like FIFO behaviour on handling existing
+ * items on the hctx->dispatch list. Ignore that for now.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e;
+	LIST_HEAD(rq_list);
+
+	WARN_ON(!cpumask_test_cpu(raw_smp_processor_id(), hctx->cpumask));
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	hctx->run++;
+
+	/* see blk_mq_exit_sched() for why this is only looked at once */
+	e = READ_ONCE(hctx->queue->elevator);
+	if (e) {
+		blk_mq_sched_dispatch_requests(hctx, e);
+		return;
+	}
+
+	/*
+	 * Touch any software queue that has pending entries.
+	 */
+	flush_busy_ctxs(hctx, &rq_list);
+
+	/*
+	 * If we have previous entries on our dispatch list, grab them
+	 * and stuff them at the front for more fair dispatch.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		if (!list_empty(&hctx->dispatch))
+			list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	blk_mq_dispatch_rq_list(hctx, &rq_list);
 }
 
 /*
@@ -1007,9 +1139,13 @@ void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
 
 	hctx = q->mq_ops->map_queue(q, ctx->cpu);
 
-	spin_lock(&ctx->lock);
-	__blk_mq_insert_request(hctx, rq, at_head);
-	spin_unlock(&ctx->lock);
+	if (q->elevator) {
+		blk_mq_sched_insert_request(hctx, rq, at_head);
+	} else {
+		spin_lock(&ctx->lock);
+		__blk_mq_insert_request(hctx, rq, at_head);
+		spin_unlock(&ctx->lock);
+	}
 
 	if (run_queue)
 		blk_mq_run_hw_queue(hctx, async);
@@ -1035,6 +1171,11 @@ static void blk_mq_insert_requests(struct request_queue *q,
 		ctx = current_ctx;
 	hctx = q->mq_ops->map_queue(q, ctx->cpu);
 
+	if (q->elevator) {
+		blk_mq_sched_insert_requests(hctx, ctx, list);
+		goto run;
+	}
+
 	/*
 	 * preemption doesn't flush plug list, so it's possible ctx->cpu is
 	 * offline now
@@ -1050,7 +1191,7 @@ static void blk_mq_insert_requests(struct request_queue *q,
 	}
 	blk_mq_hctx_mark_pending(hctx, ctx);
 	spin_unlock(&ctx->lock);
-
+run:
 	blk_mq_run_hw_queue(hctx, from_schedule);
 	blk_mq_put_ctx(current_ctx);
 }
@@ -1166,6 +1307,7 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 	struct request *rq;
 	int rw = bio_data_dir(bio);
 	struct blk_mq_alloc_data alloc_data;
+	bool sched;
 
 	blk_queue_enter_live(q);
 	ctx = blk_mq_get_ctx(q);
@@ -1174,9 +1316,17 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 	if (rw_is_sync(bio->bi_rw))
 		rw |= REQ_SYNC;
 
+	/*
+	 * With an I/O scheduler attached, regular requests come out of the
+	 * scheduler tags and only get a driver tag at dispatch. Flushes
+	 * go straight to the flush machinery and need one right away.
+	 */
+	sched = q->elevator && !(bio->bi_rw & (REQ_FLUSH | REQ_FUA));
+
 	trace_block_getrq(q, bio, rw);
 	blk_mq_set_alloc_data(&alloc_data, q, GFP_ATOMIC, false, ctx,
 			hctx);
+	alloc_data.internal = sched;
 	rq = __blk_mq_alloc_request(&alloc_data, rw);
 	if (unlikely(!rq)) {
 		__blk_mq_run_hw_queue(hctx);
@@ -1187,17 +1337,33 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 		hctx = q->mq_ops->map_queue(q, ctx->cpu);
 		blk_mq_set_alloc_data(&alloc_data, q,
 				__GFP_RECLAIM|__GFP_HIGH, false, ctx, hctx);
+		alloc_data.internal = sched;
 		rq = __blk_mq_alloc_request(&alloc_data, rw);
 		ctx = alloc_data.ctx;
 		hctx = alloc_data.hctx;
 	}
 
+	if (sched) {
+		rq->cmd_flags |= REQ_ELVPRIV;
+		blk_mq_sched_prepare_request(rq, bio);
+	}
+
 	hctx->queued++;
 	data->hctx = hctx;
 	data->ctx = ctx;
 	return rq;
 }
 
+static blk_qc_t request_to_qc_t(struct blk_mq_hw_ctx *hctx,
+		struct request *rq)
+{
+	/* scheduled requests don't have a driver tag yet to poll for */
+	if (rq->tag == -1)
+		return BLK_QC_T_NONE;
+
+	return blk_tag_to_qc_t(rq->tag, hctx->queue_num);
+}
+
 static int blk_mq_direct_issue_request(struct request *rq, blk_qc_t *cookie)
 {
 	int ret;
@@ -1211,6 +1377,10 @@ static int blk_mq_direct_issue_request(struct request *rq, blk_qc_t *cookie)
 	};
 	blk_qc_t new_cookie = blk_tag_to_qc_t(rq->tag, hctx->queue_num);
 
+	/* scheduled requests are issued by the scheduler, in its order */
+	if (q->elevator)
+		return -1;
+
 	/*
 	 * For OK queue, we are done. For error, kill it. Any other
 	 * error (busy), just add it to our list as we previously
@@ -1263,11 +1433,14 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	    blk_attempt_plug_merge(q, bio, &request_count, &same_queue_rq))
 		return BLK_QC_T_NONE;
 
+	if (!is_flush_fua && blk_mq_sched_bio_merge(q, bio))
+		return BLK_QC_T_NONE;
+
 	rq = blk_mq_map_request(q, bio, &data);
 	if (unlikely(!rq))
 		return BLK_QC_T_NONE;
 
-	cookie = blk_tag_to_qc_t(rq->tag, data.hctx->queue_num);
+	cookie = request_to_qc_t(data.hctx, rq);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1310,10 +1483,16 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 			goto done;
 		if (test_bit(BLK_MQ_S_STOPPED, &data.hctx->state) ||
 		    blk_mq_direct_issue_request(old_rq, &cookie) != 0)
-			blk_mq_insert_request(old_rq, false, true, true);
+			blk_mq_insert_request(old_rq, false, true, !q->elevator);
 		goto done;
 	}
 
+	if (q->elevator) {
+		blk_mq_bio_to_request(rq, bio);
+		blk_mq_sched_insert_request(data.hctx, rq, false);
+		goto run_queue;
+	}
+
 	if (!blk_mq_merge_queue_io(data.hctx, data.ctx, rq, bio)) {
 		/*
 		 * For a SYNC request, send it to the hardware immediately. For
@@ -1358,11 +1537,14 @@ static blk_qc_t blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	} else
 		request_count = blk_plug_queued_count(q);
 
+	if (!is_flush_fua && blk_mq_sched_bio_merge(q, bio))
+		return BLK_QC_T_NONE;
+
 	rq = blk_mq_map_request(q, bio, &data);
 	if (unlikely(!rq))
 		return BLK_QC_T_NONE;
 
-	cookie = blk_tag_to_qc_t(rq->tag, data.hctx->queue_num);
+	cookie = request_to_qc_t(data.hctx, rq);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1392,6 +1574,12 @@ static blk_qc_t blk_sq_make_request(struct request_queue *q, struct bio *bio)
 		return cookie;
 	}
 
+	if (q->elevator) {
+		blk_mq_bio_to_request(rq, bio);
+		blk_mq_sched_insert_request(data.hctx, rq, false);
+		goto run_queue;
+	}
+
 	if (!blk_mq_merge_queue_io(data.hctx, data.ctx, rq, bio)) {
 		/*
 		 * For a SYNC request, send it to the hardware immediately. For
@@ -1416,20 +1604,20 @@ struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
 }
 EXPORT_SYMBOL(blk_mq_map_queue);
 
-static void blk_mq_free_rq_map(struct blk_mq_tag_set *set,
-		struct blk_mq_tags *tags, unsigned int hctx_idx)
+void blk_mq_free_rq_map(struct blk_mq_tag_set *set, struct blk_mq_tags *tags,
+			unsigned int hctx_idx)
 {
 	struct page *page;
 
-	if (tags->rqs && set->ops->exit_request) {
+	if (tags->static_rqs && set->ops->exit_request) {
 		int i;
 
 		for (i = 0; i < tags->nr_tags; i++) {
-			if (!tags->rqs[i])
+			if (!tags->static_rqs[i])
 				continue;
-			set->ops->exit_request(set->driver_data, tags->rqs[i],
-						hctx_idx, i);
-			tags->rqs[i] = NULL;
+			set->ops->exit_request(set->driver_data,
+					       tags->static_rqs[i], hctx_idx, i);
+			tags->static_rqs[i] = NULL;
 		}
 	}
 
@@ -1445,6 +1633,7 @@ static void blk_mq_free_rq_map(struct blk_mq_tag_set *set,
 	}
 
 	kfree(tags->rqs);
+	kfree(tags->static_rqs);
 
 	blk_mq_free_tags(tags);
 }
@@ -1454,22 +1643,28 @@ static size_t order_to_size(unsigned int order)
 	return (size_t)PAGE_SIZE << order;
 }
 
-static struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
-		unsigned int hctx_idx)
+/*
+ * Allocate a tag map of @depth tags for hardware queue @hctx_idx, along with
+ * a request for each of them. This backs both the driver tags of a tag set,
+ * and the scheduler tags of a queue with an I/O scheduler attached.
+ */
+struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
+				       unsigned int hctx_idx,
+				       unsigned int depth,
+				       unsigned int reserved_tags)
 {
 	struct blk_mq_tags *tags;
 	unsigned int i, j, entries_per_page, max_order = 4;
 	size_t rq_size, left;
 
-	tags = blk_mq_init_tags(set->queue_depth, set->reserved_tags,
-				set->numa_node,
+	tags = blk_mq_init_tags(depth, reserved_tags, set->numa_node,
 				BLK_MQ_FLAG_TO_ALLOC_POLICY(set->flags));
 	if (!tags)
 		return NULL;
 
 	INIT_LIST_HEAD(&tags->page_list);
 
-	tags->rqs = kzalloc_node(set->queue_depth * sizeof(struct request *),
+	tags->rqs = kzalloc_node(depth * sizeof(struct request *),
 				 GFP_NOIO | __GFP_NOWARN | __GFP_NORETRY,
 				 set->numa_node);
 	if (!tags->rqs) {
@@ -1477,15 +1672,24 @@ static struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
 		return NULL;
 	}
 
+	tags->static_rqs = kzalloc_node(depth * sizeof(struct request *),
+				 GFP_NOIO | __GFP_NOWARN | __GFP_NORETRY,
+				 set->numa_node);
+	if (!tags->static_rqs) {
+		kfree(tags->rqs);
+		blk_mq_free_tags(tags);
+		return NULL;
+	}
+
 	/*
 	 * rq_size is the size of the request plus driver payload, rounded
 	 * to the cacheline size
 	 */
 	rq_size = round_up(sizeof(struct request) + set->cmd_size,
 				cache_line_size());
-	left = rq_size * set->queue_depth;
+	left = rq_size * depth;
 
-	for (i = 0; i < set->queue_depth; ) {
+	for (i = 0; i < depth; ) {
 		int this_order = max_order;
 		struct page *page;
 		int to_do;
@@ -1519,15 +1723,16 @@ static struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
 		 */
 		kmemleak_alloc(p, order_to_size(this_order), 1, GFP_NOIO);
 		entries_per_page = order_to_size(this_order) / rq_size;
-		to_do = min(entries_per_page, set->queue_depth - i);
+		to_do = min(entries_per_page, depth - i);
 		left -= to_do * rq_size;
 		for (j = 0; j < to_do; j++) {
+			tags->static_rqs[i] = p;
 			tags->rqs[i] = p;
 			if (set->ops->init_request) {
 				if (set->ops->init_request(set->driver_data,
-						tags->rqs[i], hctx_idx, i,
+						tags->static_rqs[i], hctx_idx, i,
 						set->numa_node)) {
-					tags->rqs[i] = NULL;
+					tags->static_rqs[i] = NULL;
 					goto fail;
 				}
 			}
@@ -1843,7 +2048,8 @@ static void blk_mq_map_swqueue(struct request_queue *q,
 
 		/* unmapped hw queue can be remapped after CPU topo changed */
 		if (!set->tags[i])
-			set->tags[i] = blk_mq_init_rq_map(set, i);
+			set->tags[i] = blk_mq_init_rq_map(set, i,
+					set->queue_depth, set->reserved_tags);
 		hctx->tags = set->tags[i];
 		WARN_ON(!hctx->tags);
 
@@ -2095,6 +2301,9 @@ void blk_mq_free_queue(struct request_queue *q)
 
 	blk_mq_del_queue_tag_set(q);
 
+	if (q->elevator)
+		blk_mq_exit_sched(q, q->elevator);
+
 	blk_mq_exit_hw_queues(q, set, set->nr_hw_queues);
 	blk_mq_free_hw_queues(q, set);
 }
@@ -2160,7 +2369,8 @@ static int __blk_mq_alloc_rq_maps(struct blk_mq_tag_set *set)
 	int i;
 
 	for (i = 0; i < set->nr_hw_queues; i++) {
-		set->tags[i] = blk_mq_init_rq_map(set, i);
+		set->tags[i] = blk_mq_init_rq_map(set, i, set->queue_depth,
+						  set->reserved_tags);
 		if (!set->tags[i])
 			goto out_unwind;
 	}
@@ -2291,12 +2501,19 @@ int blk_mq_update_nr_requests(struct request_queue *q, unsigned int nr)
 	struct blk_mq_hw_ctx *hctx;
 	int i, ret;
 
-	if (!set || nr > set->queue_depth)
+	if (!set)
 		return -EINVAL;
 
+	/*
+	 * With an I/O scheduler, nr_requests sizes the scheduler tags,
+	 * which can be shrunk but not grown past what was allocated.
+	 */
 	ret = 0;
 	queue_for_each_hw_ctx(q, hctx, i) {
-		ret = blk_mq_tag_update_depth(hctx->tags, nr);
+		if (hctx->sched_tags)
+			ret = blk_mq_tag_update_depth(hctx->sched_tags, nr);
+		else
+			ret = blk_mq_tag_update_depth(hctx->tags, nr);
 		if (ret)
 			break;
 	}
@@ -13,6 +13,7 @@ struct blk_mq_ctx {
 	unsigned int		index_hw;
 
 	unsigned int		last_tag ____cacheline_aligned_in_smp;
+	unsigned int		last_sched_tag;
 
 	/* incremented at dispatch time */
 	unsigned long		rq_dispatched[2];
@@ -30,6 +31,20 @@ void blk_mq_freeze_queue(struct request_queue *q);
 void blk_mq_free_queue(struct request_queue *q);
 int blk_mq_update_nr_requests(struct request_queue *q, unsigned int nr);
 void blk_mq_wake_waiters(struct request_queue *q);
+bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx, struct list_head *list);
+bool blk_mq_bio_list_merge(struct request_queue *q, struct list_head *list,
+			   struct bio *bio);
+bool blk_mq_get_driver_tag(struct request *rq, struct blk_mq_hw_ctx *hctx);
+
+/*
+ * Request map helpers, shared between driver and scheduler tags
+ */
+void blk_mq_free_rq_map(struct blk_mq_tag_set *set, struct blk_mq_tags *tags,
+			unsigned int hctx_idx);
+struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
+				       unsigned int hctx_idx,
+				       unsigned int depth,
+				       unsigned int reserved_tags);
 
 /*
  * CPU hotplug helpers
@@ -96,6 +111,8 @@ struct blk_mq_alloc_data {
 	struct request_queue *q;
 	gfp_t gfp;
 	bool reserved;
+	/* allocate from the scheduler tags instead of the driver tags */
+	bool internal;
 
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
@@ -110,10 +127,27 @@ static inline void blk_mq_set_alloc_data(struct blk_mq_alloc_data *data,
 	data->q = q;
 	data->gfp = gfp;
 	data->reserved = reserved;
+	data->internal = false;
 	data->ctx = ctx;
 	data->hctx = hctx;
 }
 
+static inline struct blk_mq_tags *blk_mq_tags_from_data(struct blk_mq_alloc_data *data)
+{
+	if (data->internal)
+		return data->hctx->sched_tags;
+
+	return data->hctx->tags;
+}
+
+static inline unsigned int *blk_mq_last_tag_from_data(struct blk_mq_alloc_data *data)
+{
+	if (data->internal)
+		return &data->ctx->last_sched_tag;
+
+	return &data->ctx->last_tag;
+}
+
 static inline bool blk_mq_hw_queue_mapped(struct blk_mq_hw_ctx *hctx)
 {
 	return hctx->nr_ctx && hctx->tags;
@@ -0,0 +1,215 @@
+/*
+ * Request latency statistics
+ *
+ * Every request is timed from the driver being handed it to its
+ * completion, and the latency goes into a per-cpu log2 histogram of its
+ * operation.  This is cheap enough to be always on, unlike tracing every
+ * request, and is reported in /sys/block/<dev>/queue/stats.
+ */
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+
+#include "blk-stat.h"
+
+static const char *const blk_stat_op_names[BLK_STAT_OPS] = {
+	[BLK_STAT_READ]		= "read",
+	[BLK_STAT_WRITE]	= "write",
+	[BLK_STAT_DISCARD]	= "discard",
+	[BLK_STAT_FLUSH]	= "flush",
+};
+
+/* how often the poll means are recomputed, in jiffies */
+#define BLK_STAT_POLL_WIN	(HZ / 10)
+
+static void blk_stat_poll_timer_fn(unsigned long data)
+{
+	struct request_queue *q = (struct request_queue *)data;
+	struct blk_poll_stat *ps = q->poll_stat;
+	bool active = false;
+	int cpu, bkt;
+
+	for (bkt = 0; bkt < BLK_STAT_POLL_BKTS; bkt++) {
+		u64 total_ns = 0, nr = 0;
+
+		for_each_possible_cpu(cpu) {
+			struct blk_rq_stat *stat = per_cpu_ptr(q->stats, cpu);
+
+			total_ns += stat->poll_total_ns[bkt];
+			nr += stat->poll_nr[bkt];
+		}
+
+		/* an empty window keeps the old mean */
+		if (nr > ps->last_nr[bkt]) {
+			ps->mean_ns[bkt] = div64_u64(total_ns -
+						     ps->last_total_ns[bkt],
+						     nr - ps->last_nr[bkt]);
+			active = true;
+		}
+		ps->last_total_ns[bkt] = total_ns;
+		ps->last_nr[bkt] = nr;
+	}
+
+	if (active)
+		mod_timer(&ps->timer, jiffies + BLK_STAT_POLL_WIN);
+}
+
+int blk_stat_alloc(struct request_queue *q)
+{
+	q->stats = alloc_percpu(struct blk_rq_stat);
+	if (!q->stats)
+		return -ENOMEM;
+
+	q->poll_stat = kzalloc(sizeof(*q->poll_stat), GFP_KERNEL);
+	if (!q->poll_stat) {
+		free_percpu(q->stats);
+		q->stats = NULL;
+		return -ENOMEM;
+	}
+	setup_timer(&q->poll_stat->timer, blk_stat_poll_timer_fn,
+		    (unsigned long)q);
+	return 0;
+}
+
+void blk_stat_free(struct request_queue *q)
+{
+	if (q->poll_stat)
+		del_timer_sync(&q->poll_stat->timer);
+	kfree(q->poll_stat);
+	q->poll_stat = NULL;
+	free_percpu(q->stats);
+	q->stats = NULL;
+}
+
+static int blk_stat_op(struct request *rq)
+{
+	if (rq->cmd_flags & REQ_DISCARD)
+		return BLK_STAT_DISCARD;
+	if ((rq->cmd_flags & REQ_FLUSH) && !blk_rq_bytes(rq))
+		return BLK_STAT_FLUSH;
+	return rq_data_dir(rq) == WRITE ? BLK_STAT_WRITE : BLK_STAT_READ;
+}
+
+static int blk_stat_poll_bkt(struct request *rq)
+{
+	int bkt = ilog2(max(rq->issue_bytes, 512U)) - 9;
+
+	bkt = min(bkt, BLK_STAT_POLL_BKTS / 2 - 1);
+	return 2 * bkt + rq_data_dir(rq);
+}
+
+/*
+ * Called on completion of @rq from any context.  The per-cpu counters are
+ * only ever added to with this_cpu ops, so completions interrupting each
+ * other can't lose counts, at worst a maximum.
+ */
+void blk_stat_add(struct request *rq)
+{
+	struct blk_rq_stat __percpu *stats = rq->q->stats;
+	u64 now, lat_ns;
+	int op, bucket;
+
+	if (!rq->issue_time_ns || rq->cmd_type != REQ_TYPE_FS)
+		return;
+
+	now = ktime_get_ns();
+	lat_ns = now > rq->issue_time_ns ? now - rq->issue_time_ns : 0;
+	rq->issue_time_ns = 0;
+
+	op = blk_stat_op(rq);
+	bucket = min_t(int, fls64(div_u64(lat_ns, NSEC_PER_USEC)),
+		       BLK_STAT_BUCKETS - 1);
+
+	this_cpu_inc(stats->hist[op][bucket]);
+	this_cpu_add(stats->total_ns[op], lat_ns);
+	if (lat_ns > this_cpu_read(stats->max_ns[op]))
+		this_cpu_write(stats->max_ns[op], lat_ns);
+
+	if (op <= BLK_STAT_WRITE &&
+	    test_bit(QUEUE_FLAG_POLL, &rq->q->queue_flags)) {
+		bucket = blk_stat_poll_bkt(rq);
+		this_cpu_add(stats->poll_total_ns[bucket], lat_ns);
+		this_cpu_inc(stats->poll_nr[bucket]);
+	}
+}
+
+/*
+ * Mean completion time of requests like @rq in the last window, or 0 if
+ * there were none.  Polling starts the window timer if it isn't running.
+ */
+u64 blk_stat_poll_mean(struct request_queue *q, struct request *rq)
+{
+	struct blk_poll_stat *ps = q->poll_stat;
+
+	if (!timer_pending(&ps->timer))
+		mod_timer(&ps->timer, jiffies + BLK_STAT_POLL_WIN);
+
+	return ps->mean_ns[blk_stat_poll_bkt(rq)];
+}
+
+ssize_t blk_stat_show(struct request_queue *q, char *page)
+{
+	struct blk_rq_stat sum;
+	ssize_t num_char = 0;
+	u64 samples[BLK_STAT_OPS] = { };
+	int cpu, op, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct blk_rq_stat *stat = per_cpu_ptr(q->stats, cpu);
+
+		for (op = 0; op < BLK_STAT_OPS; op++) {
+			for (i = 0; i < BLK_STAT_BUCKETS; i++)
+				sum.hist[op][i] += stat->hist[op][i];
+			sum.total_ns[op] += stat->total_ns[op];
+			sum.max_ns[op] = max(sum.max_ns[op], stat->max_ns[op]);
+		}
+	}
+
+	num_char += sprintf(page, "%10s", "usecs <");
+	for (op = 0; op < BLK_STAT_OPS; op++)
+		num_char += sprintf(page + num_char, " %10s",
+				    blk_stat_op_names[op]);
+	num_char += sprintf(page + num_char, "\n");
+
+	for (i = 0; i < BLK_STAT_BUCKETS; i++) {
+		if (i < BLK_STAT_BUCKETS - 1)
+			num_char += sprintf(page + num_char, "%10lu", 1UL << i);
+		else
+			num_char += sprintf(page + num_char, "%10s", "inf");
+		for (op = 0; op < BLK_STAT_OPS; op++) {
+			samples[op] += sum.hist[op][i];
+			num_char += sprintf(page + num_char, " %10llu",
+				(unsigned long long)sum.hist[op][i]);
+		}
+		num_char += sprintf(page + num_char, "\n");
+	}
+
+	num_char += sprintf(page + num_char, "%10s", "mean");
+	for (op = 0; op < BLK_STAT_OPS; op++)
+		num_char += sprintf(page + num_char, " %10llu",
+			(unsigned long long)(samples[op] ?
+			div64_u64(sum.total_ns[op], samples[op] *
+				  NSEC_PER_USEC) : 0));
+	num_char += sprintf(page + num_char, "\n%10s", "max");
+	for (op = 0; op < BLK_STAT_OPS; op++)
+		num_char += sprintf(page + num_char, " %10llu",
+			(unsigned long long)div_u64(sum.max_ns[op],
+						    NSEC_PER_USEC));
+	num_char += sprintf(page + num_char, "\n");
+
+	return num_char;
+}
+
+/*
+ * Completions racing with this may survive it.  The poll counters are
+ * left alone, the poll window only looks at their deltas.
+ */
+void blk_stat_clear(struct request_queue *q)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(q->stats, cpu), 0,
+		       offsetof(struct blk_rq_stat, poll_total_ns));
+}
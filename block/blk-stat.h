@@ -0,0 +1,65 @@
+#ifndef BLK_STAT_H
+#define BLK_STAT_H
+
+#include <linux/blkdev.h>
+#include <linux/ktime.h>
+#include <linux/timer.h>
+
+/* operations with a latency histogram of their own */
+enum {
+	BLK_STAT_READ,
+	BLK_STAT_WRITE,
+	BLK_STAT_DISCARD,
+	BLK_STAT_FLUSH,
+	BLK_STAT_OPS,
+};
+
+/* log2 usecs buckets, the last one takes everything from ~4s up */
+#define BLK_STAT_BUCKETS	24
+
+/*
+ * Polled reads and writes, by direction and log2 size from 512 bytes up
+ * to 64k and larger.
+ */
+#define BLK_STAT_POLL_BKTS	16
+
+/*
+ * Per-cpu latency of the requests of a queue, from the driver being
+ * handed a request to its completion.  The poll counters are only kept
+ * while the queue is polled, and survive clearing the histograms.
+ */
+struct blk_rq_stat {
+	u64			hist[BLK_STAT_OPS][BLK_STAT_BUCKETS];
+	u64			total_ns[BLK_STAT_OPS];
+	u64			max_ns[BLK_STAT_OPS];
+
+	u64			poll_total_ns[BLK_STAT_POLL_BKTS];
+	u64			poll_nr[BLK_STAT_POLL_BKTS];
+};
+
+/*
+ * Mean completion time of the polled requests of the last window, for
+ * the hybrid poll sleep.  The window timer only runs while the queue
+ * keeps getting polled.
+ */
+struct blk_poll_stat {
+	struct timer_list	timer;
+	u64			mean_ns[BLK_STAT_POLL_BKTS];
+	u64			last_total_ns[BLK_STAT_POLL_BKTS];
+	u64			last_nr[BLK_STAT_POLL_BKTS];
+};
+
+int blk_stat_alloc(struct request_queue *q);
+void blk_stat_free(struct request_queue *q);
+void blk_stat_add(struct request *rq);
+ssize_t blk_stat_show(struct request_queue *q, char *page);
+void blk_stat_clear(struct request_queue *q);
+u64 blk_stat_poll_mean(struct request_queue *q, struct request *rq);
+
+static inline void blk_stat_set_issue(struct request *rq)
+{
+	rq->issue_time_ns = ktime_get_ns();
+	rq->issue_bytes = blk_rq_bytes(rq);
+}
+
+#endif
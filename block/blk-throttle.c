@@ -21,6 +21,15 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/* what a group without a low limit gets while low limits are enforced */
+#define MIN_THROTL_BPS		(320 * 1024)
+#define MIN_THROTL_IOPS		10
+
+/* think time above which a group is idle, in usecs */
+#define DFL_IDLE_THRESHOLD_SSD	1000L		/* 1 ms */
+#define DFL_IDLE_THRESHOLD_HD	(100L * 1000)	/* 100 ms */
+#define MAX_IDLE_TIME		(5L * 1000 * 1000) /* 5 s */
+
 static struct blkcg_policy blkcg_policy_throtl;
 
 /* A workqueue to queue throttle related work */
@@ -83,6 +92,19 @@ enum tg_state_flags {
 
 #define rb_entry_tg(node)	rb_entry((node), struct throtl_grp, rb_node)
 
+/*
+ * Each group has two sets of limits.  While some group has a low limit,
+ * the queue starts out enforcing the low limits of every group, and
+ * switches to the max limits only once each group with a low limit is
+ * either using it up or idle.  It switches back as soon as a busy group
+ * falls below its low limit.
+ */
+enum {
+	LIMIT_LOW,
+	LIMIT_MAX,
+	LIMIT_CNT,
+};
+
 struct throtl_grp {
 	/* must be the first member */
 	struct blkg_policy_data pd;
@@ -119,11 +141,14 @@ struct throtl_grp {
 	/* are there any throtl rules between this group and td? */
 	bool has_rules[2];
 
-	/* bytes per second rate limits */
-	uint64_t bps[2];
+	/*
+	 * bytes per second rate limits, -1 for no max limit and 0 for no
+	 * low limit
+	 */
+	uint64_t bps[2][LIMIT_CNT];
 
-	/* IOPS limits */
-	unsigned int iops[2];
+	/* IOPS limits, same conventions */
+	unsigned int iops[2][LIMIT_CNT];
 
 	/* Number of bytes disptached in current slice */
 	uint64_t bytes_disp[2];
@@ -133,6 +158,30 @@ struct throtl_grp {
 	/* When did we start a new slice */
 	unsigned long slice_start[2];
 	unsigned long slice_end[2];
+
+	/* dispatched since the last check for a downgrade */
+	uint64_t last_bytes_disp[2];
+	unsigned int last_io_disp[2];
+	unsigned long last_check_time;
+
+	/* last time the group was throttled at, or reached, its low limit */
+	unsigned long last_low_overflow_time[2];
+
+	/*
+	 * Idle detection.  Times are in usecs.  The group is idle if its
+	 * average think time, from the completion of a bio to the
+	 * submission of the next one, is above idletime_threshold, or if
+	 * no more than one in five of its bios take longer than
+	 * latency_target (0 for none) to complete.
+	 */
+	unsigned long idletime_threshold;
+	unsigned long latency_target;
+	unsigned long last_finish_time;
+	unsigned long checked_last_finish_time;
+	unsigned long avg_idletime;
+	unsigned int bio_cnt;
+	unsigned int bad_bio_cnt;
+	unsigned long bio_cnt_reset_time;
 };
 
 struct throtl_data
@@ -152,10 +201,23 @@ struct throtl_data
 
 	/* Work for dispatching throttled bios */
 	struct work_struct dispatch_work;
+
+	/* set of limits in force, and whether each set is configured */
+	unsigned int limit_index;
+	bool limit_valid[LIMIT_CNT];
+
+	unsigned long low_upgrade_time;
+	unsigned long low_downgrade_time;
 };
 
 static void throtl_pending_timer_fn(unsigned long arg);
 
+static unsigned long throtl_dfl_idle_threshold(struct throtl_data *td)
+{
+	return blk_queue_nonrot(td->queue) ?
+		DFL_IDLE_THRESHOLD_SSD : DFL_IDLE_THRESHOLD_HD;
+}
+
 static inline struct throtl_grp *pd_to_tg(struct blkg_policy_data *pd)
 {
 	return pd ? container_of(pd, struct throtl_grp, pd) : NULL;
@@ -203,6 +265,50 @@ static struct throtl_data *sq_to_td(struct throtl_service_queue *sq)
 		return container_of(sq, struct throtl_data, service_queue);
 }
 
+/*
+ * While low limits are in force, a leaf group without one gets a token
+ * bandwidth, so that it only runs freely once the groups with low limits
+ * are served.  Intermediate groups are only limited through their
+ * children.
+ */
+static uint64_t tg_bps_limit(struct throtl_grp *tg, int rw)
+{
+	struct blkcg_gq *blkg = tg_to_blkg(tg);
+	struct throtl_data *td = tg->td;
+	uint64_t ret;
+
+	if (cgroup_subsys_on_dfl(io_cgrp_subsys) && !blkg->parent)
+		return -1;
+
+	ret = tg->bps[rw][td->limit_index];
+	if (ret == 0 && td->limit_index == LIMIT_LOW) {
+		if (!list_empty(&blkg->blkcg->css.children) ||
+		    tg->iops[rw][LIMIT_LOW])
+			return -1;
+		return MIN_THROTL_BPS;
+	}
+	return ret;
+}
+
+static unsigned int tg_iops_limit(struct throtl_grp *tg, int rw)
+{
+	struct blkcg_gq *blkg = tg_to_blkg(tg);
+	struct throtl_data *td = tg->td;
+	unsigned int ret;
+
+	if (cgroup_subsys_on_dfl(io_cgrp_subsys) && !blkg->parent)
+		return -1;
+
+	ret = tg->iops[rw][td->limit_index];
+	if (ret == 0 && td->limit_index == LIMIT_LOW) {
+		if (!list_empty(&blkg->blkcg->css.children) ||
+		    tg->bps[rw][LIMIT_LOW])
+			return -1;
+		return MIN_THROTL_IOPS;
+	}
+	return ret;
+}
+
 /**
  * throtl_log - log debug message via blktrace
  * @sq: the service_queue being reported
@@ -340,10 +446,10 @@ static struct blkg_policy_data *throtl_pd_alloc(gfp_t gfp, int node)
 	}
 
 	RB_CLEAR_NODE(&tg->rb_node);
-	tg->bps[READ] = -1;
-	tg->bps[WRITE] = -1;
-	tg->iops[READ] = -1;
-	tg->iops[WRITE] = -1;
+	tg->bps[READ][LIMIT_MAX] = -1;
+	tg->bps[WRITE][LIMIT_MAX] = -1;
+	tg->iops[READ][LIMIT_MAX] = -1;
+	tg->iops[WRITE][LIMIT_MAX] = -1;
 
 	return &tg->pd;
 }
@@ -372,21 +478,27 @@ static void throtl_pd_init(struct blkg_policy_data *pd)
 	if (cgroup_subsys_on_dfl(io_cgrp_subsys) && blkg->parent)
 		sq->parent_sq = &blkg_to_tg(blkg->parent)->service_queue;
 	tg->td = td;
+
+	tg->idletime_threshold = throtl_dfl_idle_threshold(td);
 }
 
 /*
  * Set has_rules[] if @tg or any of its parents have limits configured.
  * This doesn't require walking up to the top of the hierarchy as the
- * parent's has_rules[] is guaranteed to be correct.
+ * parent's has_rules[] is guaranteed to be correct.  Any low limit on
+ * the queue makes every group subject to rules, see tg_bps_limit().
  */
 static void tg_update_has_rules(struct throtl_grp *tg)
 {
 	struct throtl_grp *parent_tg = sq_to_tg(tg->service_queue.parent_sq);
+	struct throtl_data *td = tg->td;
 	int rw;
 
 	for (rw = READ; rw <= WRITE; rw++)
 		tg->has_rules[rw] = (parent_tg && parent_tg->has_rules[rw]) ||
-				    (tg->bps[rw] != -1 || tg->iops[rw] != -1);
+				    td->limit_valid[LIMIT_LOW] ||
+				    tg->bps[rw][LIMIT_MAX] != -1 ||
+				    tg->iops[rw][LIMIT_MAX] != -1;
 }
 
 static void throtl_pd_online(struct blkg_policy_data *pd)
@@ -649,11 +761,11 @@ static inline void throtl_trim_slice(struct throtl_grp *tg, bool rw)
 
 	if (!nr_slices)
 		return;
-	tmp = tg->bps[rw] * throtl_slice * nr_slices;
+	tmp = tg_bps_limit(tg, rw) * throtl_slice * nr_slices;
 	do_div(tmp, HZ);
 	bytes_trim = tmp;
 
-	io_trim = (tg->iops[rw] * throtl_slice * nr_slices)/HZ;
+	io_trim = (tg_iops_limit(tg, rw) * throtl_slice * nr_slices)/HZ;
 
 	if (!bytes_trim && !io_trim)
 		return;
@@ -699,7 +811,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	 * have been trimmed.
 	 */
 
-	tmp = (u64)tg->iops[rw] * jiffy_elapsed_rnd;
+	tmp = (u64)tg_iops_limit(tg, rw) * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 
 	if (tmp > UINT_MAX)
@@ -714,7 +826,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	}
 
 	/* Calc approx time to dispatch */
-	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg->iops[rw] + 1;
+	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg_iops_limit(tg, rw) + 1;
 
 	if (jiffy_wait > jiffy_elapsed)
 		jiffy_wait = jiffy_wait - jiffy_elapsed;
@@ -741,7 +853,7 @@ static bool tg_with_in_bps_limit(struct throtl_grp *tg, struct bio *bio,
 
 	jiffy_elapsed_rnd = roundup(jiffy_elapsed_rnd, throtl_slice);
 
-	tmp = tg->bps[rw] * jiffy_elapsed_rnd;
+	tmp = tg_bps_limit(tg, rw) * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 	bytes_allowed = tmp;
 
@@ -753,7 +865,7 @@ static bool tg_with_in_bps_limit(struct throtl_grp *tg, struct bio *bio,
 
 	/* Calc approx time to dispatch */
 	extra_bytes = tg->bytes_disp[rw] + bio->bi_iter.bi_size - bytes_allowed;
-	jiffy_wait = div64_u64(extra_bytes * HZ, tg->bps[rw]);
+	jiffy_wait = div64_u64(extra_bytes * HZ, tg_bps_limit(tg, rw));
 
 	if (!jiffy_wait)
 		jiffy_wait = 1;
@@ -788,7 +900,7 @@ static bool tg_may_dispatch(struct throtl_grp *tg, struct bio *bio,
 	       bio != throtl_peek_queued(&tg->service_queue.queued[rw]));
 
 	/* If tg->bps = -1, then BW is unlimited */
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1) {
+	if (tg_bps_limit(tg, rw) == -1 && tg_iops_limit(tg, rw) == -1) {
 		if (wait)
 			*wait = 0;
 		return true;
@@ -831,6 +943,8 @@ static void throtl_charge_bio(struct throtl_grp *tg, struct bio *bio)
 	/* Charge the bio to the group */
 	tg->bytes_disp[rw] += bio->bi_iter.bi_size;
 	tg->io_disp[rw]++;
+	tg->last_bytes_disp[rw] += bio->bi_iter.bi_size;
+	tg->last_io_disp[rw]++;
 
 	/*
 	 * REQ_THROTTLED is used to prevent the same bio to be throttled
@@ -1012,6 +1126,288 @@ static int throtl_select_dispatch(struct throtl_service_queue *parent_sq)
 	return nr_disp;
 }
 
+/*
+ * The limits in force changed.  Let every group dispatch against the new
+ * limits right away instead of waiting out dispatch times computed from
+ * the old ones.
+ */
+static void throtl_state_changed(struct throtl_data *td)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+
+		if (!tg)
+			continue;
+		tg->disptime = jiffies - 1;
+		throtl_select_dispatch(&tg->service_queue);
+		throtl_schedule_next_dispatch(&tg->service_queue, true);
+	}
+	rcu_read_unlock();
+	throtl_select_dispatch(&td->service_queue);
+	throtl_schedule_next_dispatch(&td->service_queue, true);
+	queue_work(kthrotld_workqueue, &td->dispatch_work);
+}
+
+static bool tg_has_low_limit(struct throtl_grp *tg, int rw)
+{
+	return tg->bps[rw][LIMIT_LOW] || tg->iops[rw][LIMIT_LOW];
+}
+
+/*
+ * Low limits.  While any group on the queue has one, the queue starts out
+ * enforcing the low limits.  It upgrades to the max limits once every
+ * group with a low limit is either served up to it or idle, and
+ * downgrades again as soon as such a group is busy but stays below its
+ * low limit for a slice.
+ */
+static unsigned long __tg_last_low_overflow_time(struct throtl_grp *tg)
+{
+	unsigned long rtime = jiffies, wtime = jiffies;
+
+	if (tg_has_low_limit(tg, READ))
+		rtime = tg->last_low_overflow_time[READ];
+	if (tg_has_low_limit(tg, WRITE))
+		wtime = tg->last_low_overflow_time[WRITE];
+	return min(rtime, wtime);
+}
+
+/* @tg must be a leaf, intermediate groups are limited by their children */
+static unsigned long tg_last_low_overflow_time(struct throtl_grp *tg)
+{
+	struct throtl_grp *parent = tg;
+	unsigned long ret = __tg_last_low_overflow_time(tg);
+
+	while ((parent = sq_to_tg(parent->service_queue.parent_sq))) {
+		/*
+		 * A parent without a low limit always reaches it, its
+		 * overflow time tells nothing about the children.
+		 */
+		if (!tg_has_low_limit(parent, READ) &&
+		    !tg_has_low_limit(parent, WRITE))
+			continue;
+		if (time_after(__tg_last_low_overflow_time(parent), ret))
+			ret = __tg_last_low_overflow_time(parent);
+	}
+	return ret;
+}
+
+static bool throtl_tg_is_idle(struct throtl_grp *tg)
+{
+	unsigned long now = ktime_get_ns() >> 10;
+	unsigned long time = min_t(unsigned long, MAX_IDLE_TIME,
+				   4 * tg->idletime_threshold);
+
+	return now - tg->last_finish_time > time ||
+	       tg->avg_idletime > tg->idletime_threshold ||
+	       (tg->latency_target && tg->bio_cnt &&
+		tg->bad_bio_cnt * 5 < tg->bio_cnt);
+}
+
+static bool throtl_tg_can_upgrade(struct throtl_grp *tg)
+{
+	struct throtl_service_queue *sq = &tg->service_queue;
+	bool read_limit, write_limit;
+
+	/* a group without a low limit always reaches it */
+	read_limit = tg_has_low_limit(tg, READ);
+	write_limit = tg_has_low_limit(tg, WRITE);
+	if (!read_limit && !write_limit)
+		return true;
+
+	/* throttled at its low limit in every direction it has one */
+	if ((!read_limit || sq->nr_queued[READ]) &&
+	    (!write_limit || sq->nr_queued[WRITE]))
+		return true;
+
+	return time_after_eq(jiffies,
+			     tg_last_low_overflow_time(tg) + throtl_slice) &&
+	       throtl_tg_is_idle(tg);
+}
+
+static bool throtl_hierarchy_can_upgrade(struct throtl_grp *tg)
+{
+	while (true) {
+		if (throtl_tg_can_upgrade(tg))
+			return true;
+		tg = sq_to_tg(tg->service_queue.parent_sq);
+		if (!tg || !tg_to_blkg(tg)->parent)
+			return false;
+	}
+}
+
+/* may @td switch to the max limits, not counting @this_tg? */
+static bool throtl_can_upgrade(struct throtl_data *td,
+			       struct throtl_grp *this_tg)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+
+	if (td->limit_index != LIMIT_LOW)
+		return false;
+
+	if (time_before(jiffies, td->low_downgrade_time + throtl_slice))
+		return false;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+
+		if (!tg || tg == this_tg)
+			continue;
+		if (!list_empty(&blkg->blkcg->css.children))
+			continue;
+		if (!throtl_hierarchy_can_upgrade(tg)) {
+			rcu_read_unlock();
+			return false;
+		}
+	}
+	rcu_read_unlock();
+	return true;
+}
+
+static void throtl_upgrade_state(struct throtl_data *td)
+{
+	throtl_log(&td->service_queue, "upgrade to max");
+	td->limit_index = LIMIT_MAX;
+	td->low_upgrade_time = jiffies;
+	throtl_state_changed(td);
+}
+
+static void throtl_downgrade_state(struct throtl_data *td)
+{
+	throtl_log(&td->service_queue, "downgrade to low");
+	td->limit_index = LIMIT_LOW;
+	td->low_downgrade_time = jiffies;
+}
+
+static void throtl_reset_last_disp(struct throtl_grp *tg, unsigned long now)
+{
+	int rw;
+
+	tg->last_check_time = now;
+	for (rw = READ; rw <= WRITE; rw++) {
+		tg->last_bytes_disp[rw] = 0;
+		tg->last_io_disp[rw] = 0;
+	}
+}
+
+static void throtl_upgrade_check(struct throtl_grp *tg)
+{
+	unsigned long now = jiffies;
+
+	if (tg->td->limit_index != LIMIT_LOW)
+		return;
+
+	if (time_after(tg->last_check_time + throtl_slice, now))
+		return;
+
+	throtl_reset_last_disp(tg, now);
+
+	if (time_before(now, __tg_last_low_overflow_time(tg) + throtl_slice))
+		return;
+
+	if (throtl_can_upgrade(tg->td, NULL))
+		throtl_upgrade_state(tg->td);
+}
+
+static bool throtl_tg_can_downgrade(struct throtl_grp *tg)
+{
+	unsigned long now = jiffies;
+
+	/*
+	 * Busy, or with children that may be, and below its low limit for
+	 * a whole slice: the groups running above theirs are in the way.
+	 */
+	return time_after_eq(now, tg->td->low_upgrade_time + throtl_slice) &&
+	       time_after_eq(now,
+			     tg_last_low_overflow_time(tg) + throtl_slice) &&
+	       (!throtl_tg_is_idle(tg) ||
+		!list_empty(&tg_to_blkg(tg)->blkcg->css.children));
+}
+
+static bool throtl_hierarchy_can_downgrade(struct throtl_grp *tg)
+{
+	while (true) {
+		if (!throtl_tg_can_downgrade(tg))
+			return false;
+		tg = sq_to_tg(tg->service_queue.parent_sq);
+		if (!tg || !tg_to_blkg(tg)->parent)
+			return true;
+	}
+}
+
+static void throtl_downgrade_check(struct throtl_grp *tg)
+{
+	unsigned long now = jiffies;
+	unsigned long elapsed_time;
+	uint64_t bps;
+	int rw;
+
+	if (tg->td->limit_index != LIMIT_MAX ||
+	    !tg->td->limit_valid[LIMIT_LOW])
+		return;
+	if (!list_empty(&tg_to_blkg(tg)->blkcg->css.children))
+		return;
+	if (time_after(tg->last_check_time + throtl_slice, now))
+		return;
+
+	elapsed_time = now - tg->last_check_time;
+
+	/* a group dispatching at or above its low limit has reached it */
+	for (rw = READ; rw <= WRITE; rw++) {
+		if (tg->bps[rw][LIMIT_LOW]) {
+			bps = tg->last_bytes_disp[rw] * HZ;
+			do_div(bps, elapsed_time);
+			if (bps >= tg->bps[rw][LIMIT_LOW])
+				tg->last_low_overflow_time[rw] = now;
+		}
+		if (tg->iops[rw][LIMIT_LOW] &&
+		    div_u64((u64)tg->last_io_disp[rw] * HZ, elapsed_time) >=
+		    tg->iops[rw][LIMIT_LOW])
+			tg->last_low_overflow_time[rw] = now;
+	}
+
+	if (throtl_hierarchy_can_downgrade(tg))
+		throtl_downgrade_state(tg->td);
+
+	throtl_reset_last_disp(tg, now);
+}
+
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+/* time the bio to its completion, see blk_throtl_bio_endio() */
+static void blk_throtl_assoc_bio(struct throtl_grp *tg, struct bio *bio)
+{
+	if (!tg->td->limit_valid[LIMIT_LOW] || bio->bi_throtl_blkg)
+		return;
+
+	blkg_get(tg_to_blkg(tg));
+	bio->bi_throtl_blkg = tg_to_blkg(tg);
+	bio->bi_throtl_issue = ktime_get_ns();
+}
+
+/* fold the think time since the last completion into the average */
+static void blk_throtl_update_idletime(struct throtl_grp *tg)
+{
+	unsigned long now = ktime_get_ns() >> 10;
+	unsigned long last_finish_time = tg->last_finish_time;
+
+	if (now <= last_finish_time || !last_finish_time ||
+	    last_finish_time == tg->checked_last_finish_time)
+		return;
+
+	tg->avg_idletime = (tg->avg_idletime * 7 + now - last_finish_time) >> 3;
+	tg->checked_last_finish_time = last_finish_time;
+}
+#else
+static inline void blk_throtl_assoc_bio(struct throtl_grp *tg,
+					struct bio *bio) { }
+static inline void blk_throtl_update_idletime(struct throtl_grp *tg) { }
+#endif
+
 /**
  * throtl_pending_timer_fn - timer function for service_queue->pending_timer
  * @arg: the throtl_service_queue being serviced
@@ -1038,6 +1434,8 @@ static void throtl_pending_timer_fn(unsigned long arg)
 	int ret;
 
 	spin_lock_irq(q->queue_lock);
+	if (throtl_can_upgrade(td, NULL))
+		throtl_upgrade_state(td);
 again:
 	parent_sq = sq->parent_sq;
 	dispatched = false;
@@ -1155,25 +1553,65 @@ static int tg_print_conf_uint(struct seq_file *sf, void *v)
 	return 0;
 }
 
+/* are low limits configured for any group on @td? */
+static void blk_throtl_update_limit_valid(struct throtl_data *td)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+	bool low_valid = false;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+
+		if (tg && (tg_has_low_limit(tg, READ) ||
+			   tg_has_low_limit(tg, WRITE))) {
+			low_valid = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	td->limit_valid[LIMIT_LOW] = low_valid;
+}
+
 static void tg_conf_updated(struct throtl_grp *tg)
 {
+	struct throtl_data *td = tg->td;
 	struct throtl_service_queue *sq = &tg->service_queue;
 	struct cgroup_subsys_state *pos_css;
-	struct blkcg_gq *blkg;
+	struct blkcg_gq *blkg, *top = tg_to_blkg(tg);
+	bool low_valid = td->limit_valid[LIMIT_LOW];
 
 	throtl_log(&tg->service_queue,
 		   "limit change rbps=%llu wbps=%llu riops=%u wiops=%u",
-		   tg->bps[READ], tg->bps[WRITE],
-		   tg->iops[READ], tg->iops[WRITE]);
+		   tg_bps_limit(tg, READ), tg_bps_limit(tg, WRITE),
+		   tg_iops_limit(tg, READ), tg_iops_limit(tg, WRITE));
+
+	/*
+	 * The first low limit on the queue puts it in the low state, and
+	 * removing the last one lets it go back to the max limits for good.
+	 */
+	blk_throtl_update_limit_valid(td);
+	if (td->limit_valid[LIMIT_LOW] != low_valid) {
+		if (td->limit_valid[LIMIT_LOW]) {
+			td->limit_index = LIMIT_LOW;
+			td->low_downgrade_time = jiffies;
+		} else {
+			td->limit_index = LIMIT_MAX;
+			td->low_upgrade_time = jiffies;
+		}
+		top = td->queue->root_blkg;
+	}
 
 	/*
 	 * Update has_rules[] flags for the updated tg's subtree.  A tg is
 	 * considered to have rules if either the tg itself or any of its
 	 * ancestors has rules.  This identifies groups without any
 	 * restrictions in the whole hierarchy and allows them to bypass
-	 * blk-throttle.
+	 * blk-throttle.  Low limits being in use affects every group.
 	 */
-	blkg_for_each_descendant_pre(blkg, pos_css, tg_to_blkg(tg))
+	blkg_for_each_descendant_pre(blkg, pos_css, top)
 		tg_update_has_rules(blkg_to_tg(blkg));
 
 	/*
@@ -1187,7 +1625,9 @@ static void tg_conf_updated(struct throtl_grp *tg)
 	throtl_start_new_slice(tg, 0);
 	throtl_start_new_slice(tg, 1);
 
-	if (tg->flags & THROTL_TG_PENDING) {
+	if (td->limit_valid[LIMIT_LOW] != low_valid) {
+		throtl_state_changed(td);
+	} else if (tg->flags & THROTL_TG_PENDING) {
 		tg_update_disptime(tg);
 		throtl_schedule_next_dispatch(sq->parent_sq, true);
 	}
@@ -1241,25 +1681,25 @@ static ssize_t tg_set_conf_uint(struct kernfs_open_file *of,
 static struct cftype throtl_legacy_files[] = {
 	{
 		.name = "throttle.read_bps_device",
-		.private = offsetof(struct throtl_grp, bps[READ]),
+		.private = offsetof(struct throtl_grp, bps[READ][LIMIT_MAX]),
 		.seq_show = tg_print_conf_u64,
 		.write = tg_set_conf_u64,
 	},
 	{
 		.name = "throttle.write_bps_device",
-		.private = offsetof(struct throtl_grp, bps[WRITE]),
+		.private = offsetof(struct throtl_grp, bps[WRITE][LIMIT_MAX]),
 		.seq_show = tg_print_conf_u64,
 		.write = tg_set_conf_u64,
 	},
 	{
 		.name = "throttle.read_iops_device",
-		.private = offsetof(struct throtl_grp, iops[READ]),
+		.private = offsetof(struct throtl_grp, iops[READ][LIMIT_MAX]),
 		.seq_show = tg_print_conf_uint,
 		.write = tg_set_conf_uint,
 	},
 	{
 		.name = "throttle.write_iops_device",
-		.private = offsetof(struct throtl_grp, iops[WRITE]),
+		.private = offsetof(struct throtl_grp, iops[WRITE][LIMIT_MAX]),
 		.seq_show = tg_print_conf_uint,
 		.write = tg_set_conf_uint,
 	},
@@ -1276,48 +1716,75 @@ static struct cftype throtl_legacy_files[] = {
 	{ }	/* terminate */
 };
 
-static u64 tg_prfill_max(struct seq_file *sf, struct blkg_policy_data *pd,
-			 int off)
+static u64 tg_prfill_limit(struct seq_file *sf, struct blkg_policy_data *pd,
+			   int off)
 {
 	struct throtl_grp *tg = pd_to_tg(pd);
 	const char *dname = blkg_dev_name(pd->blkg);
 	char bufs[4][21] = { "max", "max", "max", "max" };
+	char extra[64] = "";
+	u64 bps_dft;
+	unsigned int iops_dft;
 
 	if (!dname)
 		return 0;
-	if (tg->bps[READ] == -1 && tg->bps[WRITE] == -1 &&
-	    tg->iops[READ] == -1 && tg->iops[WRITE] == -1)
+
+	if (off == LIMIT_LOW) {
+		bps_dft = 0;
+		iops_dft = 0;
+	} else {
+		bps_dft = -1;
+		iops_dft = -1;
+	}
+
+	if (tg->bps[READ][off] == bps_dft &&
+	    tg->bps[WRITE][off] == bps_dft &&
+	    tg->iops[READ][off] == iops_dft &&
+	    tg->iops[WRITE][off] == iops_dft &&
+	    (off != LIMIT_LOW || (!tg->latency_target &&
+	     tg->idletime_threshold == throtl_dfl_idle_threshold(tg->td))))
 		return 0;
 
-	if (tg->bps[READ] != -1)
-		snprintf(bufs[0], sizeof(bufs[0]), "%llu", tg->bps[READ]);
-	if (tg->bps[WRITE] != -1)
-		snprintf(bufs[1], sizeof(bufs[1]), "%llu", tg->bps[WRITE]);
-	if (tg->iops[READ] != -1)
-		snprintf(bufs[2], sizeof(bufs[2]), "%u", tg->iops[READ]);
-	if (tg->iops[WRITE] != -1)
-		snprintf(bufs[3], sizeof(bufs[3]), "%u", tg->iops[WRITE]);
-
-	seq_printf(sf, "%s rbps=%s wbps=%s riops=%s wiops=%s\n",
-		   dname, bufs[0], bufs[1], bufs[2], bufs[3]);
+	if (tg->bps[READ][off] != -1)
+		snprintf(bufs[0], sizeof(bufs[0]), "%llu", tg->bps[READ][off]);
+	if (tg->bps[WRITE][off] != -1)
+		snprintf(bufs[1], sizeof(bufs[1]), "%llu", tg->bps[WRITE][off]);
+	if (tg->iops[READ][off] != -1)
+		snprintf(bufs[2], sizeof(bufs[2]), "%u", tg->iops[READ][off]);
+	if (tg->iops[WRITE][off] != -1)
+		snprintf(bufs[3], sizeof(bufs[3]), "%u", tg->iops[WRITE][off]);
+	if (off == LIMIT_LOW)
+		snprintf(extra, sizeof(extra), " idle=%lu latency=%lu",
+			 tg->idletime_threshold, tg->latency_target);
+
+	seq_printf(sf, "%s rbps=%s wbps=%s riops=%s wiops=%s%s\n",
+		   dname, bufs[0], bufs[1], bufs[2], bufs[3], extra);
 	return 0;
 }
 
-static int tg_print_max(struct seq_file *sf, void *v)
+static int tg_print_limit(struct seq_file *sf, void *v)
 {
-	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), tg_prfill_max,
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), tg_prfill_limit,
 			  &blkcg_policy_throtl, seq_cft(sf)->private, false);
 	return 0;
 }
 
-static ssize_t tg_set_max(struct kernfs_open_file *of,
-			  char *buf, size_t nbytes, loff_t off)
+/*
+ * "max" takes rbps, wbps, riops and wiops, each a positive number or
+ * "max".  "low" takes the same, where 0 removes the limit, plus the idle
+ * threshold and the latency target in usecs.  A low limit can't be above
+ * the max one.
+ */
+static ssize_t tg_set_limit(struct kernfs_open_file *of,
+			    char *buf, size_t nbytes, loff_t off)
 {
 	struct blkcg *blkcg = css_to_blkcg(of_css(of));
 	struct blkg_conf_ctx ctx;
 	struct throtl_grp *tg;
+	unsigned long idle_time, latency_time;
+	int index = of_cft(of)->private;
 	u64 v[4];
-	int ret;
+	int ret, rw;
 
 	ret = blkg_conf_prep(blkcg, &blkcg_policy_throtl, buf, &ctx);
 	if (ret)
@@ -1325,10 +1792,12 @@ static ssize_t tg_set_max(struct kernfs_open_file *of,
 
 	tg = blkg_to_tg(ctx.blkg);
 
-	v[0] = tg->bps[READ];
-	v[1] = tg->bps[WRITE];
-	v[2] = tg->iops[READ];
-	v[3] = tg->iops[WRITE];
+	v[0] = tg->bps[READ][index];
+	v[1] = tg->bps[WRITE][index];
+	v[2] = tg->iops[READ][index];
+	v[3] = tg->iops[WRITE][index];
+	idle_time = tg->idletime_threshold;
+	latency_time = tg->latency_target;
 
 	while (true) {
 		char tok[27];	/* wiops=18446744073709551616 */
@@ -1349,7 +1818,7 @@ static ssize_t tg_set_max(struct kernfs_open_file *of,
 			goto out_finish;
 
 		ret = -ERANGE;
-		if (!val)
+		if (!val && index == LIMIT_MAX)
 			goto out_finish;
 
 		ret = -EINVAL;
@@ -1361,14 +1830,30 @@ static ssize_t tg_set_max(struct kernfs_open_file *of,
 			v[2] = min_t(u64, val, UINT_MAX);
 		else if (!strcmp(tok, "wiops"))
 			v[3] = min_t(u64, val, UINT_MAX);
+		else if (index == LIMIT_LOW && !strcmp(tok, "idle"))
+			idle_time = min_t(u64, val, ULONG_MAX);
+		else if (index == LIMIT_LOW && !strcmp(tok, "latency"))
+			latency_time = min_t(u64, val, ULONG_MAX);
 		else
 			goto out_finish;
 	}
 
-	tg->bps[READ] = v[0];
-	tg->bps[WRITE] = v[1];
-	tg->iops[READ] = v[2];
-	tg->iops[WRITE] = v[3];
+	tg->bps[READ][index] = v[0];
+	tg->bps[WRITE][index] = v[1];
+	tg->iops[READ][index] = v[2];
+	tg->iops[WRITE][index] = v[3];
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		tg->bps[rw][LIMIT_LOW] = min(tg->bps[rw][LIMIT_LOW],
+					     tg->bps[rw][LIMIT_MAX]);
+		tg->iops[rw][LIMIT_LOW] = min(tg->iops[rw][LIMIT_LOW],
+					      tg->iops[rw][LIMIT_MAX]);
+	}
+
+	if (index == LIMIT_LOW) {
+		tg->idletime_threshold = idle_time;
+		tg->latency_target = latency_time;
+	}
 
 	tg_conf_updated(tg);
 	ret = 0;
@@ -1378,11 +1863,21 @@ out_finish:
 }
 
 static struct cftype throtl_files[] = {
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	{
+		.name = "low",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = tg_print_limit,
+		.write = tg_set_limit,
+		.private = LIMIT_LOW,
+	},
+#endif
 	{
 		.name = "max",
 		.flags = CFTYPE_NOT_ON_ROOT,
-		.seq_show = tg_print_max,
-		.write = tg_set_max,
+		.seq_show = tg_print_limit,
+		.write = tg_set_limit,
+		.private = LIMIT_MAX,
 	},
 	{ }	/* terminate */
 };
@@ -1394,6 +1889,26 @@ static void throtl_shutdown_wq(struct request_queue *q)
 	cancel_work_sync(&td->dispatch_work);
 }
 
+/* an offlined group stops counting as one with low limits */
+static void throtl_pd_offline(struct blkg_policy_data *pd)
+{
+	struct throtl_grp *tg = pd_to_tg(pd);
+	struct throtl_data *td = tg->td;
+	int rw;
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		tg->bps[rw][LIMIT_LOW] = 0;
+		tg->iops[rw][LIMIT_LOW] = 0;
+	}
+
+	if (!td->limit_valid[LIMIT_LOW])
+		return;
+
+	blk_throtl_update_limit_valid(td);
+	if (!td->limit_valid[LIMIT_LOW] && td->limit_index == LIMIT_LOW)
+		throtl_upgrade_state(td);
+}
+
 static struct blkcg_policy blkcg_policy_throtl = {
 	.dfl_cftypes		= throtl_files,
 	.legacy_cftypes		= throtl_legacy_files,
@@ -1401,6 +1916,7 @@ static struct blkcg_policy blkcg_policy_throtl = {
 	.pd_alloc_fn		= throtl_pd_alloc,
 	.pd_init_fn		= throtl_pd_init,
 	.pd_online_fn		= throtl_pd_online,
+	.pd_offline_fn		= throtl_pd_offline,
 	.pd_free_fn		= throtl_pd_free,
 };
 
@@ -1426,14 +1942,28 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 
 	sq = &tg->service_queue;
 
+	blk_throtl_assoc_bio(tg, bio);
+	blk_throtl_update_idletime(tg);
+again:
 	while (true) {
+		if (!tg->last_low_overflow_time[rw])
+			tg->last_low_overflow_time[rw] = jiffies;
+		throtl_downgrade_check(tg);
+		throtl_upgrade_check(tg);
+
 		/* throtl is FIFO - if bios are already queued, should queue */
 		if (sq->nr_queued[rw])
 			break;
 
 		/* if above limits, break to queue */
-		if (!tg_may_dispatch(tg, bio, NULL))
+		if (!tg_may_dispatch(tg, bio, NULL)) {
+			tg->last_low_overflow_time[rw] = jiffies;
+			if (throtl_can_upgrade(tg->td, tg)) {
+				throtl_upgrade_state(tg->td);
+				goto again;
+			}
 			break;
+		}
 
 		/* within limits, let's charge and dispatch directly */
 		throtl_charge_bio(tg, bio);
@@ -1466,14 +1996,18 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	/* out-of-limit, queue to @tg */
 	throtl_log(sq, "[%c] bio. bdisp=%llu sz=%u bps=%llu iodisp=%u iops=%u queued=%d/%d",
 		   rw == READ ? 'R' : 'W',
-		   tg->bytes_disp[rw], bio->bi_iter.bi_size, tg->bps[rw],
-		   tg->io_disp[rw], tg->iops[rw],
+		   tg->bytes_disp[rw], bio->bi_iter.bi_size,
+		   tg_bps_limit(tg, rw), tg->io_disp[rw], tg_iops_limit(tg, rw),
 		   sq->nr_queued[READ], sq->nr_queued[WRITE]);
 
 	bio_associate_current(bio);
 	tg->td->nr_queued[rw]++;
 	throtl_add_bio_tg(bio, qn, tg);
 	throttled = true;
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	/* time spent here isn't the device's latency */
+	bio->bi_throtl_issue = 0;
+#endif
 
 	/*
 	 * Update @tg's dispatch time and force schedule dispatch if @tg
@@ -1499,6 +2033,51 @@ out:
 	return throttled;
 }
 
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+/*
+ * Called on completion of every bio timed by blk_throtl_bio(), from any
+ * context.  Records when the group last finished a bio, for its think
+ * time, and how many of its bios missed the latency target.  The counts
+ * decay so that they follow the group's recent behaviour.
+ */
+void blk_throtl_bio_endio(struct bio *bio)
+{
+	struct blkcg_gq *blkg = bio->bi_throtl_blkg;
+	struct throtl_grp *tg;
+	u64 finish_time_ns, start_time_ns;
+	unsigned long lat;
+
+	if (!blkg)
+		return;
+	bio->bi_throtl_blkg = NULL;
+
+	tg = blkg_to_tg(blkg);
+	if (!tg)
+		goto out;
+
+	finish_time_ns = ktime_get_ns();
+	tg->last_finish_time = finish_time_ns >> 10;
+
+	start_time_ns = bio->bi_throtl_issue;
+	if (start_time_ns && finish_time_ns > start_time_ns &&
+	    tg->latency_target) {
+		lat = (finish_time_ns - start_time_ns) >> 10;
+		tg->bio_cnt++;
+		if (lat > tg->latency_target)
+			tg->bad_bio_cnt++;
+	}
+
+	if (time_after(jiffies, tg->bio_cnt_reset_time) ||
+	    tg->bio_cnt > 1024) {
+		tg->bio_cnt /= 2;
+		tg->bad_bio_cnt /= 2;
+		tg->bio_cnt_reset_time = jiffies + 5 * HZ;
+	}
+out:
+	blkg_put(blkg);
+}
+#endif
+
 /*
  * Dispatch all bios from all children tg's queued on @parent_sq.  On
  * return, @parent_sq is guaranteed to not have any active children tg's
@@ -1575,6 +2154,9 @@ int blk_throtl_init(struct request_queue *q)
 	INIT_WORK(&td->dispatch_work, blk_throtl_dispatch_work_fn);
 	throtl_service_queue_init(&td->service_queue);
 
+	td->limit_index = LIMIT_MAX;
+	td->limit_valid[LIMIT_MAX] = true;
+
 	q->td = td;
 	td->queue = q;
 
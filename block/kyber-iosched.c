@@ -0,0 +1,513 @@
+/*
+ * The Kyber I/O scheduler. Controls latency by throttling the queue depths
+ * of the request classes that get in the way of reads.
+ *
+ * Requests are split into three domains: reads, synchronous writes and
+ * everything else.  Each domain may only have so many requests in flight
+ * in the device at once, a limit kept as a token count.  Every window the
+ * completion latencies of the last window are checked against the read and
+ * write targets: if reads missed theirs, the depth of the other domains is
+ * halved, if writes missed theirs, asynchronous requests are throttled,
+ * and when everything is on target the depths grow back.
+ *
+ * Kyber does no sorting, dispatch just round robins over the domains in
+ * small batches.  Fast devices get the shallow, low latency queue they
+ * want without the cost of a sorting scheduler.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/elevator.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+#include "blk-mq-tag.h"
+
+/* Scheduling domains. */
+enum {
+	KYBER_READ,
+	KYBER_SYNC_WRITE,
+	KYBER_OTHER, /* Async writes, discard, etc. */
+	KYBER_NUM_DOMAINS,
+};
+
+/* Latency targets, the only tunables. */
+enum {
+	KYBER_READ_LAT,
+	KYBER_WRITE_LAT,
+	KYBER_NUM_LAT,
+};
+
+/* Latency target status of the last window. */
+enum {
+	KYBER_LAT_NONE,		/* not enough samples */
+	KYBER_LAT_GOOD,
+	KYBER_LAT_MISSED,
+};
+
+/*
+ * How many requests of a domain are dispatched in a row before moving on
+ * to the next one.
+ */
+static const unsigned int kyber_batch_size[] = {
+	[KYBER_READ] = 16,
+	[KYBER_SYNC_WRITE] = 8,
+	[KYBER_OTHER] = 8,
+};
+
+/*
+ * Maximum depth of each domain, as a shift of the driver queue depth.
+ * Reads may fill the device, the others start at a fraction of it.
+ */
+static const unsigned int kyber_depth_shift[] = {
+	[KYBER_READ] = 0,
+	[KYBER_SYNC_WRITE] = 1,
+	[KYBER_OTHER] = 2,
+};
+
+#define KYBER_WINDOW		(HZ / 10)
+#define KYBER_MIN_SAMPLES	16
+
+/*
+ * A window misses its target when more than 1 in this many completions
+ * took longer than the target, i.e. the 99th percentile is over it.
+ */
+#define KYBER_MISS_RATIO	100
+
+/* Set in rq->elv.priv[0] while the request holds a domain token. */
+#define KYBER_TOKEN		((void *)1UL)
+
+struct kyber_latency {
+	atomic_t samples;
+	atomic_t missed;
+};
+
+struct kyber_queue_data {
+	struct request_queue *q;
+
+	/* Requests of each domain in the device, and how many may be. */
+	atomic_t inflight[KYBER_NUM_DOMAINS];
+	unsigned int depth[KYBER_NUM_DOMAINS];
+	unsigned int max_depth[KYBER_NUM_DOMAINS];
+
+	/* Domains a hardware queue ran out of tokens for. */
+	unsigned long wait_mask;
+
+	struct kyber_latency lat[KYBER_NUM_LAT];
+	struct timer_list timer;
+
+	u64 lat_target[KYBER_NUM_LAT];
+};
+
+struct kyber_hctx_data {
+	spinlock_t lock;
+	struct list_head rqs[KYBER_NUM_DOMAINS];
+	unsigned int cur_domain;
+	unsigned int batching;
+};
+
+static unsigned int kyber_rw_domain(unsigned long rw)
+{
+	if (!(rw & REQ_WRITE))
+		return KYBER_READ;
+	if (rw & REQ_SYNC)
+		return KYBER_SYNC_WRITE;
+	return KYBER_OTHER;
+}
+
+static unsigned int kyber_rq_domain(struct request *rq)
+{
+	return kyber_rw_domain(rq->cmd_flags);
+}
+
+static int kyber_lat_status(struct kyber_queue_data *kqd, unsigned int type)
+{
+	unsigned int samples = atomic_xchg(&kqd->lat[type].samples, 0);
+	unsigned int missed = atomic_xchg(&kqd->lat[type].missed, 0);
+
+	if (samples < KYBER_MIN_SAMPLES)
+		return KYBER_LAT_NONE;
+	if (missed * KYBER_MISS_RATIO > samples)
+		return KYBER_LAT_MISSED;
+	return KYBER_LAT_GOOD;
+}
+
+static void kyber_shrink_depth(struct kyber_queue_data *kqd,
+			       unsigned int domain)
+{
+	unsigned int depth = READ_ONCE(kqd->depth[domain]);
+
+	WRITE_ONCE(kqd->depth[domain], max(depth / 2, 1U));
+}
+
+static void kyber_grow_depth(struct kyber_queue_data *kqd,
+			     unsigned int domain)
+{
+	unsigned int depth = READ_ONCE(kqd->depth[domain]);
+
+	depth = max(depth + 1, depth + depth / 4);
+	WRITE_ONCE(kqd->depth[domain], min(depth, kqd->max_depth[domain]));
+}
+
+static void kyber_run_waiters(struct kyber_queue_data *kqd)
+{
+	if (READ_ONCE(kqd->wait_mask) && xchg(&kqd->wait_mask, 0))
+		blk_mq_run_hw_queues(kqd->q, true);
+}
+
+/*
+ * Runs once per window with completions, and adjusts the domain depths to
+ * what the last window's latencies ask for.
+ */
+static void kyber_adjust_depths(unsigned long data)
+{
+	struct kyber_queue_data *kqd = (struct kyber_queue_data *)data;
+	int read_status = kyber_lat_status(kqd, KYBER_READ_LAT);
+	int write_status = kyber_lat_status(kqd, KYBER_WRITE_LAT);
+	unsigned int i;
+
+	if (read_status == KYBER_LAT_MISSED) {
+		/* reads come first, throttle everything else hard */
+		kyber_shrink_depth(kqd, KYBER_SYNC_WRITE);
+		kyber_shrink_depth(kqd, KYBER_OTHER);
+	} else if (write_status == KYBER_LAT_MISSED) {
+		kyber_shrink_depth(kqd, KYBER_OTHER);
+	} else if (read_status == KYBER_LAT_GOOD ||
+		   write_status == KYBER_LAT_GOOD) {
+		for (i = 0; i < KYBER_NUM_DOMAINS; i++)
+			kyber_grow_depth(kqd, i);
+		/* growing may have made room for a waiting domain */
+		kyber_run_waiters(kqd);
+	}
+}
+
+static bool kyber_get_token(struct kyber_queue_data *kqd, unsigned int domain)
+{
+	if (atomic_inc_return(&kqd->inflight[domain]) <=
+	    READ_ONCE(kqd->depth[domain]))
+		return true;
+
+	atomic_dec(&kqd->inflight[domain]);
+	return false;
+}
+
+static void kyber_put_token(struct kyber_queue_data *kqd, struct request *rq)
+{
+	unsigned int domain = kyber_rq_domain(rq);
+
+	rq->elv.priv[0] = NULL;
+	atomic_dec(&kqd->inflight[domain]);
+
+	/* pairs with the barrier in kyber_dispatch_cur_domain() */
+	smp_mb__after_atomic();
+	if (test_bit(domain, &kqd->wait_mask) &&
+	    test_and_clear_bit(domain, &kqd->wait_mask))
+		blk_mq_run_hw_queues(kqd->q, true);
+}
+
+static int kyber_init_sched(struct request_queue *q, struct elevator_type *e)
+{
+	unsigned int queue_depth = q->tag_set->queue_depth;
+	struct kyber_queue_data *kqd;
+	struct elevator_queue *eq;
+	unsigned int i;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	kqd = kzalloc_node(sizeof(*kqd), GFP_KERNEL, q->node);
+	if (!kqd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+	eq->elevator_data = kqd;
+
+	kqd->q = q;
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++) {
+		atomic_set(&kqd->inflight[i], 0);
+		kqd->max_depth[i] = max(queue_depth >> kyber_depth_shift[i],
+					1U);
+		kqd->depth[i] = kqd->max_depth[i];
+	}
+	kqd->lat_target[KYBER_READ_LAT] = 2ULL * NSEC_PER_MSEC;
+	kqd->lat_target[KYBER_WRITE_LAT] = 10ULL * NSEC_PER_MSEC;
+	setup_timer(&kqd->timer, kyber_adjust_depths, (unsigned long)kqd);
+
+	q->elevator = eq;
+	return 0;
+}
+
+static void kyber_exit_sched(struct elevator_queue *e)
+{
+	struct kyber_queue_data *kqd = e->elevator_data;
+
+	del_timer_sync(&kqd->timer);
+	kfree(kqd);
+}
+
+static int kyber_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct kyber_hctx_data *khd;
+	unsigned int i;
+
+	khd = kzalloc_node(sizeof(*khd), GFP_KERNEL, hctx->numa_node);
+	if (!khd)
+		return -ENOMEM;
+
+	spin_lock_init(&khd->lock);
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++)
+		INIT_LIST_HEAD(&khd->rqs[i]);
+
+	hctx->sched_data = khd;
+	return 0;
+}
+
+static void kyber_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct kyber_hctx_data *khd = hctx->sched_data;
+	unsigned int i;
+
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++)
+		WARN_ON(!list_empty(&khd->rqs[i]));
+
+	kfree(khd);
+	hctx->sched_data = NULL;
+}
+
+static bool kyber_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
+{
+	struct kyber_hctx_data *khd = hctx->sched_data;
+	struct list_head *list = &khd->rqs[kyber_rw_domain(bio->bi_rw)];
+	bool merged;
+
+	spin_lock(&khd->lock);
+	merged = blk_mq_bio_list_merge(hctx->queue, list, bio);
+	spin_unlock(&khd->lock);
+
+	return merged;
+}
+
+static void kyber_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct list_head *list, bool at_head)
+{
+	struct kyber_hctx_data *khd = hctx->sched_data;
+	struct request *rq, *next;
+
+	spin_lock(&khd->lock);
+	list_for_each_entry_safe(rq, next, list, queuelist) {
+		struct list_head *head = &khd->rqs[kyber_rq_domain(rq)];
+
+		if (at_head)
+			list_move(&rq->queuelist, head);
+		else
+			list_move_tail(&rq->queuelist, head);
+	}
+	spin_unlock(&khd->lock);
+}
+
+static void kyber_started_request(struct request *rq)
+{
+	rq->elv.priv[1] = (void *)(unsigned long)ktime_get_ns();
+}
+
+static void kyber_requeue_request(struct request *rq)
+{
+	struct kyber_queue_data *kqd = rq->q->elevator->elevator_data;
+
+	if (rq->elv.priv[0] == KYBER_TOKEN)
+		kyber_put_token(kqd, rq);
+}
+
+static void kyber_completed_request(struct request *rq)
+{
+	struct kyber_queue_data *kqd = rq->q->elevator->elevator_data;
+	unsigned int type;
+	unsigned long lat;
+
+	if (rq->elv.priv[0] != KYBER_TOKEN)
+		return;
+
+	kyber_put_token(kqd, rq);
+
+	/* only reads and sync writes have latency targets */
+	if (kyber_rq_domain(rq) == KYBER_OTHER)
+		return;
+
+	/* start time only fits in a long, so this wraps on 32-bit */
+	lat = (unsigned long)ktime_get_ns() - (unsigned long)rq->elv.priv[1];
+	type = rq_data_dir(rq) == READ ? KYBER_READ_LAT : KYBER_WRITE_LAT;
+
+	atomic_inc(&kqd->lat[type].samples);
+	if (lat > kqd->lat_target[type])
+		atomic_inc(&kqd->lat[type].missed);
+
+	if (!timer_pending(&kqd->timer))
+		mod_timer(&kqd->timer, jiffies + KYBER_WINDOW);
+}
+
+static struct request *
+kyber_dispatch_cur_domain(struct kyber_queue_data *kqd,
+			  struct kyber_hctx_data *khd)
+{
+	unsigned int domain = khd->cur_domain;
+	struct list_head *list = &khd->rqs[domain];
+	struct request *rq;
+
+	if (list_empty(list))
+		return NULL;
+
+	if (!kyber_get_token(kqd, domain)) {
+		/*
+		 * Have the next token put rerun the queues, and retry once
+		 * in case it happened before the bit was visible.
+		 */
+		set_bit(domain, &kqd->wait_mask);
+		smp_mb__after_atomic();
+		if (!kyber_get_token(kqd, domain))
+			return NULL;
+	}
+
+	rq = list_first_entry(list, struct request, queuelist);
+	list_del_init(&rq->queuelist);
+	rq->elv.priv[0] = KYBER_TOKEN;
+	khd->batching++;
+	return rq;
+}
+
+static struct request *kyber_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct kyber_queue_data *kqd = hctx->queue->elevator->elevator_data;
+	struct kyber_hctx_data *khd = hctx->sched_data;
+	struct request *rq;
+	unsigned int i;
+
+	spin_lock(&khd->lock);
+
+	/* stay on the current domain until its batch is used up */
+	if (khd->batching < kyber_batch_size[khd->cur_domain]) {
+		rq = kyber_dispatch_cur_domain(kqd, khd);
+		if (rq)
+			goto out;
+	}
+
+	khd->batching = 0;
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++) {
+		if (++khd->cur_domain >= KYBER_NUM_DOMAINS)
+			khd->cur_domain = 0;
+		rq = kyber_dispatch_cur_domain(kqd, khd);
+		if (rq)
+			goto out;
+	}
+
+	rq = NULL;
+out:
+	spin_unlock(&khd->lock);
+	return rq;
+}
+
+static bool kyber_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct kyber_hctx_data *khd = hctx->sched_data;
+	unsigned int i;
+
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++) {
+		if (!list_empty_careful(&khd->rqs[i]))
+			return true;
+	}
+	return false;
+}
+
+#define KYBER_LAT_SHOW_STORE(name, type)				\
+static ssize_t kyber_##name##_lat_show(struct elevator_queue *e,	\
+				       char *page)			\
+{									\
+	struct kyber_queue_data *kqd = e->elevator_data;		\
+									\
+	return sprintf(page, "%llu\n",					\
+		       (unsigned long long)kqd->lat_target[type]);	\
+}									\
+									\
+static ssize_t kyber_##name##_lat_store(struct elevator_queue *e,	\
+					const char *page, size_t count)	\
+{									\
+	struct kyber_queue_data *kqd = e->elevator_data;		\
+	unsigned long long nsec;					\
+	int ret;							\
+									\
+	ret = kstrtoull(page, 10, &nsec);				\
+	if (ret)							\
+		return ret;						\
+	if (!nsec)							\
+		return -EINVAL;						\
+									\
+	kqd->lat_target[type] = nsec;					\
+	return count;							\
+}
+KYBER_LAT_SHOW_STORE(read, KYBER_READ_LAT);
+KYBER_LAT_SHOW_STORE(write, KYBER_WRITE_LAT);
+#undef KYBER_LAT_SHOW_STORE
+
+static ssize_t kyber_depth_show(struct elevator_queue *e, char *page)
+{
+	struct kyber_queue_data *kqd = e->elevator_data;
+
+	return sprintf(page, "read %u/%u sync_write %u/%u other %u/%u\n",
+		       atomic_read(&kqd->inflight[KYBER_READ]),
+		       READ_ONCE(kqd->depth[KYBER_READ]),
+		       atomic_read(&kqd->inflight[KYBER_SYNC_WRITE]),
+		       READ_ONCE(kqd->depth[KYBER_SYNC_WRITE]),
+		       atomic_read(&kqd->inflight[KYBER_OTHER]),
+		       READ_ONCE(kqd->depth[KYBER_OTHER]));
+}
+
+static struct elv_fs_entry kyber_sched_attrs[] = {
+	__ATTR(read_lat_nsec, S_IRUGO|S_IWUSR, kyber_read_lat_show,
+	       kyber_read_lat_store),
+	__ATTR(write_lat_nsec, S_IRUGO|S_IWUSR, kyber_write_lat_show,
+	       kyber_write_lat_store),
+	__ATTR(depth, S_IRUGO, kyber_depth_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type kyber_sched = {
+	.mq_ops = {
+		.init_sched		= kyber_init_sched,
+		.exit_sched		= kyber_exit_sched,
+		.init_hctx		= kyber_init_hctx,
+		.exit_hctx		= kyber_exit_hctx,
+		.bio_merge		= kyber_bio_merge,
+		.started_request	= kyber_started_request,
+		.requeue_request	= kyber_requeue_request,
+		.completed_request	= kyber_completed_request,
+		.insert_requests	= kyber_insert_requests,
+		.dispatch_request	= kyber_dispatch_request,
+		.has_work		= kyber_has_work,
+	},
+
+	.uses_mq	= true,
+	.elevator_attrs = kyber_sched_attrs,
+	.elevator_name = "kyber",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init kyber_init(void)
+{
+	return elv_register(&kyber_sched);
+}
+
+static void __exit kyber_exit(void)
+{
+	elv_unregister(&kyber_sched);
+}
+
+module_init(kyber_init);
+module_exit(kyber_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Kyber I/O scheduler");
+MODULE_ALIAS("kyber-iosched");
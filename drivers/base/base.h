@@ -136,6 +136,10 @@ extern int devres_release_all(struct device *dev);
 extern struct kset *devices_kset;
 extern void devices_kset_move_last(struct device *dev);
 
+/* Device links support */
+extern int device_links_read_lock(void);
+extern void device_links_read_unlock(int idx);
+
 #if defined(CONFIG_MODULES) && defined(CONFIG_SYSFS)
 extern void module_add_driver(struct module *mod, struct device_driver *drv);
 extern void module_remove_driver(struct device_driver *drv);
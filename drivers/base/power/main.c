@@ -28,6 +28,8 @@
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <linux/async.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/suspend.h>
 #include <trace/events/power.h>
 #include <linux/cpufreq.h>
@@ -245,6 +247,55 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+static void dpm_wait_for_suppliers(struct device *dev, bool async)
+{
+	struct device_link *link;
+	int idx;
+
+	idx = device_links_read_lock();
+
+	/*
+	 * If the supplier goes away right after we've checked the link to it,
+	 * we'll wait for its completion to change the state, but that's fine,
+	 * because the only things that will block as a result are the SRCU
+	 * callbacks freeing the link objects for the links in the list we're
+	 * walking.
+	 */
+	list_for_each_entry_rcu(link, &dev->links.suppliers, c_node)
+		dpm_wait(link->supplier, async);
+
+	device_links_read_unlock(idx);
+}
+
+static void dpm_wait_for_superior(struct device *dev, bool async)
+{
+	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
+}
+
+static void dpm_wait_for_consumers(struct device *dev, bool async)
+{
+	struct device_link *link;
+	int idx;
+
+	idx = device_links_read_lock();
+
+	/*
+	 * A consumer being unregistered in parallel is still waited for, but
+	 * device_pm_remove() completes it, so that cannot block us for long.
+	 */
+	list_for_each_entry_rcu(link, &dev->links.consumers, s_node)
+		dpm_wait(link->consumer, async);
+
+	device_links_read_unlock(idx);
+}
+
+static void dpm_wait_for_subordinate(struct device *dev, bool async)
+{
+	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
+}
+
 /**
  * pm_op - Return the PM operation appropriate for given PM event.
  * @ops: PM operations to choose from.
@@ -376,6 +427,24 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 		usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
 }
 
+#ifdef CONFIG_PM_SLEEP_DEBUG
+static void dpm_save_time(struct device *dev, enum dpm_phase phase,
+			  ktime_t starttime)
+{
+	dev->power.phase_time[phase] =
+		ktime_to_us(ktime_sub(ktime_get(), starttime));
+}
+
+static void dpm_clear_times(struct device *dev)
+{
+	memset(dev->power.phase_time, 0, sizeof(dev->power.phase_time));
+}
+#else
+static inline void dpm_save_time(struct device *dev, enum dpm_phase phase,
+				 ktime_t starttime) {}
+static inline void dpm_clear_times(struct device *dev) {}
+#endif
+
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
@@ -478,6 +547,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -489,7 +559,8 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 	if (!dev->power.is_noirq_suspended)
 		goto Out;
 
-	dpm_wait(dev->parent, async);
+	dpm_wait_for_superior(dev, async);
+	starttime = ktime_get();
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -512,6 +583,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_noirq_suspended = false;
+	dpm_save_time(dev, DPM_PHASE_RESUME_NOIRQ, starttime);
 
  Out:
 	complete_all(&dev->power.completion);
@@ -608,6 +680,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -619,7 +692,8 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 	if (!dev->power.is_late_suspended)
 		goto Out;
 
-	dpm_wait(dev->parent, async);
+	dpm_wait_for_superior(dev, async);
+	starttime = ktime_get();
 
 	if (dev->pm_domain) {
 		info = "early power domain ";
@@ -642,6 +716,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_late_suspended = false;
+	dpm_save_time(dev, DPM_PHASE_RESUME_EARLY, starttime);
 
  Out:
 	TRACE_RESUME(error);
@@ -736,6 +811,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 	DECLARE_DPM_WATCHDOG_ON_STACK(wd);
 
@@ -751,7 +827,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 		goto Complete;
 	}
 
-	dpm_wait(dev->parent, async);
+	dpm_wait_for_superior(dev, async);
+	starttime = ktime_get();
 	dpm_watchdog_set(&wd, dev);
 	device_lock(dev);
 
@@ -808,6 +885,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  End:
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_suspended = false;
+	dpm_save_time(dev, DPM_PHASE_RESUME, starttime);
 
  Unlock:
 	device_unlock(dev);
@@ -924,8 +1002,11 @@ static void device_complete(struct device *dev, pm_message_t state)
 	}
 
 	if (callback) {
+		ktime_t starttime = ktime_get();
+
 		pm_dev_dbg(dev, state, info);
 		callback(dev);
+		dpm_save_time(dev, DPM_PHASE_COMPLETE, starttime);
 	}
 
 	device_unlock(dev);
@@ -1020,12 +1101,13 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_SUSPEND(0);
 
-	dpm_wait_for_children(dev, async);
+	dpm_wait_for_subordinate(dev, async);
 
 	if (async_error)
 		goto Complete;
@@ -1038,6 +1120,8 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 	if (dev->power.syscore || dev->power.direct_complete)
 		goto Complete;
 
+	starttime = ktime_get();
+
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
 		callback = pm_noirq_op(&dev->pm_domain->ops, state);
@@ -1058,6 +1142,7 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 	}
 
 	error = dpm_run_callback(callback, dev, state, info);
+	dpm_save_time(dev, DPM_PHASE_SUSPEND_NOIRQ, starttime);
 	if (!error) {
 		dev->power.is_noirq_suspended = true;
 	} else {
@@ -1167,6 +1252,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -1174,7 +1260,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 
 	__pm_runtime_disable(dev, false);
 
-	dpm_wait_for_children(dev, async);
+	dpm_wait_for_subordinate(dev, async);
 
 	if (async_error)
 		goto Complete;
@@ -1187,6 +1273,8 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 	if (dev->power.syscore || dev->power.direct_complete)
 		goto Complete;
 
+	starttime = ktime_get();
+
 	if (dev->pm_domain) {
 		info = "late power domain ";
 		callback = pm_late_early_op(&dev->pm_domain->ops, state);
@@ -1207,6 +1295,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 	}
 
 	error = dpm_run_callback(callback, dev, state, info);
+	dpm_save_time(dev, DPM_PHASE_SUSPEND_LATE, starttime);
 	if (!error) {
 		dev->power.is_late_suspended = true;
 	} else {
@@ -1357,12 +1446,13 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	char *info = NULL;
 	int error = 0;
 	char suspend_abort[MAX_SUSPEND_ABORT_LEN];
+	ktime_t starttime;
 	DECLARE_DPM_WATCHDOG_ON_STACK(wd);
 
 	TRACE_DEVICE(dev);
 	TRACE_SUSPEND(0);
 
-	dpm_wait_for_children(dev, async);
+	dpm_wait_for_subordinate(dev, async);
 
 	if (async_error) {
 		dev->power.direct_complete = false;
@@ -1405,6 +1495,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 		dev->power.direct_complete = false;
 	}
 
+	starttime = ktime_get();
 	dpm_watchdog_set(&wd, dev);
 	device_lock(dev);
 
@@ -1454,6 +1545,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	error = dpm_run_callback(callback, dev, state, info);
 
  End:
+	dpm_save_time(dev, DPM_PHASE_SUSPEND, starttime);
 	if (!error) {
 		struct device *parent = dev->parent;
 
@@ -1577,6 +1669,8 @@ static int device_prepare(struct device *dev, pm_message_t state)
 	char *info = NULL;
 	int ret = 0;
 
+	dpm_clear_times(dev);
+
 	if (dev->power.syscore)
 		return 0;
 
@@ -1616,8 +1710,12 @@ static int device_prepare(struct device *dev, pm_message_t state)
 		callback = dev->driver->pm->prepare;
 	}
 
-	if (callback)
+	if (callback) {
+		ktime_t starttime = ktime_get();
+
 		ret = callback(dev);
+		dpm_save_time(dev, DPM_PHASE_PREPARE, starttime);
+	}
 
 unlock:
 	device_unlock(dev);
@@ -1778,3 +1876,75 @@ void device_pm_check_callbacks(struct device *dev)
 		(!dev->driver || pm_ops_is_empty(dev->driver->pm));
 	spin_unlock_irq(&dev->power.lock);
 }
+
+#if defined(CONFIG_PM_SLEEP_DEBUG) && defined(CONFIG_DEBUG_FS)
+static const char * const dpm_phase_names[DPM_PHASE_COUNT] = {
+	[DPM_PHASE_PREPARE]		= "prepare",
+	[DPM_PHASE_SUSPEND]		= "suspend",
+	[DPM_PHASE_SUSPEND_LATE]	= "suspend_late",
+	[DPM_PHASE_SUSPEND_NOIRQ]	= "suspend_noirq",
+	[DPM_PHASE_RESUME_NOIRQ]	= "resume_noirq",
+	[DPM_PHASE_RESUME_EARLY]	= "resume_early",
+	[DPM_PHASE_RESUME]		= "resume",
+	[DPM_PHASE_COMPLETE]		= "complete",
+};
+
+/**
+ * dpm_times_show - Print per-device callback times of the last transition.
+ * @m: seq_file to print the times into.
+ *
+ * One line per device that ran any callback, in dpm_list order, with the
+ * time in microseconds each phase's callbacks took for it.  The time spent
+ * waiting for parents, children, suppliers and consumers is not included.
+ */
+static int dpm_times_show(struct seq_file *m, void *unused)
+{
+	struct device *dev;
+	int phase;
+	u32 total;
+
+	seq_puts(m, "device async");
+	for (phase = 0; phase < DPM_PHASE_COUNT; phase++)
+		seq_printf(m, " %s", dpm_phase_names[phase]);
+	seq_putc(m, '\n');
+
+	mutex_lock(&dpm_list_mtx);
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		total = 0;
+		for (phase = 0; phase < DPM_PHASE_COUNT; phase++)
+			total += dev->power.phase_time[phase];
+		if (!total)
+			continue;
+
+		seq_printf(m, "%s %d", dev_name(dev), is_async(dev));
+		for (phase = 0; phase < DPM_PHASE_COUNT; phase++)
+			seq_printf(m, " %u", dev->power.phase_time[phase]);
+		seq_putc(m, '\n');
+	}
+	mutex_unlock(&dpm_list_mtx);
+
+	return 0;
+}
+
+static int dpm_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_times_show, NULL);
+}
+
+static const struct file_operations dpm_times_fops = {
+	.owner = THIS_MODULE,
+	.open = dpm_times_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init dpm_times_debugfs_init(void)
+{
+	debugfs_create_file("suspend_device_times", S_IRUGO, NULL, NULL,
+			    &dpm_times_fops);
+	return 0;
+}
+
+late_initcall(dpm_times_debugfs_init);
+#endif /* CONFIG_PM_SLEEP_DEBUG && CONFIG_DEBUG_FS */
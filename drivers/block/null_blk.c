@@ -369,6 +369,28 @@ static int null_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return BLK_MQ_RQ_QUEUE_OK;
 }
 
+/*
+ * Timer completions can be polled for: a command whose time is up is
+ * completed by whoever takes its timer off the queue, the timer or us.
+ */
+static int null_poll(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	struct request *rq = blk_mq_tag_to_rq(hctx->tags, tag);
+	struct nullb_cmd *cmd;
+
+	if (irqmode != NULL_IRQ_TIMER || !rq || !blk_mq_request_started(rq))
+		return 0;
+
+	cmd = blk_mq_rq_to_pdu(rq);
+	if (ktime_before(ktime_get(), hrtimer_get_expires(&cmd->timer)))
+		return 0;
+	if (hrtimer_try_to_cancel(&cmd->timer) != 1)
+		return 0;
+
+	end_cmd(cmd);
+	return 1;
+}
+
 static void null_init_queue(struct nullb *nullb, struct nullb_queue *nq)
 {
 	BUG_ON(!nullb);
@@ -396,6 +418,7 @@ static struct blk_mq_ops null_mq_ops = {
 	.map_queue      = blk_mq_map_queue,
 	.init_hctx	= null_init_hctx,
 	.complete	= null_softirq_done_fn,
+	.poll		= null_poll,
 };
 
 static void cleanup_queue(struct nullb_queue *nq)
@@ -169,7 +169,7 @@ int cpuidle_enter_freeze(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 			int index)
 {
-	int entered_state;
+	int entered_state, i;
 
 	struct cpuidle_state *target_state = &drv->states[index];
 	bool broadcast = !!(target_state->flags & CPUIDLE_FLAG_TIMER_STOP);
@@ -231,6 +231,37 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 		 */
 		dev->states_usage[entered_state].time += dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+
+		/*
+		 * Tell a state entered too deep, where the cpu did not stay
+		 * for the target residency and an enabled shallower state
+		 * would have done, from one entered too shallow, where the
+		 * cpu stayed long enough for the next enabled deeper state
+		 * to pay off even after its exit latency.
+		 */
+		if (dev->last_residency <
+		    (int)drv->states[entered_state].target_residency) {
+			for (i = entered_state - 1; i >= 0; i--) {
+				if (drv->states[i].disabled ||
+				    dev->states_usage[i].disable)
+					continue;
+
+				dev->states_usage[entered_state].above++;
+				break;
+			}
+		} else {
+			for (i = entered_state + 1; i < drv->state_count; i++) {
+				if (drv->states[i].disabled ||
+				    dev->states_usage[i].disable)
+					continue;
+
+				if (dev->last_residency -
+				    (int)drv->states[i].exit_latency >=
+				    (int)drv->states[i].target_residency)
+					dev->states_usage[entered_state].below++;
+				break;
+			}
+		}
 	} else {
 		dev->last_residency = 0;
 	}
@@ -0,0 +1,408 @@
+/*
+ * teo.c - the timer events oriented idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ *
+ * The menu governor corrects the time till the next timer by a factor
+ * learnt from past residencies, so it happily enters a deep state right
+ * before a timer it knows about whenever the factor says wakeups tend to
+ * come later than that. This governor starts from the other end: the next
+ * timer is the upper bound of the idle duration, and the question is only
+ * how likely something else wakes the cpu up before it.
+ *
+ * The idle duration range is split into bins, one per idle state, from
+ * the state's target residency up to the next state's. For every bin the
+ * governor keeps three decaying metrics:
+ *
+ * - "hits": the next timer fell into the bin and so did the wakeup;
+ * - "misses": the next timer fell into the bin, but the cpu was woken up
+ *   earlier, in a shallower bin;
+ * - "early_hits": the cpu was woken up in this bin, before a timer that
+ *   fell into a deeper one.
+ *
+ * On entry the governor takes the bin of the next timer. If its hits
+ * outweigh its misses, the state of that bin is statistically safe and is
+ * used. Otherwise the wakeup is likely to come early and the shallower
+ * state whose bin collected the most early hits is used instead. A cpu
+ * with tasks waiting for I/O is woken up by the completion interrupt
+ * rather than by a timer, so there the timer's bin has to win by a wider
+ * margin. Finally, if most of the recent wakeups came well before the
+ * timer, their average bounds the choice too.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/pm_qos.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+
+/*
+ * The PULSE value is added to metrics when they grow and the DECAY_SHIFT
+ * value is used for decreasing metrics on a regular basis.
+ */
+#define PULSE		1024
+#define DECAY_SHIFT	3
+
+/*
+ * Number of the most recent idle duration values to take into
+ * consideration for the detection of wakeup patterns.
+ */
+#define INTERVALS	8
+
+/* Length of a tick, below which a state is too shallow once it is off */
+#define TEO_TICK_US	(USEC_PER_SEC / HZ)
+
+/**
+ * struct teo_idle_state - idle state data used by the teo governor
+ * @early_hits: "early" cpu wakeups "matching" this state
+ * @hits: "on time" cpu wakeups "matching" this state
+ * @misses: cpu wakeups "missing" this state
+ */
+struct teo_idle_state {
+	unsigned int early_hits;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+/**
+ * struct teo_cpu - cpu data used by the teo governor
+ * @sleep_length_us: time till the closest timer event at the last select
+ * @states: idle states data corresponding to this cpu
+ * @last_state: idle state entered by the cpu last time, -1 if none
+ * @interval_idx: index of the most recent saved idle interval
+ * @intervals: saved idle duration values
+ */
+struct teo_cpu {
+	unsigned int sleep_length_us;
+	struct teo_idle_state states[CPUIDLE_STATE_MAX];
+	int last_state;
+	int interval_idx;
+	unsigned int intervals[INTERVALS];
+};
+
+static DEFINE_PER_CPU(struct teo_cpu, teo_cpus);
+
+static inline bool teo_state_disabled(struct cpuidle_driver *drv,
+				      struct cpuidle_device *dev, int i)
+{
+	return drv->states[i].disabled || dev->states_usage[i].disable;
+}
+
+/**
+ * teo_update - update cpu data after wakeup
+ * @drv: cpuidle driver containing state data
+ * @dev: target cpu
+ */
+static void teo_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+	unsigned int sleep_length_us = cpu_data->sleep_length_us;
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+	int i, idx_hit = -1, idx_timer = -1;
+
+	if (measured_us >= sleep_length_us) {
+		/* Woken up by the timer, or as late as if it had been */
+		measured_us = sleep_length_us;
+	} else {
+		unsigned int lat;
+
+		/*
+		 * The residency includes the exit latency, and the wakeup
+		 * event came somewhere during the exit: assume halfway.
+		 */
+		lat = drv->states[cpu_data->last_state].exit_latency;
+		if (measured_us >= lat)
+			measured_us -= lat / 2;
+		else
+			measured_us /= 2;
+	}
+
+	/*
+	 * Decay the "early hits" of all states and find the bins matching
+	 * the sleep length and the measured idle duration.
+	 */
+	for (i = 0; i < drv->state_count; i++) {
+		unsigned int early_hits = cpu_data->states[i].early_hits;
+
+		cpu_data->states[i].early_hits -= early_hits >> DECAY_SHIFT;
+
+		if (drv->states[i].target_residency <= sleep_length_us) {
+			idx_timer = i;
+			if (drv->states[i].target_residency <= measured_us)
+				idx_hit = i;
+		}
+	}
+
+	/*
+	 * The bin of the timer scores a hit if the wakeup fell into it
+	 * too, a miss otherwise, in which case the bin the wakeup fell into
+	 * scores an early hit.
+	 */
+	if (idx_timer >= 0) {
+		unsigned int hits = cpu_data->states[idx_timer].hits;
+		unsigned int misses = cpu_data->states[idx_timer].misses;
+
+		hits -= hits >> DECAY_SHIFT;
+		misses -= misses >> DECAY_SHIFT;
+
+		if (idx_timer > idx_hit) {
+			misses += PULSE;
+			if (idx_hit >= 0)
+				cpu_data->states[idx_hit].early_hits += PULSE;
+		} else {
+			hits += PULSE;
+		}
+
+		cpu_data->states[idx_timer].misses = misses;
+		cpu_data->states[idx_timer].hits = hits;
+	}
+
+	/* Save the idle duration for the detection of wakeup patterns */
+	cpu_data->intervals[cpu_data->interval_idx++] = measured_us;
+	if (cpu_data->interval_idx >= INTERVALS)
+		cpu_data->interval_idx = 0;
+}
+
+/**
+ * teo_find_shallower_state - find shallower idle state matching a duration
+ * @drv: cpuidle driver containing state data
+ * @dev: target cpu
+ * @state_idx: index of the capping idle state
+ * @duration_us: idle duration value to match
+ */
+static int teo_find_shallower_state(struct cpuidle_driver *drv,
+				    struct cpuidle_device *dev, int state_idx,
+				    unsigned int duration_us)
+{
+	int i;
+
+	for (i = state_idx - 1; i >= 0; i--) {
+		if (teo_state_disabled(drv, dev, i))
+			continue;
+
+		state_idx = i;
+		if (drv->states[i].target_residency <= duration_us)
+			break;
+	}
+
+	return state_idx;
+}
+
+/**
+ * teo_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: target cpu
+ */
+static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int duration_us, hits, misses, early_hits;
+	int max_early_idx, prev_max_early_idx, constraint_idx, idx, i;
+	bool tick_stopped = tick_nohz_tick_stopped();
+
+	if (cpu_data->last_state >= 0) {
+		teo_update(drv, dev);
+		cpu_data->last_state = -1;
+	}
+
+	duration_us = ktime_to_us(tick_nohz_get_sleep_length());
+	cpu_data->sleep_length_us = duration_us;
+
+	hits = 0;
+	misses = 0;
+	early_hits = 0;
+	max_early_idx = -1;
+	prev_max_early_idx = -1;
+	constraint_idx = drv->state_count;
+	idx = -1;
+
+	for (i = 0; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (teo_state_disabled(drv, dev, i)) {
+			/*
+			 * Ignore disabled states with target residencies
+			 * beyond the anticipated idle duration.
+			 */
+			if (s->target_residency > duration_us)
+				continue;
+
+			/*
+			 * The bin of a disabled state is covered by the
+			 * current candidate, so its metrics decide whether
+			 * the candidate is good enough.
+			 */
+			hits = cpu_data->states[i].hits;
+			misses = cpu_data->states[i].misses;
+
+			if (early_hits >= cpu_data->states[i].early_hits ||
+			    idx < 0)
+				continue;
+
+			/*
+			 * The candidate takes over the early hits of the
+			 * disabled state, unless it is too shallow to be
+			 * left in with the tick stopped.
+			 */
+			if (max_early_idx == idx) {
+				early_hits = cpu_data->states[i].early_hits;
+				continue;
+			}
+
+			if (!(tick_stopped &&
+			      drv->states[idx].target_residency < TEO_TICK_US)) {
+				prev_max_early_idx = max_early_idx;
+				early_hits = cpu_data->states[i].early_hits;
+				max_early_idx = idx;
+			}
+
+			continue;
+		}
+
+		if (idx < 0) {
+			idx = i; /* first enabled state */
+			hits = cpu_data->states[i].hits;
+			misses = cpu_data->states[i].misses;
+		}
+
+		if (s->target_residency > duration_us)
+			break;
+
+		if (s->exit_latency > latency_req && constraint_idx > i)
+			constraint_idx = i;
+
+		idx = i;
+		hits = cpu_data->states[i].hits;
+		misses = cpu_data->states[i].misses;
+
+		if (early_hits < cpu_data->states[i].early_hits &&
+		    !(tick_stopped &&
+		      drv->states[i].target_residency < TEO_TICK_US)) {
+			prev_max_early_idx = max_early_idx;
+			early_hits = cpu_data->states[i].early_hits;
+			max_early_idx = i;
+		}
+	}
+
+	/*
+	 * I/O completions do not show up in the timer: with tasks waiting
+	 * for I/O on this cpu, the timer's bin has to win by twice as much.
+	 */
+	if (nr_iowait_cpu(dev->cpu))
+		misses <<= 1;
+
+	/*
+	 * If the hits of the timer's bin outweigh its misses, that is the
+	 * state to use. Otherwise one of the shallower bins is more likely
+	 * to match the wakeup, so take the one with the most early hits, if
+	 * there is one.
+	 */
+	if (hits <= misses) {
+		if (idx == max_early_idx)
+			max_early_idx = prev_max_early_idx;
+
+		if (max_early_idx >= 0) {
+			idx = max_early_idx;
+			duration_us = drv->states[idx].target_residency;
+		}
+	}
+
+	if (constraint_idx < idx)
+		idx = constraint_idx;
+
+	if (idx < 0) {
+		idx = 0; /* No states enabled. Must use 0. */
+	} else if (idx > 0) {
+		unsigned int count = 0;
+		u64 sum = 0;
+
+		/*
+		 * Count and sum the most recent idle duration values less
+		 * than the expected idle duration.
+		 */
+		for (i = 0; i < INTERVALS; i++) {
+			unsigned int val = cpu_data->intervals[i];
+
+			if (val >= duration_us)
+				continue;
+
+			count++;
+			sum += val;
+		}
+
+		/*
+		 * Give up unless the majority of the most recent idle
+		 * durations fall short of the expected one.
+		 */
+		if (count > INTERVALS / 2) {
+			unsigned int avg_us = div64_u64(sum, count);
+
+			/*
+			 * Avoid spending too much time in an idle state
+			 * that would be too shallow.
+			 */
+			if (!(tick_stopped && avg_us < TEO_TICK_US))
+				idx = teo_find_shallower_state(drv, dev, idx,
+							       avg_us);
+		}
+	}
+
+	return idx;
+}
+
+/**
+ * teo_reflect - note that governor data for the cpu need to be updated
+ * @dev: target cpu
+ * @state: entered state
+ */
+static void teo_reflect(struct cpuidle_device *dev, int state)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+
+	cpu_data->last_state = state;
+}
+
+/**
+ * teo_enable_device - initialize the governor's data for the target cpu
+ * @drv: cpuidle driver (not used)
+ * @dev: target cpu
+ */
+static int teo_enable_device(struct cpuidle_driver *drv,
+			     struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = &per_cpu(teo_cpus, dev->cpu);
+	int i;
+
+	memset(cpu_data, 0, sizeof(*cpu_data));
+	cpu_data->last_state = -1;
+
+	for (i = 0; i < INTERVALS; i++)
+		cpu_data->intervals[i] = UINT_MAX;
+
+	return 0;
+}
+
+static struct cpuidle_governor teo_governor = {
+	.name =		"teo",
+	.rating =	19,
+	.enable =	teo_enable_device,
+	.select =	teo_select,
+	.reflect =	teo_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_teo - initializes the governor
+ */
+static int __init init_teo(void)
+{
+	return cpuidle_register_governor(&teo_governor);
+}
+
+postcore_initcall(init_teo);
@@ -17,6 +17,7 @@
 #include <net/rtnetlink.h>
 #include <net/dst.h>
 #include <net/xfrm.h>
+#include <net/gro_cells.h>
 #include <linux/veth.h>
 #include <linux/module.h>
 
@@ -35,6 +36,7 @@ struct pcpu_vstats {
 struct veth_priv {
 	struct net_device __rcu	*peer;
 	atomic64_t		dropped;
+	struct gro_cells	gro_cells;
 };
 
 /*
@@ -105,6 +107,24 @@ static const struct ethtool_ops veth_ethtool_ops = {
 	.get_ethtool_stats	= veth_get_ethtool_stats,
 };
 
+/*
+ * Frames a peer is going to forward on go through GRO when it asked for
+ * fraglist GRO, so that they leave it chained rather than one by one.
+ */
+static int veth_forward_skb(struct net_device *rcv, struct sk_buff *skb)
+{
+	struct veth_priv *rcv_priv = netdev_priv(rcv);
+
+	if (!(rcv->features & NETIF_F_GRO_FRAGLIST))
+		return dev_forward_skb(rcv, skb);
+
+	if (__dev_forward_skb(rcv, skb) != NET_RX_SUCCESS)
+		return NET_RX_DROP;
+
+	gro_cells_receive(&rcv_priv->gro_cells, skb);
+	return NET_RX_SUCCESS;
+}
+
 static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct veth_priv *priv = netdev_priv(dev);
@@ -118,7 +138,7 @@ static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 		goto drop;
 	}
 
-	if (likely(dev_forward_skb(rcv, skb) == NET_RX_SUCCESS)) {
+	if (likely(veth_forward_skb(rcv, skb) == NET_RX_SUCCESS)) {
 		struct pcpu_vstats *stats = this_cpu_ptr(dev->vstats);
 
 		u64_stats_update_begin(&stats->syncp);
@@ -230,12 +250,29 @@ static int veth_change_mtu(struct net_device *dev, int new_mtu)
 
 static int veth_dev_init(struct net_device *dev)
 {
+	struct veth_priv *priv = netdev_priv(dev);
+	int err;
+
 	dev->vstats = netdev_alloc_pcpu_stats(struct pcpu_vstats);
 	if (!dev->vstats)
 		return -ENOMEM;
+
+	err = gro_cells_init(&priv->gro_cells, dev);
+	if (err) {
+		free_percpu(dev->vstats);
+		dev->vstats = NULL;
+		return err;
+	}
 	return 0;
 }
 
+static void veth_dev_uninit(struct net_device *dev)
+{
+	struct veth_priv *priv = netdev_priv(dev);
+
+	gro_cells_destroy(&priv->gro_cells);
+}
+
 static void veth_dev_free(struct net_device *dev)
 {
 	free_percpu(dev->vstats);
@@ -273,6 +310,7 @@ static int veth_get_iflink(const struct net_device *dev)
 
 static const struct net_device_ops veth_netdev_ops = {
 	.ndo_init            = veth_dev_init,
+	.ndo_uninit          = veth_dev_uninit,
 	.ndo_open            = veth_open,
 	.ndo_stop            = veth_close,
 	.ndo_start_xmit      = veth_xmit,
@@ -1350,6 +1350,14 @@ static struct regulator *create_regulator(struct regulator_dev *rdev,
 		regulator->always_on = true;
 
 	mutex_unlock(&rdev->mutex);
+
+	/*
+	 * Suspend the consumer before and resume it after its supply.  This
+	 * also lets the PM core handle both asynchronously.
+	 */
+	if (dev && device_link_add(dev, &rdev->dev, 0))
+		regulator->device_link = true;
+
 	return regulator;
 overflow_err:
 	list_del(&regulator->list);
@@ -1734,6 +1742,9 @@ static void _regulator_put(struct regulator *regulator)
 
 	debugfs_remove_recursive(regulator->debugfs);
 
+	if (regulator->device_link)
+		device_link_remove(regulator->dev, &rdev->dev);
+
 	/* remove any sysfs entries */
 	if (regulator->dev)
 		sysfs_remove_link(&rdev->dev.kobj, regulator->supply_name);
@@ -0,0 +1,176 @@
+/*
+ * EROFS metadata access and uncompressed data address space operations
+ *
+ * Copyright (C) 2017-2018 HUAWEI, Inc.
+ *             http://www.huawei.com/
+ * Created by Gao Xiang <gaoxiang25@huawei.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/mpage.h>
+#include "internal.h"
+
+/*
+ * Metadata (superblock, inodes, compression indexes, inline tails) and
+ * compressed clusters are read through the block device page cache, so
+ * hot compressed clusters stay cached and are reclaimed like any other
+ * clean page.
+ */
+struct page *erofs_get_meta_page(struct super_block *sb, erofs_blk_t blkaddr)
+{
+	struct address_space *mapping = sb->s_bdev->bd_inode->i_mapping;
+
+	return read_cache_page_gfp(mapping, blkaddr,
+				   mapping_gfp_constraint(mapping, ~__GFP_FS));
+}
+
+/*
+ * Map the metadata byte at @pos. The previous page in *@pagep is reused if
+ * it covers @pos, otherwise it is released; the caller drops the last one
+ * with erofs_put_metabuf().
+ */
+void *erofs_read_metabuf(struct super_block *sb, erofs_off_t pos,
+			 struct page **pagep)
+{
+	erofs_blk_t blkaddr = erofs_blknr(pos);
+	struct page *page = *pagep;
+
+	if (!page || page->index != blkaddr) {
+		erofs_put_metabuf(page);
+		*pagep = NULL;
+
+		page = erofs_get_meta_page(sb, blkaddr);
+		if (IS_ERR(page))
+			return ERR_CAST(page);
+		kmap(page);
+		*pagep = page;
+	}
+
+	return page_address(page) + erofs_blkoff(pos);
+}
+
+static bool erofs_is_inline_tail(struct inode *inode, pgoff_t index)
+{
+	return EROFS_I(inode)->datalayout == EROFS_INODE_FLAT_INLINE &&
+		index == erofs_inode_datablocks(inode) - 1;
+}
+
+static int erofs_get_block(struct inode *inode, sector_t iblock,
+			   struct buffer_head *bh, int create)
+{
+	struct erofs_inode *vi = EROFS_I(inode);
+	unsigned long nblocks = erofs_inode_datablocks(inode);
+	unsigned long max_blocks = bh->b_size >> inode->i_blkbits;
+
+	/* leave blocks past EOF unmapped, mpage zeroes them */
+	if (iblock >= nblocks)
+		return 0;
+
+	/* the inline tail lives in the metadata block, not in the data area */
+	if (vi->datalayout == EROFS_INODE_FLAT_INLINE) {
+		if (iblock == nblocks - 1)
+			return -EIO;
+		nblocks--;
+	}
+
+	/* data blocks of flat inodes are contiguous */
+	max_blocks = min_t(unsigned long, max_blocks, nblocks - iblock);
+	map_bh(bh, inode->i_sb, vi->raw_blkaddr + iblock);
+	bh->b_size = max_blocks << inode->i_blkbits;
+	return 0;
+}
+
+static int erofs_read_inline_page(struct inode *inode, struct page *page)
+{
+	struct erofs_inode *vi = EROFS_I(inode);
+	struct super_block *sb = inode->i_sb;
+	struct page *ipage = NULL;
+	unsigned int tailsize;
+	void *src, *dst;
+	int err = 0;
+
+	tailsize = inode->i_size - blknr_to_addr(page->index);
+	src = erofs_read_metabuf(sb, iloc(EROFS_SB(sb), vi->nid) +
+				 vi->inode_isize + vi->xattr_isize, &ipage);
+	if (IS_ERR(src)) {
+		err = PTR_ERR(src);
+		SetPageError(page);
+		goto out;
+	}
+
+	/* mkfs never lets the inline tail cross the inode's block */
+	if ((src - page_address(ipage)) + tailsize > EROFS_BLKSIZ) {
+		erofs_err(sb, "bogus inline data of nid %llu", vi->nid);
+		err = -EIO;
+		SetPageError(page);
+		goto out;
+	}
+
+	dst = kmap_atomic(page);
+	memcpy(dst, src, tailsize);
+	memset(dst + tailsize, 0, PAGE_SIZE - tailsize);
+	kunmap_atomic(dst);
+	flush_dcache_page(page);
+	SetPageUptodate(page);
+out:
+	erofs_put_metabuf(ipage);
+	unlock_page(page);
+	return err;
+}
+
+static int erofs_raw_access_readpage(struct file *file, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+
+	if (erofs_is_inline_tail(inode, page->index))
+		return erofs_read_inline_page(inode, page);
+
+	return mpage_readpage(page, erofs_get_block);
+}
+
+static int erofs_raw_access_readpages(struct file *filp,
+				      struct address_space *mapping,
+				      struct list_head *pages,
+				      unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct page *page;
+
+	/* pull the inline tail out, mpage can only handle mapped blocks */
+	list_for_each_entry(page, pages, lru) {
+		if (!erofs_is_inline_tail(inode, page->index))
+			continue;
+
+		list_del(&page->lru);
+		if (!add_to_page_cache_lru(page, mapping, page->index,
+				mapping_gfp_constraint(mapping, GFP_KERNEL)))
+			erofs_read_inline_page(inode, page);
+		put_page(page);
+		--nr_pages;
+		break;
+	}
+
+	if (!nr_pages)
+		return 0;
+
+	return mpage_readpages(mapping, pages, nr_pages, erofs_get_block);
+}
+
+static sector_t erofs_bmap(struct address_space *mapping, sector_t block)
+{
+	struct inode *inode = mapping->host;
+
+	if (erofs_is_inline_tail(inode, block))
+		return 0;
+
+	return generic_block_bmap(mapping, block, erofs_get_block);
+}
+
+/* for uncompressed (aligned) files and raw access for other files */
+const struct address_space_operations erofs_raw_access_aops = {
+	.readpage = erofs_raw_access_readpage,
+	.readpages = erofs_raw_access_readpages,
+	.bmap = erofs_bmap,
+};
@@ -0,0 +1,188 @@
+/*
+ * EROFS (Enhanced Read-Only File System) in-memory structures
+ *
+ * Copyright (C) 2017-2018 HUAWEI, Inc.
+ *             http://www.huawei.com/
+ * Created by Gao Xiang <gaoxiang25@huawei.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __EROFS_INTERNAL_H
+#define __EROFS_INTERNAL_H
+
+#include <linux/fs.h>
+#include <linux/dcache.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/bio.h>
+#include <linux/buffer_head.h>
+#include <linux/slab.h>
+#include "erofs_fs.h"
+
+#define erofs_err(sb, fmt, ...)	\
+	pr_err("%s: " fmt "\n", (sb)->s_id, ##__VA_ARGS__)
+#define erofs_info(sb, fmt, ...) \
+	pr_info("%s: " fmt "\n", (sb)->s_id, ##__VA_ARGS__)
+#ifdef CONFIG_EROFS_FS_DEBUG
+#define erofs_dbg(x, ...)	pr_debug(x "\n", ##__VA_ARGS__)
+#define DBG_BUGON		BUG_ON
+#else
+#define erofs_dbg(x, ...)	((void)0)
+#define DBG_BUGON(x)		((void)(x))
+#endif
+
+typedef u64 erofs_nid_t;
+typedef u64 erofs_off_t;
+/* data type for filesystem-wide blocks number */
+typedef u32 erofs_blk_t;
+
+struct erofs_sb_info {
+	u32 blocks;
+	u32 meta_blkaddr;
+
+	u32 build_time_nsec;
+	u64 build_time;
+
+	/* what we really care is nid, rather than ino.. */
+	erofs_nid_t root_nid;
+	/* used for statfs, f_files - f_favail */
+	u64 inos;
+
+	u8 uuid[16];
+	u8 volume_name[16];
+	u32 feature_incompat;
+
+	/* number of per-cpu buffer fallbacks in z_erofs decompression */
+	atomic_long_t z_pcpubuf_hits;
+};
+
+#define EROFS_SB(sb) ((struct erofs_sb_info *)(sb)->s_fs_info)
+#define EROFS_I_SB(inode) ((struct erofs_sb_info *)(inode)->i_sb->s_fs_info)
+
+#define EROFS_FEATURE_FUNCS(name, compat, feature) \
+static inline bool erofs_sb_has_##name(struct erofs_sb_info *sbi) \
+{ \
+	return sbi->feature_##compat & EROFS_FEATURE_##feature; \
+}
+
+EROFS_FEATURE_FUNCS(lz4_0padding, incompat, INCOMPAT_LZ4_0PADDING)
+
+/* we strictly follow PAGE_SIZE */
+#define LOG_BLOCK_SIZE		PAGE_SHIFT
+#define EROFS_BLKSIZ		(1 << LOG_BLOCK_SIZE)
+
+#define erofs_blknr(addr)	((addr) / EROFS_BLKSIZ)
+#define erofs_blkoff(addr)	((addr) % EROFS_BLKSIZ)
+#define blknr_to_addr(nr)	((erofs_off_t)(nr) * EROFS_BLKSIZ)
+
+static inline erofs_off_t iloc(struct erofs_sb_info *sbi, erofs_nid_t nid)
+{
+	return blknr_to_addr(sbi->meta_blkaddr) + (nid << EROFS_ISLOTBITS);
+}
+
+struct erofs_inode {
+	erofs_nid_t nid;
+
+	unsigned char datalayout;
+	unsigned char inode_isize;
+	unsigned short xattr_isize;
+
+	union {
+		erofs_blk_t raw_blkaddr;
+		struct {
+			unsigned short	z_advise;
+			unsigned char	z_algorithmtype;
+			unsigned char	z_logical_clusterbits;
+		};
+	};
+	/* the corresponding vfs inode */
+	struct inode vfs_inode;
+};
+
+#define EROFS_I(ptr)	\
+	container_of(ptr, struct erofs_inode, vfs_inode)
+
+static inline unsigned long erofs_inode_datablocks(struct inode *inode)
+{
+	/* since i_size cannot be changed */
+	return DIV_ROUND_UP(inode->i_size, EROFS_BLKSIZ);
+}
+
+static inline unsigned int erofs_bitrange(unsigned int value, unsigned int bit,
+					  unsigned int bits)
+{
+	return (value >> bit) & ((1 << bits) - 1);
+}
+
+static inline unsigned int erofs_inode_version(unsigned int value)
+{
+	return erofs_bitrange(value, EROFS_I_VERSION_BIT,
+			      EROFS_I_VERSION_BITS);
+}
+
+static inline unsigned int erofs_inode_datalayout(unsigned int value)
+{
+	return erofs_bitrange(value, EROFS_I_DATALAYOUT_BIT,
+			      EROFS_I_DATALAYOUT_BITS);
+}
+
+extern const struct super_operations erofs_sops;
+
+extern const struct address_space_operations erofs_raw_access_aops;
+extern const struct address_space_operations z_erofs_aops;
+
+/* data.c */
+struct page *erofs_get_meta_page(struct super_block *sb, erofs_blk_t blkaddr);
+void *erofs_read_metabuf(struct super_block *sb, erofs_off_t pos,
+			 struct page **pagep);
+
+static inline void erofs_put_metabuf(struct page *page)
+{
+	if (page) {
+		kunmap(page);
+		put_page(page);
+	}
+}
+
+/* inode.c */
+static inline unsigned long erofs_inode_hash(erofs_nid_t nid)
+{
+#if BITS_PER_LONG == 32
+	return (nid >> 32) ^ (nid & 0xffffffff);
+#else
+	return nid;
+#endif
+}
+
+struct inode *erofs_iget(struct super_block *sb, erofs_nid_t nid);
+
+/* namei.c */
+extern const struct inode_operations erofs_dir_iops;
+
+int erofs_namei(struct inode *dir, struct qstr *name,
+		erofs_nid_t *nid, unsigned int *d_type);
+
+/* dir.c */
+extern const struct file_operations erofs_dir_fops;
+
+/* zmap.c */
+#define Z_EROFS_PCPUBUF_NR_PAGES	4
+
+struct z_erofs_map {
+	erofs_off_t m_la;	/* start of the extent, in the file */
+	erofs_off_t m_llen;	/* decompressed length of the extent */
+	erofs_blk_t m_pblk;	/* the physical cluster holding it */
+	bool m_compressed;	/* false for an uncompressed (plain) cluster */
+};
+
+int z_erofs_fill_inode(struct inode *inode);
+int z_erofs_map_blocks(struct inode *inode, erofs_off_t la,
+		       struct z_erofs_map *map);
+
+/* zdata.c */
+int __init z_erofs_init_zip_subsystem(void);
+void z_erofs_exit_zip_subsystem(void);
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * EROFS directory lookup
+ *
+ * Copyright (C) 2017-2018 HUAWEI, Inc.
+ *             http://www.huawei.com/
+ * Created by Gao Xiang <gaoxiang25@huawei.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include "internal.h"
+
+struct erofs_qstr {
+	const unsigned char *name;
+	const unsigned char *end;
+};
+
+/* clamp bogus name offsets so a corrupted block can't walk off the page */
+static inline unsigned int nameoff_from_disk(__le16 off, unsigned int len)
+{
+	unsigned int ret = le16_to_cpu(off);
+
+	return ret < len ? ret : len;
+}
+
+/* @qn must be NUL-terminated, on-disk names in @qd may not be */
+static int erofs_dirnamecmp(const struct erofs_qstr *qn,
+			    const struct erofs_qstr *qd,
+			    unsigned int *matched)
+{
+	unsigned int i = *matched;
+
+	DBG_BUGON(qd->name > qd->end);
+
+	while (qd->name + i < qd->end && qd->name[i] != '\0') {
+		if (qn->name[i] != qd->name[i]) {
+			*matched = i;
+			return qn->name[i] > qd->name[i] ? 1 : -1;
+		}
+		++i;
+	}
+	*matched = i;
+	return qn->name[i] == '\0' ? 0 : 1;
+}
+
+/* binary search within a directory block, the first dirent is known < name */
+static struct erofs_dirent *find_target_dirent(struct erofs_qstr *name,
+					       u8 *data,
+					       unsigned int dirblksize,
+					       const int ndirents)
+{
+	struct erofs_dirent *const de = (struct erofs_dirent *)data;
+	unsigned int startprfx = 0, endprfx = 0;
+	int head = 1, back = ndirents - 1;
+
+	while (head <= back) {
+		const int mid = head + (back - head) / 2;
+		const unsigned int nameoff =
+			nameoff_from_disk(de[mid].nameoff, dirblksize);
+		unsigned int matched = min(startprfx, endprfx);
+		struct erofs_qstr dname;
+		int ret;
+
+		dname.name = data + nameoff;
+		if (mid >= ndirents - 1)
+			dname.end = data + dirblksize;
+		else
+			dname.end = data + nameoff_from_disk(de[mid + 1].nameoff,
+							     dirblksize);
+
+		/* string comparison without the already matched prefix */
+		ret = erofs_dirnamecmp(name, &dname, &matched);
+		if (!ret)
+			return de + mid;
+
+		if (ret > 0) {
+			head = mid + 1;
+			startprfx = matched;
+		} else {
+			back = mid - 1;
+			endprfx = matched;
+		}
+	}
+	return ERR_PTR(-ENOENT);
+}
+
+/*
+ * Binary search over directory blocks by their first name. Returns the
+ * block that may hold @name; *@_ndirents is 0 if its first dirent matched.
+ */
+static struct page *find_target_block_classic(struct inode *dir,
+					      struct erofs_qstr *name,
+					      int *_ndirents)
+{
+	struct address_space *const mapping = dir->i_mapping;
+	struct page *candidate = ERR_PTR(-ENOENT);
+	unsigned int startprfx = 0, endprfx = 0;
+	int head = 0, back = erofs_inode_datablocks(dir) - 1;
+
+	while (head <= back) {
+		const int mid = head + (back - head) / 2;
+		struct page *page = read_mapping_page(mapping, mid, NULL);
+		struct erofs_dirent *de;
+		struct erofs_qstr dname;
+		unsigned int nameoff, matched;
+		int ndirents, diff;
+
+		if (IS_ERR(page))
+			goto out;
+
+		de = kmap_atomic(page);
+		nameoff = nameoff_from_disk(de->nameoff, EROFS_BLKSIZ);
+		ndirents = nameoff / sizeof(*de);
+		if (!ndirents) {
+			kunmap_atomic(de);
+			put_page(page);
+			erofs_err(dir->i_sb, "corrupted dir block %d @ nid %llu",
+				  mid, EROFS_I(dir)->nid);
+			page = ERR_PTR(-EIO);
+			goto out;
+		}
+
+		matched = min(startprfx, endprfx);
+		dname.name = (u8 *)de + nameoff;
+		if (ndirents == 1)
+			dname.end = (u8 *)de + EROFS_BLKSIZ;
+		else
+			dname.end = (u8 *)de +
+				nameoff_from_disk(de[1].nameoff, EROFS_BLKSIZ);
+
+		diff = erofs_dirnamecmp(name, &dname, &matched);
+		kunmap_atomic(de);
+
+		if (!diff) {
+			*_ndirents = 0;
+			goto out;
+		}
+
+		if (diff > 0) {
+			head = mid + 1;
+			startprfx = matched;
+			if (!IS_ERR(candidate))
+				put_page(candidate);
+			candidate = page;
+			*_ndirents = ndirents;
+		} else {
+			put_page(page);
+			back = mid - 1;
+			endprfx = matched;
+		}
+		continue;
+out:
+		if (!IS_ERR(candidate))
+			put_page(candidate);
+		return page;
+	}
+	return candidate;
+}
+
+int erofs_namei(struct inode *dir, struct qstr *name,
+		erofs_nid_t *nid, unsigned int *d_type)
+{
+	struct erofs_dirent *de;
+	struct erofs_qstr qn;
+	struct page *page;
+	int ndirents = 0;
+	void *data;
+
+	if (!dir->i_size)
+		return -ENOENT;
+
+	qn.name = name->name;
+	qn.end = name->name + name->len;
+
+	page = find_target_block_classic(dir, &qn, &ndirents);
+	if (IS_ERR(page))
+		return PTR_ERR(page);
+
+	data = kmap_atomic(page);
+	if (ndirents)
+		de = find_target_dirent(&qn, data, EROFS_BLKSIZ, ndirents);
+	else
+		de = data;
+
+	if (!IS_ERR(de)) {
+		*nid = le64_to_cpu(de->nid);
+		*d_type = de->file_type;
+	}
+	kunmap_atomic(data);
+	put_page(page);
+	return PTR_ERR_OR_ZERO(de);
+}
+
+static struct dentry *erofs_lookup(struct inode *dir, struct dentry *dentry,
+				   unsigned int flags)
+{
+	struct inode *inode;
+	unsigned int d_type;
+	erofs_nid_t nid;
+	int err;
+
+	if (dentry->d_name.len > EROFS_NAME_LEN)
+		return ERR_PTR(-ENAMETOOLONG);
+
+	err = erofs_namei(dir, &dentry->d_name, &nid, &d_type);
+	if (err == -ENOENT)
+		inode = NULL;
+	else if (err)
+		inode = ERR_PTR(err);
+	else
+		inode = erofs_iget(dir->i_sb, nid);
+
+	return d_splice_alias(inode, dentry);
+}
+
+const struct inode_operations erofs_dir_iops = {
+	.lookup = erofs_lookup,
+};
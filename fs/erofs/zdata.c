@@ -0,0 +1,318 @@
+/*
+ * EROFS compressed data address space operations
+ *
+ * Copyright (C) 2018-2019 HUAWEI, Inc.
+ *             http://www.huawei.com/
+ * Created by Gao Xiang <gaoxiang25@huawei.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/lz4.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include "internal.h"
+
+/*
+ * Scratch output for extents which only partially land in the pages being
+ * read; decompressing into them avoids allocating and mapping temporary
+ * pages for the common case of a small readpage.
+ */
+static DEFINE_PER_CPU(void *, z_erofs_pcpubuf);
+
+/* locked page cache pages of a read request, indexed from @start */
+struct z_erofs_readctx {
+	struct inode *inode;
+	pgoff_t start;
+	unsigned int nr;
+	struct page **pages;
+};
+
+static struct page *z_erofs_ctx_page(struct z_erofs_readctx *rq, pgoff_t index)
+{
+	if (index < rq->start || index - rq->start >= rq->nr)
+		return NULL;
+	return rq->pages[index - rq->start];
+}
+
+/* copy decompressed bytes to whichever output pages the request holds */
+static void z_erofs_copy_out(struct z_erofs_readctx *rq, pgoff_t first,
+			     unsigned int pageofs, const u8 *src,
+			     unsigned int len)
+{
+	while (len) {
+		unsigned int cnt = min_t(unsigned int, len,
+					 PAGE_SIZE - pageofs);
+		struct page *page = z_erofs_ctx_page(rq, first);
+
+		if (page) {
+			u8 *dst = kmap_atomic(page);
+
+			memcpy(dst + pageofs, src, cnt);
+			kunmap_atomic(dst);
+		}
+		src += cnt;
+		len -= cnt;
+		pageofs = 0;
+		++first;
+	}
+}
+
+static int z_erofs_lz4_decompress(const u8 *src, u8 *dst, unsigned int outlen)
+{
+	unsigned int inputmargin = 0;
+	size_t dstlen = outlen;
+
+	/* LZ4_0PADDING: compressed data is aligned to the end of the block */
+	while (inputmargin < EROFS_BLKSIZ && !src[inputmargin])
+		++inputmargin;
+	if (inputmargin >= EROFS_BLKSIZ)
+		return -EIO;
+
+	if (lz4_decompress_unknownoutputsize(src + inputmargin,
+					     EROFS_BLKSIZ - inputmargin,
+					     dst, &dstlen) || dstlen != outlen)
+		return -EIO;
+	return 0;
+}
+
+static int z_erofs_decompress_extent(struct z_erofs_readctx *rq,
+				     const struct z_erofs_map *map)
+{
+	struct super_block *sb = rq->inode->i_sb;
+	const pgoff_t first = map->m_la >> PAGE_SHIFT;
+	const unsigned int pageofs = map->m_la & ~PAGE_MASK;
+	const unsigned int outlen = map->m_llen;
+	const unsigned int nrpages_out =
+		DIV_ROUND_UP(pageofs + map->m_llen, PAGE_SIZE);
+	struct page *onstack[Z_EROFS_PCPUBUF_NR_PAGES];
+	struct page **out = onstack, *ipage;
+	unsigned int i, nr_missing = 0;
+	u8 *src, *dst;
+	int err = 0;
+
+	/* lz4 can't expand a block by more than 255x, reject bogus maps */
+	if (map->m_llen > (erofs_off_t)EROFS_BLKSIZ << 8)
+		return -EIO;
+
+	ipage = erofs_get_meta_page(sb, map->m_pblk);
+	if (IS_ERR(ipage))
+		return PTR_ERR(ipage);
+	src = kmap(ipage);
+
+	/* uncompressed clusters are stored shifted to the start of the block */
+	if (!map->m_compressed) {
+		if (outlen > EROFS_BLKSIZ)
+			err = -EIO;
+		else
+			z_erofs_copy_out(rq, first, pageofs, src, outlen);
+		goto out_ipage;
+	}
+
+	if (nrpages_out > Z_EROFS_PCPUBUF_NR_PAGES) {
+		out = kcalloc(nrpages_out, sizeof(*out), GFP_NOFS);
+		if (!out) {
+			err = -ENOMEM;
+			goto out_ipage;
+		}
+	}
+	for (i = 0; i < nrpages_out; ++i) {
+		out[i] = z_erofs_ctx_page(rq, first + i);
+		if (!out[i])
+			++nr_missing;
+	}
+
+	if (!nr_missing && nrpages_out == 1) {
+		dst = kmap_atomic(out[0]);
+		err = z_erofs_lz4_decompress(src, dst + pageofs, outlen);
+		kunmap_atomic(dst);
+		goto out_array;
+	}
+
+	if (nr_missing && nrpages_out <= Z_EROFS_PCPUBUF_NR_PAGES) {
+		dst = get_cpu_var(z_erofs_pcpubuf);
+		err = z_erofs_lz4_decompress(src, dst + pageofs, outlen);
+		if (!err)
+			z_erofs_copy_out(rq, first, pageofs,
+					 dst + pageofs, outlen);
+		put_cpu_var(z_erofs_pcpubuf);
+		atomic_long_inc(&EROFS_SB(sb)->z_pcpubuf_hits);
+		goto out_array;
+	}
+
+	/* decompress straight into the page cache, padding the gaps */
+	for (i = 0; i < nrpages_out; ++i) {
+		if (out[i])
+			continue;
+		out[i] = alloc_page(GFP_NOFS);
+		if (!out[i]) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	dst = vm_map_ram(out, nrpages_out, -1, PAGE_KERNEL);
+	if (!dst) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	err = z_erofs_lz4_decompress(src, dst + pageofs, outlen);
+	vm_unmap_ram(dst, nrpages_out);
+
+out_free:
+	for (i = 0; nr_missing && i < nrpages_out; ++i) {
+		if (out[i] && out[i] != z_erofs_ctx_page(rq, first + i))
+			__free_page(out[i]);
+	}
+out_array:
+	if (out != onstack)
+		kfree(out);
+out_ipage:
+	kunmap(ipage);
+	put_page(ipage);
+
+	if (err)
+		erofs_err(sb, "failed to decompress extent @ la %llu of nid %llu",
+			  map->m_la, EROFS_I(rq->inode)->nid);
+	return err;
+}
+
+static void z_erofs_do_read(struct z_erofs_readctx *rq)
+{
+	struct inode *inode = rq->inode;
+	const erofs_off_t isize = i_size_read(inode);
+	erofs_off_t pos = (erofs_off_t)rq->start << PAGE_SHIFT;
+	const erofs_off_t end = min_t(erofs_off_t, isize,
+		(erofs_off_t)(rq->start + rq->nr) << PAGE_SHIFT);
+	unsigned int i;
+
+	while (pos < end) {
+		struct z_erofs_map map;
+		pgoff_t index;
+		int err;
+
+		/* skip the holes which are already cached */
+		if (!z_erofs_ctx_page(rq, pos >> PAGE_SHIFT)) {
+			pos = round_down(pos, PAGE_SIZE) + PAGE_SIZE;
+			continue;
+		}
+
+		err = z_erofs_map_blocks(inode, pos, &map);
+		if (!err)
+			err = z_erofs_decompress_extent(rq, &map);
+		if (!err) {
+			pos = map.m_la + map.m_llen;
+			continue;
+		}
+
+		/* fail the page at @pos and try the next one */
+		index = pos >> PAGE_SHIFT;
+		SetPageError(z_erofs_ctx_page(rq, index));
+		pos = ((erofs_off_t)index + 1) << PAGE_SHIFT;
+	}
+
+	for (i = 0; i < rq->nr; ++i) {
+		struct page *page = rq->pages[i];
+		erofs_off_t off = (erofs_off_t)(rq->start + i) << PAGE_SHIFT;
+
+		if (!page)
+			continue;
+
+		/* zero whatever lies beyond EOF */
+		if (off + PAGE_SIZE > isize)
+			zero_user_segment(page, off < isize ? isize - off : 0,
+					  PAGE_SIZE);
+
+		if (!PageError(page)) {
+			flush_dcache_page(page);
+			SetPageUptodate(page);
+		}
+		unlock_page(page);
+	}
+}
+
+static int z_erofs_readpage(struct file *file, struct page *page)
+{
+	struct z_erofs_readctx rq = {
+		.inode = page->mapping->host,
+		.start = page->index,
+		.nr = 1,
+		.pages = &page,
+	};
+
+	z_erofs_do_read(&rq);
+	return 0;
+}
+
+static int z_erofs_readpages(struct file *filp, struct address_space *mapping,
+			     struct list_head *pages, unsigned int nr_pages)
+{
+	gfp_t gfp = mapping_gfp_constraint(mapping, GFP_KERNEL);
+	struct z_erofs_readctx rq = { .inode = mapping->host };
+	pgoff_t last = 0;
+	struct page *page;
+
+	rq.start = ULONG_MAX;
+	list_for_each_entry(page, pages, lru) {
+		rq.start = min(rq.start, page->index);
+		last = max(last, page->index);
+	}
+	rq.nr = last - rq.start + 1;
+
+	rq.pages = kcalloc(rq.nr, sizeof(*rq.pages), GFP_NOFS | __GFP_NOWARN);
+
+	while (!list_empty(pages)) {
+		page = list_entry(pages->prev, struct page, lru);
+		list_del(&page->lru);
+
+		if (add_to_page_cache_lru(page, mapping, page->index, gfp)) {
+			put_page(page);
+			continue;
+		}
+
+		/* fall back to reading one page at a time */
+		if (!rq.pages)
+			z_erofs_readpage(filp, page);
+		else
+			rq.pages[page->index - rq.start] = page;
+		put_page(page);
+	}
+
+	if (rq.pages) {
+		z_erofs_do_read(&rq);
+		kfree(rq.pages);
+	}
+	return 0;
+}
+
+const struct address_space_operations z_erofs_aops = {
+	.readpage = z_erofs_readpage,
+	.readpages = z_erofs_readpages,
+};
+
+int __init z_erofs_init_zip_subsystem(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		void *buf = vmalloc(Z_EROFS_PCPUBUF_NR_PAGES * PAGE_SIZE);
+
+		if (!buf) {
+			z_erofs_exit_zip_subsystem();
+			return -ENOMEM;
+		}
+		per_cpu(z_erofs_pcpubuf, cpu) = buf;
+	}
+	return 0;
+}
+
+void z_erofs_exit_zip_subsystem(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(z_erofs_pcpubuf, cpu));
+		per_cpu(z_erofs_pcpubuf, cpu) = NULL;
+	}
+}
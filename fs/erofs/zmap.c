@@ -0,0 +1,196 @@
+/*
+ * EROFS compressed extent mapping
+ *
+ * Copyright (C) 2018-2019 HUAWEI, Inc.
+ *             http://www.huawei.com/
+ * Created by Gao Xiang <gaoxiang25@huawei.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include "internal.h"
+
+int z_erofs_fill_inode(struct inode *inode)
+{
+	struct erofs_inode *vi = EROFS_I(inode);
+	struct super_block *sb = inode->i_sb;
+
+	/*
+	 * Only the legacy full (8-byte per logical cluster) index is handled;
+	 * compacted indexes need a newer mkfs layout walker.
+	 */
+	if (vi->datalayout != EROFS_INODE_FLAT_COMPRESSION_LEGACY) {
+		erofs_err(sb, "compacted indexes of nid %llu are unsupported",
+			  vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	/*
+	 * The in-kernel lz4 decoder needs the exact compressed length, which
+	 * is only recoverable when compressed data is aligned to block end.
+	 */
+	if (!erofs_sb_has_lz4_0padding(EROFS_SB(sb))) {
+		erofs_err(sb, "lz4 without 0padding is unsupported (nid %llu)",
+			  vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	/* legacy images always use 4k-page sized lz4 clusters */
+	vi->z_advise = 0;
+	vi->z_algorithmtype = Z_EROFS_COMPRESSION_LZ4;
+	vi->z_logical_clusterbits = LOG_BLOCK_SIZE;
+	return 0;
+}
+
+struct z_erofs_lcluster {
+	struct inode *inode;
+	struct page *mpage;
+
+	unsigned int type;
+	unsigned int clusterofs;
+	erofs_blk_t pblk;
+	u16 delta[2];
+};
+
+static int z_erofs_load_lcluster(struct z_erofs_lcluster *m, unsigned long lcn)
+{
+	struct inode *inode = m->inode;
+	struct erofs_inode *vi = EROFS_I(inode);
+	const erofs_off_t ibase = iloc(EROFS_I_SB(inode), vi->nid);
+	const erofs_off_t pos =
+		Z_EROFS_VLE_LEGACY_INDEX_ALIGN(ibase + vi->inode_isize +
+					       vi->xattr_isize) +
+		lcn * sizeof(struct z_erofs_vle_decompressed_index);
+	struct z_erofs_vle_decompressed_index *di;
+	unsigned int advise;
+
+	di = erofs_read_metabuf(inode->i_sb, pos, &m->mpage);
+	if (IS_ERR(di))
+		return PTR_ERR(di);
+
+	advise = le16_to_cpu(di->di_advise);
+	m->type = erofs_bitrange(advise, Z_EROFS_VLE_DI_CLUSTER_TYPE_BIT,
+				 Z_EROFS_VLE_DI_CLUSTER_TYPE_BITS);
+	switch (m->type) {
+	case Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD:
+		m->clusterofs = 1 << vi->z_logical_clusterbits;
+		m->delta[0] = le16_to_cpu(di->di_u.delta[0]);
+		m->delta[1] = le16_to_cpu(di->di_u.delta[1]);
+		break;
+	case Z_EROFS_VLE_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_VLE_CLUSTER_TYPE_HEAD:
+		m->clusterofs = le16_to_cpu(di->di_clusterofs);
+		m->pblk = le32_to_cpu(di->di_u.blkaddr);
+		break;
+	default:
+		DBG_BUGON(1);
+		return -EOPNOTSUPP;
+	}
+	return 0;
+}
+
+/* walk NONHEAD lclusters back to the head of the extent covering @lcn */
+static int z_erofs_lookback(struct z_erofs_lcluster *m, unsigned long lcn,
+			    unsigned long *headlcn)
+{
+	int err;
+
+	for (;;) {
+		err = z_erofs_load_lcluster(m, lcn);
+		if (err)
+			return err;
+
+		if (m->type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD)
+			break;
+
+		if (!m->delta[0] || m->delta[0] > lcn) {
+			erofs_err(m->inode->i_sb,
+				  "bogus lookback distance @ nid %llu",
+				  EROFS_I(m->inode)->nid);
+			DBG_BUGON(1);
+			return -EIO;
+		}
+		lcn -= m->delta[0];
+	}
+	*headlcn = lcn;
+	return 0;
+}
+
+/*
+ * Map the whole extent covering @la: where it starts in the file, which
+ * physical cluster it decompresses from and how long its output is.
+ */
+int z_erofs_map_blocks(struct inode *inode, erofs_off_t la,
+		       struct z_erofs_map *map)
+{
+	struct erofs_inode *vi = EROFS_I(inode);
+	const unsigned int lclusterbits = vi->z_logical_clusterbits;
+	struct z_erofs_lcluster m = { .inode = inode };
+	unsigned long lcn = la >> lclusterbits;
+	unsigned long headlcn;
+	unsigned int endoff = la & ((1 << lclusterbits) - 1);
+	erofs_off_t end;
+	int err;
+
+	if (la >= inode->i_size)
+		return -EINVAL;
+
+	err = z_erofs_load_lcluster(&m, lcn);
+	if (err)
+		goto out;
+
+	if (m.type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD &&
+	    endoff >= m.clusterofs) {
+		headlcn = lcn;
+	} else {
+		/* @la belongs to an extent which started in a prior lcluster */
+		if (!lcn) {
+			err = -EIO;
+			goto out;
+		}
+		err = z_erofs_lookback(&m, m.type ==
+				       Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD ?
+				       lcn : lcn - 1, &headlcn);
+		if (err)
+			goto out;
+	}
+
+	map->m_la = ((erofs_off_t)headlcn << lclusterbits) + m.clusterofs;
+	map->m_pblk = m.pblk;
+	map->m_compressed = m.type == Z_EROFS_VLE_CLUSTER_TYPE_HEAD;
+
+	/* look ahead for the next HEAD/PLAIN lcluster, which ends the extent */
+	lcn = headlcn + 1;
+	for (;;) {
+		if (((erofs_off_t)lcn << lclusterbits) >= inode->i_size) {
+			end = inode->i_size;
+			break;
+		}
+
+		err = z_erofs_load_lcluster(&m, lcn);
+		if (err)
+			goto out;
+
+		if (m.type != Z_EROFS_VLE_CLUSTER_TYPE_NONHEAD) {
+			end = ((erofs_off_t)lcn << lclusterbits) + m.clusterofs;
+			break;
+		}
+		/* work around an invalid delta[1] generated by old mkfs */
+		lcn += m.delta[1] ? m.delta[1] : 1;
+	}
+
+	if (end <= map->m_la || end > inode->i_size) {
+		erofs_err(inode->i_sb, "bogus extent @ la %llu of nid %llu",
+			  la, vi->nid);
+		err = -EIO;
+		goto out;
+	}
+	map->m_llen = end - map->m_la;
+
+	erofs_dbg("%s, nid %llu la %llu: m_la %llu m_llen %llu m_pblk %u",
+		  __func__, vi->nid, la, map->m_la, map->m_llen, map->m_pblk);
+out:
+	erofs_put_metabuf(m.mpage);
+	return err;
+}
@@ -1097,6 +1097,7 @@ struct ext4_inode_info {
 
 #define EXT4_MOUNT2_EXPLICIT_JOURNAL_CHECKSUM	0x00000008 /* User explicitly
 						specified journal checksum */
+#define EXT4_MOUNT2_JOURNAL_FAST_COMMIT	0x00000010 /* Journal fast commit */
 
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
@@ -1450,6 +1451,13 @@ struct ext4_sb_info {
 	struct ratelimit_state s_err_ratelimit_state;
 	struct ratelimit_state s_warning_ratelimit_state;
 	struct ratelimit_state s_msg_ratelimit_state;
+
+	/* Fast commits */
+	tid_t s_fc_ineligible_tid;	/* last tid which touched metadata
+					   fast commits can't describe */
+	int s_fc_replay_blocks;		/* valid blocks found by recovery */
+	atomic_t s_fc_commits;
+	atomic_t s_full_commits;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -2425,6 +2433,11 @@ static inline  unsigned char get_dtype(struct super_block *sb, int filetype)
 extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 			     void *buf, int buf_size);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(handle_t *handle);
+extern void ext4_fc_init(struct super_block *sb, journal_t *journal);
+extern int ext4_fc_commit(struct inode *inode, tid_t commit_tid);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
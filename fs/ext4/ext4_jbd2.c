@@ -153,8 +153,13 @@ static void ext4_journal_abort_handle(const char *caller, unsigned int line,
 	jbd2_journal_abort_handle(handle);
 }
 
-int __ext4_journal_get_write_access(const char *where, unsigned int line,
-				    handle_t *handle, struct buffer_head *bh)
+/*
+ * Write access to an inode table block, which doesn't keep the transaction
+ * from being fast committed.
+ */
+int __ext4_journal_get_inode_write_access(const char *where, unsigned int line,
+					  handle_t *handle,
+					  struct buffer_head *bh)
 {
 	int err = 0;
 
@@ -169,6 +174,13 @@ int __ext4_journal_get_write_access(const char *where, unsigned int line,
 	return err;
 }
 
+int __ext4_journal_get_write_access(const char *where, unsigned int line,
+				    handle_t *handle, struct buffer_head *bh)
+{
+	ext4_fc_mark_ineligible(handle);
+	return __ext4_journal_get_inode_write_access(where, line, handle, bh);
+}
+
 /*
  * The ext4 forget function must perform a revoke if we are freeing data
  * which has been journaled.  Metadata (eg. indirect blocks) must be
@@ -202,6 +214,7 @@ int __ext4_forget(const char *where, unsigned int line, handle_t *handle,
 		bforget(bh);
 		return 0;
 	}
+	ext4_fc_mark_ineligible(handle);
 
 	/* Never use the revoke function if we are doing full data
 	 * journaling: there is no need to, and a V1 superblock won't
@@ -242,6 +255,7 @@ int __ext4_journal_get_create_access(const char *where, unsigned int line,
 	int err = 0;
 
 	if (ext4_handle_valid(handle)) {
+		ext4_fc_mark_ineligible(handle);
 		err = jbd2_journal_get_create_access(handle, bh);
 		if (err)
 			ext4_journal_abort_handle(where, line, __func__,
@@ -229,6 +229,10 @@ int ext4_mark_inode_dirty(handle_t *handle, struct inode *inode);
 /*
  * Wrapper functions with which ext4 calls into JBD.
  */
+int __ext4_journal_get_inode_write_access(const char *where, unsigned int line,
+					  handle_t *handle,
+					  struct buffer_head *bh);
+
 int __ext4_journal_get_write_access(const char *where, unsigned int line,
 				    handle_t *handle, struct buffer_head *bh);
 
@@ -246,6 +250,9 @@ int __ext4_handle_dirty_metadata(const char *where, unsigned int line,
 int __ext4_handle_dirty_super(const char *where, unsigned int line,
 			      handle_t *handle, struct super_block *sb);
 
+#define ext4_journal_get_inode_write_access(handle, bh) \
+	__ext4_journal_get_inode_write_access(__func__, __LINE__, (handle), \
+					      (bh))
 #define ext4_journal_get_write_access(handle, bh) \
 	__ext4_journal_get_write_access(__func__, __LINE__, (handle), (bh))
 #define ext4_forget(handle, is_metadata, inode, bh, block_nr) \
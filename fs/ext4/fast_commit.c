@@ -0,0 +1,343 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ *  ext4 fast commits
+ *
+ *  Most fsync()s after overwriting a file only change its inode: the size
+ *  and times are updated, no blocks are allocated.  Instead of committing
+ *  the whole running transaction, such an fsync() writes a single block
+ *  with the inode's raw on-disk image into the fast commit area at the end
+ *  of the journal, tagged with the id of the running transaction.
+ *
+ *  A transaction remains eligible for fast commits as long as it only gets
+ *  write access to inode table blocks.  Touching any other metadata
+ *  (bitmaps, directory and extent tree blocks, the superblock, ...) or
+ *  revoking a block makes it ineligible, and fsync() falls back to a full
+ *  commit then.  The fast commit area is reused once the transaction is
+ *  fully committed.
+ *
+ *  Recovery replays the regular journal first.  Fast commit records for
+ *  the transaction following the last committed one are then copied back
+ *  into their inode table blocks.
+ */
+
+#include <linux/crc32.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "fast_commit.h"
+
+/*
+ * Called before a handle gets access to any metadata other than an inode
+ * table block.
+ */
+void ext4_fc_mark_ineligible(handle_t *handle)
+{
+	struct ext4_sb_info *sbi;
+	transaction_t *txn;
+
+	if (!ext4_handle_valid(handle) || is_handle_aborted(handle))
+		return;
+
+	txn = handle->h_transaction;
+	sbi = EXT4_SB(txn->t_journal->j_private);
+	if (!test_opt2(sbi->s_sb, JOURNAL_FAST_COMMIT) ||
+	    READ_ONCE(sbi->s_fc_ineligible_tid) == txn->t_tid)
+		return;
+
+	WRITE_ONCE(sbi->s_fc_ineligible_tid, txn->t_tid);
+	/* pairs with smp_rmb() in ext4_fc_write_inode() */
+	smp_wmb();
+}
+
+static bool ext4_fc_eligible(struct ext4_sb_info *sbi, tid_t tid)
+{
+	return !tid_geq(READ_ONCE(sbi->s_fc_ineligible_tid), tid);
+}
+
+static u8 *ext4_fc_add_tl(u8 *dst, u16 tag, u16 len)
+{
+	struct ext4_fc_tl *tl = (struct ext4_fc_tl *)dst;
+
+	tl->fc_tag = cpu_to_le16(tag);
+	tl->fc_len = cpu_to_le16(len);
+	return dst + sizeof(*tl);
+}
+
+/* Write the fast commit block for @inode, the caller owns the fast commit */
+static int ext4_fc_write_inode(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	const int inode_len = EXT4_INODE_SIZE(sb);
+	struct ext4_fc_head *head;
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_fc_tail *tail;
+	struct buffer_head *bh;
+	struct ext4_iloc iloc;
+	int op = WRITE_SYNC;
+	u8 *dst;
+	int ret;
+
+	if (EXT4_FC_BLOCK_OVERHEAD + inode_len > journal->j_blocksize)
+		return -ENOSPC;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	ret = jbd2_fc_get_buf(journal, &bh);
+	if (ret)
+		goto out_iloc;
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	dst = bh->b_data;
+
+	dst = ext4_fc_add_tl(dst, EXT4_IFC_TAG_HEAD, sizeof(*head));
+	head = (struct ext4_fc_head *)dst;
+	head->fc_features = 0;
+	head->fc_tid = cpu_to_le32(tid);
+	dst += sizeof(*head);
+
+	dst = ext4_fc_add_tl(dst, EXT4_IFC_TAG_INODE,
+			     sizeof(*fc_inode) + inode_len);
+	fc_inode = (struct ext4_fc_inode *)dst;
+	fc_inode->fc_ino = cpu_to_le32(inode->i_ino);
+	dst += sizeof(*fc_inode);
+
+	spin_lock(&EXT4_I(inode)->i_raw_lock);
+	memcpy(dst, ext4_raw_inode(&iloc), inode_len);
+	spin_unlock(&EXT4_I(inode)->i_raw_lock);
+	dst += inode_len;
+
+	/*
+	 * Metadata the inode image may depend on could have been touched
+	 * while it was copied, recheck now that the copy is stable.
+	 */
+	smp_rmb();
+	if (!ext4_fc_eligible(sbi, tid)) {
+		clear_buffer_uptodate(bh);
+		unlock_buffer(bh);
+		brelse(bh);
+		ret = -EAGAIN;
+		goto out_iloc;
+	}
+
+	dst = ext4_fc_add_tl(dst, EXT4_IFC_TAG_TAIL, sizeof(*tail));
+	tail = (struct ext4_fc_tail *)dst;
+	tail->fc_tid = cpu_to_le32(tid);
+	tail->fc_crc = cpu_to_le32(crc32_be(~0, bh->b_data,
+				(u8 *)&tail->fc_crc - (u8 *)bh->b_data));
+
+	/* the data written by fsync() has to be stable before the record */
+	if (journal->j_flags & JBD2_BARRIER) {
+		if (journal->j_fs_dev != journal->j_dev)
+			blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS, NULL);
+		op = WRITE_FLUSH_FUA;
+	}
+
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	get_bh(bh);
+	submit_bh(op, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		ret = -EIO;
+	brelse(bh);
+out_iloc:
+	brelse(iloc.bh);
+	return ret;
+}
+
+/*
+ * Make the changes of transaction @commit_tid to @inode durable with a fast
+ * commit.  Returns 0 on success; otherwise the caller has to wait for a full
+ * commit of the transaction.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t commit_tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	journal_t *journal = sbi->s_journal;
+	int ret;
+
+	if (!ext4_fc_eligible(sbi, commit_tid))
+		return -EAGAIN;
+
+	ret = jbd2_fc_begin_commit(journal, commit_tid);
+	if (ret)
+		return ret;
+
+	ret = ext4_fc_write_inode(inode, commit_tid);
+	if (ret) {
+		jbd2_fc_end_commit_fallback(journal);
+		return ret;
+	}
+
+	jbd2_fc_end_commit(journal);
+	atomic_inc(&sbi->s_fc_commits);
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				const u8 *raw)
+{
+	const unsigned long inodes_per_group = EXT4_INODES_PER_GROUP(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long offset;
+	ext4_fsblk_t block;
+
+	gdp = ext4_get_group_desc(sb, (ino - 1) / inodes_per_group, NULL);
+	if (!gdp)
+		return -EFSCORRUPTED;
+
+	offset = ((ino - 1) % inodes_per_group) * EXT4_INODE_SIZE(sb);
+	block = ext4_inode_table(sb, gdp) + (offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	offset &= sb->s_blocksize - 1;
+
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+
+	/* written back by the sync_blockdev() at the end of recovery */
+	lock_buffer(bh);
+	memcpy(bh->b_data + offset, raw, EXT4_INODE_SIZE(sb));
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/*
+ * Check the record in fast commit block @buf and, if @replay is set, apply
+ * it.  Returns 1 if the block holds a valid record for @tid, 0 if not, or a
+ * negative error.
+ */
+static int ext4_fc_do_block(struct super_block *sb, u8 *buf, tid_t tid,
+			    bool replay)
+{
+	const int inode_len = EXT4_INODE_SIZE(sb);
+	const unsigned int size = sb->s_blocksize;
+	struct ext4_fc_head *head;
+	struct ext4_fc_tail *tail;
+	struct ext4_fc_tl *tl;
+	unsigned int pos = 0;
+	u16 len;
+	int ret;
+
+	while (pos + sizeof(*tl) <= size) {
+		tl = (struct ext4_fc_tl *)(buf + pos);
+		pos += sizeof(*tl);
+		len = le16_to_cpu(tl->fc_len);
+		if (pos + len > size)
+			return 0;
+
+		switch (le16_to_cpu(tl->fc_tag)) {
+		case EXT4_IFC_TAG_HEAD:
+			head = (struct ext4_fc_head *)(buf + pos);
+			if (pos != sizeof(*tl) || len != sizeof(*head) ||
+			    le32_to_cpu(head->fc_tid) != tid)
+				return 0;
+			break;
+		case EXT4_IFC_TAG_INODE:
+			if (pos == sizeof(*tl) ||
+			    len != sizeof(struct ext4_fc_inode) + inode_len)
+				return 0;
+			if (!replay)
+				break;
+			ret = ext4_fc_replay_inode(sb,
+				le32_to_cpu(((struct ext4_fc_inode *)
+					     (buf + pos))->fc_ino),
+				buf + pos + sizeof(struct ext4_fc_inode));
+			if (ret)
+				return ret;
+			break;
+		case EXT4_IFC_TAG_TAIL:
+			tail = (struct ext4_fc_tail *)(buf + pos);
+			if (pos == sizeof(*tl) || len != sizeof(*tail) ||
+			    le32_to_cpu(tail->fc_tid) != tid)
+				return 0;
+			return le32_to_cpu(tail->fc_crc) ==
+				crc32_be(~0, buf, (u8 *)&tail->fc_crc - buf);
+		default:
+			return 0;
+		}
+		pos += len;
+	}
+	return 0;
+}
+
+/* Inode numbers are only checked once the record is known to be intact */
+static bool ext4_fc_inodes_valid(struct super_block *sb, u8 *buf)
+{
+	struct ext4_fc_tl *tl;
+	unsigned int pos = 0;
+
+	for (;;) {
+		tl = (struct ext4_fc_tl *)(buf + pos);
+		pos += sizeof(*tl);
+		switch (le16_to_cpu(tl->fc_tag)) {
+		case EXT4_IFC_TAG_INODE:
+			if (!ext4_valid_inum(sb, le32_to_cpu(
+				((struct ext4_fc_inode *)(buf + pos))->fc_ino)))
+				return false;
+			break;
+		case EXT4_IFC_TAG_TAIL:
+			return true;
+		}
+		pos += le16_to_cpu(tl->fc_len);
+	}
+}
+
+/*
+ * jbd2 recovery callback.  The scan pass counts the consecutive blocks
+ * with valid records for @expected_tid from the start of the area, the
+ * replay pass applies them.
+ */
+static int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  enum passtype pass, int off, tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	u8 *buf = (u8 *)bh->b_data;
+	int ret;
+
+	if (pass == PASS_SCAN) {
+		if (!off)
+			sbi->s_fc_replay_blocks = 0;
+		ret = ext4_fc_do_block(sb, buf, expected_tid, false);
+		if (ret <= 0)
+			return ret < 0 ? ret : 1;
+		if (!ext4_fc_inodes_valid(sb, buf)) {
+			ext4_msg(sb, KERN_ERR, "corrupted fast commit record "
+				 "at block %d of the fast commit area", off);
+			return -EFSCORRUPTED;
+		}
+		sbi->s_fc_replay_blocks = off + 1;
+		return 0;
+	}
+
+	if (pass != PASS_REPLAY || off >= sbi->s_fc_replay_blocks)
+		return 1;
+
+	ret = ext4_fc_do_block(sb, buf, expected_tid, true);
+	if (ret < 0)
+		return ret;
+	if (off + 1 == sbi->s_fc_replay_blocks)
+		ext4_msg(sb, KERN_INFO, "replayed %d fast commit blocks",
+			 sbi->s_fc_replay_blocks);
+	/* the scan pass has validated the record */
+	return ret ? 0 : -EIO;
+}
+
+/*
+ * Called before the journal is loaded, so that recovery can hand fast
+ * commit records back even if fast commits are not enabled for this mount.
+ */
+void ext4_fc_init(struct super_block *sb, journal_t *journal)
+{
+	journal->j_fc_replay_callback = ext4_fc_replay;
+}
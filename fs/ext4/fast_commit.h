@@ -0,0 +1,52 @@
+/*
+ * fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commit records.
+ */
+
+#ifndef __FAST_COMMIT_H__
+#define __FAST_COMMIT_H__
+
+/*
+ * Each fast commit block holds one self-contained record: a HEAD tag, the
+ * logged inode and a TAIL tag whose checksum covers everything before it.
+ * The rest of the block is zeroed.  Tags and lengths are little endian.
+ *
+ * This is a local format, stored in the JBD2_FEATURE_INCOMPAT_INODE_FC
+ * area.  It is not upstream's fast commit format (several records per
+ * block, crc32c tail, tags 1-9), so the tags live in a range upstream
+ * does not assign.
+ */
+#define EXT4_IFC_TAG_HEAD		0x8001
+#define EXT4_IFC_TAG_INODE		0x8002
+#define EXT4_IFC_TAG_TAIL		0x8003
+
+/* Tag and length of the value which follows */
+struct ext4_fc_tl {
+	__le16 fc_tag;
+	__le16 fc_len;
+};
+
+/* Value of HEAD tag */
+struct ext4_fc_head {
+	__le32 fc_features;
+	__le32 fc_tid;
+};
+
+/* Value of INODE tag, followed by the raw on-disk inode */
+struct ext4_fc_inode {
+	__le32 fc_ino;
+};
+
+/* Value of TAIL tag */
+struct ext4_fc_tail {
+	__le32 fc_tid;
+	__le32 fc_crc;		/* crc32_be of the block up to here */
+};
+
+/* Bytes of a block which aren't available for the raw inode */
+#define EXT4_FC_BLOCK_OVERHEAD					\
+	(3 * sizeof(struct ext4_fc_tl) + sizeof(struct ext4_fc_head) +	\
+	 sizeof(struct ext4_fc_inode) + sizeof(struct ext4_fc_tail))
+
+#endif /* __FAST_COMMIT_H__ */
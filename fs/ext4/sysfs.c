@@ -187,6 +187,10 @@ EXT4_RW_ATTR_SBI_UI(msg_ratelimit_burst, s_msg_ratelimit_state.burst);
 EXT4_RO_ATTR_ES_UI(errors_count, s_error_count);
 EXT4_RO_ATTR_ES_UI(first_error_time, s_first_error_time);
 EXT4_RO_ATTR_ES_UI(last_error_time, s_last_error_time);
+EXT4_ATTR_OFFSET(fc_commits, 0444, pointer_atomic, ext4_sb_info,
+		 s_fc_commits);
+EXT4_ATTR_OFFSET(full_commits, 0444, pointer_atomic, ext4_sb_info,
+		 s_full_commits);
 
 static unsigned int old_bump_val = 128;
 EXT4_ATTR_PTR(max_writeback_mb_bump, 0444, pointer_ui, &old_bump_val);
@@ -216,6 +220,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(errors_count),
 	ATTR_LIST(first_error_time),
 	ATTR_LIST(last_error_time),
+	ATTR_LIST(fc_commits),
+	ATTR_LIST(full_commits),
 	NULL,
 };
 
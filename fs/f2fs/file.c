@@ -3039,6 +3039,274 @@ long f2fs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 }
 #endif
 
+/*
+ * Copy one data block from @src to @dst on disk, the way GC moves blocks:
+ * the source block is read into a meta page cached at a freshly allocated
+ * block address, and that page is written out as the new destination block.
+ * The data never goes through either file's page cache.
+ */
+static int f2fs_copy_data_block(struct inode *src, pgoff_t sidx,
+				struct inode *dst, pgoff_t didx)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(src);
+	struct f2fs_io_info fio = {
+		.sbi = sbi,
+		.ino = dst->i_ino,
+		.type = DATA,
+		.temp = WARM,
+		.op = REQ_OP_READ,
+		.op_flags = REQ_SYNC,
+		.encrypted_page = NULL,
+		.in_list = false,
+		.retry = false,
+	};
+	struct dnode_of_data dn;
+	struct f2fs_summary sum;
+	struct node_info ni;
+	struct page *page, *mpage;
+	block_t src_blkaddr, old_blkaddr, newaddr;
+	bool lfs_mode = test_opt(sbi, LFS);
+	int err;
+
+	set_new_dnode(&dn, src, NULL, NULL, 0);
+	err = f2fs_get_dnode_of_data(&dn, sidx, LOOKUP_NODE);
+	if (err && err != -ENOENT)
+		return err;
+	src_blkaddr = err ? NULL_ADDR : dn.data_blkaddr;
+	if (!err)
+		f2fs_put_dnode(&dn);
+
+	/* holes and preallocated blocks read back as zeroes */
+	if (!__is_valid_data_blkaddr(src_blkaddr))
+		return f2fs_truncate_hole(dst, didx, didx + 1);
+
+	if (!f2fs_is_valid_blkaddr(sbi, src_blkaddr, DATA_GENERIC_ENHANCE))
+		return -EFSCORRUPTED;
+
+	f2fs_wait_on_block_writeback(src, src_blkaddr);
+
+	set_new_dnode(&dn, dst, NULL, NULL, 0);
+	err = f2fs_get_dnode_of_data(&dn, didx, ALLOC_NODE);
+	if (err)
+		return err;
+
+	if (dn.data_blkaddr == NULL_ADDR) {
+		err = f2fs_reserve_new_block(&dn);
+		if (err)
+			goto put_out;
+	}
+	old_blkaddr = dn.data_blkaddr;
+	f2fs_wait_on_block_writeback(dst, old_blkaddr);
+
+	err = f2fs_get_node_info(sbi, dn.nid, &ni);
+	if (err)
+		goto put_out;
+
+	set_summary(&sum, dn.nid, dn.ofs_in_node, ni.version);
+
+	/* do not read out */
+	page = f2fs_grab_cache_page(dst->i_mapping, didx, true);
+	if (!page) {
+		err = -ENOMEM;
+		goto put_out;
+	}
+
+	if (lfs_mode)
+		down_write(&sbi->io_order_lock);
+
+	f2fs_allocate_data_block(sbi, NULL, NULL_ADDR, &newaddr, &sum,
+					CURSEG_WARM_DATA, NULL, false);
+
+	mpage = f2fs_pagecache_get_page(META_MAPPING(sbi), newaddr,
+					FGP_LOCK | FGP_CREAT, GFP_NOFS);
+	if (!mpage) {
+		err = -ENOMEM;
+		goto recover_block;
+	}
+
+	/* read source block in mpage */
+	fio.page = page;
+	fio.encrypted_page = mpage;
+	fio.old_blkaddr = fio.new_blkaddr = src_blkaddr;
+	err = f2fs_submit_page_bio(&fio);
+	if (err)
+		goto put_mpage;
+
+	lock_page(mpage);
+	if (unlikely(mpage->mapping != META_MAPPING(sbi) ||
+						!PageUptodate(mpage))) {
+		err = -EIO;
+		goto put_mpage;
+	}
+
+	/* write it back out as the destination block */
+	f2fs_wait_on_page_writeback(mpage, DATA, true, true);
+	set_page_dirty(mpage);
+	if (clear_page_dirty_for_io(mpage))
+		dec_page_count(sbi, F2FS_DIRTY_META);
+
+	set_page_writeback(mpage);
+	ClearPageError(page);
+
+	f2fs_wait_on_page_writeback(dn.node_page, NODE, true, true);
+
+	fio.op = REQ_OP_WRITE;
+	fio.op_flags = REQ_SYNC | REQ_NOIDLE;
+	fio.old_blkaddr = old_blkaddr;
+	fio.new_blkaddr = newaddr;
+	f2fs_submit_page_write(&fio);
+	if (fio.retry) {
+		err = -EAGAIN;
+		if (PageWriteback(mpage))
+			end_page_writeback(mpage);
+		goto put_mpage;
+	}
+
+	f2fs_update_iostat(sbi, APP_WRITE_IO, F2FS_BLKSIZE);
+
+	f2fs_update_data_blkaddr(&dn, newaddr);
+	/* a racing read may have cached the old contents meanwhile */
+	ClearPageUptodate(page);
+	if (__is_valid_data_blkaddr(old_blkaddr)) {
+		f2fs_invalidate_blocks(sbi, old_blkaddr);
+		invalidate_mapping_pages(META_MAPPING(sbi),
+					old_blkaddr, old_blkaddr);
+	}
+	set_inode_flag(dst, FI_APPEND_WRITE);
+	if (didx == 0)
+		set_inode_flag(dst, FI_FIRST_BLOCK_WRITTEN);
+put_mpage:
+	f2fs_put_page(mpage, 1);
+recover_block:
+	if (err)
+		f2fs_invalidate_blocks(sbi, newaddr);
+	if (lfs_mode)
+		up_write(&sbi->io_order_lock);
+	f2fs_put_page(page, 1);
+put_out:
+	f2fs_put_dnode(&dn);
+	return err;
+}
+
+/*
+ * Copy whole blocks between two files of the same filesystem on disk. A
+ * partial last block is only copied when it ends both the source file and
+ * the destination range. Anything else is left to the generic splice copy.
+ */
+static ssize_t f2fs_copy_file_range(struct file *file_in, loff_t pos_in,
+				    struct file *file_out, loff_t pos_out,
+				    size_t len, unsigned int flags)
+{
+	struct inode *src = file_inode(file_in);
+	struct inode *dst = file_inode(file_out);
+	struct f2fs_sb_info *sbi = F2FS_I_SB(src);
+	pgoff_t sidx, didx, nr, i;
+	loff_t src_size, copied;
+	ssize_t ret;
+
+	if (src->i_sb != dst->i_sb)
+		return -EXDEV;
+
+	if (src == dst || f2fs_encrypted_inode(src) ||
+			f2fs_encrypted_inode(dst))
+		return -EOPNOTSUPP;
+
+	if (!IS_ALIGNED(pos_in, F2FS_BLKSIZE) ||
+			!IS_ALIGNED(pos_out, F2FS_BLKSIZE))
+		return -EOPNOTSUPP;
+
+	/* io_bits bios have to start aligned, copied blocks may not be */
+	if (F2FS_IO_SIZE_BITS(sbi))
+		return -EOPNOTSUPP;
+
+	if (unlikely(f2fs_cp_error(sbi)))
+		return -EIO;
+
+	lock_two_nondirectories(src, dst);
+
+	ret = -EOPNOTSUPP;
+	if (f2fs_has_inline_data(src) || f2fs_is_atomic_file(src) ||
+			f2fs_is_atomic_file(dst) || f2fs_is_volatile_file(dst) ||
+			f2fs_is_pinned_file(dst))
+		goto out_unlock;
+
+	ret = 0;
+	src_size = i_size_read(src);
+	if (pos_in >= src_size)
+		goto out_unlock;
+	if (len > src_size - pos_in)
+		len = src_size - pos_in;
+
+	nr = len >> F2FS_BLKSIZE_BITS;
+	if (!IS_ALIGNED(len, F2FS_BLKSIZE) && pos_in + len == src_size &&
+			pos_out + len >= i_size_read(dst))
+		nr++;
+	ret = -EOPNOTSUPP;
+	if (!nr)
+		goto out_unlock;
+
+	ret = f2fs_convert_inline_inode(dst);
+	if (ret)
+		goto out_unlock;
+
+	ret = file_remove_privs(file_out);
+	if (ret)
+		goto out_unlock;
+
+	/* the blocks are copied on disk, write out what is cached first */
+	ret = filemap_write_and_wait_range(src->i_mapping, pos_in,
+			pos_in + ((loff_t)nr << F2FS_BLKSIZE_BITS) - 1);
+	if (ret)
+		goto out_unlock;
+
+	ret = filemap_write_and_wait_range(dst->i_mapping, pos_out,
+			pos_out + ((loff_t)nr << F2FS_BLKSIZE_BITS) - 1);
+	if (ret)
+		goto out_unlock;
+
+	f2fs_balance_fs(sbi, true);
+
+	/* keep GC and mmap writes off both ranges while blocks are copied */
+	down_write(&F2FS_I(src)->i_gc_rwsem[WRITE]);
+	down_write(&F2FS_I(dst)->i_gc_rwsem[WRITE]);
+	down_write(&F2FS_I(src)->i_mmap_sem);
+	down_write(&F2FS_I(dst)->i_mmap_sem);
+
+	truncate_pagecache_range(dst, pos_out,
+			pos_out + ((loff_t)nr << F2FS_BLKSIZE_BITS) - 1);
+
+	sidx = pos_in >> F2FS_BLKSIZE_BITS;
+	didx = pos_out >> F2FS_BLKSIZE_BITS;
+	for (i = 0; i < nr; i++) {
+		f2fs_lock_op(sbi);
+		ret = f2fs_copy_data_block(src, sidx + i, dst, didx + i);
+		f2fs_unlock_op(sbi);
+		if (ret)
+			break;
+	}
+
+	/* let the generic splice copy take over if a write must be redone */
+	if (ret == -EAGAIN)
+		ret = -EOPNOTSUPP;
+
+	copied = min_t(loff_t, (loff_t)i << F2FS_BLKSIZE_BITS, len);
+	if (copied) {
+		if (pos_out + copied > i_size_read(dst))
+			f2fs_i_size_write(dst, pos_out + copied);
+		dst->i_mtime = dst->i_ctime = current_time(dst);
+		f2fs_mark_inode_dirty_sync(dst, false);
+		ret = copied;
+	}
+
+	up_write(&F2FS_I(dst)->i_mmap_sem);
+	up_write(&F2FS_I(src)->i_mmap_sem);
+	up_write(&F2FS_I(dst)->i_gc_rwsem[WRITE]);
+	up_write(&F2FS_I(src)->i_gc_rwsem[WRITE]);
+out_unlock:
+	unlock_two_nondirectories(src, dst);
+	return ret;
+}
+
 const struct file_operations f2fs_file_operations = {
 	.llseek		= f2fs_llseek,
 	.read_iter	= generic_file_read_iter,
@@ -3055,4 +3323,5 @@ const struct file_operations f2fs_file_operations = {
 #endif
 	.splice_read	= generic_file_splice_read,
 	.splice_write	= iter_file_splice_write,
+	.copy_file_range = f2fs_copy_file_range,
 };
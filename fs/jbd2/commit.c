@@ -155,9 +155,19 @@ static int journal_submit_commit_record(journal_t *journal,
 	set_buffer_uptodate(bh);
 	bh->b_end_io = journal_end_buffer_io_sync;
 
-	if (journal->j_flags & JBD2_BARRIER &&
-	    !jbd2_has_feature_async_commit(journal))
+	if (!(journal->j_flags & JBD2_BARRIER))
+		ret = submit_bh(WRITE_SYNC, bh);
+	else if (!jbd2_has_feature_async_commit(journal))
 		ret = submit_bh(WRITE_SYNC | WRITE_FLUSH_FUA, bh);
+	else if (commit_transaction->t_need_data_flush &&
+		 journal->j_fs_dev == journal->j_dev)
+		/*
+		 * An async commit record goes out together with the log
+		 * blocks, which are protected by their checksums, but the
+		 * ordered data it commits has no checksum: make sure the data
+		 * written so far is stable before the record can be.
+		 */
+		ret = submit_bh(WRITE_SYNC | WRITE_FLUSH, bh);
 	else
 		ret = submit_bh(WRITE_SYNC, bh);
 
@@ -184,6 +194,39 @@ static int journal_wait_on_commit_record(journal_t *journal,
 	return ret;
 }
 
+static void journal_end_flush_io(struct bio *bio)
+{
+	complete(bio->bi_private);
+}
+
+/*
+ * Issue a cache flush of the journal device without waiting for it, so that
+ * other IO can be queued while it is in flight.  Pair with
+ * journal_wait_on_flush().
+ */
+static struct bio *journal_submit_flush(journal_t *journal,
+					struct completion *done)
+{
+	struct bio *bio = bio_alloc(GFP_NOFS, 0);
+
+	init_completion(done);
+	bio->bi_bdev = journal->j_dev;
+	bio->bi_end_io = journal_end_flush_io;
+	bio->bi_private = done;
+	submit_bio(WRITE_FLUSH, bio);
+	return bio;
+}
+
+/*
+ * As with the other flushes in the commit path, the result is ignored: a
+ * device without a volatile cache has nothing to flush.
+ */
+static void journal_wait_on_flush(struct bio *bio, struct completion *done)
+{
+	wait_for_completion_io(done);
+	bio_put(bio);
+}
+
 /*
  * write the filemap data using writepage() address_space_operations.
  * We don't do block allocation here even for delalloc. We don't
@@ -208,9 +251,12 @@ static int journal_submit_inode_data_buffers(struct address_space *mapping)
  * Submit all the data buffers of inode associated with the transaction to
  * disk.
  *
- * We are in a committing transaction. Therefore no new inode can be added to
- * our inode list. We use JI_COMMIT_RUNNING flag to protect inode we currently
- * operate on from being released while we write out pages.
+ * This is normally the committing transaction, so no new inode can be added
+ * to our inode list.  It may also be the running transaction while the
+ * previous commit waits for its cache flush; inodes are then only added at
+ * the head of the list, and we may simply miss them.  We use
+ * JI_COMMIT_RUNNING flag to protect inode we currently operate on from being
+ * released while we write out pages.
  */
 static int journal_submit_data_buffers(journal_t *journal,
 		transaction_t *commit_transaction)
@@ -424,6 +470,24 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		jbd_debug(3, "superblock not updated\n");
 	}
 
+	/*
+	 * Let a fast commit of the running transaction finish before it is
+	 * locked down.  No new fast commit starts until this one is done.
+	 */
+	write_lock(&journal->j_state_lock);
+	journal->j_flags |= JBD2_FULL_COMMIT_ONGOING;
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		write_lock(&journal->j_state_lock);
+		finish_wait(&journal->j_fc_wait, &wait);
+	}
+	write_unlock(&journal->j_state_lock);
+
 	J_ASSERT(journal->j_running_transaction != NULL);
 	J_ASSERT(journal->j_committing_transaction == NULL);
 
@@ -895,7 +959,33 @@ start_journal_io:
 		err = journal_wait_on_commit_record(journal, cbh);
 	if (jbd2_has_feature_async_commit(journal) &&
 	    journal->j_flags & JBD2_BARRIER) {
-		blkdev_issue_flush(journal->j_dev, GFP_NOFS, NULL);
+		struct completion flush_done;
+		transaction_t *next = NULL;
+		struct bio *flush_bio;
+
+		/*
+		 * Nothing below may mark buffers dirty before the commit
+		 * record is stable, but the transaction which is already
+		 * running doesn't have to sit idle meanwhile: if someone is
+		 * waiting for it to commit too, start its ordered data now
+		 * so that the next commit finds it already on its way.
+		 *
+		 * Only the ordered data overlaps the flush.  The next
+		 * transaction's log blocks can't be written yet: buffers it
+		 * modified while we owned them only move to its lists in the
+		 * forget processing below, which has to wait for the flush.
+		 */
+		flush_bio = journal_submit_flush(journal, &flush_done);
+		read_lock(&journal->j_state_lock);
+		if (journal->j_running_transaction &&
+		    tid_geq(journal->j_commit_request,
+			    journal->j_running_transaction->t_tid))
+			next = journal->j_running_transaction;
+		read_unlock(&journal->j_state_lock);
+		/* only this thread commits, so it can't go away under us */
+		if (next)
+			journal_submit_data_buffers(journal, next);
+		journal_wait_on_flush(flush_bio, &flush_done);
 	}
 
 	if (err)
@@ -1105,6 +1195,9 @@ restart_loop:
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
+	/* Fast commit records of this transaction are obsolete now */
+	journal->j_fc_off = 0;
+	journal->j_flags &= ~JBD2_FULL_COMMIT_ONGOING;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
@@ -1118,6 +1211,7 @@ restart_loop:
 		journal->j_average_commit_time = commit_time;
 
 	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
 
 	if (journal->j_commit_callback)
 		journal->j_commit_callback(journal, commit_transaction);
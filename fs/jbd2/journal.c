@@ -99,6 +99,10 @@ EXPORT_SYMBOL(jbd2_journal_init_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_release_jbd_inode);
 EXPORT_SYMBOL(jbd2_journal_begin_ordered_truncate);
 EXPORT_SYMBOL(jbd2_inode_cache);
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+EXPORT_SYMBOL(jbd2_fc_end_commit_fallback);
+EXPORT_SYMBOL(jbd2_fc_get_buf);
 
 static void __journal_abort_soft (journal_t *journal, int errno);
 static int jbd2_journal_create_slab(size_t slab_size);
@@ -795,6 +799,141 @@ int jbd2_journal_bmap(journal_t *journal, unsigned long blocknr,
 	return err;
 }
 
+/*
+ * Fast commits
+ *
+ * A fast commit lets the filesystem log compact records of its own for
+ * the running transaction into the fast commit area at the end of the
+ * journal, instead of committing the whole transaction.  The area is
+ * reused once the transaction has been fully committed, and the records
+ * are handed back to the filesystem through j_fc_replay_callback during
+ * recovery.
+ */
+
+/*
+ * Start a fast commit of transaction @tid.  Waits for another fast commit
+ * or a full commit in flight to finish first.  Returns -EALREADY if @tid
+ * has been committed meanwhile; any other error means the caller has to
+ * fall back to a full commit.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	if (!jbd2_has_feature_inode_fc(journal))
+		return -EOPNOTSUPP;
+
+	write_lock(&journal->j_state_lock);
+	/* an aborted journal never finishes the full commit we wait for */
+	while (!is_journal_aborted(journal) &&
+	       (journal->j_flags &
+		(JBD2_FAST_COMMIT_ONGOING | JBD2_FULL_COMMIT_ONGOING))) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		write_lock(&journal->j_state_lock);
+		finish_wait(&journal->j_fc_wait, &wait);
+	}
+
+	if (tid_geq(journal->j_commit_sequence, tid)) {
+		write_unlock(&journal->j_state_lock);
+		return -EALREADY;
+	}
+
+	/*
+	 * Recovery skips a journal marked empty on disk, so the fast commit
+	 * would be lost until a full commit has updated the superblock.
+	 */
+	if (is_journal_aborted(journal) ||
+	    (journal->j_flags & JBD2_FLUSHED) ||
+	    !journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid) {
+		write_unlock(&journal->j_state_lock);
+		return -EAGAIN;
+	}
+
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	return 0;
+}
+
+/* Finish a fast commit started by jbd2_fc_begin_commit() */
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/*
+ * Abandon a fast commit.  Its partially written records must not be
+ * followed by those of another fast commit, so further fast commits are
+ * held off until the caller's full commit of the transaction is done.
+ */
+void jbd2_fc_end_commit_fallback(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	journal->j_flags |= JBD2_FULL_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+
+/*
+ * Get the buffer of the next free fast commit block.  Only the owner of
+ * the ongoing fast commit may call this.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int ret;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last)
+		return -ENOSPC;
+
+	blocknr = journal->j_fc_first + journal->j_fc_off++;
+	ret = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (ret)
+		return ret;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	*bh_out = bh;
+	return 0;
+}
+
+/*
+ * The fast commit area takes the last blocks of the journal, the log
+ * proper ends in front of it.
+ */
+static int journal_init_fast_commit(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks = jbd2_journal_get_num_fc_blks(sb);
+	unsigned long maxlen = be32_to_cpu(sb->s_maxlen);
+
+	if (be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS + num_fc_blks >
+	    maxlen + 1) {
+		printk(KERN_ERR "JBD2: Journal too short for %lu fast commit "
+		       "blocks.\n", num_fc_blks);
+		return -ENOSPC;
+	}
+
+	journal->j_fc_last = maxlen;
+	journal->j_fc_first = maxlen - num_fc_blks;
+	journal->j_fc_off = 0;
+	journal->j_last = journal->j_fc_first;
+	return 0;
+}
+
 /*
  * We play buffer_head aliasing tricks to write data/metadata blocks to
  * the journal without copying their contents, but for journal
@@ -1077,6 +1216,7 @@ static journal_t * journal_init_common (void)
 
 	init_waitqueue_head(&journal->j_wait_transaction_locked);
 	init_waitqueue_head(&journal->j_wait_done_commit);
+	init_waitqueue_head(&journal->j_fc_wait);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
 	init_waitqueue_head(&journal->j_wait_reserved);
@@ -1273,6 +1413,8 @@ static int journal_reset(journal_t *journal)
 
 	first = be32_to_cpu(sb->s_first);
 	last = be32_to_cpu(sb->s_maxlen);
+	if (jbd2_has_feature_inode_fc(journal))
+		last -= jbd2_journal_get_num_fc_blks(sb);
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD2: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1602,6 +1744,9 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (jbd2_has_feature_inode_fc(journal))
+		return journal_init_fast_commit(journal);
+
 	return 0;
 }
 
@@ -1881,6 +2026,26 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 		}
 	}
 
+	/*
+	 * Carving the fast commit area out of the log is only safe while
+	 * nothing is logged, i.e. right after the journal has been loaded.
+	 */
+	if (INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_INODE_FC)) {
+		unsigned long num_fc_blks = jbd2_journal_get_num_fc_blks(sb);
+
+		write_lock(&journal->j_state_lock);
+		if (journal->j_running_transaction ||
+		    journal->j_committing_transaction ||
+		    journal->j_head != journal->j_tail ||
+		    journal->j_head >= journal->j_last - num_fc_blks ||
+		    journal_init_fast_commit(journal)) {
+			write_unlock(&journal->j_state_lock);
+			return 0;
+		}
+		journal->j_free = journal->j_last - journal->j_first;
+		write_unlock(&journal->j_state_lock);
+	}
+
 	/* If enabling v1 checksums, downgrade superblock */
 	if (COMPAT_FEATURE_ON(JBD2_FEATURE_COMPAT_CHECKSUM))
 		sb->s_feature_incompat &=
@@ -38,7 +38,6 @@ struct recovery_info
 	int		nr_revoke_hits;
 };
 
-enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
 static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
@@ -233,6 +232,43 @@ do {									\
 		var -= ((journal)->j_last - (journal)->j_first);	\
 } while (0)
 
+/*
+ * Hand the fast commit area to the filesystem, one block at a time.  Fast
+ * commits only ever extend the last committed transaction, so this runs
+ * after the regular replay, with @expected_tid being the first transaction
+ * which was not found committed in the log.
+ */
+static int fc_do_one_pass(journal_t *journal, tid_t expected_tid,
+			  enum passtype pass)
+{
+	unsigned long next;
+	struct buffer_head *bh;
+	int err = 0;
+
+	if (!jbd2_has_feature_inode_fc(journal) ||
+	    !journal->j_fc_replay_callback)
+		return 0;
+
+	for (next = journal->j_fc_first; next < journal->j_fc_last; next++) {
+		err = jread(&bh, journal, next);
+		if (err)
+			break;
+
+		err = journal->j_fc_replay_callback(journal, bh, pass,
+					next - journal->j_fc_first,
+					expected_tid);
+		brelse(bh);
+		if (err)
+			break;
+	}
+
+	if (err < 0)
+		printk(KERN_ERR "JBD2: fast commit %s failed at block %lu, "
+		       "error %d\n", pass == PASS_SCAN ? "scan" : "replay",
+		       next, err);
+	return err < 0 ? err : 0;
+}
+
 /**
  * jbd2_journal_recover - recovers a on-disk journal
  * @journal: the journal to recover
@@ -273,6 +309,11 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err)
+		err = fc_do_one_pass(journal, info.end_transaction, PASS_SCAN);
+	if (!err)
+		err = fc_do_one_pass(journal, info.end_transaction,
+				     PASS_REPLAY);
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
@@ -417,6 +458,73 @@ static int jbd2_block_tag_csum_verify(journal_t *j, journal_block_tag_t *tag,
 		return tag->t_checksum == cpu_to_be16(csum32);
 }
 
+static int jbd2_revoke_block_csum_verify(journal_t *j,
+					 void *buf)
+{
+	struct jbd2_journal_revoke_tail *tail;
+	__be32 provided;
+	__u32 calculated;
+
+	if (!jbd2_journal_has_csum_v2or3(j))
+		return 1;
+
+	tail = (struct jbd2_journal_revoke_tail *)(buf + j->j_blocksize -
+			sizeof(struct jbd2_journal_revoke_tail));
+	provided = tail->r_checksum;
+	tail->r_checksum = 0;
+	calculated = jbd2_chksum(j, j->j_csum_seed, buf, j->j_blocksize);
+	tail->r_checksum = provided;
+
+	return provided == cpu_to_be32(calculated);
+}
+
+/*
+ * An async commit record is written together with the blocks it commits, so
+ * it may be on disk while some of them are not.  Read the blocks described
+ * by the descriptor block and check them against their tag checksums before
+ * the commit record is trusted.  Returns nonzero on IO error; clears
+ * *tag_csum_ok if a block doesn't match.
+ */
+static int verify_tag_csums(journal_t *journal, struct buffer_head *bh,
+			    unsigned long *next_log_block, __u32 sequence,
+			    int *tag_csum_ok)
+{
+	int tag_bytes = journal_tag_bytes(journal);
+	int csum_size = sizeof(struct jbd2_journal_block_tail);
+	journal_block_tag_t *tag;
+	struct buffer_head *obh;
+	unsigned long io_block;
+	char *tagp;
+	int flags, err;
+
+	tagp = &bh->b_data[sizeof(journal_header_t)];
+	while ((tagp - bh->b_data + tag_bytes) <=
+	       journal->j_blocksize - csum_size) {
+		tag = (journal_block_tag_t *)tagp;
+		flags = be16_to_cpu(tag->t_flags);
+
+		io_block = (*next_log_block)++;
+		wrap(journal, *next_log_block);
+		err = jread(&obh, journal, io_block);
+		if (err) {
+			printk(KERN_ERR "JBD2: IO error %d recovering block "
+				"%lu in log\n", err, io_block);
+			return 1;
+		}
+		if (!jbd2_block_tag_csum_verify(journal, tag, obh->b_data,
+						sequence))
+			*tag_csum_ok = 0;
+		put_bh(obh);
+
+		tagp += tag_bytes;
+		if (!(flags & JBD2_FLAG_SAME_UUID))
+			tagp += 16;
+		if (flags & JBD2_FLAG_LAST_TAG)
+			break;
+	}
+	return 0;
+}
+
 static int do_one_pass(journal_t *journal,
 			struct recovery_info *info, enum passtype pass)
 {
@@ -432,6 +540,8 @@ static int do_one_pass(journal_t *journal,
 	__u32			crc32_sum = ~0; /* Transactional Checksums */
 	int			descr_csum_size = 0;
 	int			block_error = 0;
+	int			async_csum;	/* check async commits by tag */
+	int			tag_csum_ok = 1;
 
 	/*
 	 * First thing is to establish what we expect to find in the log
@@ -447,6 +557,10 @@ static int do_one_pass(journal_t *journal,
 	if (pass == PASS_SCAN)
 		info->start_transaction = first_commit_ID;
 
+	async_csum = pass == PASS_SCAN &&
+		     jbd2_has_feature_async_commit(journal) &&
+		     jbd2_journal_has_csum_v2or3(journal);
+
 	jbd_debug(1, "Starting recovery pass %d\n", pass);
 
 	/*
@@ -537,6 +651,17 @@ static int do_one_pass(journal_t *journal,
 			 * calculate checksums in PASS_SCAN, otherwise,
 			 * just skip over the blocks it describes. */
 			if (pass != PASS_REPLAY) {
+				if (async_csum && !info->end_transaction) {
+					if (verify_tag_csums(journal, bh,
+							&next_log_block,
+							next_commit_ID,
+							&tag_csum_ok)) {
+						put_bh(bh);
+						break;
+					}
+					put_bh(bh);
+					continue;
+				}
 				if (pass == PASS_SCAN &&
 				    jbd2_has_feature_checksum(journal) &&
 				    !info->end_transaction) {
@@ -742,6 +867,24 @@ static int do_one_pass(journal_t *journal,
 				}
 				crc32_sum = ~0;
 			}
+			/*
+			 * Same for async commits checked by tag checksums:
+			 * the commit record of the next transaction is only
+			 * written once this one is stable, so finding one
+			 * after a transaction with bad blocks means that
+			 * transaction is corrupt, not interrupted.
+			 */
+			if (async_csum) {
+				if (info->end_transaction) {
+					journal->j_failed_commit =
+						info->end_transaction;
+					brelse(bh);
+					break;
+				}
+				if (!tag_csum_ok)
+					info->end_transaction = next_commit_ID;
+				tag_csum_ok = 1;
+			}
 			if (pass == PASS_SCAN &&
 			    !jbd2_commit_block_csum_verify(journal,
 							   bh->b_data)) {
@@ -759,6 +902,11 @@ static int do_one_pass(journal_t *journal,
 			continue;
 
 		case JBD2_REVOKE_BLOCK:
+			if (async_csum && !info->end_transaction &&
+			    !jbd2_revoke_block_csum_verify(journal,
+							   bh->b_data))
+				tag_csum_ok = 0;
+
 			/* If we aren't in the REVOKE pass, then we can
 			 * just skip over this block. */
 			if (pass != PASS_REVOKE) {
@@ -811,26 +959,6 @@ static int do_one_pass(journal_t *journal,
 	return err;
 }
 
-static int jbd2_revoke_block_csum_verify(journal_t *j,
-					 void *buf)
-{
-	struct jbd2_journal_revoke_tail *tail;
-	__be32 provided;
-	__u32 calculated;
-
-	if (!jbd2_journal_has_csum_v2or3(j))
-		return 1;
-
-	tail = (struct jbd2_journal_revoke_tail *)(buf + j->j_blocksize -
-			sizeof(struct jbd2_journal_revoke_tail));
-	provided = tail->r_checksum;
-	tail->r_checksum = 0;
-	calculated = jbd2_chksum(j, j->j_csum_seed, buf, j->j_blocksize);
-	tail->r_checksum = provided;
-
-	return provided == cpu_to_be32(calculated);
-}
-
 /* Scan a revoke record, marking all blocks mentioned as revoked. */
 
 static int scan_revoke_records(journal_t *journal, struct buffer_head *bh,
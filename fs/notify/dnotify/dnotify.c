@@ -85,6 +85,7 @@ static int dnotify_handle_event(struct fsnotify_group *group,
 				struct inode *inode,
 				struct fsnotify_mark *inode_mark,
 				struct fsnotify_mark *vfsmount_mark,
+				struct fsnotify_mark *sb_mark,
 				u32 mask, void *data, int data_type,
 				const unsigned char *file_name, u32 cookie)
 {
@@ -98,7 +99,7 @@ static int dnotify_handle_event(struct fsnotify_group *group,
 	if (!S_ISDIR(inode->i_mode))
 		return 0;
 
-	BUG_ON(vfsmount_mark);
+	BUG_ON(vfsmount_mark || sb_mark);
 
 	dn_mark = container_of(inode_mark, struct dnotify_mark, fsn_mark);
 
@@ -20,11 +20,28 @@ static bool should_merge(struct fsnotify_event *old_fsn,
 	old = FANOTIFY_E(old_fsn);
 	new = FANOTIFY_E(new_fsn);
 
-	if (old_fsn->inode == new_fsn->inode && old->tgid == new->tgid &&
-	    old->path.mnt == new->path.mnt &&
-	    old->path.dentry == new->path.dentry)
-		return true;
-	return false;
+	if (old_fsn->inode != new_fsn->inode || old->tgid != new->tgid ||
+	    old->fh_type != new->fh_type || old->fh_len != new->fh_len)
+		return false;
+
+	if (fanotify_event_has_path(old))
+		return old->path.mnt == new->path.mnt &&
+		       old->path.dentry == new->path.dentry;
+
+	/*
+	 * Directory entry events of the same directory are merged no matter
+	 * which entry they were about, the listener has to rescan the
+	 * directory anyway.
+	 */
+	if (fanotify_event_has_fid(old))
+		return old->fid.fsid.val[0] == new->fid.fsid.val[0] &&
+		       old->fid.fsid.val[1] == new->fid.fsid.val[1] &&
+		       !memcmp(fanotify_fid_fh(&old->fid, old->fh_len),
+			       fanotify_fid_fh(&new->fid, new->fh_len),
+			       old->fh_len);
+
+	/* events without an object can't be told apart */
+	return true;
 }
 
 /* and the list better be locked by something too! */
@@ -87,58 +104,129 @@ static int fanotify_get_response(struct fsnotify_group *group,
 }
 #endif
 
-static bool fanotify_should_send_event(struct fsnotify_mark *inode_mark,
+static bool fanotify_should_send_event(struct fsnotify_group *group,
+				       struct fsnotify_mark *inode_mark,
 				       struct fsnotify_mark *vfsmnt_mark,
+				       struct fsnotify_mark *sb_mark,
 				       u32 event_mask,
 				       void *data, int data_type)
 {
 	__u32 marks_mask = 0, marks_ignored_mask = 0;
 	struct path *path = data;
-
-	pr_debug("%s: inode_mark=%p vfsmnt_mark=%p mask=%x data=%p"
-		 " data_type=%d\n", __func__, inode_mark, vfsmnt_mark,
-		 event_mask, data, data_type);
-
-	/* if we don't have enough info to send an event to userspace say no */
-	if (data_type != FSNOTIFY_EVENT_PATH)
-		return false;
-
-	/* sorry, fanotify only gives a damn about files and dirs */
-	if (!d_is_reg(path->dentry) &&
-	    !d_can_lookup(path->dentry))
+	bool on_child;
+
+	pr_debug("%s: inode_mark=%p vfsmnt_mark=%p sb_mark=%p mask=%x"
+		 " data=%p data_type=%d\n", __func__, inode_mark, vfsmnt_mark,
+		 sb_mark, event_mask, data, data_type);
+
+	if (data_type == FSNOTIFY_EVENT_PATH) {
+		/* sorry, fanotify only gives a damn about files and dirs */
+		if (!d_is_reg(path->dentry) &&
+		    !d_can_lookup(path->dentry))
+			return false;
+	} else if (data_type != FSNOTIFY_EVENT_INODE ||
+		   !FAN_GROUP_FLAG(group, FAN_REPORT_FID)) {
+		/* if we don't have enough info to send an event to userspace say no */
 		return false;
+	}
 
 	/*
-	 * if the event is for a child and this inode doesn't care about
-	 * events on the child, don't send it!
+	 * Directory entry events are events on the directory itself, even
+	 * though they carry FS_EVENT_ON_CHILD.  Other events on a child are
+	 * also reported on the child itself, so only an inode mark that asked
+	 * for events on children gets them, and mount and super block marks
+	 * ignore them rather than reporting everything twice.
 	 */
+	on_child = (event_mask & FS_EVENT_ON_CHILD) &&
+		   !(event_mask & FANOTIFY_DIRENT_EVENTS);
+
 	if (inode_mark &&
-	    (!(event_mask & FS_EVENT_ON_CHILD) ||
-	     (inode_mark->mask & FS_EVENT_ON_CHILD))) {
+	    (!on_child || (inode_mark->mask & FS_EVENT_ON_CHILD))) {
 		marks_mask |= inode_mark->mask;
 		marks_ignored_mask |= inode_mark->ignored_mask;
 	}
 
-	if (vfsmnt_mark) {
+	if (vfsmnt_mark && !on_child) {
 		marks_mask |= vfsmnt_mark->mask;
 		marks_ignored_mask |= vfsmnt_mark->ignored_mask;
 	}
 
-	if (d_is_dir(path->dentry) &&
+	if (sb_mark && !on_child) {
+		marks_mask |= sb_mark->mask;
+		marks_ignored_mask |= sb_mark->ignored_mask;
+	}
+
+	if (((data_type == FSNOTIFY_EVENT_PATH && d_is_dir(path->dentry)) ||
+	     (event_mask & FS_ISDIR)) &&
 	    !(marks_mask & FS_ISDIR & ~marks_ignored_mask))
 		return false;
 
-	if (event_mask & FAN_ALL_OUTGOING_EVENTS & marks_mask &
+	if (event_mask & FANOTIFY_OUTGOING_EVENTS & marks_mask &
 				 ~marks_ignored_mask)
 		return true;
 
 	return false;
 }
 
-struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
-						 struct path *path)
+/*
+ * Encode the file handle of @inode into @event.  Returns the handle type,
+ * or FILEID_INVALID if the handle could not be encoded; the event is still
+ * reported then, just without a handle.
+ */
+static int fanotify_encode_fid(struct fanotify_event_info *event,
+			       struct inode *inode, gfp_t gfp,
+			       __kernel_fsid_t *fsid)
+{
+	struct fanotify_fid *fid = &event->fid;
+	int dwords, bytes = 0;
+	int err, type;
+
+	fid->ext_fh = NULL;
+	dwords = 0;
+	err = -ENOENT;
+	type = exportfs_encode_inode_fh(inode, NULL, &dwords, NULL);
+	if (!dwords)
+		goto out_err;
+
+	bytes = dwords << 2;
+	if (bytes > FANOTIFY_INLINE_FH_LEN) {
+		/* Treat failure to allocate fh as failure to allocate event */
+		err = -ENOMEM;
+		fid->ext_fh = kmalloc(bytes, gfp);
+		if (!fid->ext_fh)
+			goto out_err;
+	}
+
+	type = exportfs_encode_inode_fh(inode, fanotify_fid_fh(fid, bytes),
+					&dwords, NULL);
+	err = -EINVAL;
+	if (!type || type == FILEID_INVALID || bytes != dwords << 2)
+		goto out_err;
+
+	fid->fsid = *fsid;
+	event->fh_len = bytes;
+
+	return type;
+
+out_err:
+	pr_warn_ratelimited("fanotify: failed to encode fid (fsid=%x.%x, "
+			    "type=%d, bytes=%d, err=%i)\n",
+			    fsid->val[0], fsid->val[1], type, bytes, err);
+	if (bytes > FANOTIFY_INLINE_FH_LEN)
+		kfree(fid->ext_fh);
+	fid->ext_fh = NULL;
+	event->fh_len = 0;
+
+	return FILEID_INVALID;
+}
+
+struct fanotify_event_info *fanotify_alloc_event(struct fsnotify_group *group,
+						 struct inode *inode, u32 mask,
+						 void *data, int data_type,
+						 __kernel_fsid_t *fsid)
 {
 	struct fanotify_event_info *event;
+	struct inode *id = NULL;
 
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 	if (mask & FAN_ALL_PERM_EVENTS) {
@@ -159,10 +247,30 @@ struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
 init: __maybe_unused
 	fsnotify_init_event(&event->fse, inode, mask);
 	event->tgid = get_pid(task_tgid(current));
-	if (path) {
-		event->path = *path;
+	event->fh_len = 0;
+	if (FAN_GROUP_FLAG(group, FAN_REPORT_FID)) {
+		/*
+		 * Directory entry events identify the directory, everything
+		 * else the object the event happened on.
+		 */
+		if (mask & FANOTIFY_DIRENT_EVENTS)
+			id = inode;
+		else if (data_type == FSNOTIFY_EVENT_PATH)
+			id = ((struct path *)data)->dentry->d_inode;
+		else if (data_type == FSNOTIFY_EVENT_INODE)
+			id = data;
+
+		if (id)
+			event->fh_type = fanotify_encode_fid(event, id,
+							     GFP_KERNEL, fsid);
+		else
+			event->fh_type = FILEID_INVALID;
+	} else if (data_type == FSNOTIFY_EVENT_PATH) {
+		event->fh_type = FILEID_ROOT;
+		event->path = *((struct path *)data);
 		path_get(&event->path);
 	} else {
+		event->fh_type = FILEID_ROOT;
 		event->path.mnt = NULL;
 		event->path.dentry = NULL;
 	}
@@ -173,32 +281,44 @@ static int fanotify_handle_event(struct fsnotify_group *group,
 				 struct inode *inode,
 				 struct fsnotify_mark *inode_mark,
 				 struct fsnotify_mark *fanotify_mark,
+				 struct fsnotify_mark *sb_mark,
 				 u32 mask, void *data, int data_type,
 				 const unsigned char *file_name, u32 cookie)
 {
 	int ret = 0;
 	struct fanotify_event_info *event;
 	struct fsnotify_event *fsn_event;
+	struct fsnotify_mark *mark;
 
 	BUILD_BUG_ON(FAN_ACCESS != FS_ACCESS);
 	BUILD_BUG_ON(FAN_MODIFY != FS_MODIFY);
 	BUILD_BUG_ON(FAN_CLOSE_NOWRITE != FS_CLOSE_NOWRITE);
 	BUILD_BUG_ON(FAN_CLOSE_WRITE != FS_CLOSE_WRITE);
 	BUILD_BUG_ON(FAN_OPEN != FS_OPEN);
+	BUILD_BUG_ON(FAN_ATTRIB != FS_ATTRIB);
+	BUILD_BUG_ON(FAN_MOVED_FROM != FS_MOVED_FROM);
+	BUILD_BUG_ON(FAN_MOVED_TO != FS_MOVED_TO);
+	BUILD_BUG_ON(FAN_CREATE != FS_CREATE);
+	BUILD_BUG_ON(FAN_DELETE != FS_DELETE);
+	BUILD_BUG_ON(FAN_DELETE_SELF != FS_DELETE_SELF);
+	BUILD_BUG_ON(FAN_MOVE_SELF != FS_MOVE_SELF);
 	BUILD_BUG_ON(FAN_EVENT_ON_CHILD != FS_EVENT_ON_CHILD);
 	BUILD_BUG_ON(FAN_Q_OVERFLOW != FS_Q_OVERFLOW);
 	BUILD_BUG_ON(FAN_OPEN_PERM != FS_OPEN_PERM);
 	BUILD_BUG_ON(FAN_ACCESS_PERM != FS_ACCESS_PERM);
 	BUILD_BUG_ON(FAN_ONDIR != FS_ISDIR);
 
-	if (!fanotify_should_send_event(inode_mark, fanotify_mark, mask, data,
-					data_type))
+	if (!fanotify_should_send_event(group, inode_mark, fanotify_mark,
+					sb_mark, mask, data, data_type))
 		return 0;
 
 	pr_debug("%s: group=%p inode=%p mask=%x\n", __func__, group, inode,
 		 mask);
 
-	event = fanotify_alloc_event(inode, mask, data);
+	/* all marks of the event are on the same filesystem */
+	mark = sb_mark ?: fanotify_mark ?: inode_mark;
+	event = fanotify_alloc_event(group, inode, mask, data, data_type,
+				     &FANOTIFY_M(mark)->fsid);
 	if (unlikely(!event))
 		return -ENOMEM;
 
@@ -236,7 +356,10 @@ static void fanotify_free_event(struct fsnotify_event *fsn_event)
 	struct fanotify_event_info *event;
 
 	event = FANOTIFY_E(fsn_event);
-	path_put(&event->path);
+	if (fanotify_event_has_path(event))
+		path_put(&event->path);
+	else if (event->fh_len > FANOTIFY_INLINE_FH_LEN)
+		kfree(event->fid.ext_fh);
 	put_pid(event->tgid);
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 	if (fsn_event->mask & FAN_ALL_PERM_EVENTS) {
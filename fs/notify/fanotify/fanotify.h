@@ -1,10 +1,49 @@
 #include <linux/fsnotify_backend.h>
 #include <linux/path.h>
 #include <linux/slab.h>
+#include <linux/exportfs.h>
 
 extern struct kmem_cache *fanotify_event_cachep;
 extern struct kmem_cache *fanotify_perm_event_cachep;
 
+#define FAN_GROUP_FLAG(group, flag) \
+	((group)->fanotify_data.flags & (flag))
+
+/*
+ * fanotify marks remember the fsid of the filesystem they were added on, so
+ * that groups reporting file handles don't have to statfs() on every event.
+ */
+struct fanotify_mark {
+	struct fsnotify_mark fsn_mark;
+	__kernel_fsid_t fsid;
+};
+
+static inline struct fanotify_mark *FANOTIFY_M(struct fsnotify_mark *fsn_mark)
+{
+	return container_of(fsn_mark, struct fanotify_mark, fsn_mark);
+}
+
+/*
+ * Handles of up to this size are stored inline in the event, bigger ones
+ * are allocated separately.  20 bytes fit the FILEID_INO32_GEN_PARENT
+ * handles of ext4 and f2fs as well as the 64-bit inode handles of xfs.
+ */
+#define FANOTIFY_INLINE_FH_LEN	20
+
+struct fanotify_fid {
+	__kernel_fsid_t fsid;
+	union {
+		unsigned char fh[FANOTIFY_INLINE_FH_LEN];
+		unsigned char *ext_fh;
+	};
+};
+
+static inline void *fanotify_fid_fh(struct fanotify_fid *fid,
+				    unsigned int fh_len)
+{
+	return fh_len <= FANOTIFY_INLINE_FH_LEN ? fid->fh : fid->ext_fh;
+}
+
 /*
  * Structure for normal fanotify events. It gets allocated in
  * fanotify_handle_event() and freed when the information is retrieved by
@@ -13,13 +52,32 @@ extern struct kmem_cache *fanotify_perm_event_cachep;
 struct fanotify_event_info {
 	struct fsnotify_event fse;
 	/*
-	 * We hold ref to this path so it may be dereferenced at any point
-	 * during this object's lifetime
+	 * Groups reporting fds hold a ref to the path, so it may be
+	 * dereferenced at any point during this object's lifetime.  Groups
+	 * reporting file handles only keep the encoded handle around, which
+	 * pins nothing.
 	 */
-	struct path path;
+	union {
+		struct path path;
+		struct fanotify_fid fid;
+	};
+	/* FILEID_ROOT for path events, FILEID_INVALID if encoding failed */
+	u8 fh_type;
+	u8 fh_len;
 	struct pid *tgid;
 };
 
+static inline bool fanotify_event_has_path(struct fanotify_event_info *event)
+{
+	return event->fh_type == FILEID_ROOT;
+}
+
+static inline bool fanotify_event_has_fid(struct fanotify_event_info *event)
+{
+	return event->fh_type != FILEID_ROOT &&
+	       event->fh_type != FILEID_INVALID;
+}
+
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 /*
  * Structure for permission fanotify events. It gets allocated and freed in
@@ -46,5 +104,7 @@ static inline struct fanotify_event_info *FANOTIFY_E(struct fsnotify_event *fse)
 	return container_of(fse, struct fanotify_event_info, fse);
 }
 
-struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
-						 struct path *path);
+struct fanotify_event_info *fanotify_alloc_event(struct fsnotify_group *group,
+						 struct inode *inode, u32 mask,
+						 void *data, int data_type,
+						 __kernel_fsid_t *fsid);
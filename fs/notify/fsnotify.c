@@ -41,6 +41,14 @@ void __fsnotify_vfsmount_delete(struct vfsmount *mnt)
 	fsnotify_clear_marks_by_mount(mnt);
 }
 
+/*
+ * Clear all of the marks on a super block when it is being shut down
+ */
+void fsnotify_sb_delete(struct super_block *sb)
+{
+	fsnotify_clear_marks_by_sb(sb);
+}
+
 /*
  * Given an inode, first check if we care what happens to our children.  Inotify
  * and dnotify both tell their parents about events.  If we care about any event
@@ -129,6 +137,7 @@ EXPORT_SYMBOL_GPL(__fsnotify_parent);
 static int send_to_group(struct inode *to_tell,
 			 struct fsnotify_mark *inode_mark,
 			 struct fsnotify_mark *vfsmount_mark,
+			 struct fsnotify_mark *sb_mark,
 			 __u32 mask, void *data,
 			 int data_is, u32 cookie,
 			 const unsigned char *file_name)
@@ -136,8 +145,9 @@ static int send_to_group(struct inode *to_tell,
 	struct fsnotify_group *group = NULL;
 	__u32 inode_test_mask = 0;
 	__u32 vfsmount_test_mask = 0;
+	__u32 sb_test_mask = 0;
 
-	if (unlikely(!inode_mark && !vfsmount_mark)) {
+	if (unlikely(!inode_mark && !vfsmount_mark && !sb_mark)) {
 		BUG();
 		return 0;
 	}
@@ -150,6 +160,9 @@ static int send_to_group(struct inode *to_tell,
 		if (vfsmount_mark &&
 		    !(vfsmount_mark->flags & FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY))
 			vfsmount_mark->ignored_mask = 0;
+		if (sb_mark &&
+		    !(sb_mark->flags & FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY))
+			sb_mark->ignored_mask = 0;
 	}
 
 	/* does the inode mark tell us to do something? */
@@ -170,19 +183,39 @@ static int send_to_group(struct inode *to_tell,
 			vfsmount_test_mask &= ~inode_mark->ignored_mask;
 	}
 
+	/* does the sb_mark tell us to do something? */
+	if (sb_mark) {
+		sb_test_mask = (mask & ~FS_EVENT_ON_CHILD);
+		group = sb_mark->group;
+		sb_test_mask &= sb_mark->mask;
+		sb_test_mask &= ~sb_mark->ignored_mask;
+		if (inode_mark)
+			sb_test_mask &= ~inode_mark->ignored_mask;
+		if (vfsmount_mark)
+			sb_test_mask &= ~vfsmount_mark->ignored_mask;
+	}
+
 	pr_debug("%s: group=%p to_tell=%p mask=%x inode_mark=%p"
 		 " inode_test_mask=%x vfsmount_mark=%p vfsmount_test_mask=%x"
-		 " data=%p data_is=%d cookie=%d\n",
+		 " sb_mark=%p sb_test_mask=%x data=%p data_is=%d cookie=%d\n",
 		 __func__, group, to_tell, mask, inode_mark,
-		 inode_test_mask, vfsmount_mark, vfsmount_test_mask, data,
-		 data_is, cookie);
+		 inode_test_mask, vfsmount_mark, vfsmount_test_mask, sb_mark,
+		 sb_test_mask, data, data_is, cookie);
 
-	if (!inode_test_mask && !vfsmount_test_mask)
+	if (!inode_test_mask && !vfsmount_test_mask && !sb_test_mask)
 		return 0;
 
 	return group->ops->handle_event(group, to_tell, inode_mark,
-					vfsmount_mark, mask, data, data_is,
-					file_name, cookie);
+					vfsmount_mark, sb_mark, mask, data,
+					data_is, file_name, cookie);
+}
+
+static struct fsnotify_mark *fsnotify_next_mark(struct hlist_node *node)
+{
+	if (!node)
+		return NULL;
+	return hlist_entry(srcu_dereference(node, &fsnotify_mark_srcu),
+			   struct fsnotify_mark, obj_list);
 }
 
 /*
@@ -195,8 +228,10 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 	     const unsigned char *file_name, u32 cookie)
 {
 	struct hlist_node *inode_node = NULL, *vfsmount_node = NULL;
-	struct fsnotify_mark *inode_mark = NULL, *vfsmount_mark = NULL;
-	struct fsnotify_group *inode_group, *vfsmount_group;
+	struct hlist_node *sb_node = NULL;
+	struct fsnotify_mark *inode_mark, *vfsmount_mark, *sb_mark;
+	struct fsnotify_group *group;
+	struct super_block *sb = to_tell->i_sb;
 	struct mount *mnt;
 	int idx, ret = 0;
 	/* global tests shouldn't care about events on child only the specific event */
@@ -215,16 +250,18 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 	 * need SRCU to keep them "alive".
 	 */
 	if (hlist_empty(&to_tell->i_fsnotify_marks) &&
-	    (!mnt || hlist_empty(&mnt->mnt_fsnotify_marks)))
+	    (!mnt || hlist_empty(&mnt->mnt_fsnotify_marks)) &&
+	    hlist_empty(&sb->s_fsnotify_marks))
 		return 0;
 	/*
 	 * if this is a modify event we may need to clear the ignored masks
-	 * otherwise return if neither the inode nor the vfsmount care about
-	 * this type of event.
+	 * otherwise return if neither the inode nor the vfsmount nor the
+	 * super block care about this type of event.
 	 */
 	if (!(mask & FS_MODIFY) &&
 	    !(test_mask & to_tell->i_fsnotify_mask) &&
-	    !(mnt && test_mask & mnt->mnt_fsnotify_mask))
+	    !(mnt && test_mask & mnt->mnt_fsnotify_mask) &&
+	    !(test_mask & sb->s_fsnotify_mask))
 		return 0;
 
 	idx = srcu_read_lock(&fsnotify_mark_srcu);
@@ -242,52 +279,59 @@ int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 					      &fsnotify_mark_srcu);
 	}
 
+	if ((mask & FS_MODIFY) || (test_mask & sb->s_fsnotify_mask)) {
+		sb_node = srcu_dereference(sb->s_fsnotify_marks.first,
+					   &fsnotify_mark_srcu);
+		if (mnt)
+			vfsmount_node = srcu_dereference(mnt->mnt_fsnotify_marks.first,
+							 &fsnotify_mark_srcu);
+		inode_node = srcu_dereference(to_tell->i_fsnotify_marks.first,
+					      &fsnotify_mark_srcu);
+	}
+
 	/*
-	 * We need to merge inode & vfsmount mark lists so that inode mark
-	 * ignore masks are properly reflected for mount mark notifications.
-	 * That's why this traversal is so complicated...
+	 * We need to merge inode, vfsmount & sb mark lists so that inode and
+	 * vfsmount mark ignore masks are properly reflected for mount and sb
+	 * mark notifications.  All lists are sorted by group, so take the
+	 * marks of the first group in order from all of them on each step.
 	 */
-	while (inode_node || vfsmount_node) {
-		inode_group = NULL;
-		inode_mark = NULL;
-		vfsmount_group = NULL;
-		vfsmount_mark = NULL;
-
-		if (inode_node) {
-			inode_mark = hlist_entry(srcu_dereference(inode_node, &fsnotify_mark_srcu),
-						 struct fsnotify_mark, obj_list);
-			inode_group = inode_mark->group;
-		}
+	while (inode_node || vfsmount_node || sb_node) {
+		inode_mark = fsnotify_next_mark(inode_node);
+		vfsmount_mark = fsnotify_next_mark(vfsmount_node);
+		sb_mark = fsnotify_next_mark(sb_node);
 
-		if (vfsmount_node) {
-			vfsmount_mark = hlist_entry(srcu_dereference(vfsmount_node, &fsnotify_mark_srcu),
-						    struct fsnotify_mark, obj_list);
-			vfsmount_group = vfsmount_mark->group;
-		}
-
-		if (inode_group && vfsmount_group) {
-			int cmp = fsnotify_compare_groups(inode_group,
-							  vfsmount_group);
-			if (cmp > 0) {
-				inode_group = NULL;
-				inode_mark = NULL;
-			} else if (cmp < 0) {
-				vfsmount_group = NULL;
-				vfsmount_mark = NULL;
-			}
-		}
-		ret = send_to_group(to_tell, inode_mark, vfsmount_mark, mask,
-				    data, data_is, cookie, file_name);
+		group = NULL;
+		if (inode_mark)
+			group = inode_mark->group;
+		if (vfsmount_mark &&
+		    fsnotify_compare_groups(group, vfsmount_mark->group) > 0)
+			group = vfsmount_mark->group;
+		if (sb_mark &&
+		    fsnotify_compare_groups(group, sb_mark->group) > 0)
+			group = sb_mark->group;
+
+		if (inode_mark && inode_mark->group != group)
+			inode_mark = NULL;
+		if (vfsmount_mark && vfsmount_mark->group != group)
+			vfsmount_mark = NULL;
+		if (sb_mark && sb_mark->group != group)
+			sb_mark = NULL;
+
+		ret = send_to_group(to_tell, inode_mark, vfsmount_mark, sb_mark,
+				    mask, data, data_is, cookie, file_name);
 
 		if (ret && (mask & ALL_FSNOTIFY_PERM_EVENTS))
 			goto out;
 
-		if (inode_group)
+		if (inode_mark)
 			inode_node = srcu_dereference(inode_node->next,
 						      &fsnotify_mark_srcu);
-		if (vfsmount_group)
+		if (vfsmount_mark)
 			vfsmount_node = srcu_dereference(vfsmount_node->next,
 							 &fsnotify_mark_srcu);
+		if (sb_mark)
+			sb_node = srcu_dereference(sb_node->next,
+						   &fsnotify_mark_srcu);
 	}
 	ret = 0;
 out:
@@ -48,6 +48,9 @@
  * given inode and each mark is hooked via the i_list. (and sorta the
  * free_i_list)
  *
+ * The vfsmount and super block marks follow the same rules with
+ * mnt_root->d_lock and sb->s_fsnotify_lock in place of inode->i_lock.
+ *
  *
  * LIFETIME:
  * Inode marks survive between when they are added to an inode and when their
@@ -122,7 +125,7 @@ u32 fsnotify_recalc_mask(struct hlist_head *head)
 }
 
 /*
- * Remove mark from inode / vfsmount list, group list, drop inode reference
+ * Remove mark from inode / vfsmount / sb list, group list, drop inode reference
  * if we got one.
  *
  * Must be called with group->mark_mutex held.
@@ -149,6 +152,8 @@ void fsnotify_detach_mark(struct fsnotify_mark *mark)
 		fsnotify_destroy_inode_mark(mark);
 	} else if (mark->flags & FSNOTIFY_MARK_FLAG_VFSMOUNT)
 		fsnotify_destroy_vfsmount_mark(mark);
+	else if (mark->flags & FSNOTIFY_MARK_FLAG_SB)
+		fsnotify_destroy_sb_mark(mark);
 	else
 		BUG();
 	/*
@@ -263,14 +268,14 @@ void fsnotify_set_mark_ignored_mask_locked(struct fsnotify_mark *mark, __u32 mas
  * Fanotify supports different notification classes (reflected as priority of
  * notification group). Events shall be passed to notification groups in
  * decreasing priority order. To achieve this marks in notification lists for
- * inodes and vfsmounts are sorted so that priorities of corresponding groups
- * are descending.
+ * inodes, vfsmounts and super blocks are sorted so that priorities of
+ * corresponding groups are descending.
  *
- * Furthermore correct handling of the ignore mask requires processing inode
- * and vfsmount marks of each group together. Using the group address as
- * further sort criterion provides a unique sorting order and thus we can
- * merge inode and vfsmount lists of marks in linear time and find groups
- * present in both lists.
+ * Furthermore correct handling of the ignore mask requires processing inode,
+ * vfsmount and super block marks of each group together. Using the group
+ * address as further sort criterion provides a unique sorting order and thus
+ * we can merge the lists of marks in linear time and find groups present in
+ * more than one of them.
  *
  * A return value of 1 signifies that b has priority over a.
  * A return value of 0 signifies that the two marks have to be handled together.
@@ -331,14 +336,16 @@ int fsnotify_add_mark_list(struct hlist_head *head, struct fsnotify_mark *mark,
  * These marks may be used for the fsnotify backend to determine which
  * event types should be delivered to which group.
  */
-int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
-			     struct fsnotify_group *group, struct inode *inode,
-			     struct vfsmount *mnt, int allow_dups)
+static int fsnotify_add_object_mark_locked(struct fsnotify_mark *mark,
+					   struct fsnotify_group *group,
+					   struct inode *inode,
+					   struct vfsmount *mnt,
+					   struct super_block *sb,
+					   int allow_dups)
 {
 	int ret = 0;
 
-	BUG_ON(inode && mnt);
-	BUG_ON(!inode && !mnt);
+	BUG_ON(!!inode + !!mnt + !!sb != 1);
 	BUG_ON(!mutex_is_locked(&group->mark_mutex));
 
 	/*
@@ -364,6 +371,10 @@ int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
 		ret = fsnotify_add_vfsmount_mark(mark, group, mnt, allow_dups);
 		if (ret)
 			goto err;
+	} else if (sb) {
+		ret = fsnotify_add_sb_mark(mark, group, sb, allow_dups);
+		if (ret)
+			goto err;
 	} else {
 		BUG();
 	}
@@ -393,6 +404,22 @@ err:
 	return ret;
 }
 
+int fsnotify_add_mark_locked(struct fsnotify_mark *mark,
+			     struct fsnotify_group *group, struct inode *inode,
+			     struct vfsmount *mnt, int allow_dups)
+{
+	return fsnotify_add_object_mark_locked(mark, group, inode, mnt, NULL,
+					       allow_dups);
+}
+
+int fsnotify_add_sb_mark_locked(struct fsnotify_mark *mark,
+				struct fsnotify_group *group,
+				struct super_block *sb, int allow_dups)
+{
+	return fsnotify_add_object_mark_locked(mark, group, NULL, NULL, sb,
+					       allow_dups);
+}
+
 int fsnotify_add_mark(struct fsnotify_mark *mark, struct fsnotify_group *group,
 		      struct inode *inode, struct vfsmount *mnt, int allow_dups)
 {
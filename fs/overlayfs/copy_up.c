@@ -218,9 +218,43 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 	return err;
 }
 
+static int ovl_set_size(struct dentry *upperdentry, struct kstat *stat)
+{
+	struct iattr attr = {
+		.ia_valid = ATTR_SIZE,
+		.ia_size = stat->size,
+	};
+
+	return notify_change(upperdentry, &attr, NULL);
+}
+
+/*
+ * Record where the data of a metadata-only copy lives: the path of the
+ * file relative to the layer root.  Lower non-directories cannot be
+ * renamed without copy up, so this is also the path in the lower layer.
+ */
+static int ovl_set_metacopy(struct dentry *dentry, struct dentry *upper)
+{
+	char *buf, *path;
+	int err;
+
+	buf = (char *) __get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	path = dentry_path_raw(dentry, buf, PAGE_SIZE);
+	err = PTR_ERR(path);
+	if (!IS_ERR(path))
+		err = ovl_do_setxattr(upper, OVL_XATTR_METACOPY, path,
+				      strlen(path), 0);
+	free_page((unsigned long) buf);
+	return err;
+}
+
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
-			      struct kstat *stat, const char *link)
+			      struct kstat *stat, const char *link,
+			      bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -247,7 +281,7 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (S_ISREG(stat->mode) && !metacopy) {
 		struct path upperpath;
 		ovl_path_upper(dentry, &upperpath);
 		BUG_ON(upperpath.dentry != NULL);
@@ -262,8 +296,18 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy) {
+		err = ovl_set_metacopy(dentry, newdentry);
+		if (err)
+			goto out_cleanup;
+	}
+
 	mutex_lock(&newdentry->d_inode->i_mutex);
-	err = ovl_set_attr(newdentry, stat);
+	/* Sparse upper file, so that st_size is right without any data */
+	if (metacopy)
+		err = ovl_set_size(newdentry, stat);
+	if (!err)
+		err = ovl_set_attr(newdentry, stat);
 	mutex_unlock(&newdentry->d_inode->i_mutex);
 	if (err)
 		goto out_cleanup;
@@ -272,6 +316,7 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	ovl_dentry_set_metacopy(dentry, metacopy);
 	ovl_dentry_update(dentry, newdentry);
 	newdentry = NULL;
 
@@ -306,9 +351,14 @@ out_cleanup:
  * up uses upper parent i_mutex for exclusion.  Since rename can change
  * d_parent it is possible that the copy up will lock the old parent.  At
  * that point the file will have already been copied up anyway.
+ *
+ * With metacopy enabled, a regular file that is not about to be opened for
+ * write (@flags are the open flags, or 0 for a metadata change) only gets
+ * its metadata copied up.  The data stays in the lower layer until
+ * ovl_copy_up_meta_data() is called on the first open for write.
  */
 int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
-		    struct path *lowerpath, struct kstat *stat)
+		    struct path *lowerpath, struct kstat *stat, int flags)
 {
 	struct dentry *workdir = ovl_workdir(dentry);
 	int err;
@@ -318,10 +368,15 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	struct dentry *upperdentry;
 	const struct cred *old_cred;
 	char *link = NULL;
+	bool metacopy;
 
 	if (WARN_ON(!workdir))
 		return -EROFS;
 
+	metacopy = ovl_metacopy_enabled(dentry->d_sb) &&
+		   S_ISREG(stat->mode) && stat->size &&
+		   !ovl_open_flags_need_copy_up(flags);
+
 	ovl_path_upper(parent, &parentpath);
 	upperdir = parentpath.dentry;
 
@@ -350,7 +405,7 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	}
 
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, link);
+				 stat, link, metacopy);
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -365,7 +420,70 @@ out_unlock:
 	return err;
 }
 
-int ovl_copy_up(struct dentry *dentry)
+/*
+ * Copy the data of a metadata-only upper file, in place.  The metacopy
+ * xattr goes last, so a crash in the middle leaves a file that still reads
+ * its data from the lower layer and gets copied again on the next open.
+ * O_TRUNC needs no data at all.
+ */
+static int ovl_copy_up_meta_data(struct dentry *dentry, int flags)
+{
+	struct dentry *workdir = ovl_workdir(dentry);
+	struct dentry *parent;
+	struct dentry *upperdir;
+	struct path upperpath;
+	struct path lowerpath;
+	const struct cred *old_cred;
+	struct kstat stat;
+	int err;
+
+	if (WARN_ON(!workdir))
+		return -EROFS;
+
+	parent = dget_parent(dentry);
+	upperdir = ovl_dentry_upper(parent);
+	old_cred = ovl_override_creds(dentry->d_sb);
+
+	err = -EIO;
+	if (lock_rename(workdir, upperdir) != NULL) {
+		pr_err("overlayfs: failed to lock workdir+upperdir\n");
+		goto out_unlock;
+	}
+	/* Raced with another data copy-up?  Nothing to do, then... */
+	err = 0;
+	if (!ovl_dentry_is_metacopy(dentry))
+		goto out_unlock;
+
+	ovl_path_upper(dentry, &upperpath);
+	ovl_path_lower(dentry, &lowerpath);
+
+	if (!(flags & O_TRUNC)) {
+		err = vfs_getattr(&upperpath, &stat);
+		if (err)
+			goto out_unlock;
+
+		err = ovl_copy_up_data(&lowerpath, &upperpath, stat.size);
+		if (err)
+			goto out_unlock;
+
+		/* Writing the data must not show up as a modification */
+		mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+		ovl_set_timestamps(upperpath.dentry, &stat);
+		mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+	}
+
+	err = ovl_do_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (!err)
+		ovl_dentry_set_metacopy(dentry, false);
+out_unlock:
+	unlock_rename(workdir, upperdir);
+	ovl_revert_creds(old_cred);
+	dput(parent);
+
+	return err;
+}
+
+int ovl_copy_up_flags(struct dentry *dentry, int flags)
 {
 	int err;
 
@@ -396,11 +514,21 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(&lowerpath, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      next == dentry ? flags : 0);
 
 		dput(parent);
 		dput(next);
 	}
 
+	if (!err && ovl_dentry_is_metacopy(dentry) &&
+	    ovl_open_flags_need_copy_up(flags))
+		err = ovl_copy_up_meta_data(dentry, flags);
+
 	return err;
 }
+
+int ovl_copy_up(struct dentry *dentry)
+{
+	return ovl_copy_up_flags(dentry, 0);
+}
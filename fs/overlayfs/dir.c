@@ -492,7 +492,11 @@ static int ovl_link(struct dentry *old, struct inode *newdir,
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(old);
+	/*
+	 * The new name starts out pure upper with no lower data to fall
+	 * back on, so a metadata-only copy up is not enough here.
+	 */
+	err = ovl_copy_up_flags(old, O_WRONLY);
 	if (err)
 		goto out_drop_write;
 
@@ -31,7 +31,7 @@ static int ovl_copy_up_truncate(struct dentry *dentry)
 		goto out_dput_parent;
 
 	stat.size = 0;
-	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat);
+	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, O_TRUNC);
 
 out_dput_parent:
 	dput(parent);
@@ -60,7 +60,9 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(dentry);
+	/* Changing the size needs the data, anything else only metadata */
+	err = ovl_copy_up_flags(dentry,
+				(attr->ia_valid & ATTR_SIZE) ? O_WRONLY : 0);
 	if (!err) {
 		upperdentry = ovl_dentry_upper(dentry);
 
@@ -82,9 +84,20 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	struct kstat lowerstat;
+	int err;
 
 	ovl_path_real(dentry, &realpath);
-	return vfs_getattr(&realpath, stat);
+	err = vfs_getattr(&realpath, stat);
+	if (err || !ovl_dentry_is_metacopy(dentry))
+		return err;
+
+	/* The upper file is sparse, the blocks are in the lower layer */
+	ovl_path_lower(dentry, &realpath);
+	if (!vfs_getattr(&realpath, &lowerstat))
+		stat->blocks = lowerstat.blocks;
+
+	return 0;
 }
 
 int ovl_permission(struct inode *inode, int mask)
@@ -268,7 +281,8 @@ static bool ovl_need_xattr_filter(struct dentry *dentry,
 				  enum ovl_path_type type)
 {
 	if ((type & (__OVL_PATH_PURE | __OVL_PATH_UPPER)) == __OVL_PATH_UPPER)
-		return S_ISDIR(dentry->d_inode->i_mode);
+		return S_ISDIR(dentry->d_inode->i_mode) ||
+		       ovl_dentry_is_metacopy(dentry);
 	else
 		return false;
 }
@@ -363,16 +377,17 @@ out:
 	return err;
 }
 
-static bool ovl_open_need_copy_up(int flags, enum ovl_path_type type,
+static bool ovl_open_need_copy_up(struct dentry *dentry, int flags,
+				  enum ovl_path_type type,
 				  struct dentry *realdentry)
 {
-	if (OVL_TYPE_UPPER(type))
+	if (OVL_TYPE_UPPER(type) && !ovl_dentry_is_metacopy(dentry))
 		return false;
 
 	if (special_file(realdentry->d_inode->i_mode))
 		return false;
 
-	if (!(OPEN_FMODE(flags) & FMODE_WRITE) && !(flags & O_TRUNC))
+	if (!ovl_open_flags_need_copy_up(flags))
 		return false;
 
 	return true;
@@ -388,20 +403,23 @@ struct inode *ovl_d_select_inode(struct dentry *dentry, unsigned file_flags)
 		return d_backing_inode(dentry);
 
 	type = ovl_path_real(dentry, &realpath);
-	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
+	if (ovl_open_need_copy_up(dentry, file_flags, type, realpath.dentry)) {
 		err = ovl_want_write(dentry);
 		if (err)
 			return ERR_PTR(err);
 
-		if (file_flags & O_TRUNC)
+		if ((file_flags & O_TRUNC) && !OVL_TYPE_UPPER(type))
 			err = ovl_copy_up_truncate(dentry);
 		else
-			err = ovl_copy_up(dentry);
+			err = ovl_copy_up_flags(dentry, file_flags);
 		ovl_drop_write(dentry);
 		if (err)
 			return ERR_PTR(err);
 
 		ovl_path_upper(dentry, &realpath);
+	} else if (OVL_TYPE_UPPER(type) && ovl_dentry_is_metacopy(dentry)) {
+		/* Read-only open of a metadata-only copy: data is below */
+		ovl_path_lower(dentry, &realpath);
 	}
 
 	if (realpath.dentry->d_flags & DCACHE_OP_SELECT_INODE)
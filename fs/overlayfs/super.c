@@ -32,6 +32,7 @@ struct ovl_config {
 	char *upperdir;
 	char *workdir;
 	bool override_creds;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -57,6 +58,7 @@ struct ovl_entry {
 		struct {
 			u64 version;
 			bool opaque;
+			bool metacopy;
 		};
 		struct rcu_head rcu;
 	};
@@ -211,6 +213,24 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	return READ_ONCE(oe->metacopy);
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	WRITE_ONCE(oe->metacopy, metacopy);
+}
+
+bool ovl_metacopy_enabled(struct super_block *sb)
+{
+	struct ovl_fs *ofs = sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -280,6 +300,18 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+static bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	struct inode *inode = dentry->d_inode;
+
+	if (!S_ISREG(inode->i_mode) || !inode->i_op->getxattr)
+		return false;
+
+	res = inode->i_op->getxattr(dentry, OVL_XATTR_METACOPY, NULL, 0);
+	return res > 0;
+}
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -429,6 +461,82 @@ static inline struct dentry *ovl_lookup_real(struct dentry *dir,
 	return dentry;
 }
 
+/*
+ * Follow the redirect stored in a metadata-only upper file to the lower
+ * file holding its data.  The redirect is the path from the layer root, so
+ * it stays valid when the upper file is renamed.  The topmost lower layer
+ * with a regular file at that path wins.
+ */
+static int ovl_lookup_data(struct super_block *sb, struct dentry *upperdentry,
+			   struct path *datapath)
+{
+	struct ovl_entry *roe = sb->s_root->d_fsdata;
+	char *redirect, *name, *end;
+	struct dentry *this;
+	unsigned int i;
+	ssize_t res;
+	int err;
+
+	redirect = kzalloc(PATH_MAX, GFP_KERNEL);
+	if (!redirect)
+		return -ENOMEM;
+
+	res = vfs_getxattr(upperdentry, OVL_XATTR_METACOPY, redirect,
+			   PATH_MAX - 1);
+	err = res;
+	if (res < 0)
+		goto out;
+
+	err = -EIO;
+	if (res == 0 || redirect[0] != '/')
+		goto out_invalid;
+
+	for (i = 0; i < roe->numlower; i++) {
+		this = dget(roe->lowerstack[i].dentry);
+		for (name = redirect + 1; this && *name; name = end) {
+			struct qstr q;
+			struct dentry *next;
+
+			end = strchrnul(name, '/');
+			q = (struct qstr) QSTR_INIT(name, end - name);
+			if (*end)
+				end++;
+			if (!q.len)
+				continue;
+
+			next = NULL;
+			if (S_ISDIR(this->d_inode->i_mode))
+				next = ovl_lookup_real(this, &q);
+			dput(this);
+			if (IS_ERR(next)) {
+				err = PTR_ERR(next);
+				goto out;
+			}
+			this = next;
+		}
+		if (!this)
+			continue;
+		if (ovl_is_whiteout(this)) {
+			dput(this);
+			break;
+		}
+		if (S_ISREG(this->d_inode->i_mode)) {
+			datapath->dentry = this;
+			datapath->mnt = roe->lowerstack[i].mnt;
+			err = 0;
+			goto out;
+		}
+		dput(this);
+	}
+
+out_invalid:
+	pr_warn_ratelimited("overlayfs: no lower data for metacopy file %pd2\n",
+			    upperdentry);
+out:
+	kfree(redirect);
+	return err;
+}
+
 /*
  * Returns next layer in stack starting from top.
  * Returns -1 if this is the last layer.
@@ -460,6 +568,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	struct dentry *this, *prev = NULL;
 	unsigned int i;
 	int err;
@@ -483,11 +592,27 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 				upperopaque = true;
 			} else if (poe->numlower && ovl_is_opaquedir(this)) {
 				upperopaque = true;
+			} else if (ovl_is_metacopy(this)) {
+				metacopy = true;
 			}
 		}
 		upperdentry = prev = this;
 	}
 
+	if (metacopy) {
+		err = -ENOMEM;
+		stack = kzalloc(sizeof(struct path), GFP_KERNEL);
+		if (!stack)
+			goto out_put_upper;
+
+		err = ovl_lookup_data(dentry->d_sb, upperdentry, &stack[0]);
+		if (err)
+			goto out_put;
+		ctr = 1;
+		/* Same as a non-dir copied up: don't look further down */
+		upperopaque = true;
+	}
+
 	if (!upperopaque && poe->numlower) {
 		err = -ENOMEM;
 		stack = kcalloc(poe->numlower, sizeof(struct path), GFP_KERNEL);
@@ -566,6 +691,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	}
 
 	oe->opaque = upperopaque;
+	oe->metacopy = metacopy;
 	oe->__upperdentry = upperdentry;
 	memcpy(oe->lowerstack, stack, sizeof(struct path) * ctr);
 	kfree(stack);
@@ -640,6 +766,12 @@ module_param_named(override_creds, ovl_override_creds_def, bool, 0644);
 MODULE_PARM_DESC(ovl_override_creds_def,
 		 "Use mounter's credentials for accesses");
 
+static bool __read_mostly ovl_metacopy_def =
+	IS_ENABLED(CONFIG_OVERLAY_FS_METACOPY);
+module_param_named(metacopy, ovl_metacopy_def, bool, 0644);
+MODULE_PARM_DESC(ovl_metacopy_def,
+		 "Copy up only metadata on metadata changes");
+
 /**
  * ovl_show_options
  *
@@ -659,6 +791,9 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 	if (ufs->config.override_creds != ovl_override_creds_def)
 		seq_show_option(m, "override_creds",
 				ufs->config.override_creds ? "on" : "off");
+	if (ufs->config.metacopy != ovl_metacopy_def)
+		seq_show_option(m, "metacopy",
+				ufs->config.metacopy ? "on" : "off");
 	return 0;
 }
 
@@ -685,6 +820,8 @@ enum {
 	OPT_WORKDIR,
 	OPT_OVERRIDE_CREDS_ON,
 	OPT_OVERRIDE_CREDS_OFF,
+	OPT_METACOPY_ON,
+	OPT_METACOPY_OFF,
 	OPT_ERR,
 };
 
@@ -694,6 +831,8 @@ static const match_table_t ovl_tokens = {
 	{OPT_WORKDIR,			"workdir=%s"},
 	{OPT_OVERRIDE_CREDS_ON,		"override_creds=on"},
 	{OPT_OVERRIDE_CREDS_OFF,	"override_creds=off"},
+	{OPT_METACOPY_ON,		"metacopy=on"},
+	{OPT_METACOPY_OFF,		"metacopy=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -725,6 +864,7 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 	char *p;
 
 	config->override_creds = ovl_override_creds_def;
+	config->metacopy = ovl_metacopy_def;
 	while ((p = ovl_next_opt(&opt)) != NULL) {
 		int token;
 		substring_t args[MAX_OPT_ARGS];
@@ -763,6 +903,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 			config->override_creds = false;
 			break;
 
+		case OPT_METACOPY_ON:
+			config->metacopy = true;
+			break;
+
+		case OPT_METACOPY_OFF:
+			config->metacopy = false;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
@@ -1114,6 +1262,22 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 			if (!err)
 				pr_warn("overlayfs: upper fs needs to support d_type.\n");
 		}
+
+		/*
+		 * Metadata-only copy up points at the lower data with an
+		 * xattr, so the upper fs has to be able to store one.
+		 */
+		if (ufs->workdir && ufs->config.metacopy) {
+			err = ovl_do_setxattr(ufs->workdir, OVL_XATTR_METACOPY,
+					      "/", 1, 0);
+			if (err) {
+				pr_warn("overlayfs: upper fs does not support xattr, disabling metacopy.\n");
+				ufs->config.metacopy = false;
+			} else {
+				ovl_do_removexattr(ufs->workdir,
+						   OVL_XATTR_METACOPY);
+			}
+		}
 	}
 
 	err = -ENOMEM;
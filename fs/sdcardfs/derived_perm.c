@@ -46,13 +46,12 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 	info->data->under_android = false;
 	info->data->under_cache = false;
 	info->data->under_obb = false;
+	info->data->memo_gen = 0;
+	info->data->owner_gen = 0;
 }
 
-/* While renaming, there is a point where we want the path from dentry,
- * but the name from newdentry
- */
-void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
-				const struct qstr *name)
+static void __get_derived_permission_new(struct dentry *parent,
+				struct dentry *dentry, const struct qstr *name)
 {
 	struct sdcardfs_inode_info *info = SDCARDFS_I(d_inode(dentry));
 	struct sdcardfs_inode_info *parent_info = SDCARDFS_I(d_inode(parent));
@@ -145,6 +144,44 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	}
 }
 
+/* While renaming, there is a point where we want the path from dentry,
+ * but the name from newdentry
+ *
+ * The derived state only depends on the parent's state, the name and the
+ * package list, so it is kept until the package list generation changes or
+ * the inode shows up under another parent.
+ */
+void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
+				const struct qstr *name)
+{
+	struct sdcardfs_inode_data *data = SDCARDFS_I(d_inode(dentry))->data;
+	struct sdcardfs_inode_data *parent_data =
+					SDCARDFS_I(d_inode(parent))->data;
+	unsigned int gen = pkgl_get_generation();
+	perm_t perm = data->perm;
+	userid_t userid = data->userid;
+	uid_t d_uid = data->d_uid;
+	bool under_android = data->under_android;
+	bool under_cache = data->under_cache;
+	bool under_obb = data->under_obb;
+
+	if (data->memo_gen == gen && data->memo_parent == parent_data) {
+		atomic64_inc(&sdcardfs_lookup_stats.perm_memo_hits);
+		return;
+	}
+
+	__get_derived_permission_new(parent, dentry, name);
+
+	if (data->perm != perm || data->userid != userid ||
+			data->d_uid != d_uid ||
+			data->under_android != under_android ||
+			data->under_cache != under_cache ||
+			data->under_obb != under_obb)
+		data->owner_gen = 0;
+	data->memo_parent = parent_data;
+	data->memo_gen = gen;
+}
+
 void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 {
 	get_derived_permission_new(parent, dentry, &dentry->d_name);
@@ -177,12 +214,20 @@ void fixup_lower_ownership(struct dentry *dentry, const char *name)
 	uid_t uid = sbi->options.fs_low_uid;
 	gid_t gid = sbi->options.fs_low_gid;
 	struct iattr newattrs;
+	unsigned int gen;
 
 	if (!sbi->options.gid_derivation)
 		return;
 
 	info = SDCARDFS_I(d_inode(dentry));
 	info_d = info->data;
+	gen = pkgl_get_generation();
+	if (info_d->owner_gen == gen) {
+		uid = info_d->owner_uid;
+		gid = info_d->owner_gid;
+		goto check;
+	}
+
 	perm = info_d->perm;
 	if (info_d->under_obb) {
 		perm = PERM_ANDROID_OBB;
@@ -239,7 +284,11 @@ void fixup_lower_ownership(struct dentry *dentry, const char *name)
 	default:
 		break;
 	}
+	info_d->owner_uid = uid;
+	info_d->owner_gid = gid;
+	info_d->owner_gen = gen;
 
+check:
 	sdcardfs_get_lower_path(dentry, &path);
 	inode = d_inode(path.dentry);
 	if (d_inode(path.dentry)->i_gid.val != gid || d_inode(path.dentry)->i_uid.val != uid) {
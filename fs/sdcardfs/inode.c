@@ -70,6 +70,7 @@ static int sdcardfs_create(struct inode *dir, struct dentry *dentry,
 	const struct cred *saved_cred = NULL;
 	struct fs_struct *saved_fs;
 	struct fs_struct *copied_fs;
+	struct sdcardfs_ci_stamp stamp;
 
 	if (!check_caller_access_to_name(dir, &dentry->d_name)) {
 		err = -EACCES;
@@ -86,6 +87,7 @@ static int sdcardfs_create(struct inode *dir, struct dentry *dentry,
 	lower_dentry = lower_path.dentry;
 	lower_dentry_mnt = lower_path.mnt;
 	lower_parent_dentry = lock_parent(lower_dentry);
+	sdcardfs_ci_get_stamp(&stamp, d_inode(lower_parent_dentry));
 
 	/* set last 16bytes of mode field to 0664 */
 	mode = (mode & S_IFMT) | 00664;
@@ -105,6 +107,8 @@ static int sdcardfs_create(struct inode *dir, struct dentry *dentry,
 	err = vfs_create2(lower_dentry_mnt, d_inode(lower_parent_dentry), lower_dentry, mode, want_excl);
 	if (err)
 		goto out;
+	sdcardfs_ci_cache_update(dir, d_inode(lower_parent_dentry), &stamp,
+				 NULL, &lower_dentry->d_name);
 
 	err = sdcardfs_interpose(dentry, dir->i_sb, &lower_path,
 			SDCARDFS_I(dir)->data->userid);
@@ -136,6 +140,7 @@ static int sdcardfs_unlink(struct inode *dir, struct dentry *dentry)
 	struct dentry *lower_dir_dentry;
 	struct path lower_path;
 	const struct cred *saved_cred = NULL;
+	struct sdcardfs_ci_stamp stamp;
 
 	if (!check_caller_access_to_name(dir, &dentry->d_name)) {
 		err = -EACCES;
@@ -153,6 +158,7 @@ static int sdcardfs_unlink(struct inode *dir, struct dentry *dentry)
 	lower_mnt = lower_path.mnt;
 	dget(lower_dentry);
 	lower_dir_dentry = lock_parent(lower_dentry);
+	sdcardfs_ci_get_stamp(&stamp, d_inode(lower_dir_dentry));
 
 	err = vfs_unlink2(lower_mnt, lower_dir_inode, lower_dentry, NULL);
 
@@ -167,6 +173,8 @@ static int sdcardfs_unlink(struct inode *dir, struct dentry *dentry)
 		err = 0;
 	if (err)
 		goto out;
+	sdcardfs_ci_cache_update(dir, d_inode(lower_dir_dentry), &stamp,
+				 &lower_dentry->d_name, NULL);
 	fsstack_copy_attr_times(dir, lower_dir_inode);
 	fsstack_copy_inode_size(dir, lower_dir_inode);
 	set_nlink(d_inode(dentry),
@@ -216,6 +224,7 @@ static int sdcardfs_mkdir(struct inode *dir, struct dentry *dentry, umode_t mode
 	struct fs_struct *copied_fs;
 	struct qstr q_obb = QSTR_LITERAL("obb");
 	struct qstr q_data = QSTR_LITERAL("data");
+	struct sdcardfs_ci_stamp stamp;
 
 	if (!check_caller_access_to_name(dir, &dentry->d_name)) {
 		err = -EACCES;
@@ -243,6 +252,7 @@ static int sdcardfs_mkdir(struct inode *dir, struct dentry *dentry, umode_t mode
 	lower_dentry = lower_path.dentry;
 	lower_mnt = lower_path.mnt;
 	lower_parent_dentry = lock_parent(lower_dentry);
+	sdcardfs_ci_get_stamp(&stamp, d_inode(lower_parent_dentry));
 
 	/* set last 16bytes of mode field to 0775 */
 	mode = (mode & S_IFMT) | 00775;
@@ -266,6 +276,8 @@ static int sdcardfs_mkdir(struct inode *dir, struct dentry *dentry, umode_t mode
 		unlock_dir(lower_parent_dentry);
 		goto out;
 	}
+	sdcardfs_ci_cache_update(dir, d_inode(lower_parent_dentry), &stamp,
+				 NULL, &lower_dentry->d_name);
 
 	/* if it is a local obb dentry, setup it with the base obbpath */
 	if (need_graft_path(dentry)) {
@@ -348,6 +360,7 @@ static int sdcardfs_rmdir(struct inode *dir, struct dentry *dentry)
 	int err;
 	struct path lower_path;
 	const struct cred *saved_cred = NULL;
+	struct sdcardfs_ci_stamp stamp;
 
 	if (!check_caller_access_to_name(dir, &dentry->d_name)) {
 		err = -EACCES;
@@ -368,10 +381,13 @@ static int sdcardfs_rmdir(struct inode *dir, struct dentry *dentry)
 	lower_dentry = lower_path.dentry;
 	lower_mnt = lower_path.mnt;
 	lower_dir_dentry = lock_parent(lower_dentry);
+	sdcardfs_ci_get_stamp(&stamp, d_inode(lower_dir_dentry));
 
 	err = vfs_rmdir2(lower_mnt, d_inode(lower_dir_dentry), lower_dentry);
 	if (err)
 		goto out;
+	sdcardfs_ci_cache_update(dir, d_inode(lower_dir_dentry), &stamp,
+				 &lower_dentry->d_name, NULL);
 
 	d_drop(dentry);	/* drop our dentry on success (why not VFS's job?) */
 	if (d_inode(dentry))
@@ -404,6 +420,8 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	struct dentry *trap = NULL;
 	struct path lower_old_path, lower_new_path;
 	const struct cred *saved_cred = NULL;
+	struct sdcardfs_ci_stamp old_stamp, new_stamp;
+	struct qstr old_name;
 
 	if (!check_caller_access_to_name(old_dir, &old_dentry->d_name) ||
 		!check_caller_access_to_name(new_dir, &new_dentry->d_name)) {
@@ -437,12 +455,36 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		goto out;
 	}
 
+	/* the rename gives the lower dentry its new name */
+	old_name.len = lower_old_dentry->d_name.len;
+	old_name.name = kmemdup(lower_old_dentry->d_name.name, old_name.len,
+				GFP_KERNEL);
+	sdcardfs_ci_get_stamp(&old_stamp, d_inode(lower_old_dir_dentry));
+	sdcardfs_ci_get_stamp(&new_stamp, d_inode(lower_new_dir_dentry));
+
 	err = vfs_rename2(lower_mnt,
 			 d_inode(lower_old_dir_dentry), lower_old_dentry,
 			 d_inode(lower_new_dir_dentry), lower_new_dentry,
 			 NULL, 0);
-	if (err)
+	if (err) {
+		kfree(old_name.name);
 		goto out;
+	}
+
+	if (!old_name.name)
+		sdcardfs_free_ci_cache(old_dir);
+	if (new_dir == old_dir) {
+		sdcardfs_ci_cache_update(old_dir, d_inode(lower_old_dir_dentry),
+					 &old_stamp, &old_name,
+					 &lower_new_dentry->d_name);
+	} else {
+		sdcardfs_ci_cache_update(old_dir, d_inode(lower_old_dir_dentry),
+					 &old_stamp, &old_name, NULL);
+		sdcardfs_ci_cache_update(new_dir, d_inode(lower_new_dir_dentry),
+					 &new_stamp, NULL,
+					 &lower_new_dentry->d_name);
+	}
+	kfree(old_name.name);
 
 	/* Copy attrs from lower dir, but i_uid/i_gid */
 	sdcardfs_copy_and_fix_attrs(new_dir, d_inode(lower_new_dir_dentry));
@@ -452,6 +494,8 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		sdcardfs_copy_and_fix_attrs(old_dir, d_inode(lower_old_dir_dentry));
 		fsstack_copy_inode_size(old_dir, d_inode(lower_old_dir_dentry));
 	}
+	/* the moved subtree derives its state from a new name */
+	pkgl_bump_generation();
 	get_derived_permission_new(new_dentry->d_parent, old_dentry, &new_dentry->d_name);
 	fixup_tmp_permissions(d_inode(old_dentry));
 	fixup_lower_ownership(old_dentry, new_dentry->d_name.name);
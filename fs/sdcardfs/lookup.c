@@ -20,6 +20,12 @@
 
 #include "sdcardfs.h"
 #include "linux/delay.h"
+#include <linux/ctype.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/shrinker.h>
+
+struct sdcardfs_lookup_stats sdcardfs_lookup_stats;
 
 /* The dentry cache is just so we have properly sized dentries */
 static struct kmem_cache *sdcardfs_dentry_cachep;
@@ -220,11 +226,331 @@ int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 	return PTR_ERR(ret_dentry);
 }
 
+/*
+ * Case-insensitive lookup cache
+ *
+ * A lookup which misses on the exact name has to scan the whole lower
+ * directory for a case-insensitive match.  The scan also collects all names
+ * into a case-folded hash table hung off our directory inode, so that later
+ * misses in the same directory, including plain negative lookups, are
+ * answered without scanning again.  The table is only used while the lower
+ * directory is unchanged, and is protected by our directory's i_mutex,
+ * which the VFS holds across ->lookup and the namespace operations.
+ * Changes made through us update single names in the table, any other
+ * change of the lower directory drops it.
+ *
+ * All tables sit on a global LRU.  A shrinker and a cap on the total number
+ * of cached names free the least recently used ones.  Attaching a table to
+ * or detaching it from its inode takes sdcardfs_ci_lock on top of i_mutex,
+ * so that either lock is enough to look at it.
+ */
+#define SDCARDFS_CI_MAX_NAMES	4096
+#define SDCARDFS_CI_MAX_TOTAL	(16 * SDCARDFS_CI_MAX_NAMES)
+
+struct sdcardfs_ci_name {
+	struct hlist_node hlist;
+	unsigned int hash;
+	unsigned int len;
+	char name[];
+};
+
+struct sdcardfs_ci_cache {
+	/* state of the lower directory the names were read from */
+	struct sdcardfs_ci_stamp stamp;
+
+	struct inode *dir;
+	struct list_head lru;		/* under sdcardfs_ci_lock */
+	bool referenced;
+	unsigned int nr_names;
+
+	unsigned int bits;
+	struct hlist_head table[];
+};
+
+static DEFINE_SPINLOCK(sdcardfs_ci_lock);
+static LIST_HEAD(sdcardfs_ci_lru);
+static unsigned long sdcardfs_ci_nr_caches;
+static unsigned long sdcardfs_ci_nr_names;
+
+static unsigned int sdcardfs_ci_hash(const char *name, unsigned int len)
+{
+	unsigned long hash = init_name_hash();
+
+	while (len--)
+		hash = partial_name_hash(tolower(*name++), hash);
+	return end_name_hash(hash);
+}
+
+void sdcardfs_ci_get_stamp(struct sdcardfs_ci_stamp *stamp,
+			   struct inode *lower_dir)
+{
+	stamp->mtime = lower_dir->i_mtime;
+	stamp->ctime = lower_dir->i_ctime;
+	stamp->version = lower_dir->i_version;
+	stamp->size = i_size_read(lower_dir);
+}
+
+static bool sdcardfs_ci_stamp_equal(const struct sdcardfs_ci_stamp *a,
+				    const struct sdcardfs_ci_stamp *b)
+{
+	return timespec_equal(&a->mtime, &b->mtime) &&
+		timespec_equal(&a->ctime, &b->ctime) &&
+		a->version == b->version && a->size == b->size;
+}
+
+static bool sdcardfs_ci_stamp_valid(const struct sdcardfs_ci_stamp *stamp,
+				    struct inode *lower_dir)
+{
+	struct sdcardfs_ci_stamp now;
+
+	sdcardfs_ci_get_stamp(&now, lower_dir);
+	return sdcardfs_ci_stamp_equal(stamp, &now);
+}
+
+static void sdcardfs_ci_free_names(struct hlist_head *head)
+{
+	struct sdcardfs_ci_name *ent;
+	struct hlist_node *tmp;
+
+	hlist_for_each_entry_safe(ent, tmp, head, hlist) {
+		hlist_del(&ent->hlist);
+		kfree(ent);
+	}
+}
+
+static void sdcardfs_ci_free(struct sdcardfs_ci_cache *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < (1U << cache->bits); i++)
+		sdcardfs_ci_free_names(&cache->table[i]);
+	kfree(cache);
+}
+
+/* Detach @cache from its inode, under sdcardfs_ci_lock */
+static void __sdcardfs_ci_detach(struct sdcardfs_ci_cache *cache)
+{
+	SDCARDFS_I(cache->dir)->ci_cache = NULL;
+	list_del(&cache->lru);
+	sdcardfs_ci_nr_caches--;
+	sdcardfs_ci_nr_names -= cache->nr_names;
+}
+
+/*
+ * Free up to @nr_to_scan names, least recently used tables first.  Tables
+ * whose directory is busy or which were used since the last pass are
+ * skipped.  Only trylocks i_mutex, so this can be called with the i_mutex
+ * of another sdcardfs directory held.
+ */
+static unsigned long sdcardfs_ci_prune(unsigned long nr_to_scan)
+{
+	struct sdcardfs_ci_cache *cache, *tmp;
+	unsigned long nr, freed = 0;
+	LIST_HEAD(dispose);
+
+	spin_lock(&sdcardfs_ci_lock);
+	for (nr = sdcardfs_ci_nr_caches; nr && freed < nr_to_scan; nr--) {
+		cache = list_last_entry(&sdcardfs_ci_lru,
+					struct sdcardfs_ci_cache, lru);
+		if (cache->referenced ||
+		    !mutex_trylock(&cache->dir->i_mutex)) {
+			cache->referenced = false;
+			list_move(&cache->lru, &sdcardfs_ci_lru);
+			continue;
+		}
+		freed += cache->nr_names;
+		__sdcardfs_ci_detach(cache);
+		mutex_unlock(&cache->dir->i_mutex);
+		list_add(&cache->lru, &dispose);
+	}
+	spin_unlock(&sdcardfs_ci_lock);
+
+	list_for_each_entry_safe(cache, tmp, &dispose, lru)
+		sdcardfs_ci_free(cache);
+	return freed;
+}
+
+static unsigned long sdcardfs_ci_shrink_count(struct shrinker *shrink,
+					      struct shrink_control *sc)
+{
+	return READ_ONCE(sdcardfs_ci_nr_names);
+}
+
+static unsigned long sdcardfs_ci_shrink_scan(struct shrinker *shrink,
+					     struct shrink_control *sc)
+{
+	return sdcardfs_ci_prune(sc->nr_to_scan);
+}
+
+static struct shrinker sdcardfs_ci_shrinker = {
+	.count_objects	= sdcardfs_ci_shrink_count,
+	.scan_objects	= sdcardfs_ci_shrink_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+int sdcardfs_init_ci_cache(void)
+{
+	return register_shrinker(&sdcardfs_ci_shrinker);
+}
+
+void sdcardfs_destroy_ci_cache(void)
+{
+	unregister_shrinker(&sdcardfs_ci_shrinker);
+}
+
+void sdcardfs_free_ci_cache(struct inode *dir)
+{
+	struct sdcardfs_ci_cache *cache;
+
+	if (!S_ISDIR(dir->i_mode))
+		return;
+
+	/* the shrinker may be detaching it without our i_mutex */
+	spin_lock(&sdcardfs_ci_lock);
+	cache = SDCARDFS_I(dir)->ci_cache;
+	if (cache)
+		__sdcardfs_ci_detach(cache);
+	spin_unlock(&sdcardfs_ci_lock);
+
+	if (cache)
+		sdcardfs_ci_free(cache);
+}
+
+static struct sdcardfs_ci_name *
+sdcardfs_ci_find_exact(struct sdcardfs_ci_cache *cache, const struct qstr *name)
+{
+	unsigned int hash = sdcardfs_ci_hash(name->name, name->len);
+	struct sdcardfs_ci_name *ent;
+
+	hlist_for_each_entry(ent, &cache->table[hash_32(hash, cache->bits)],
+			     hlist) {
+		if (ent->hash == hash && ent->len == name->len &&
+		    !memcmp(ent->name, name->name, name->len))
+			return ent;
+	}
+	return NULL;
+}
+
+static struct sdcardfs_ci_name *sdcardfs_ci_alloc_name(const char *name,
+						      unsigned int len)
+{
+	struct sdcardfs_ci_name *ent;
+
+	ent = kmalloc(sizeof(*ent) + len + 1, GFP_KERNEL);
+	if (!ent)
+		return NULL;
+	ent->hash = sdcardfs_ci_hash(name, len);
+	ent->len = len;
+	memcpy(ent->name, name, len);
+	ent->name[len] = 0;
+	return ent;
+}
+
+/*
+ * Apply a change made through us to the name cache of @dir: @removed was
+ * taken out of @lower_dir and @added put into it, either may be NULL.
+ * @before is the state of @lower_dir before the change, and the lower
+ * directory must have been locked from then on.
+ *
+ * A later change made directly to the lower directory must still show up
+ * in the stamp, so the cache is only kept if the lower filesystem bumped
+ * i_version for our change or the timestamp tick has passed since.
+ */
+void sdcardfs_ci_cache_update(struct inode *dir, struct inode *lower_dir,
+			      const struct sdcardfs_ci_stamp *before,
+			      const struct qstr *removed,
+			      const struct qstr *added)
+{
+	struct sdcardfs_ci_cache *cache = SDCARDFS_I(dir)->ci_cache;
+	struct sdcardfs_ci_name *ent;
+	struct timespec now;
+
+	if (!cache)
+		return;
+	if (lower_dir != sdcardfs_lower_inode(dir) ||
+	    !sdcardfs_ci_stamp_equal(&cache->stamp, before))
+		goto drop;
+	now = current_fs_time(lower_dir->i_sb);
+	if (lower_dir->i_version == before->version &&
+	    timespec_equal(&lower_dir->i_mtime, &now))
+		goto drop;
+
+	if (removed) {
+		ent = sdcardfs_ci_find_exact(cache, removed);
+		if (ent) {
+			hlist_del(&ent->hlist);
+			kfree(ent);
+			spin_lock(&sdcardfs_ci_lock);
+			cache->nr_names--;
+			sdcardfs_ci_nr_names--;
+			spin_unlock(&sdcardfs_ci_lock);
+		}
+	}
+
+	if (added && !sdcardfs_ci_find_exact(cache, added)) {
+		if (cache->nr_names >= SDCARDFS_CI_MAX_NAMES)
+			goto drop;
+		ent = sdcardfs_ci_alloc_name(added->name, added->len);
+		if (!ent)
+			goto drop;
+		hlist_add_head(&ent->hlist,
+			       &cache->table[hash_32(ent->hash, cache->bits)]);
+		spin_lock(&sdcardfs_ci_lock);
+		cache->nr_names++;
+		sdcardfs_ci_nr_names++;
+		spin_unlock(&sdcardfs_ci_lock);
+	}
+
+	sdcardfs_ci_get_stamp(&cache->stamp, lower_dir);
+	return;
+
+drop:
+	sdcardfs_free_ci_cache(dir);
+}
+
+/*
+ * Look @name up in the name cache of @dir.  Returns 1 and copies the lower
+ * name into @buf on a match, 0 if the lower directory has no such name, or
+ * -EAGAIN if the lower directory has to be scanned.
+ */
+static int sdcardfs_ci_cache_lookup(struct inode *dir, struct inode *lower_dir,
+				    const struct qstr *name, char *buf)
+{
+	struct sdcardfs_ci_cache *cache = SDCARDFS_I(dir)->ci_cache;
+	struct sdcardfs_ci_name *ent;
+	unsigned int hash;
+
+	if (!cache)
+		return -EAGAIN;
+	if (!sdcardfs_ci_stamp_valid(&cache->stamp, lower_dir)) {
+		sdcardfs_free_ci_cache(dir);
+		return -EAGAIN;
+	}
+	cache->referenced = true;
+
+	hash = sdcardfs_ci_hash(name->name, name->len);
+	hlist_for_each_entry(ent, &cache->table[hash_32(hash, cache->bits)],
+			     hlist) {
+		if (ent->hash == hash && ent->len == name->len &&
+		    str_n_case_eq(ent->name, name->name, name->len)) {
+			memcpy(buf, ent->name, ent->len);
+			buf[ent->len] = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
 struct sdcardfs_name_data {
 	struct dir_context ctx;
 	const struct qstr *to_find;
 	char *name;
 	bool found;
+
+	/* all names seen, for the name cache */
+	struct hlist_head names;
+	unsigned int nr_names;
+	bool overflow;
 };
 
 static int sdcardfs_name_match(struct dir_context *ctx, const char *name,
@@ -232,14 +558,118 @@ static int sdcardfs_name_match(struct dir_context *ctx, const char *name,
 {
 	struct sdcardfs_name_data *buf = container_of(ctx, struct sdcardfs_name_data, ctx);
 	struct qstr candidate = QSTR_INIT(name, namelen);
+	struct sdcardfs_ci_name *ent;
 
-	if (qstr_case_eq(buf->to_find, &candidate)) {
+	if (!buf->found && qstr_case_eq(buf->to_find, &candidate)) {
 		memcpy(buf->name, name, namelen);
 		buf->name[namelen] = 0;
 		buf->found = true;
-		return 1;
 	}
+
+	/* keep reading only as long as the names can be cached */
+	if (buf->overflow)
+		return buf->found;
+	if (buf->nr_names >= SDCARDFS_CI_MAX_NAMES)
+		goto overflow;
+	ent = sdcardfs_ci_alloc_name(name, namelen);
+	if (!ent)
+		goto overflow;
+	hlist_add_head(&ent->hlist, &buf->names);
+	buf->nr_names++;
 	return 0;
+
+overflow:
+	buf->overflow = true;
+	sdcardfs_ci_free_names(&buf->names);
+	return buf->found;
+}
+
+static void sdcardfs_ci_cache_install(struct inode *dir,
+				      struct inode *lower_dir,
+				      struct sdcardfs_name_data *buf,
+				      const struct sdcardfs_ci_stamp *before)
+{
+	struct sdcardfs_ci_cache *cache;
+	struct sdcardfs_ci_name *ent;
+	struct hlist_node *tmp;
+	unsigned long total;
+	unsigned int bits;
+
+	/* the directory changed while it was read */
+	if (buf->overflow || !sdcardfs_ci_stamp_valid(before, lower_dir))
+		goto out_free;
+
+	sdcardfs_free_ci_cache(dir);
+	total = READ_ONCE(sdcardfs_ci_nr_names) + buf->nr_names;
+	if (total > SDCARDFS_CI_MAX_TOTAL)
+		sdcardfs_ci_prune(total - SDCARDFS_CI_MAX_TOTAL);
+
+	bits = buf->nr_names > 2 ? ilog2(buf->nr_names) : 1;
+	cache = kzalloc(sizeof(*cache) + (sizeof(struct hlist_head) << bits),
+			GFP_KERNEL | __GFP_NOWARN);
+	if (!cache)
+		goto out_free;
+
+	cache->stamp = *before;
+	cache->dir = dir;
+	cache->nr_names = buf->nr_names;
+	cache->bits = bits;
+	hlist_for_each_entry_safe(ent, tmp, &buf->names, hlist) {
+		hlist_del(&ent->hlist);
+		hlist_add_head(&ent->hlist,
+			       &cache->table[hash_32(ent->hash, bits)]);
+	}
+
+	spin_lock(&sdcardfs_ci_lock);
+	/* the other tables are all in use */
+	if (sdcardfs_ci_nr_names + cache->nr_names > SDCARDFS_CI_MAX_TOTAL) {
+		spin_unlock(&sdcardfs_ci_lock);
+		sdcardfs_ci_free(cache);
+		return;
+	}
+	list_add(&cache->lru, &sdcardfs_ci_lru);
+	sdcardfs_ci_nr_caches++;
+	sdcardfs_ci_nr_names += cache->nr_names;
+	SDCARDFS_I(dir)->ci_cache = cache;
+	spin_unlock(&sdcardfs_ci_lock);
+	return;
+
+out_free:
+	sdcardfs_ci_free_names(&buf->names);
+}
+
+/* Scan the lower directory for a case-insensitive match of buf->to_find */
+static int sdcardfs_ci_scan(struct inode *dir, struct path *lower_parent_path,
+			    struct sdcardfs_name_data *buf)
+{
+	struct inode *lower_dir = d_inode(lower_parent_path->dentry);
+	struct sdcardfs_ci_stamp before;
+	struct timespec now;
+	struct file *file;
+	int err;
+
+	atomic64_inc(&sdcardfs_lookup_stats.ci_scans);
+
+	/*
+	 * Another change within the same timestamp tick as the last one
+	 * would go unnoticed, so don't cache freshly modified directories.
+	 */
+	now = current_fs_time(lower_dir->i_sb);
+	sdcardfs_ci_get_stamp(&before, lower_dir);
+	if (timespec_equal(&before.mtime, &now))
+		buf->overflow = true;
+
+	file = dentry_open(lower_parent_path, O_RDONLY, current_cred());
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	err = iterate_dir(file, &buf->ctx);
+	fput(file);
+
+	if (err)
+		sdcardfs_ci_free_names(&buf->names);
+	else
+		sdcardfs_ci_cache_install(dir, lower_dir, buf, &before);
+	return err;
 }
 
 /*
@@ -248,8 +678,9 @@ static int sdcardfs_name_match(struct dir_context *ctx, const char *name,
  * Returns: NULL (ok), ERR_PTR if an error occurred.
  * Fills in lower_parent_path with <dentry,mnt> on success.
  */
-static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
-		unsigned int flags, struct path *lower_parent_path, userid_t id)
+static struct dentry *__sdcardfs_lookup(struct inode *dir,
+		struct dentry *dentry, unsigned int flags,
+		struct path *lower_parent_path, userid_t id)
 {
 	int err = 0;
 	struct vfsmount *lower_dir_mnt;
@@ -279,29 +710,28 @@ static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
 				&lower_path);
 	/* check for other cases */
 	if (err == -ENOENT) {
-		struct file *file;
-		const struct cred *cred = current_cred();
-
 		struct sdcardfs_name_data buffer = {
 			.ctx.actor = sdcardfs_name_match,
 			.to_find = name,
 			.name = __getname(),
 			.found = false,
+			.names = HLIST_HEAD_INIT,
 		};
 
 		if (!buffer.name) {
 			err = -ENOMEM;
 			goto out;
 		}
-		file = dentry_open(lower_parent_path, O_RDONLY, cred);
-		if (IS_ERR(file)) {
-			err = PTR_ERR(file);
-			goto put_name;
+		err = sdcardfs_ci_cache_lookup(dir, d_inode(lower_dir_dentry),
+					       name, buffer.name);
+		if (err >= 0) {
+			atomic64_inc(&sdcardfs_lookup_stats.ci_cache_hits);
+			buffer.found = err;
+		} else {
+			err = sdcardfs_ci_scan(dir, lower_parent_path, &buffer);
+			if (err)
+				goto put_name;
 		}
-		err = iterate_dir(file, &buffer.ctx);
-		fput(file);
-		if (err)
-			goto put_name;
 
 		if (buffer.found)
 			err = vfs_path_lookup(lower_dir_dentry,
@@ -417,6 +847,7 @@ struct dentry *sdcardfs_lookup(struct inode *dir, struct dentry *dentry,
 	struct path lower_parent_path;
 	int err = 0;
 	const struct cred *saved_cred = NULL;
+	u64 start = ktime_get_ns();
 
 	parent = dget_parent(dentry);
 
@@ -442,7 +873,7 @@ struct dentry *sdcardfs_lookup(struct inode *dir, struct dentry *dentry,
 		goto out;
 	}
 
-	ret = __sdcardfs_lookup(dentry, flags, &lower_parent_path,
+	ret = __sdcardfs_lookup(dir, dentry, flags, &lower_parent_path,
 				SDCARDFS_I(dir)->data->userid);
 	if (IS_ERR(ret))
 		goto out;
@@ -465,5 +896,7 @@ out:
 	revert_fsids(saved_cred);
 out_err:
 	dput(parent);
+	atomic64_inc(&sdcardfs_lookup_stats.lookups);
+	atomic64_add(ktime_get_ns() - start, &sdcardfs_lookup_stats.lookup_ns);
 	return ret;
 }
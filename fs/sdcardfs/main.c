@@ -472,6 +472,9 @@ static int __init init_sdcardfs_fs(void)
 	if (err)
 		goto out;
 	err = sdcardfs_init_dentry_cache();
+	if (err)
+		goto out;
+	err = sdcardfs_init_ci_cache();
 	if (err)
 		goto out;
 	err = packagelist_init();
@@ -482,6 +485,7 @@ out:
 	if (err) {
 		sdcardfs_destroy_inode_cache();
 		sdcardfs_destroy_dentry_cache();
+		sdcardfs_destroy_ci_cache();
 		packagelist_exit();
 	}
 	return err;
@@ -491,6 +495,7 @@ static void __exit exit_sdcardfs_fs(void)
 {
 	sdcardfs_destroy_inode_cache();
 	sdcardfs_destroy_dentry_cache();
+	sdcardfs_destroy_ci_cache();
 	packagelist_exit();
 	unregister_filesystem(&sdcardfs_fs_type);
 	pr_info("Completed sdcardfs module unload\n");
@@ -45,6 +45,24 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/*
+ * Bumped on every package list change, before the affected inodes are fixed
+ * up.  Memoized derived permissions are only trusted while it is unchanged;
+ * 0 is never used so that it can stand for "nothing memoized".
+ */
+static atomic_t pkgl_generation = ATOMIC_INIT(1);
+
+unsigned int pkgl_get_generation(void)
+{
+	return atomic_read(&pkgl_generation);
+}
+
+void pkgl_bump_generation(void)
+{
+	if (atomic_inc_return(&pkgl_generation) == 0)
+		atomic_inc(&pkgl_generation);
+}
+
 static unsigned int full_name_case_hash(const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash();
@@ -295,6 +313,7 @@ static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
+	pkgl_bump_generation();
 	if (!err)
 		fixup_all_perms_name(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
@@ -308,6 +327,7 @@ static int insert_ext_gid_entry(const struct qstr *key, appid_t value)
 
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_ext_gid_entry_locked(key, value);
+	pkgl_bump_generation();
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -319,6 +339,7 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
+	pkgl_bump_generation();
 	if (!err)
 		fixup_all_perms_name_userid(key, value);
 	mutex_unlock(&sdcardfs_super_list_lock);
@@ -361,6 +382,7 @@ static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_packagelist_entry_locked(key);
+	pkgl_bump_generation();
 	fixup_all_perms_name(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -384,6 +406,7 @@ static void remove_ext_gid_entry(const struct qstr *key, gid_t group)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_ext_gid_entry_locked(key, group);
+	pkgl_bump_generation();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -410,6 +433,7 @@ static void remove_userid_all_entry(userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_all_entry_locked(userid);
+	pkgl_bump_generation();
 	fixup_all_perms_userid(userid);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -434,6 +458,7 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_exclude_entry_locked(key, userid);
+	pkgl_bump_generation();
 	fixup_all_perms_name_userid(key, userid);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
@@ -801,9 +826,27 @@ static struct configfs_attribute packages_attr_packages_gid_list = {
 
 SDCARDFS_CONFIGFS_ATTR_WO(packages_, remove_userid);
 
+static ssize_t packages_lookup_stats_show(struct config_item *item,
+					  char *page)
+{
+	struct sdcardfs_lookup_stats *st = &sdcardfs_lookup_stats;
+
+	return scnprintf(page, PAGE_SIZE,
+			 "lookups %lld\nlookup_ns %lld\nci_scans %lld\n"
+			 "ci_cache_hits %lld\nperm_memo_hits %lld\n",
+			 (long long)atomic64_read(&st->lookups),
+			 (long long)atomic64_read(&st->lookup_ns),
+			 (long long)atomic64_read(&st->ci_scans),
+			 (long long)atomic64_read(&st->ci_cache_hits),
+			 (long long)atomic64_read(&st->perm_memo_hits));
+}
+
+SDCARDFS_CONFIGFS_ATTR_RO(packages_, lookup_stats);
+
 static struct configfs_attribute *packages_attrs[] = {
 	&packages_attr_packages_gid_list,
 	&packages_attr_remove_userid,
+	&packages_attr_lookup_stats,
 	NULL,
 };
 
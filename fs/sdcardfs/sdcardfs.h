@@ -150,6 +150,36 @@ extern struct inode *sdcardfs_iget(struct super_block *sb,
 				 struct inode *lower_inode, userid_t id);
 extern int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 			    struct path *lower_path, userid_t id);
+extern int sdcardfs_init_ci_cache(void);
+extern void sdcardfs_destroy_ci_cache(void);
+extern void sdcardfs_free_ci_cache(struct inode *dir);
+
+/* state of a lower directory, to tell whether its names changed */
+struct sdcardfs_ci_stamp {
+	struct timespec mtime;
+	struct timespec ctime;
+	u64 version;
+	loff_t size;
+};
+
+extern void sdcardfs_ci_get_stamp(struct sdcardfs_ci_stamp *stamp,
+				  struct inode *lower_dir);
+extern void sdcardfs_ci_cache_update(struct inode *dir,
+				     struct inode *lower_dir,
+				     const struct sdcardfs_ci_stamp *before,
+				     const struct qstr *removed,
+				     const struct qstr *added);
+
+/* exported through configfs as sdcardfs/lookup_stats */
+struct sdcardfs_lookup_stats {
+	atomic64_t lookups;
+	atomic64_t lookup_ns;		/* total time spent in ->lookup */
+	atomic64_t ci_scans;		/* lower directory scans */
+	atomic64_t ci_cache_hits;	/* scans avoided by the name cache */
+	atomic64_t perm_memo_hits;	/* derivations avoided by the memo */
+};
+
+extern struct sdcardfs_lookup_stats sdcardfs_lookup_stats;
 
 /* file private data */
 struct sdcardfs_file_info {
@@ -167,8 +197,20 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+
+	/*
+	 * Memoized results, valid while the package list generation is
+	 * memo_gen and the parent's data is memo_parent.
+	 */
+	unsigned int memo_gen;
+	struct sdcardfs_inode_data *memo_parent;
+	unsigned int owner_gen;		/* generation of owner_uid/gid */
+	uid_t owner_uid;
+	gid_t owner_gid;
 };
 
+struct sdcardfs_ci_cache;
+
 /* sdcardfs inode data in memory */
 struct sdcardfs_inode_info {
 	struct inode *lower_inode;
@@ -179,6 +221,9 @@ struct sdcardfs_inode_info {
 	spinlock_t top_lock;
 	struct sdcardfs_inode_data *top_data;
 
+	/* case-folded names of the lower directory, see lookup.c */
+	struct sdcardfs_ci_cache *ci_cache;
+
 	struct inode vfs_inode;
 };
 
@@ -493,6 +538,8 @@ extern appid_t is_excluded(const char *app_name, userid_t userid);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int packagelist_init(void);
 extern void packagelist_exit(void);
+extern unsigned int pkgl_get_generation(void);
+extern void pkgl_bump_generation(void);
 
 /* for derived_perm.c */
 #define BY_NAME		(1 << 0)
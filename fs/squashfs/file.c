@@ -47,6 +47,9 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/buffer_head.h>
+#include <linux/blkdev.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -502,6 +505,144 @@ out:
 }
 
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Readahead of datablocks.  All the datablocks covered by a readahead
+ * window have their I/O submitted together, then are decompressed in
+ * parallel on the unbound workqueue straight into the page cache (the
+ * first block, which the reader is most likely waiting on, is
+ * decompressed by the caller).  Pages of the tail-end fragment are left
+ * to squashfs_readpage.
+ */
+struct squashfs_readahead {
+	struct work_struct	work;
+	struct list_head	list;
+	struct inode		*inode;
+	u64			block;
+	int			bsize;
+	int			pages;
+	struct page		*page[0];
+};
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra =
+		container_of(work, struct squashfs_readahead, work);
+
+	squashfs_readahead_block(ra->inode, ra->block, ra->bsize, ra->pages,
+								ra->page);
+	kfree(ra);
+}
+
+/* Start reading the compressed datablock so all blocks share one plug */
+static void squashfs_readahead_data(struct super_block *sb, u64 block,
+	int bsize)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	u64 cur = block >> msblk->devblksize_log2;
+	u64 end = (block + SQUASHFS_COMPRESSED_SIZE_BLOCK(bsize) +
+			msblk->devblksize - 1) >> msblk->devblksize_log2;
+
+	for (; cur < end; cur++)
+		sb_breadahead(sb, cur);
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t end_page = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+							PAGE_CACHE_SHIFT;
+	gfp_t gfp = mapping_gfp_constraint(mapping, GFP_KERNEL);
+	struct squashfs_readahead *ra, *next, *first = NULL;
+	struct blk_plug plug;
+	LIST_HEAD(ra_list);
+
+	blk_start_plug(&plug);
+	while (!list_empty(pages)) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+		int index = page->index >> shift, i, n;
+		pgoff_t start_index = (pgoff_t)index << shift;
+		u64 block = 0;
+		int bsize;
+
+		if (page->index >= end_page || (index >= file_end &&
+				squashfs_i(inode)->fragment_block !=
+				SQUASHFS_INVALID_BLK))
+			break;
+
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize < 0)
+			break;
+
+		n = min_t(pgoff_t, 1 << shift, end_page - start_index);
+		ra = kzalloc(sizeof(*ra) + n * sizeof(struct page *),
+								GFP_KERNEL);
+		if (ra == NULL)
+			break;
+
+		INIT_WORK(&ra->work, squashfs_readahead_work);
+		ra->inode = inode;
+		ra->block = block;
+		ra->bsize = bsize;
+		ra->pages = n;
+
+		/* Take the readahead pages falling into this datablock */
+		while (!list_empty(pages)) {
+			page = list_entry(pages->prev, struct page, lru);
+			if (page->index >= start_index + n)
+				break;
+
+			list_del(&page->lru);
+			if (add_to_page_cache_lru(page, mapping, page->index,
+									gfp)) {
+				page_cache_release(page);
+				continue;
+			}
+			ra->page[page->index - start_index] = page;
+		}
+
+		/* And any other page of the block that isn't cached yet */
+		for (i = 0; i < n; i++) {
+			if (ra->page[i])
+				continue;
+
+			ra->page[i] = grab_cache_page_nowait(mapping,
+							start_index + i);
+			if (ra->page[i] && PageUptodate(ra->page[i])) {
+				unlock_page(ra->page[i]);
+				page_cache_release(ra->page[i]);
+				ra->page[i] = NULL;
+			}
+		}
+
+		if (bsize)
+			squashfs_readahead_data(inode->i_sb, block, bsize);
+
+		if (first == NULL)
+			first = ra;
+		else
+			list_add_tail(&ra->list, &ra_list);
+	}
+	blk_finish_plug(&plug);
+
+	list_for_each_entry_safe(ra, next, &ra_list, list)
+		queue_work(system_unbound_wq, &ra->work);
+
+	if (first)
+		squashfs_readahead_work(&first->work);
+
+	return 0;
+}
+#endif
+
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
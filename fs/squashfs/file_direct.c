@@ -20,8 +20,43 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page);
+
+/*
+ * Decompress a datablock straight into the locked page cache pages
+ * covering it.  All @pages pages must be present.
+ */
+static int squashfs_read_direct(struct inode *inode, u64 block, int bsize,
+	int pages, struct page **page)
+{
+	struct squashfs_page_actor *actor;
+	void *pageaddr;
+	int res, bytes;
+
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		return -ENOMEM;
+
+	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	kfree(actor);
+	if (res < 0)
+		return res;
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_CACHE_SIZE;
+	if (bytes) {
+		pageaddr = kmap_atomic(page[pages - 1]);
+		memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+	return res;
+}
 
 /* Read separately compressed datablock directly into page cache */
 int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
@@ -34,10 +69,8 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
 	int start_index = target_page->index & ~mask;
 	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
+	int i, n, pages, missing_pages, res = -ENOMEM;
 	struct page **page;
-	struct squashfs_page_actor *actor;
-	void *pageaddr;
 
 	if (end_index > file_end)
 		end_index = file_end;
@@ -48,14 +81,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	if (page == NULL)
 		return res;
 
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
 	/* Try to grab all the pages covered by the Squashfs block */
 	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
 		page[i] = (n == target_page->index) ? target_page :
@@ -82,8 +107,8 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-								page);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+							pages, page);
 		if (res < 0)
 			goto mark_errored;
 
@@ -91,18 +116,10 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	}
 
 	/* Decompress directly into the page cache buffers */
-	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	res = squashfs_read_direct(inode, block, bsize, pages, page);
 	if (res < 0)
 		goto mark_errored;
 
-	/* Last page may have trailing bytes not filled */
-	bytes = res % PAGE_CACHE_SIZE;
-	if (bytes) {
-		pageaddr = kmap_atomic(page[pages - 1]);
-		memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
-		kunmap_atomic(pageaddr);
-	}
-
 	/* Mark pages as uptodate, unlock and release */
 	for (i = 0; i < pages; i++) {
 		flush_dcache_page(page[i]);
@@ -112,7 +129,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 			page_cache_release(page[i]);
 	}
 
-	kfree(actor);
 	kfree(page);
 
 	return 0;
@@ -131,16 +147,14 @@ mark_errored:
 	}
 
 out:
-	kfree(actor);
 	kfree(page);
 	return res;
 }
 
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page)
 {
-	struct inode *i = target_page->mapping->host;
 	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
 						 block, bsize);
 	int bytes = buffer->length, res = buffer->error, n, offset = 0;
@@ -174,3 +188,61 @@ out:
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+
+/*
+ * Fill the pages of one datablock on behalf of readahead, then unlock and
+ * release all of them.  Slots in @page are NULL where the page is already
+ * cached or couldn't be grabbed, in which case the block goes through the
+ * intermediate buffer.  A zero @bsize is a sparse block.
+ */
+void squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	int pages, struct page **page)
+{
+	struct squashfs_cache_entry *buffer = NULL;
+	int i, missing_pages = 0, bytes = 0, res = 0;
+	void *pageaddr;
+
+	for (i = 0; i < pages; i++)
+		if (page[i] == NULL)
+			missing_pages++;
+
+	if (bsize && missing_pages) {
+		buffer = squashfs_get_datablock(inode->i_sb, block, bsize);
+		res = buffer->error;
+		bytes = buffer->length;
+	} else if (bsize)
+		res = squashfs_read_direct(inode, block, bsize, pages, page);
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+
+	for (i = 0; i < pages; i++, bytes -= PAGE_CACHE_SIZE) {
+		if (page[i] == NULL)
+			continue;
+
+		if (res < 0)
+			SetPageError(page[i]);
+		else {
+			if (buffer || bsize == 0) {
+				int avail = clamp_t(int, bytes, 0,
+							PAGE_CACHE_SIZE);
+
+				pageaddr = kmap_atomic(page[i]);
+				squashfs_copy_data(pageaddr, buffer,
+					i * PAGE_CACHE_SIZE, avail);
+				memset(pageaddr + avail, 0,
+					PAGE_CACHE_SIZE - avail);
+				kunmap_atomic(pageaddr);
+			}
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+
+	if (buffer)
+		squashfs_cache_put(buffer);
+}
@@ -130,6 +130,9 @@ struct blkcg_gq {
 	struct blkg_rwstat		stat_bytes;
 	struct blkg_rwstat		stat_ios;
 
+	/* bios issued and not yet completed, see blkcg_bio_issue_check() */
+	atomic_t			nr_inflight[2];
+
 	struct blkg_policy_data		*pd[BLKCG_MAX_POLS];
 
 	struct rcu_head			rcu_head;
@@ -367,6 +370,17 @@ static inline void blkg_get(struct blkcg_gq *blkg)
 	atomic_inc(&blkg->refcnt);
 }
 
+/**
+ * blkg_tryget - try to get a blkg reference
+ * @blkg: blkg to get
+ *
+ * For a blkg only protected by RCU, which may be on its way out.
+ */
+static inline bool blkg_tryget(struct blkcg_gq *blkg)
+{
+	return atomic_inc_not_zero(&blkg->refcnt);
+}
+
 void __blkg_release_rcu(struct rcu_head *rcu);
 
 /**
@@ -716,12 +730,33 @@ static inline bool blkcg_bio_issue_check(struct request_queue *q,
 		blkg_rwstat_add(&blkg->stat_bytes, bio->bi_rw,
 				bio->bi_iter.bi_size);
 		blkg_rwstat_add(&blkg->stat_ios, bio->bi_rw, 1);
+
+		/*
+		 * A bio remapped to another queue stays in flight in the
+		 * group of the first queue it was issued to.
+		 */
+		if (!bio->bi_blkg && blkg_tryget(blkg)) {
+			bio->bi_blkg = blkg;
+			atomic_inc(&blkg->nr_inflight[bio_data_dir(bio)]);
+		}
 	}
 
 	rcu_read_unlock();
 	return !throtl;
 }
 
+/* called from bio_endio(), in any context */
+static inline void blkcg_bio_complete(struct bio *bio)
+{
+	struct blkcg_gq *blkg = bio->bi_blkg;
+
+	if (blkg) {
+		atomic_dec(&blkg->nr_inflight[bio_data_dir(bio)]);
+		bio->bi_blkg = NULL;
+		blkg_put(blkg);
+	}
+}
+
 #else	/* CONFIG_BLK_CGROUP */
 
 struct blkcg {
@@ -777,6 +812,7 @@ static inline struct request_list *blk_rq_rl(struct request *rq) { return &rq->q
 
 static inline bool blkcg_bio_issue_check(struct request_queue *q,
 					 struct bio *bio) { return true; }
+static inline void blkcg_bio_complete(struct bio *bio) { }
 
 #define blk_queue_for_each_rl(rl, q)	\
 	for ((rl) = &(q)->root_rl; (rl); (rl) = NULL)
@@ -46,6 +46,9 @@ struct blk_mq_hw_ctx {
 	atomic_t		wait_index;
 
 	struct blk_mq_tags	*tags;
+	/* requests owned by the I/O scheduler, if one is attached */
+	struct blk_mq_tags	*sched_tags;
+	void			*sched_data;
 
 	unsigned long		queued;
 	unsigned long		run;
@@ -161,6 +164,7 @@ enum {
 
 	BLK_MQ_S_STOPPED	= 0,
 	BLK_MQ_S_TAG_ACTIVE	= 1,
+	BLK_MQ_S_SCHED_RESTART	= 2,
 
 	BLK_MQ_MAX_DEPTH	= 10240,
 
@@ -92,6 +92,13 @@ struct bio {
 	 */
 	struct io_context	*bi_ioc;
 	struct cgroup_subsys_state *bi_css;
+	/* group the bio is in flight in, from issue to completion */
+	struct blkcg_gq		*bi_blkg;
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	/* throttle group to report the completion to, and issue time */
+	struct blkcg_gq		*bi_throtl_blkg;
+	u64			bi_throtl_issue;
+#endif
 #endif
 	union {
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -35,6 +35,8 @@ struct sg_io_hdr;
 struct bsg_job;
 struct blkcg_gq;
 struct blk_flush_queue;
+struct blk_rq_stat;
+struct blk_poll_stat;
 struct pr_ops;
 
 #define BLKDEV_MIN_RQ	4
@@ -152,6 +154,8 @@ struct request {
 	struct gendisk *rq_disk;
 	struct hd_struct *part;
 	unsigned long start_time;
+	u64 issue_time_ns;			/* handed to the driver, or 0 */
+	unsigned int issue_bytes;		/* size when handed over */
 #ifdef CONFIG_BLK_CGROUP
 	struct request_list *rl;		/* rl this rq is alloced from */
 	unsigned long long start_time_ns;
@@ -170,6 +174,7 @@ struct request {
 	void *special;		/* opaque pointer available for LLD use */
 
 	int tag;
+	int internal_tag;	/* I/O scheduler tag on blk-mq, or -1 */
 	int errors;
 
 	/*
@@ -402,6 +407,12 @@ struct request_queue {
 
 	unsigned int		nr_sorted;
 	unsigned int		in_flight[2];
+
+	/* completion latency histograms, see blk-stat.c */
+	struct blk_rq_stat __percpu *stats;
+	struct blk_poll_stat	*poll_stat;
+	/* hybrid poll sleep: -1 never, 0 adaptive, else nsecs */
+	int			poll_nsec;
 	/*
 	 * Number of active block driver functions for which blk_drain_queue()
 	 * must wait. Must be incremented around functions that unlock the
@@ -704,6 +704,53 @@ struct device_dma_parameters {
 	unsigned long segment_boundary_mask;
 };
 
+/*
+ * Device link flags.
+ *
+ * STATELESS: The core does not track the presence of the supplier and
+ *	consumer drivers; the link lives until every device_link_add() of it
+ *	is undone with device_link_del() or device_link_remove(), or until
+ *	either device is unregistered.
+ * PM_SYNC: Do not switch the supplier and consumer to asynchronous system
+ *	suspend and resume when adding the link.
+ */
+#define DL_FLAG_STATELESS	BIT(0)
+#define DL_FLAG_PM_SYNC		BIT(1)
+
+/**
+ * struct device_link - Device link representation.
+ * @supplier: The device on the supplier end of the link.
+ * @s_node: Hook to the supplier device's list of links to consumers.
+ * @consumer: The device on the consumer end of the link.
+ * @c_node: Hook to the consumer device's list of links to suppliers.
+ * @flags: Link flags.
+ * @kref: Count of device_link_add() calls for this pair of devices.
+ * @rcu_head: An RCU head to use for deferred execution of SRCU callbacks.
+ *
+ * A link says that @consumer cannot work without @supplier: the supplier
+ * is suspended after and resumed before the consumer, independently of
+ * where either sits in the device hierarchy.
+ */
+struct device_link {
+	struct device *supplier;
+	struct list_head s_node;
+	struct device *consumer;
+	struct list_head c_node;
+	u32 flags;
+	struct kref kref;
+	struct rcu_head rcu_head;
+};
+
+/**
+ * struct dev_links_info - Device data related to device links.
+ * @suppliers: List of links to supplier devices.
+ * @consumers: List of links to consumer devices.
+ */
+struct dev_links_info {
+	struct list_head suppliers;
+	struct list_head consumers;
+};
+
 /**
  * struct device - The basic device structure
  * @parent:	The device's "parent" device, the device to which it is attached.
@@ -734,6 +781,7 @@ struct device_dma_parameters {
  * @pm_domain:	Provide callbacks that are executed during system suspend,
  * 		hibernation, system resume and during runtime PM transitions
  * 		along with subsystem-level and driver-level callbacks.
+ * @links:	Links to suppliers and consumers of this device.
  * @pins:	For device pin management.
  *		See Documentation/pinctrl.txt for details.
  * @msi_list:	Hosts MSI descriptors
@@ -797,6 +845,7 @@ struct device {
 					   dev_set/get_drvdata */
 	struct dev_pm_info	power;
 	struct dev_pm_domain	*pm_domain;
+	struct dev_links_info	links;
 
 #ifdef CONFIG_GENERIC_MSI_IRQ_DOMAIN
 	struct irq_domain	*msi_domain;
@@ -1013,6 +1062,11 @@ extern struct device *device_find_child(struct device *dev, void *data,
 extern int device_rename(struct device *dev, const char *new_name);
 extern int device_move(struct device *dev, struct device *new_parent,
 		       enum dpm_order dpm_order);
+extern struct device_link *device_link_add(struct device *consumer,
+					   struct device *supplier, u32 flags);
+extern void device_link_del(struct device_link *link);
+extern void device_link_remove(struct device *consumer,
+			       struct device *supplier);
 extern const char *device_get_devnode(struct device *dev,
 				      umode_t *mode, kuid_t *uid, kgid_t *gid,
 				      const char **tmp);
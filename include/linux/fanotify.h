@@ -4,5 +4,20 @@
 #include <uapi/linux/fanotify.h>
 
 /* not valid from userspace, only kernel internal */
-#define FAN_MARK_ONDIR		0x00000100
+#define FAN_MARK_ONDIR		0x80000000
+
+/* Events reported on the directory whose entries changed */
+#define FANOTIFY_DIRENT_EVENTS	(FAN_MOVE | FAN_CREATE | FAN_DELETE)
+
+/* Events that can only be reported to groups with FAN_REPORT_FID */
+#define FANOTIFY_INODE_EVENTS	(FANOTIFY_DIRENT_EVENTS | \
+				 FAN_ATTRIB | FAN_MOVE_SELF | FAN_DELETE_SELF)
+
+/* Events that user can request to be notified on */
+#define FANOTIFY_EVENTS		(FAN_ALL_EVENTS | FANOTIFY_INODE_EVENTS)
+
+/* Events that may be reported to user */
+#define FANOTIFY_OUTGOING_EVENTS	(FAN_ALL_OUTGOING_EVENTS | \
+					 FANOTIFY_INODE_EVENTS)
+
 #endif /* _LINUX_FANOTIFY_H */
@@ -135,12 +135,28 @@ static inline void fsnotify_vfsmount_delete(struct vfsmount *mnt)
  */
 static inline void fsnotify_nameremove(struct dentry *dentry, int isdir)
 {
-	__u32 mask = FS_DELETE;
+	struct dentry *parent;
+	struct name_snapshot name;
+	__u32 mask = (FS_EVENT_ON_CHILD | FS_DELETE);
 
 	if (isdir)
 		mask |= FS_ISDIR;
 
-	fsnotify_parent(NULL, dentry, mask);
+	/*
+	 * Super block marks want every removal on the filesystem, so this
+	 * can't be left to fsnotify_parent(), which only looks at parents
+	 * that watch their children.
+	 */
+	if (!(dentry->d_flags & DCACHE_FSNOTIFY_PARENT_WATCHED) &&
+	    !fsnotify_sb_watches(dentry->d_sb, FS_DELETE))
+		return;
+
+	parent = dget_parent(dentry);
+	take_dentry_name_snapshot(&name, dentry);
+	fsnotify(parent->d_inode, mask, dentry->d_inode, FSNOTIFY_EVENT_INODE,
+		 name.name, 0);
+	release_dentry_name_snapshot(&name);
+	dput(parent);
 }
 
 /*
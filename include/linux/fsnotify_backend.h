@@ -84,7 +84,9 @@ struct fsnotify_fname;
  * Each group much define these ops.  The fsnotify infrastructure will call
  * these operations for each relevant group.
  *
- * handle_event - main call for a group to handle an fs event
+ * handle_event - main call for a group to handle an fs event.  Gets the marks
+ *		of the group on the inode, the vfsmount and the super block the
+ *		event happened on; any of them may be NULL, not all of them.
  * free_group_priv - called when a group refcnt hits 0 to clean up the private union
  * freeing_mark - called when a mark is being destroyed for some reason.  The group
  * 		MUST be holding a reference on each mark and that reference must be
@@ -96,6 +98,7 @@ struct fsnotify_ops {
 			    struct inode *inode,
 			    struct fsnotify_mark *inode_mark,
 			    struct fsnotify_mark *vfsmount_mark,
+			    struct fsnotify_mark *sb_mark,
 			    u32 mask, void *data, int data_type,
 			    const unsigned char *file_name, u32 cookie);
 	void (*free_group_priv)(struct fsnotify_group *group);
@@ -181,7 +184,8 @@ struct fsnotify_group {
 			struct list_head access_list;
 			wait_queue_head_t access_waitq;
 #endif /* CONFIG_FANOTIFY_ACCESS_PERMISSIONS */
-			int f_flags;
+			unsigned int flags; /* flags from fanotify_init() */
+			int f_flags; /* event_f_flags from fanotify_init() */
 			unsigned int max_marks;
 			struct user_struct *user;
 		} fanotify_data;
@@ -205,8 +209,8 @@ struct fsnotify_group {
  * at inode eviction or modification.
  *
  * Text in brackets is showing the lock(s) protecting modifications of a
- * particular entry. obj_lock means either inode->i_lock or
- * mnt->mnt_root->d_lock depending on the mark type.
+ * particular entry. obj_lock means either inode->i_lock,
+ * mnt->mnt_root->d_lock or sb->s_fsnotify_lock depending on the mark type.
  */
 struct fsnotify_mark {
 	/* Mask this mark is for [mark->lock, group->mark_mutex] */
@@ -223,11 +227,12 @@ struct fsnotify_mark {
 	struct list_head g_list;
 	/* Protects inode / mnt pointers, flags, masks */
 	spinlock_t lock;
-	/* List of marks for inode / vfsmount [obj_lock] */
+	/* List of marks for inode / vfsmount / super block [obj_lock] */
 	struct hlist_node obj_list;
 	union {	/* Object pointer [mark->lock, group->mark_mutex] */
 		struct inode *inode;	/* inode this mark is associated with */
 		struct vfsmount *mnt;	/* vfsmount this mark is associated with */
+		struct super_block *sb;	/* super block this mark is associated with */
 	};
 	/* Events types to ignore [mark->lock, group->mark_mutex] */
 	__u32 ignored_mask;
@@ -237,6 +242,7 @@ struct fsnotify_mark {
 #define FSNOTIFY_MARK_FLAG_IGNORED_SURV_MODIFY	0x08
 #define FSNOTIFY_MARK_FLAG_ALIVE		0x10
 #define FSNOTIFY_MARK_FLAG_ATTACHED		0x20
+#define FSNOTIFY_MARK_FLAG_SB			0x40
 	unsigned int flags;		/* flags [mark->lock] */
 	void (*free_mark)(struct fsnotify_mark *mark); /* called on final put+free */
 };
@@ -251,6 +257,7 @@ extern int fsnotify(struct inode *to_tell, __u32 mask, void *data, int data_is,
 extern int __fsnotify_parent(struct path *path, struct dentry *dentry, __u32 mask);
 extern void __fsnotify_inode_delete(struct inode *inode);
 extern void __fsnotify_vfsmount_delete(struct vfsmount *mnt);
+extern void fsnotify_sb_delete(struct super_block *sb);
 extern u32 fsnotify_get_cookie(void);
 
 static inline int fsnotify_inode_watches_children(struct inode *inode)
@@ -263,6 +270,12 @@ static inline int fsnotify_inode_watches_children(struct inode *inode)
 	return inode->i_fsnotify_mask & FS_EVENTS_POSS_ON_CHILD;
 }
 
+/* does any mark on this super block care about one of these events? */
+static inline int fsnotify_sb_watches(struct super_block *sb, __u32 mask)
+{
+	return sb->s_fsnotify_mask & mask;
+}
+
 /*
  * Update the dentry with a flag indicating the interest of its parent to receive
  * filesystem events when those events happens to this dentry->d_inode.
@@ -335,11 +348,15 @@ extern struct fsnotify_event *fsnotify_remove_first_event(struct fsnotify_group
 extern void fsnotify_recalc_vfsmount_mask(struct vfsmount *mnt);
 /* run all marks associated with an inode and update inode->i_fsnotify_mask */
 extern void fsnotify_recalc_inode_mask(struct inode *inode);
+/* run all marks associated with a super block and update sb->s_fsnotify_mask */
+extern void fsnotify_recalc_sb_mask(struct super_block *sb);
 extern void fsnotify_init_mark(struct fsnotify_mark *mark, void (*free_mark)(struct fsnotify_mark *mark));
 /* find (and take a reference) to a mark associated with group and inode */
 extern struct fsnotify_mark *fsnotify_find_inode_mark(struct fsnotify_group *group, struct inode *inode);
 /* find (and take a reference) to a mark associated with group and vfsmount */
 extern struct fsnotify_mark *fsnotify_find_vfsmount_mark(struct fsnotify_group *group, struct vfsmount *mnt);
+/* find (and take a reference) to a mark associated with group and super block */
+extern struct fsnotify_mark *fsnotify_find_sb_mark(struct fsnotify_group *group, struct super_block *sb);
 /* copy the values from old into new */
 extern void fsnotify_duplicate_mark(struct fsnotify_mark *new, struct fsnotify_mark *old);
 /* set the ignored_mask of a mark */
@@ -351,6 +368,9 @@ extern int fsnotify_add_mark(struct fsnotify_mark *mark, struct fsnotify_group *
 			     struct inode *inode, struct vfsmount *mnt, int allow_dups);
 extern int fsnotify_add_mark_locked(struct fsnotify_mark *mark, struct fsnotify_group *group,
 				    struct inode *inode, struct vfsmount *mnt, int allow_dups);
+/* attach the mark to both the group and the super block */
+extern int fsnotify_add_sb_mark_locked(struct fsnotify_mark *mark, struct fsnotify_group *group,
+				       struct super_block *sb, int allow_dups);
 /* given a group and a mark, flag mark to be freed when all references are dropped */
 extern void fsnotify_destroy_mark(struct fsnotify_mark *mark,
 				  struct fsnotify_group *group);
@@ -362,6 +382,8 @@ extern void fsnotify_free_mark(struct fsnotify_mark *mark);
 extern void fsnotify_clear_vfsmount_marks_by_group(struct fsnotify_group *group);
 /* run all the marks in a group, and clear all of the inode marks */
 extern void fsnotify_clear_inode_marks_by_group(struct fsnotify_group *group);
+/* run all the marks in a group, and clear all of the super block marks */
+extern void fsnotify_clear_sb_marks_by_group(struct fsnotify_group *group);
 /* run all the marks in a group, and clear all of the marks where mark->flags & flags is true*/
 extern void fsnotify_clear_marks_by_group_flags(struct fsnotify_group *group, unsigned int flags);
 /* run all the marks in a group, and flag them to be freed */
@@ -393,6 +415,14 @@ static inline void __fsnotify_inode_delete(struct inode *inode)
 static inline void __fsnotify_vfsmount_delete(struct vfsmount *mnt)
 {}
 
+static inline void fsnotify_sb_delete(struct super_block *sb)
+{}
+
+static inline int fsnotify_sb_watches(struct super_block *sb, __u32 mask)
+{
+	return 0;
+}
+
 static inline void __fsnotify_update_dcache_flags(struct dentry *dentry)
 {}
 
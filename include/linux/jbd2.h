@@ -70,6 +70,10 @@ extern void *jbd2_alloc(size_t size, gfp_t flags);
 extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
+
+/* Journal recovery passes, also handed to the fast commit replay callback */
+enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
 
 #ifdef __KERNEL__
 
@@ -270,7 +274,12 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+	__u32	s_padding[41];
+/*
+ * 0x00F8: size of the inode fast commit area.  Deliberately not the slot
+ * upstream uses for its fast commit area, whose format differs.
+ */
+	__be32	s_inode_fc_blks;	/* Number of inode fast commit blocks */
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -278,6 +287,13 @@ typedef struct journal_superblock_s
 /* 0x0400 */
 } journal_superblock_t;
 
+static inline int jbd2_journal_get_num_fc_blks(journal_superblock_t *jsb)
+{
+	int num_fc_blocks = be32_to_cpu(jsb->s_inode_fc_blks);
+
+	return num_fc_blocks ? num_fc_blocks : JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+}
+
 /* Use the jbd2_{has,set,clear}_feature_* helpers; these will be removed */
 #define JBD2_HAS_COMPAT_FEATURE(j,mask)					\
 	((j)->j_format_version >= 2 &&					\
@@ -296,6 +312,12 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
 #define JBD2_FEATURE_INCOMPAT_CSUM_V3		0x00000010
+/*
+ * Inode-image fast commit area.  This is a local format, not upstream's
+ * FAST_COMMIT (0x20): it uses a bit from the top of the incompat space so
+ * that e2fsck and other kernels refuse the journal instead of misparsing it.
+ */
+#define JBD2_FEATURE_INCOMPAT_INODE_FC		0x80000000
 
 /* See "journal feature predicate functions" below */
 
@@ -306,7 +328,8 @@ typedef struct journal_superblock_s
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
 					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V3)
+					JBD2_FEATURE_INCOMPAT_CSUM_V3 | \
+					JBD2_FEATURE_INCOMPAT_INODE_FC)
 
 #ifdef __KERNEL__
 
@@ -1014,6 +1037,29 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Fast commit area: journal blocks [j_fc_first, j_fc_last) past
+	 * j_last, with j_fc_off blocks of it used by the running
+	 * transaction. [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_off;
+	unsigned long		j_fc_last;
+
+	/* Wait queue for fast and full commits to finish */
+	wait_queue_head_t	j_fc_wait;
+
+	/*
+	 * Called for each fast commit block during recovery, first for a
+	 * scan and then for the replay pass.  Returns 0 to go on with the
+	 * next block, a positive value to stop, or a negative error.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *journal,
+							struct buffer_head *bh,
+							enum passtype pass,
+							int off,
+							tid_t expected_tid);
+
 	/*
 	 * Journal statistics
 	 */
@@ -1099,6 +1145,7 @@ JBD2_FEATURE_INCOMPAT_FUNCS(64bit,		64BIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(async_commit,	ASYNC_COMMIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum2,		CSUM_V2)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum3,		CSUM_V3)
+JBD2_FEATURE_INCOMPAT_FUNCS(inode_fc,		INODE_FC)
 
 /*
  * Journal flag definitions
@@ -1113,12 +1160,20 @@ JBD2_FEATURE_INCOMPAT_FUNCS(csum3,		CSUM_V3)
 						 * data write error in ordered
 						 * mode */
 #define JBD2_REC_ERR	0x080	/* The errno in the sb has been recorded */
+#define JBD2_FAST_COMMIT_ONGOING	0x100	/* Fast commit is ongoing */
+#define JBD2_FULL_COMMIT_ONGOING	0x200	/* Full commit is ongoing */
 
 /*
  * Function declarations for the journaling transaction and buffer
  * management
  */
 
+/* Fast commits */
+extern int jbd2_fc_begin_commit(journal_t *journal, tid_t tid);
+extern void jbd2_fc_end_commit(journal_t *journal);
+extern void jbd2_fc_end_commit_fallback(journal_t *journal);
+extern int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out);
+
 /* Filing buffers */
 extern void jbd2_journal_unfile_buffer(journal_t *, struct journal_head *);
 extern void __jbd2_journal_refile_buffer(struct journal_head *);
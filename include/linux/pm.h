@@ -540,6 +540,22 @@ enum rpm_request {
 	RPM_REQ_RESUME,
 };
 
+/*
+ * Phases of a system sleep transition, in the order they are carried out.
+ * Used to index the per-device callback times kept for debugging.
+ */
+enum dpm_phase {
+	DPM_PHASE_PREPARE = 0,
+	DPM_PHASE_SUSPEND,
+	DPM_PHASE_SUSPEND_LATE,
+	DPM_PHASE_SUSPEND_NOIRQ,
+	DPM_PHASE_RESUME_NOIRQ,
+	DPM_PHASE_RESUME_EARLY,
+	DPM_PHASE_RESUME,
+	DPM_PHASE_COMPLETE,
+	DPM_PHASE_COUNT,
+};
+
 struct wakeup_source;
 struct wake_irq;
 struct pm_domain_data;
@@ -574,6 +590,9 @@ struct dev_pm_info {
 	bool			wakeup_path:1;
 	bool			syscore:1;
 	bool			no_pm_callbacks:1;	/* Owned by the PM core */
+#ifdef CONFIG_PM_SLEEP_DEBUG
+	u32			phase_time[DPM_PHASE_COUNT];	/* usecs */
+#endif
 #else
 	unsigned int		should_wakeup:1;
 #endif
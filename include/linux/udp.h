@@ -71,6 +71,11 @@ struct udp_sock {
 	 */
 	int (*encap_rcv)(struct sock *sk, struct sk_buff *skb);
 	void (*encap_destroy)(struct sock *sk);
+	/*
+	 * Input routes of recent peers of an unconnected socket, for
+	 * early demux.  Allocated on first use.
+	 */
+	struct udp_rx_flows *rx_flows;
 };
 
 static inline struct udp_sock *udp_sk(const struct sock *sk)
@@ -37,6 +37,9 @@ extern unsigned int sysctl_net_busy_poll __read_mostly;
 #define LL_FLUSH_FAILED		-1
 #define LL_FLUSH_BUSY		-2
 
+/* 0..NR_CPUS range is reserved for sender_cpu use, see napi_hash_add() */
+#define MIN_NAPI_ID ((unsigned int)(NR_CPUS + 1))
+
 static inline bool net_busy_loop_on(void)
 {
 	return sysctl_net_busy_poll;
@@ -47,11 +50,6 @@ static inline u64 busy_loop_us_clock(void)
 	return local_clock() >> 10;
 }
 
-static inline unsigned long sk_busy_loop_end_time(struct sock *sk)
-{
-	return busy_loop_us_clock() + ACCESS_ONCE(sk->sk_ll_usec);
-}
-
 /* in poll/select we use the global sysctl_net_ll_poll value */
 static inline unsigned long busy_loop_end_time(void)
 {
@@ -72,15 +70,19 @@ static inline bool busy_loop_timeout(unsigned long end_time)
 	return time_after(now, end_time);
 }
 
-/* when used in sock_poll() nonblock is known at compile time to be true
- * so the loop and end_time will be optimized out
+/*
+ * Busy poll the NAPI context @napi_id until @loop_end returns true or the
+ * task has to reschedule.  With a NULL @loop_end it is polled only once.
+ * @loop_end is passed @loop_end_arg and the time the loop started.
  */
-static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+static inline void napi_busy_loop(unsigned int napi_id,
+				  bool (*loop_end)(void *, unsigned long),
+				  void *loop_end_arg)
 {
-	unsigned long end_time = !nonblock ? sk_busy_loop_end_time(sk) : 0;
+	unsigned long start_time = loop_end ? busy_loop_us_clock() : 0;
 	const struct net_device_ops *ops;
 	struct napi_struct *napi;
-	int rc = false;
+	int rc;
 
 	/*
 	 * rcu read lock for napi hash
@@ -88,7 +90,7 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 	 */
 	rcu_read_lock_bh();
 
-	napi = napi_by_id(sk->sk_napi_id);
+	napi = napi_by_id(napi_id);
 	if (!napi)
 		goto out;
 
@@ -104,17 +106,32 @@ static inline bool sk_busy_loop(struct sock *sk, int nonblock)
 
 		if (rc > 0)
 			/* local bh are disabled so it is ok to use _BH */
-			NET_ADD_STATS_BH(sock_net(sk),
+			NET_ADD_STATS_BH(dev_net(napi->dev),
 					 LINUX_MIB_BUSYPOLLRXPACKETS, rc);
 		cpu_relax();
 
-	} while (!nonblock && skb_queue_empty(&sk->sk_receive_queue) &&
-		 !need_resched() && !busy_loop_timeout(end_time));
-
-	rc = !skb_queue_empty(&sk->sk_receive_queue);
+	} while (loop_end && !loop_end(loop_end_arg, start_time) &&
+		 !need_resched());
 out:
 	rcu_read_unlock_bh();
-	return rc;
+}
+
+static inline bool sk_busy_loop_end(void *p, unsigned long start_time)
+{
+	struct sock *sk = p;
+
+	return !skb_queue_empty(&sk->sk_receive_queue) ||
+	       busy_loop_timeout(start_time + ACCESS_ONCE(sk->sk_ll_usec));
+}
+
+/* when used in sock_poll() nonblock is known at compile time to be true
+ * so the loop will be optimized out
+ */
+static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	napi_busy_loop(sk->sk_napi_id, nonblock ? NULL : sk_busy_loop_end, sk);
+
+	return !skb_queue_empty(&sk->sk_receive_queue);
 }
 
 /* used in the NIC receive handler to mark the skb */
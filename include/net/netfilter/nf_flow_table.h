@@ -0,0 +1,78 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/in.h>
+#include <linux/netdevice.h>
+#include <linux/rhashtable.h>
+#include <linux/rcupdate.h>
+#include <linux/netfilter.h>
+#include <net/dst.h>
+
+struct nf_conn;
+
+enum flow_offload_tuple_dir {
+	FLOW_OFFLOAD_DIR_ORIGINAL,
+	FLOW_OFFLOAD_DIR_REPLY,
+	FLOW_OFFLOAD_DIR_MAX,
+};
+
+struct flow_offload_tuple {
+	__be32				src_v4;
+	__be32				dst_v4;
+	__be16				src_port;
+	__be16				dst_port;
+	int				iifidx;
+	u8				l4proto;
+
+	/* All members above are keys for lookups, see flow_offload_hash(). */
+	struct { }			__hash;
+
+	u8				dir;
+	u16				mtu;
+	struct dst_entry		*dst_cache;
+};
+
+struct flow_offload_tuple_rhash {
+	struct rhash_head		node;
+	struct flow_offload_tuple	tuple;
+};
+
+#define FLOW_OFFLOAD_SNAT	0x1
+#define FLOW_OFFLOAD_DNAT	0x2
+#define FLOW_OFFLOAD_TEARDOWN	0x4
+
+struct flow_offload_counter {
+	atomic_long_t			packets;
+	atomic_long_t			bytes;
+};
+
+struct flow_offload {
+	struct flow_offload_tuple_rhash	tuplehash[FLOW_OFFLOAD_DIR_MAX];
+	struct nf_conn			*ct;
+	u32				flags;
+	/* jiffies at which an idle flow goes back to the slow path */
+	unsigned long			timeout;
+	/* conntrack timeout to restart whenever the flow saw traffic */
+	unsigned long			ct_timeout;
+	/* traffic not yet accounted to conntrack */
+	struct flow_offload_counter	counter[FLOW_OFFLOAD_DIR_MAX];
+	struct rcu_head			rcu_head;
+};
+
+#define NF_FLOW_TIMEOUT (30 * HZ)
+
+struct flow_offload *flow_offload_alloc(struct nf_conn *ct,
+					struct dst_entry *dst[FLOW_OFFLOAD_DIR_MAX]);
+void flow_offload_free(struct flow_offload *flow);
+
+int flow_offload_add(struct flow_offload *flow);
+void flow_offload_teardown(struct flow_offload *flow);
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(const struct flow_offload_tuple *tuple);
+
+int nf_flow_table_hook_dev(struct net_device *dev);
+
+unsigned int nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
+				     const struct nf_hook_state *state);
+
+#endif /* _NF_FLOW_TABLE_H */
@@ -161,6 +161,7 @@ void udp_set_csum(bool nocheck, struct sk_buff *skb,
 struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 				 struct udphdr *uh);
 int udp_gro_complete(struct sk_buff *skb, int nhoff);
+int udp_gro_complete_list(struct sk_buff *skb, int nhoff);
 
 static inline struct udphdr *udp_gro_udphdr(struct sk_buff *skb)
 {
@@ -176,6 +177,30 @@ static inline struct udphdr *udp_gro_udphdr(struct sk_buff *skb)
 	return uh;
 }
 
+/*
+ * A fraglist GRO packet that lands on a local socket rather than being
+ * forwarded is split back into the datagrams it was built from, each with
+ * its data at the UDP header again.  Returns NULL, with @skb freed, if
+ * that fails.
+ */
+static inline struct sk_buff *udp_rcv_segment(struct sk_buff *skb)
+{
+	struct sk_buff *segs, *seg;
+
+	__skb_push(skb, skb->data - skb_mac_header(skb));
+	segs = __skb_gso_segment(skb, NETIF_F_SG, false);
+	if (IS_ERR_OR_NULL(segs)) {
+		kfree_skb(skb);
+		return NULL;
+	}
+	consume_skb(skb);
+
+	for (seg = segs; seg; seg = seg->next)
+		__skb_pull(seg, skb_transport_offset(seg));
+
+	return segs;
+}
+
 /* hash routines shared between UDPv4/6 and UDP-Litev4/6 */
 static inline void udp_lib_hash(struct sock *sk)
 {
@@ -233,7 +258,10 @@ static inline __be16 udp_flow_src_port(struct net *net, struct sk_buff *skb,
 }
 
 /* net/ipv4/udp.c */
+extern int sysctl_udp_early_demux_unconnected;
+
 void udp_v4_early_demux(struct sk_buff *skb);
+int udp_init_sock(struct sock *sk);
 int udp_get_port(struct sock *sk, unsigned short snum,
 		 int (*saddr_cmp)(const struct sock *,
 				  const struct sock *));
@@ -192,6 +192,37 @@ TRACE_EVENT(sched_set_preferred_cluster,
 			__entry->cluster_first_cpu)
 );
 
+TRACE_EVENT(sched_group_update,
+
+	TP_PROTO(struct task_struct *p, struct related_thread_group *grp,
+		 int event),
+
+	TP_ARGS(p, grp, event),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	int,	id			)
+		__field(	int,	event			)
+		__field(unsigned int,	demand			)
+		__field(unsigned int,	pred_demand		)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->id		= grp->id;
+		__entry->event		= event;
+		__entry->demand		= p->ravg.demand;
+		__entry->pred_demand	= p->ravg.pred_demand;
+	),
+
+	TP_printk("%d (%s): group_id %d %s demand %u pred_demand %u",
+		__entry->pid, __entry->comm, __entry->id,
+		__entry->event ? "remove" : "add",
+		__entry->demand, __entry->pred_demand)
+);
+
 DECLARE_EVENT_CLASS(sched_cpu_load,
 
 	TP_PROTO(struct rq *rq, int idle, u64 irqload, unsigned int power_cost, int temp),
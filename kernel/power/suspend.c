@@ -399,6 +399,7 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 	enable_nonboot_cpus();
 
  Platform_wake:
+	suspend_test_start();
 	platform_resume_noirq(state);
 	dpm_resume_noirq(PMSG_RESUME);
 
@@ -407,6 +408,7 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 
  Devices_early_resume:
 	dpm_resume_early(PMSG_RESUME);
+	suspend_test_finish("resume noirq/early devices");
 
  Platform_finish:
 	platform_resume_finish(state);
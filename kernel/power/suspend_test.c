@@ -7,6 +7,7 @@
  */
 
 #include <linux/init.h>
+#include <linux/ktime.h>
 #include <linux/rtc.h>
 
 #include "power.h"
@@ -21,27 +22,34 @@
  */
 #define TEST_SUSPEND_SECONDS	10
 
-static unsigned long suspend_test_start_time;
+static ktime_t suspend_test_start_time;
 static u32 test_repeat_count_max = 1;
 static u32 test_repeat_count_current;
 
 void suspend_test_start(void)
 {
-	/* FIXME Use better timebase than "jiffies", ideally a clocksource.
-	 * What we want is a hardware counter that will work correctly even
-	 * during the irqs-are-off stages of the suspend/resume cycle...
+	/*
+	 * Device resume is down to tens of milliseconds with asynchronous
+	 * resume, so use ktime rather than jiffies.  Timekeeping is running
+	 * again in every place this is called from.
 	 */
-	suspend_test_start_time = jiffies;
+	suspend_test_start_time = ktime_get();
 }
 
 void suspend_test_finish(const char *label)
 {
-	long nj = jiffies - suspend_test_start_time;
 	unsigned msec;
+	s64 usecs;
 
-	msec = jiffies_to_msecs(abs(nj));
-	pr_info("PM: %s took %d.%03d seconds\n", label,
-			msec / 1000, msec % 1000);
+	/* Nothing to report if the measured section was skipped. */
+	if (!ktime_to_ns(suspend_test_start_time))
+		return;
+
+	usecs = ktime_us_delta(ktime_get(), suspend_test_start_time);
+	suspend_test_start_time = ktime_set(0, 0);
+	msec = div_s64(usecs, USEC_PER_MSEC);
+	pr_info("PM: %s took %d.%03d seconds (%lld usecs)\n", label,
+			msec / 1000, msec % 1000, usecs);
 
 	/* Warning on suspend means the RTC alarm period needs to be
 	 * larger -- the system was sooo slooowwww to suspend that the
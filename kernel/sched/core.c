@@ -1965,15 +1965,16 @@ void scheduler_ipi(void)
 	preempt_fold_need_resched();
 
 	if (llist_empty(&this_rq()->wake_list) && !got_nohz_idle_kick() &&
-							!got_boost_kick())
+				!got_boost_kick() && !got_misfit_kick())
 		return;
 
-	if (got_boost_kick()) {
+	if (got_boost_kick() || got_misfit_kick()) {
 		struct rq *rq = cpu_rq(cpu);
 
 		if (rq->curr->sched_class == &fair_sched_class)
 			check_for_migration(rq, rq->curr);
 		clear_boost_kick(cpu);
+		clear_misfit_kick(cpu);
 	}
 
 	/*
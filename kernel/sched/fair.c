@@ -3675,7 +3675,7 @@ static inline int migration_needed(struct task_struct *p, int cpu)
 		return DOWN_MIGRATION;
 	}
 
-	if (!task_will_fit(p, cpu)) {
+	if (task_misfit(p, cpu)) {
 		rcu_read_unlock();
 		return UP_MIGRATION;
 	}
@@ -3741,9 +3741,12 @@ void check_for_migration(struct rq *rq, struct task_struct *p)
 
 	raw_spin_unlock(&migration_lock);
 
-	if (active_balance)
+	if (active_balance) {
+		if (reason == UP_MIGRATION)
+			schedstat_inc(rq, upmigrate_count);
 		stop_one_cpu_nowait(cpu, active_load_balance_cpu_stop, rq,
 					&rq->active_balance_work);
+	}
 }
 
 #ifdef CONFIG_CFS_BANDWIDTH
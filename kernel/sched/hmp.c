@@ -1130,6 +1130,22 @@ int task_will_fit(struct task_struct *p, int cpu)
 	return task_load_will_fit(p, tload, cpu, sched_boost_policy());
 }
 
+/*
+ * Does the task need a cpu of higher capacity than @cpu? Its demand only
+ * catches up with a change in its behaviour once a window has rolled
+ * over, while its predicted demand already reflects the busy time of the
+ * current window, so a task that suddenly turns heavy shows up here within
+ * the window it did so.
+ */
+int task_misfit(struct task_struct *p, int cpu)
+{
+	u64 tload = max(task_load(p), p->ravg.pred_demand);
+
+	tload = scale_load_to_cpu(tload, cpu);
+
+	return !task_load_will_fit(p, tload, cpu, sched_boost_policy());
+}
+
 static int
 group_will_fit(struct sched_cluster *cluster, struct related_thread_group *grp,
 						u64 demand, bool group_boost)
@@ -2850,6 +2866,31 @@ update_task_burst(struct task_struct *p, struct rq *rq, int event, u64 runtime)
 		p->ravg.curr_burst += runtime;
 }
 
+/*
+ * Running task on a lower capacity cpu no longer fits: kick the cpu to
+ * look for an idle higher capacity one right away, instead of leaving it
+ * to the next tick. Kick at most once per window per cpu; if no idle cpu
+ * is found, check_for_migration() keeps trying from the tick.
+ */
+static void check_misfit_task(struct rq *rq, struct task_struct *p, int event)
+{
+	int cpu = cpu_of(rq);
+
+	if (p != rq->curr || event == PUT_PREV_TASK ||
+	    p->sched_class != &fair_sched_class || p->nr_cpus_allowed == 1 ||
+	    cpu_capacity(cpu) == max_capacity)
+		return;
+
+	if (rq->misfit_kick_window == rq->window_start || !task_misfit(p, cpu))
+		return;
+
+	rq->misfit_kick_window = rq->window_start;
+	if (!test_and_set_bit(MISFIT_KICK, &rq->hmp_flags)) {
+		schedstat_inc(rq, misfit_kick_count);
+		smp_send_reschedule(cpu);
+	}
+}
+
 /* Reflect task activity on its demand and cpu's busy time statistics */
 void update_task_ravg(struct task_struct *p, struct rq *rq, int event,
 						u64 wallclock, u64 irqtime)
@@ -2879,6 +2920,8 @@ void update_task_ravg(struct task_struct *p, struct rq *rq, int event,
 	if (exiting_task(p))
 		goto done;
 
+	check_misfit_task(rq, p, event);
+
 	trace_sched_update_task_ravg(p, rq, event, wallclock, irqtime,
 				     rq->cc.cycles, rq->cc.time,
 				     p->grp ? &rq->grp_time : NULL);
@@ -3706,6 +3749,21 @@ static struct sched_cluster *best_cluster(struct related_thread_group *grp,
 	return sched_cluster[0];
 }
 
+/*
+ * The stages of a frame pipeline (input, render, composition) each run for
+ * a slice of every frame and hand the frame on to the next stage. Taken
+ * one at a time their demand is small, and it is the sum that has to fit
+ * on a cluster for the frame to complete in time. A task's demand follows
+ * its history, which lags a frame that suddenly needs more work; its
+ * predicted demand already accounts for the busy time of the current
+ * window, so use whichever is larger and let the group move up a cluster
+ * within the frame whose work grew rather than several windows later.
+ */
+static inline u32 group_task_demand(struct task_struct *p)
+{
+	return max(p->ravg.demand, p->ravg.pred_demand);
+}
+
 static void _set_preferred_cluster(struct related_thread_group *grp)
 {
 	struct task_struct *p;
@@ -3738,8 +3796,7 @@ static void _set_preferred_cluster(struct related_thread_group *grp)
 		    (sched_ravg_window * sched_ravg_hist_size))
 			continue;
 
-		combined_demand += p->ravg.demand;
-
+		combined_demand += group_task_demand(p);
 	}
 
 	grp->preferred_cluster = best_cluster(grp,
@@ -3930,6 +3987,8 @@ static void remove_task_from_group(struct task_struct *p)
 	rcu_assign_pointer(p->grp, NULL);
 	__task_rq_unlock(rq);
 
+	trace_sched_group_update(p, grp, REM_TASK);
+
 	if (!list_empty(&grp->tasks)) {
 		empty_group = 0;
 		_set_preferred_cluster(grp);
@@ -3963,6 +4022,8 @@ add_task_to_group(struct task_struct *p, struct related_thread_group *grp)
 	rcu_assign_pointer(p->grp, grp);
 	__task_rq_unlock(rq);
 
+	trace_sched_group_update(p, grp, ADD_TASK);
+
 	_set_preferred_cluster(grp);
 
 	raw_spin_unlock(&grp->lock);
@@ -4012,6 +4073,7 @@ void add_new_task_to_grp(struct task_struct *new)
 	list_add(&new->grp_list, &grp->tasks);
 
 	raw_spin_unlock(&grp->lock);
+	trace_sched_group_update(new, grp, ADD_TASK);
 	write_unlock_irqrestore(&related_thread_group_lock, flags);
 }
 
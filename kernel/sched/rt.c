@@ -1881,89 +1881,128 @@ static DEFINE_PER_CPU(cpumask_var_t, local_cpu_mask);
 
 #ifdef CONFIG_SCHED_HMP
 
-static int find_lowest_rq_hmp(struct task_struct *task)
+/*
+ * How long a task woken on @cpu waits for it to come out of idle: the exit
+ * latency of the cpu's C-state and, while its whole cluster is power
+ * collapsed, that of the cluster. A running cpu is preempted right away.
+ */
+static inline int cpu_idle_exit_latency(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	int latency;
+
+	if (!idle_cpu(cpu))
+		return 0;
+
+	latency = rq->wakeup_latency;
+	if (rq->cluster->dstate)
+		latency += rq->cluster->dstate_wakeup_latency;
+
+	return latency;
+}
+
+enum {
+	RT_CPU_SHALLOW_IDLE,	/* runs the task at once, preempting nobody */
+	RT_CPU_BUSY,		/* preempts lower priority work */
+	RT_CPU_DEEP_IDLE,	/* has to come out of a deep C/D-state first */
+};
+
+/*
+ * An idle cpu in its first C-state (WFI), or in any state no slower to
+ * leave, is the best place for an RT task. Deeper idle states rank below
+ * preempting a busy cpu.
+ */
+static inline int cpu_rt_rank(int cpu, int latency)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	if (!idle_cpu(cpu))
+		return RT_CPU_BUSY;
+
+	if (!latency || (rq->cstate <= 1 && !rq->cluster->dstate))
+		return RT_CPU_SHALLOW_IDLE;
+
+	return RT_CPU_DEEP_IDLE;
+}
+
+/*
+ * Elect among the lowest priority cpus: skip cpus drowning in irq work or
+ * stuck in a long softirq, and cpus too small for the task, then prefer
+ * shallow idle cpus over busy ones over deeply idle ones (cpu_rt_rank()),
+ * then the shortest idle exit latency, then the least loaded cpu counting
+ * its irqload, and finally the previous cpu or one sharing its cache.
+ * Clusters are walked from the lowest capacity up, so the smallest cluster
+ * the task fits on wins ties. Returns -1 if no cpu passed the filters,
+ * leaving the choice to plain cpupri.
+ */
+static int find_lowest_rq_hmp(struct task_struct *task,
+			      struct cpumask *lowest_mask)
 {
-	struct cpumask *lowest_mask = *this_cpu_ptr(&local_cpu_mask);
-	struct cpumask candidate_mask = CPU_MASK_NONE;
+	struct cpumask search_mask, candidate_mask = CPU_MASK_NONE;
 	struct sched_cluster *cluster;
 	int best_cpu = -1;
 	int prev_cpu = task_cpu(task);
 	u64 cpu_load, min_load = ULLONG_MAX;
+	int latency, min_latency = INT_MAX;
+	int rank, best_rank = INT_MAX;
 	int i;
 	int restrict_cluster;
 	int boost_on_big;
-	int pack_task, wakeup_latency, least_wakeup_latency = INT_MAX;
+	int check_fit = 1;
 
 	boost_on_big = sched_boost() == FULL_THROTTLE_BOOST &&
 			sched_boost_policy() == SCHED_BOOST_ON_BIG;
 
 	restrict_cluster = sysctl_sched_restrict_cluster_spill;
 
-	/* Make sure the mask is initialized first */
-	if (unlikely(!lowest_mask))
-		return best_cpu;
-
-	if (task->nr_cpus_allowed == 1)
-		return best_cpu; /* No other targets possible */
-
-	if (!cpupri_find(&task_rq(task)->rd->cpupri, task, lowest_mask))
-		return best_cpu; /* No targets found */
-
-	pack_task = is_short_burst_task(task);
-
-	/*
-	 * At this point we have built a mask of cpus representing the
-	 * lowest priority tasks in the system.  Now we want to elect
-	 * the best one based on our affinity and topology.
-	 */
+	cpumask_andnot(&search_mask, lowest_mask, cpu_isolated_mask);
 
+	rcu_read_lock();
 retry:
 	for_each_sched_cluster(cluster) {
 		if (boost_on_big && cluster->capacity != max_possible_capacity)
 			continue;
 
-		cpumask_and(&candidate_mask, &cluster->cpus, lowest_mask);
-		cpumask_andnot(&candidate_mask, &candidate_mask,
-			       cpu_isolated_mask);
+		cpumask_and(&candidate_mask, &cluster->cpus, &search_mask);
 		/*
 		 * When placement boost is active, if there is no eligible CPU
 		 * in the highest capacity cluster, we fallback to the other
 		 * clusters. So clear the CPUs of the traversed cluster from
-		 * the lowest_mask.
+		 * the search_mask.
 		 */
 		if (unlikely(boost_on_big))
-			cpumask_andnot(lowest_mask, lowest_mask,
+			cpumask_andnot(&search_mask, &search_mask,
 				       &cluster->cpus);
 
 		if (cpumask_empty(&candidate_mask))
 			continue;
 
 		for_each_cpu(i, &candidate_mask) {
-			if (sched_cpu_high_irqload(i))
+			if (sched_cpu_high_irqload(i) ||
+			    task_may_not_preempt(READ_ONCE(cpu_rq(i)->curr), i))
 				continue;
 
-			cpu_load = cpu_rq(i)->hmp_stats.cumulative_runnable_avg;
-			if (!restrict_cluster)
-				cpu_load = scale_load_to_cpu(cpu_load, i);
-
-			if (pack_task) {
-				wakeup_latency = cpu_rq(i)->wakeup_latency;
+			if (check_fit && !task_will_fit(task, i))
+				continue;
 
-				if (wakeup_latency > least_wakeup_latency)
-					continue;
+			latency = cpu_idle_exit_latency(i);
+			rank = cpu_rt_rank(i, latency);
+			if (rank > best_rank ||
+			    (rank == best_rank && latency > min_latency))
+				continue;
 
-				if (wakeup_latency < least_wakeup_latency) {
-					least_wakeup_latency = wakeup_latency;
-					min_load = cpu_load;
-					best_cpu = i;
-					continue;
-				}
-			}
+			cpu_load = cpu_rq(i)->hmp_stats.cumulative_runnable_avg +
+				   sched_irqload(i);
+			if (!restrict_cluster)
+				cpu_load = scale_load_to_cpu(cpu_load, i);
 
-			if (cpu_load < min_load ||
+			if (rank < best_rank || latency < min_latency ||
+				cpu_load < min_load ||
 				(cpu_load == min_load &&
 				(i == prev_cpu || (best_cpu != prev_cpu &&
 				cpus_share_cache(prev_cpu, i))))) {
+				best_rank = rank;
+				min_latency = latency;
 				min_load = cpu_load;
 				best_cpu = i;
 			}
@@ -1978,6 +2017,14 @@ retry:
 		goto retry;
 	}
 
+	/* Nothing big enough: settle for the best of the smaller cpus */
+	if (check_fit && best_cpu == -1) {
+		check_fit = 0;
+		cpumask_andnot(&search_mask, lowest_mask, cpu_isolated_mask);
+		goto retry;
+	}
+	rcu_read_unlock();
+
 	return best_cpu;
 }
 #endif	/* CONFIG_SCHED_HMP */
@@ -1989,10 +2036,6 @@ static int find_lowest_rq(struct task_struct *task)
 	int this_cpu = smp_processor_id();
 	int cpu      = task_cpu(task);
 
-#ifdef CONFIG_SCHED_HMP
-	return find_lowest_rq_hmp(task);
-#endif
-
 	/* Make sure the mask is initialized first */
 	if (unlikely(!lowest_mask))
 		return -1;
@@ -2003,6 +2046,24 @@ static int find_lowest_rq(struct task_struct *task)
 	if (!cpupri_find(&task_rq(task)->rd->cpupri, task, lowest_mask))
 		return -1; /* No targets found */
 
+#ifdef CONFIG_SCHED_HMP
+	{
+		int best_cpu = find_lowest_rq_hmp(task, lowest_mask);
+
+		if (best_cpu != -1)
+			return best_cpu;
+
+		/*
+		 * Every candidate is busy with irqs or softirqs; don't let
+		 * that strand the task, pick by cpupri alone among the cpus
+		 * that are not isolated.
+		 */
+		cpumask_andnot(lowest_mask, lowest_mask, cpu_isolated_mask);
+		if (cpumask_empty(lowest_mask))
+			return -1;
+	}
+#endif
+
 	/*
 	 * At this point we have built a mask of cpus representing the
 	 * lowest priority tasks in the system.  Now we want to elect
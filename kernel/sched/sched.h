@@ -795,6 +795,8 @@ struct rq {
 	u64 window_start;
 	u64 load_reported_window;
 	unsigned long hmp_flags;
+	/* window in which the running task was last found to be a misfit */
+	u64 misfit_kick_window;
 
 	u64 cur_irqload;
 	u64 avg_irqload;
@@ -872,6 +874,11 @@ struct rq {
 #ifdef CONFIG_SMP
 	struct eas_stats eas_stats;
 #endif
+#ifdef CONFIG_SCHED_HMP
+	/* misfit task stats */
+	unsigned int misfit_kick_count;
+	unsigned int upmigrate_count;
+#endif
 #endif
 
 #ifdef CONFIG_SMP
@@ -1417,6 +1424,21 @@ static inline int same_freq_domain(int src_cpu, int dst_cpu)
 
 #define	BOOST_KICK	0
 #define	CPU_RESERVED	1
+#define	MISFIT_KICK	2
+
+static inline int got_misfit_kick(void)
+{
+	struct rq *rq = this_rq();
+
+	return test_bit(MISFIT_KICK, &rq->hmp_flags);
+}
+
+static inline void clear_misfit_kick(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	clear_bit(MISFIT_KICK, &rq->hmp_flags);
+}
 
 static inline int is_reserved(int cpu)
 {
@@ -1480,6 +1502,7 @@ extern int task_load_will_fit(struct task_struct *p, u64 task_load, int cpu,
 					enum sched_boost_policy boost_policy);
 extern enum sched_boost_policy sched_boost_policy(void);
 extern int task_will_fit(struct task_struct *p, int cpu);
+extern int task_misfit(struct task_struct *p, int cpu);
 extern u64 cpu_load(int cpu);
 extern u64 cpu_load_sync(int cpu, int sync);
 extern int preferred_cluster(struct sched_cluster *cluster,
@@ -1556,6 +1579,11 @@ static inline int got_boost_kick(void)
 	return 0;
 }
 
+static inline int got_misfit_kick(void)
+{
+	return 0;
+}
+
 static inline void update_task_ravg(struct task_struct *p, struct rq *rq,
 				int event, u64 wallclock, u64 irqtime) { }
 
@@ -1567,6 +1595,7 @@ static inline bool early_detection_notify(struct rq *rq, u64 wallclock)
 static inline void clear_ed_task(struct task_struct *p, struct rq *rq) { }
 static inline void fixup_busy_time(struct task_struct *p, int new_cpu) { }
 static inline void clear_boost_kick(int cpu) { }
+static inline void clear_misfit_kick(int cpu) { }
 static inline void clear_hmp_request(int cpu) { }
 static inline void mark_task_starting(struct task_struct *p) { }
 static inline void set_window_start(struct rq *rq) { }
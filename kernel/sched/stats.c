@@ -61,6 +61,11 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		seq_printf(seq, "\n");
 
+#ifdef CONFIG_SCHED_HMP
+		seq_printf(seq, "misfit %u %u\n",
+		    rq->misfit_kick_count, rq->upmigrate_count);
+#endif
+
 #ifdef CONFIG_SMP
 		show_easstat(seq, &rq->eas_stats);
 
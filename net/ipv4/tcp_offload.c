@@ -29,12 +29,67 @@ static void tcp_gso_tstamp(struct sk_buff *skb, unsigned int ts_seq,
 	}
 }
 
+static void __tcpv4_gso_segment_csum(struct sk_buff *seg,
+				     __be32 *oldip, const __be32 *newip,
+				     __be16 *oldport, const __be16 *newport)
+{
+	struct tcphdr *th = tcp_hdr(seg);
+
+	if (*oldip == *newip && *oldport == *newport)
+		return;
+
+	inet_proto_csum_replace4(&th->check, seg, *oldip, *newip, true);
+	inet_proto_csum_replace2(&th->check, seg, *oldport, *newport, false);
+	*oldport = *newport;
+	/* the IP header checksum is redone by inet_gso_segment() */
+	*oldip = *newip;
+}
+
+/*
+ * Only the head of a fraglist GRO packet went through forwarding and
+ * NAT: hand its addresses, ports, TTL and TOS on to the others.
+ */
+static void __tcpv4_gso_segment_list_csum(struct sk_buff *segs)
+{
+	const struct tcphdr *th = tcp_hdr(segs);
+	const struct iphdr *iph = ip_hdr(segs);
+	struct sk_buff *seg;
+
+	for (seg = segs->next; seg; seg = seg->next) {
+		struct tcphdr *th2 = tcp_hdr(seg);
+		struct iphdr *iph2 = ip_hdr(seg);
+
+		__tcpv4_gso_segment_csum(seg, &iph2->saddr, &iph->saddr,
+					 &th2->source, &th->source);
+		__tcpv4_gso_segment_csum(seg, &iph2->daddr, &iph->daddr,
+					 &th2->dest, &th->dest);
+		iph2->ttl = iph->ttl;
+		iph2->tos = iph->tos;
+	}
+}
+
+static struct sk_buff *tcp4_gso_segment_list(struct sk_buff *skb,
+					     netdev_features_t features)
+{
+	skb = skb_segment_list(skb, features,
+			       skb_network_header(skb) - skb_mac_header(skb));
+	if (IS_ERR(skb))
+		return skb;
+
+	__tcpv4_gso_segment_list_csum(skb);
+
+	return skb;
+}
+
 static struct sk_buff *tcp4_gso_segment(struct sk_buff *skb,
 					netdev_features_t features)
 {
 	if (!pskb_may_pull(skb, sizeof(struct tcphdr)))
 		return ERR_PTR(-EINVAL);
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)
+		return tcp4_gso_segment_list(skb, features);
+
 	if (unlikely(skb->ip_summed != CHECKSUM_PARTIAL)) {
 		const struct iphdr *iph = ip_hdr(skb);
 		struct tcphdr *th = tcp_hdr(skb);
@@ -246,6 +301,22 @@ found:
 
 	flush |= (len - 1) >= mss;
 	flush |= (ntohl(th2->seq) + skb_gro_len(p)) ^ ntohl(th->seq);
+	flush |= NAPI_GRO_CB(p)->is_flist ^ NAPI_GRO_CB(skb)->is_flist;
+
+	if (NAPI_GRO_CB(p)->is_flist) {
+		/* The head keeps its own header, nothing can be folded
+		 * into it: a FIN or PSH has to travel on its own.
+		 */
+		flush |= (__force int)(flags & (TCP_FLAG_FIN | TCP_FLAG_PSH));
+		flush |= skb->ip_summed != p->ip_summed;
+		flush |= skb->csum_level != p->csum_level;
+		flush |= NAPI_GRO_CB(p)->count >= GRO_FRAGLIST_MAX_SEGS;
+
+		if (flush || !pskb_may_pull(skb, skb_gro_offset(skb)) ||
+		    skb_gro_receive_list(head, skb))
+			mss = 1;
+		goto out_check_final;
+	}
 
 	if (flush || skb_gro_receive(head, skb)) {
 		mss = 1;
@@ -288,6 +359,29 @@ int tcp_gro_complete(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(tcp_gro_complete);
 
+/*
+ * Finish a fraglist GRO packet.  The checksum of the first segment stays
+ * as it is, it is needed again once the packet is split up.
+ */
+int tcp_gro_complete_list(struct sk_buff *skb)
+{
+	skb_shinfo(skb)->gso_type |= SKB_GSO_FRAGLIST;
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+
+	/*
+	 * Every segment of the chain was validated on its way in; one that
+	 * still needs its checksum filled in keeps CHECKSUM_PARTIAL.
+	 */
+	if (skb->ip_summed != CHECKSUM_UNNECESSARY &&
+	    skb->ip_summed != CHECKSUM_PARTIAL) {
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		skb->csum_level = 0;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(tcp_gro_complete_list);
+
 static struct sk_buff **tcp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 {
 	/* Don't bother verifying checksum if we're going to flush anyway. */
@@ -298,6 +392,9 @@ static struct sk_buff **tcp4_gro_receive(struct sk_buff **head, struct sk_buff *
 		return NULL;
 	}
 
+	if (skb->dev->features & NETIF_F_GRO_FRAGLIST)
+		NAPI_GRO_CB(skb)->is_flist = 1;
+
 	return tcp_gro_receive(head, skb);
 }
 
@@ -306,6 +403,11 @@ static int tcp4_gro_complete(struct sk_buff *skb, int thoff)
 	const struct iphdr *iph = ip_hdr(skb);
 	struct tcphdr *th = tcp_hdr(skb);
 
+	if (NAPI_GRO_CB(skb)->is_flist) {
+		skb_shinfo(skb)->gso_type |= SKB_GSO_TCPV4;
+		return tcp_gro_complete_list(skb);
+	}
+
 	th->check = ~tcp_v4_check(skb->len - thoff, iph->saddr,
 				  iph->daddr, 0);
 	skb_shinfo(skb)->gso_type |= SKB_GSO_TCPV4;
@@ -96,6 +96,7 @@
 #include <linux/timer.h>
 #include <linux/mm.h>
 #include <linux/inet.h>
+#include <linux/jhash.h>
 #include <linux/netdevice.h>
 #include <linux/slab.h>
 #include <net/tcp_states.h>
@@ -126,6 +127,8 @@ EXPORT_SYMBOL(sysctl_udp_rmem_min);
 int sysctl_udp_wmem_min __read_mostly;
 EXPORT_SYMBOL(sysctl_udp_wmem_min);
 
+int sysctl_udp_early_demux_unconnected __read_mostly;
+
 atomic_long_t udp_memory_allocated;
 EXPORT_SYMBOL(udp_memory_allocated);
 
@@ -1296,6 +1299,10 @@ try_again:
 	if (!skb)
 		goto out;
 
+	/* sk_rxhash is only kept for connected sockets, steer by datagram */
+	if (!inet->inet_daddr)
+		sock_rps_record_flow_hash(skb->hash);
+
 	ulen = skb->len - sizeof(struct udphdr);
 	copied = len;
 	if (copied > ulen)
@@ -1669,6 +1676,118 @@ static void udp_sk_rx_dst_set(struct sock *sk, struct dst_entry *dst)
 	dst_release(old);
 }
 
+/* An unconnected socket hears from many peers, so a single sk_rx_dst is
+ * no use to it.  Instead it keeps the input route of the last peer seen
+ * in each of a few slots, keyed by (saddr, daddr, iif).  Every entry is
+ * the result of a full route lookup for that key, source validation
+ * included, and proves that daddr is local, which is what makes early
+ * demux safe for such a socket: a datagram is only steered to it before
+ * routing if its key hits an entry whose route is still valid.
+ */
+#define UDP_RX_FLOWS		16
+
+struct udp_rx_flow {
+	__be32			saddr;
+	__be32			daddr;
+	int			iif;
+	struct dst_entry	*dst;
+};
+
+struct udp_rx_flows {
+	seqlock_t		lock;
+	struct udp_rx_flow	flow[UDP_RX_FLOWS];
+};
+
+static inline unsigned int udp_rx_flow_slot(__be32 saddr, __be32 daddr,
+					    int iif)
+{
+	return jhash_3words((__force u32)saddr, (__force u32)daddr, iif, 0) &
+	       (UDP_RX_FLOWS - 1);
+}
+
+/* called with rcu_read_lock() and a reference on sk */
+static struct dst_entry *udp_rx_flow_dst(struct sock *sk, __be32 saddr,
+					 __be32 daddr, int iif)
+{
+	struct udp_rx_flows *flows = READ_ONCE(udp_sk(sk)->rx_flows);
+	struct udp_rx_flow *flow;
+	struct dst_entry *dst;
+	unsigned int seq;
+
+	if (!flows)
+		return NULL;
+
+	flow = &flows->flow[udp_rx_flow_slot(saddr, daddr, iif)];
+	do {
+		seq = read_seqbegin(&flows->lock);
+		dst = NULL;
+		if (flow->saddr == saddr && flow->daddr == daddr &&
+		    flow->iif == iif)
+			dst = flow->dst;
+	} while (read_seqretry(&flows->lock, seq));
+
+	return dst ? dst_check(dst, 0) : NULL;
+}
+
+static void udp_rx_flow_set(struct sock *sk, struct sk_buff *skb,
+			    __be32 saddr, __be32 daddr)
+{
+	struct udp_rx_flows *flows = READ_ONCE(udp_sk(sk)->rx_flows);
+	struct dst_entry *dst = skb_dst(skb), *old;
+	struct udp_rx_flow *flow;
+	int iif = skb->skb_iif;
+
+	/* routes that are not cached cannot be used without a reference */
+	if (!dst || dst->flags & DST_NOCACHE)
+		return;
+
+	if (!flows) {
+		flows = kzalloc(sizeof(*flows), GFP_ATOMIC);
+		if (!flows)
+			return;
+		seqlock_init(&flows->lock);
+		if (cmpxchg(&udp_sk(sk)->rx_flows, NULL, flows)) {
+			kfree(flows);
+			flows = READ_ONCE(udp_sk(sk)->rx_flows);
+		}
+	}
+
+	flow = &flows->flow[udp_rx_flow_slot(saddr, daddr, iif)];
+	if (flow->dst == dst && flow->saddr == saddr &&
+	    flow->daddr == daddr && flow->iif == iif)
+		return;
+
+	dst_hold(dst);
+	write_seqlock_bh(&flows->lock);
+	old = flow->dst;
+	flow->saddr = saddr;
+	flow->daddr = daddr;
+	flow->iif = iif;
+	flow->dst = dst;
+	write_sequnlock_bh(&flows->lock);
+	dst_release(old);
+}
+
+static void udp_destruct_sock(struct sock *sk)
+{
+	struct udp_rx_flows *flows = udp_sk(sk)->rx_flows;
+	int i;
+
+	if (flows) {
+		for (i = 0; i < UDP_RX_FLOWS; i++)
+			dst_release(flows->flow[i].dst);
+		kfree(flows);
+	}
+	inet_sock_destruct(sk);
+}
+
+int udp_init_sock(struct sock *sk)
+{
+	sk->sk_destruct = udp_destruct_sock;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(udp_init_sock);
+
 /*
  *	Multicasts and broadcasts go to each listener.
  *
@@ -1778,6 +1897,19 @@ int __udp4_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 	__be32 saddr, daddr;
 	struct net *net = dev_net(skb->dev);
 
+	/* a fraglist GRO packet for us: take its datagrams one by one */
+	if (unlikely(skb_is_gso(skb) &&
+		     skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)) {
+		struct sk_buff *next;
+
+		for (skb = udp_rcv_segment(skb); skb; skb = next) {
+			next = skb->next;
+			skb->next = NULL;
+			__udp4_lib_rcv(skb, udptable, proto);
+		}
+		return 0;
+	}
+
 	/*
 	 *  Validate the packet.
 	 */
@@ -1807,7 +1939,10 @@ int __udp4_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 		struct dst_entry *dst = skb_dst(skb);
 		int ret;
 
-		if (unlikely(sk->sk_rx_dst != dst))
+		/* unconnected unicast sockets keep their routes per flow */
+		if (unlikely(sk->sk_rx_dst != dst) &&
+		    (inet_sk(sk)->inet_daddr ||
+		     rt->rt_flags & (RTCF_BROADCAST|RTCF_MULTICAST)))
 			udp_sk_rx_dst_set(sk, dst);
 
 		ret = udp_queue_rcv_skb(sk, skb);
@@ -1828,6 +1963,10 @@ int __udp4_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 	if (sk) {
 		int ret;
 
+		if (sysctl_udp_early_demux_unconnected &&
+		    proto == IPPROTO_UDP && !inet_sk(sk)->inet_daddr)
+			udp_rx_flow_set(sk, skb, saddr, daddr);
+
 		if (inet_get_convert_csum(sk) && uh->check && !IS_UDPLITE(sk))
 			skb_checksum_try_convert(skb, IPPROTO_UDP, uh->check,
 						 inet_compute_pseudo);
@@ -1982,6 +2121,39 @@ static struct sock *__udp4_lib_demux_lookup(struct net *net,
 	return result;
 }
 
+/* The full lookup an unconnected socket needs is done only once: the
+ * socket found here is handed on in skb->sk.  That is only allowed if we
+ * know the datagram is local, though, so without a cached route for its
+ * flow the socket goes back and the datagram takes the normal path.
+ */
+static void udp_v4_early_demux_unconnected(struct sk_buff *skb,
+					   const struct udphdr *uh,
+					   const struct iphdr *iph, int dif)
+{
+	struct dst_entry *dst;
+	struct sock *sk;
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, dif, &udp_table);
+	if (!sk)
+		return;
+
+	rcu_read_lock();
+	dst = NULL;
+	if (!inet_sk(sk)->inet_daddr)
+		dst = udp_rx_flow_dst(sk, iph->saddr, iph->daddr,
+				      skb->skb_iif);
+	if (!dst) {
+		rcu_read_unlock();
+		sock_put(sk);
+		return;
+	}
+	skb->sk = sk;
+	skb->destructor = sock_efree;
+	skb_dst_set_noref(skb, dst);
+	rcu_read_unlock();
+}
+
 void udp_v4_early_demux(struct sk_buff *skb)
 {
 	struct net *net = dev_net(skb->dev);
@@ -2019,6 +2191,10 @@ void udp_v4_early_demux(struct sk_buff *skb)
 	} else if (skb->pkt_type == PACKET_HOST) {
 		sk = __udp4_lib_demux_lookup(net, uh->dest, iph->daddr,
 					     uh->source, iph->saddr, dif);
+		if (!sk && sysctl_udp_early_demux_unconnected) {
+			udp_v4_early_demux_unconnected(skb, uh, iph, dif);
+			return;
+		}
 	} else {
 		return;
 	}
@@ -2299,6 +2475,7 @@ struct proto udp_prot = {
 	.connect	   = ip4_datagram_connect,
 	.disconnect	   = udp_disconnect,
 	.ioctl		   = udp_ioctl,
+	.init		   = udp_init_sock,
 	.destroy	   = udp_destroy_sock,
 	.setsockopt	   = udp_setsockopt,
 	.getsockopt	   = udp_getsockopt,
@@ -175,6 +175,68 @@ out_unlock:
 	return segs;
 }
 
+static void __udpv4_gso_segment_csum(struct sk_buff *seg,
+				     __be32 *oldip, const __be32 *newip,
+				     __be16 *oldport, const __be16 *newport)
+{
+	struct udphdr *uh = udp_hdr(seg);
+
+	if (*oldip == *newip && *oldport == *newport)
+		return;
+
+	if (uh->check) {
+		inet_proto_csum_replace4(&uh->check, seg, *oldip, *newip,
+					 true);
+		inet_proto_csum_replace2(&uh->check, seg, *oldport, *newport,
+					 false);
+		if (!uh->check)
+			uh->check = CSUM_MANGLED_0;
+	}
+	*oldport = *newport;
+	/* the IP header checksum is redone by inet_gso_segment() */
+	*oldip = *newip;
+}
+
+/*
+ * Only the head of a fraglist GRO packet went through forwarding and
+ * NAT: hand its addresses, ports, TTL and TOS on to the others.
+ */
+static void __udpv4_gso_segment_list_csum(struct sk_buff *segs)
+{
+	const struct udphdr *uh = udp_hdr(segs);
+	const struct iphdr *iph = ip_hdr(segs);
+	struct sk_buff *seg;
+
+	for (seg = segs->next; seg; seg = seg->next) {
+		struct udphdr *uh2 = udp_hdr(seg);
+		struct iphdr *iph2 = ip_hdr(seg);
+
+		__udpv4_gso_segment_csum(seg, &iph2->saddr, &iph->saddr,
+					 &uh2->source, &uh->source);
+		__udpv4_gso_segment_csum(seg, &iph2->daddr, &iph->daddr,
+					 &uh2->dest, &uh->dest);
+		iph2->ttl = iph->ttl;
+		iph2->tos = iph->tos;
+	}
+}
+
+static struct sk_buff *udp4_gso_segment_list(struct sk_buff *skb,
+					     netdev_features_t features)
+{
+	unsigned int mss = skb_shinfo(skb)->gso_size;
+
+	skb = skb_segment_list(skb, features,
+			       skb_network_header(skb) - skb_mac_header(skb));
+	if (IS_ERR(skb))
+		return skb;
+
+	/* the head gets back the length it had before GRO */
+	udp_hdr(skb)->len = htons(mss);
+	__udpv4_gso_segment_list_csum(skb);
+
+	return skb;
+}
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -184,6 +246,9 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	struct udphdr *uh;
 	struct iphdr *iph;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)
+		return udp4_gso_segment_list(skb, features);
+
 	if (skb->encapsulation &&
 	    (skb_shinfo(skb)->gso_type &
 	     (SKB_GSO_UDP_TUNNEL|SKB_GSO_UDP_TUNNEL_CSUM))) {
@@ -290,6 +355,63 @@ unlock:
 }
 EXPORT_SYMBOL(udp_del_offload);
 
+/*
+ * Chain datagrams of one flow for forwarding, payloads untouched.  All
+ * but the last datagram of a train have the size of the first one.
+ */
+static struct sk_buff **udp_gro_receive_list(struct sk_buff **head,
+					     struct sk_buff *skb,
+					     struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	struct sk_buff *p, **pp = NULL;
+	struct udphdr *uh2;
+	unsigned int ulen;
+
+	/* Do not deal with padded or malicious packets */
+	ulen = ntohs(uh->len);
+	if (ulen <= sizeof(*uh) || ulen != skb_gro_len(skb)) {
+		NAPI_GRO_CB(skb)->flush = 1;
+		return NULL;
+	}
+	skb_gro_pull(skb, sizeof(struct udphdr));
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		if (NAPI_GRO_CB(skb)->flush || NAPI_GRO_CB(p)->flush ||
+		    !NAPI_GRO_CB(p)->is_flist ||
+		    skb->ip_summed != p->ip_summed ||
+		    skb->csum_level != p->csum_level) {
+			NAPI_GRO_CB(skb)->flush = 1;
+			return head;
+		}
+
+		/*
+		 * A datagram bigger than the first one starts a new train,
+		 * a smaller one ends this one.
+		 */
+		if (ulen > ntohs(uh2->len) ||
+		    !pskb_may_pull(skb, skb_gro_offset(skb)) ||
+		    skb_gro_receive_list(head, skb) ||
+		    ulen != ntohs(uh2->len) ||
+		    NAPI_GRO_CB(p)->count >= GRO_FRAGLIST_MAX_SEGS)
+			pp = head;
+
+		return pp;
+	}
+
+	return NULL;
+}
+
 struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 				 struct udphdr *uh)
 {
@@ -299,25 +421,34 @@ struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 	unsigned int off = skb_gro_offset(skb);
 	int flush = 1;
 
-	if (NAPI_GRO_CB(skb)->encap_mark ||
-	    (skb->ip_summed != CHECKSUM_PARTIAL &&
-	     NAPI_GRO_CB(skb)->csum_cnt == 0 &&
-	     !NAPI_GRO_CB(skb)->csum_valid))
+	if (NAPI_GRO_CB(skb)->encap_mark)
 		goto out;
 
-	/* mark that this skb passed once through the tunnel gro layer */
-	NAPI_GRO_CB(skb)->encap_mark = 1;
-
 	rcu_read_lock();
 	uo_priv = rcu_dereference(udp_offload_base);
 	for (; uo_priv != NULL; uo_priv = rcu_dereference(uo_priv->next)) {
 		if (uo_priv->offload->port == uh->dest &&
 		    uo_priv->offload->callbacks.gro_receive)
-			goto unflush;
+			goto tunnel;
 	}
-	goto out_unlock;
+	rcu_read_unlock();
+
+	/* not a tunnel: plain datagrams only get chained, if at all */
+	if (skb->dev->features & NETIF_F_GRO_FRAGLIST) {
+		NAPI_GRO_CB(skb)->is_flist = 1;
+		return udp_gro_receive_list(head, skb, uh);
+	}
+	goto out;
+
+tunnel:
+	if (skb->ip_summed != CHECKSUM_PARTIAL &&
+	    NAPI_GRO_CB(skb)->csum_cnt == 0 &&
+	    !NAPI_GRO_CB(skb)->csum_valid)
+		goto out_unlock;
+
+	/* mark that this skb passed once through the tunnel gro layer */
+	NAPI_GRO_CB(skb)->encap_mark = 1;
 
-unflush:
 	flush = 0;
 
 	for (p = *head; p; p = p->next) {
@@ -412,11 +543,42 @@ int udp_gro_complete(struct sk_buff *skb, int nhoff)
 	return err;
 }
 
+/*
+ * Finish a fraglist GRO packet.  Unlike the tunnel case the checksum of
+ * the first datagram stays as it is, it is needed again once the packet
+ * is split up.  gso_size counts the UDP header, as it does for UFO.
+ */
+int udp_gro_complete_list(struct sk_buff *skb, int nhoff)
+{
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+
+	uh->len = htons(skb->len - nhoff);
+
+	skb_shinfo(skb)->gso_type |= SKB_GSO_FRAGLIST | SKB_GSO_UDP;
+	skb_shinfo(skb)->gso_size += sizeof(struct udphdr);
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+
+	/*
+	 * Every datagram of the chain was validated on its way in; one that
+	 * still needs its checksum filled in keeps CHECKSUM_PARTIAL.
+	 */
+	if (skb->ip_summed != CHECKSUM_UNNECESSARY &&
+	    skb->ip_summed != CHECKSUM_PARTIAL) {
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		skb->csum_level = 0;
+	}
+
+	return 0;
+}
+
 static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
+	if (NAPI_GRO_CB(skb)->is_flist)
+		return udp_gro_complete_list(skb, nhoff);
+
 	if (uh->check) {
 		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
 		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
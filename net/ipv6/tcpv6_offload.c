@@ -26,6 +26,9 @@ static struct sk_buff **tcp6_gro_receive(struct sk_buff **head,
 		return NULL;
 	}
 
+	if (skb->dev->features & NETIF_F_GRO_FRAGLIST)
+		NAPI_GRO_CB(skb)->is_flist = 1;
+
 	return tcp_gro_receive(head, skb);
 }
 
@@ -34,6 +37,11 @@ static int tcp6_gro_complete(struct sk_buff *skb, int thoff)
 	const struct ipv6hdr *iph = ipv6_hdr(skb);
 	struct tcphdr *th = tcp_hdr(skb);
 
+	if (NAPI_GRO_CB(skb)->is_flist) {
+		skb_shinfo(skb)->gso_type |= SKB_GSO_TCPV6;
+		return tcp_gro_complete_list(skb);
+	}
+
 	th->check = ~tcp_v6_check(skb->len - thoff, &iph->saddr,
 				  &iph->daddr, 0);
 	skb_shinfo(skb)->gso_type |= SKB_GSO_TCPV6;
@@ -41,6 +49,58 @@ static int tcp6_gro_complete(struct sk_buff *skb, int thoff)
 	return tcp_gro_complete(skb);
 }
 
+static void __tcpv6_gso_segment_csum(struct sk_buff *seg,
+				     struct in6_addr *oldip,
+				     const struct in6_addr *newip,
+				     __be16 *oldport, const __be16 *newport)
+{
+	struct tcphdr *th = tcp_hdr(seg);
+
+	if (ipv6_addr_equal(oldip, newip) && *oldport == *newport)
+		return;
+
+	inet_proto_csum_replace16(&th->check, seg, oldip->s6_addr32,
+				  newip->s6_addr32, true);
+	inet_proto_csum_replace2(&th->check, seg, *oldport, *newport, false);
+	*oldport = *newport;
+	*oldip = *newip;
+}
+
+/*
+ * Only the head of a fraglist GRO packet went through forwarding and
+ * NAT: hand its addresses, ports and hop limit on to the others.
+ */
+static void __tcpv6_gso_segment_list_csum(struct sk_buff *segs)
+{
+	const struct ipv6hdr *iph = ipv6_hdr(segs);
+	const struct tcphdr *th = tcp_hdr(segs);
+	struct sk_buff *seg;
+
+	for (seg = segs->next; seg; seg = seg->next) {
+		struct ipv6hdr *iph2 = ipv6_hdr(seg);
+		struct tcphdr *th2 = tcp_hdr(seg);
+
+		__tcpv6_gso_segment_csum(seg, &iph2->saddr, &iph->saddr,
+					 &th2->source, &th->source);
+		__tcpv6_gso_segment_csum(seg, &iph2->daddr, &iph->daddr,
+					 &th2->dest, &th->dest);
+		iph2->hop_limit = iph->hop_limit;
+	}
+}
+
+static struct sk_buff *tcp6_gso_segment_list(struct sk_buff *skb,
+					     netdev_features_t features)
+{
+	skb = skb_segment_list(skb, features,
+			       skb_network_header(skb) - skb_mac_header(skb));
+	if (IS_ERR(skb))
+		return skb;
+
+	__tcpv6_gso_segment_list_csum(skb);
+
+	return skb;
+}
+
 static struct sk_buff *tcp6_gso_segment(struct sk_buff *skb,
 					netdev_features_t features)
 {
@@ -49,6 +109,9 @@ static struct sk_buff *tcp6_gso_segment(struct sk_buff *skb,
 	if (!pskb_may_pull(skb, sizeof(*th)))
 		return ERR_PTR(-EINVAL);
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)
+		return tcp6_gso_segment_list(skb, features);
+
 	if (unlikely(skb->ip_summed != CHECKSUM_PARTIAL)) {
 		const struct ipv6hdr *ipv6h = ipv6_hdr(skb);
 		struct tcphdr *th = tcp_hdr(skb);
@@ -419,6 +419,10 @@ try_again:
 	if (!skb)
 		goto out;
 
+	/* sk_rxhash is only kept for connected sockets, steer by datagram */
+	if (ipv6_addr_any(&sk->sk_v6_daddr))
+		sock_rps_record_flow_hash(skb->hash);
+
 	ulen = skb->len - sizeof(struct udphdr);
 	copied = len;
 	if (copied > ulen)
@@ -857,6 +861,19 @@ int __udp6_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 	const struct in6_addr *saddr, *daddr;
 	u32 ulen = 0;
 
+	/* a fraglist GRO packet for us: take its datagrams one by one */
+	if (unlikely(skb_is_gso(skb) &&
+		     skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)) {
+		struct sk_buff *next;
+
+		for (skb = udp_rcv_segment(skb); skb; skb = next) {
+			next = skb->next;
+			skb->next = NULL;
+			__udp6_lib_rcv(skb, udptable, proto);
+		}
+		return 0;
+	}
+
 	if (!pskb_may_pull(skb, sizeof(struct udphdr)))
 		goto discard;
 
@@ -1603,6 +1620,7 @@ struct proto udpv6_prot = {
 	.connect	   = ip6_datagram_connect,
 	.disconnect	   = udp_disconnect,
 	.ioctl		   = udp_ioctl,
+	.init		   = udp_init_sock,
 	.destroy	   = udpv6_destroy_sock,
 	.setsockopt	   = udpv6_setsockopt,
 	.getsockopt	   = udpv6_getsockopt,
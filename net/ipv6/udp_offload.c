@@ -17,6 +17,66 @@
 #include <net/ip6_checksum.h>
 #include "ip6_offload.h"
 
+static void __udpv6_gso_segment_csum(struct sk_buff *seg,
+				     struct in6_addr *oldip,
+				     const struct in6_addr *newip,
+				     __be16 *oldport, const __be16 *newport)
+{
+	struct udphdr *uh = udp_hdr(seg);
+
+	if (ipv6_addr_equal(oldip, newip) && *oldport == *newport)
+		return;
+
+	inet_proto_csum_replace16(&uh->check, seg, oldip->s6_addr32,
+				  newip->s6_addr32, true);
+	inet_proto_csum_replace2(&uh->check, seg, *oldport, *newport,
+				 false);
+	if (!uh->check)
+		uh->check = CSUM_MANGLED_0;
+
+	*oldport = *newport;
+	*oldip = *newip;
+}
+
+/*
+ * Only the head of a fraglist GRO packet went through forwarding and
+ * NAT: hand its addresses, ports and hop limit on to the others.
+ */
+static void __udpv6_gso_segment_list_csum(struct sk_buff *segs)
+{
+	const struct ipv6hdr *iph = ipv6_hdr(segs);
+	const struct udphdr *uh = udp_hdr(segs);
+	struct sk_buff *seg;
+
+	for (seg = segs->next; seg; seg = seg->next) {
+		struct ipv6hdr *iph2 = ipv6_hdr(seg);
+		struct udphdr *uh2 = udp_hdr(seg);
+
+		__udpv6_gso_segment_csum(seg, &iph2->saddr, &iph->saddr,
+					 &uh2->source, &uh->source);
+		__udpv6_gso_segment_csum(seg, &iph2->daddr, &iph->daddr,
+					 &uh2->dest, &uh->dest);
+		iph2->hop_limit = iph->hop_limit;
+	}
+}
+
+static struct sk_buff *udp6_gso_segment_list(struct sk_buff *skb,
+					     netdev_features_t features)
+{
+	unsigned int mss = skb_shinfo(skb)->gso_size;
+
+	skb = skb_segment_list(skb, features,
+			       skb_network_header(skb) - skb_mac_header(skb));
+	if (IS_ERR(skb))
+		return skb;
+
+	/* the head gets back the length it had before GRO */
+	udp_hdr(skb)->len = htons(mss);
+	__udpv6_gso_segment_list_csum(skb);
+
+	return skb;
+}
+
 static struct sk_buff *udp6_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -31,6 +91,9 @@ static struct sk_buff *udp6_ufo_fragment(struct sk_buff *skb,
 	int tnl_hlen;
 	int err;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)
+		return udp6_gso_segment_list(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -163,6 +226,9 @@ static int udp6_gro_complete(struct sk_buff *skb, int nhoff)
 	const struct ipv6hdr *ipv6h = ipv6_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
+	if (NAPI_GRO_CB(skb)->is_flist)
+		return udp_gro_complete_list(skb, nhoff);
+
 	if (uh->check) {
 		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
 		uh->check = ~udp_v6_check(skb->len - nhoff, &ipv6h->saddr,
@@ -253,6 +253,9 @@ static int ct_seq_show(struct seq_file *s, void *v)
 	if (test_bit(IPS_ASSURED_BIT, &ct->status))
 		seq_printf(s, "[ASSURED] ");
 
+	if (test_bit(IPS_OFFLOAD_BIT, &ct->status))
+		seq_printf(s, "[OFFLOAD] ");
+
 	if (seq_has_overflowed(s))
 		goto release;
 
@@ -0,0 +1,809 @@
+/*
+ * Software flow table: a fast path at ingress for forwarded connections.
+ *
+ * Once a connection tracked and NATed by the slow path is established, it
+ * can be added here (see the FLOWOFFLOAD target).  Its later packets are
+ * then matched by the ingress hook of the device they arrive on, NATed
+ * according to the conntrack entry and handed to the neighbour layer of
+ * the output device, skipping the IP stack and all netfilter hooks.  The
+ * flow goes back to the slow path when it has been idle for
+ * NF_FLOW_TIMEOUT, on TCP FIN or RST, when its route goes away or when
+ * its conntrack entry is dying; meanwhile a periodic garbage collector
+ * keeps the conntrack entry alive and adds the offloaded traffic to its
+ * counters.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/rtnetlink.h>
+#include <linux/workqueue.h>
+#include <net/ip.h>
+#include <net/neighbour.h>
+#include <net/route.h>
+#include <net/netfilter/nf_flow_table.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_acct.h>
+#include <net/netfilter/nf_conntrack_tuple.h>
+
+static struct rhashtable flow_table;
+static struct delayed_work flow_gc_work;
+/* serializes removals */
+static DEFINE_MUTEX(flow_gc_mutex);
+
+struct flow_offload_hook {
+	struct list_head	list;
+	struct net_device	*dev;
+	struct nf_hook_ops	ops;
+	bool			registered;
+};
+
+static LIST_HEAD(flow_hooks);
+static DEFINE_SPINLOCK(flow_hooks_lock);
+
+static void flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
+				  struct dst_entry *other_dst,
+				  enum flow_offload_tuple_dir dir)
+{
+	struct flow_offload_tuple *ft = &flow->tuplehash[dir].tuple;
+	struct nf_conntrack_tuple *ctt = &ct->tuplehash[dir].tuple;
+	struct dst_entry *dst = ft->dst_cache;
+
+	ft->dir = dir;
+	ft->src_v4 = ctt->src.u3.ip;
+	ft->dst_v4 = ctt->dst.u3.ip;
+	ft->l4proto = ctt->dst.protonum;
+	ft->src_port = ctt->src.u.tcp.port;
+	ft->dst_port = ctt->dst.u.tcp.port;
+	/* packets in this direction come in where the other one goes out */
+	ft->iifidx = other_dst->dev->ifindex;
+	ft->mtu = dst_mtu(dst);
+}
+
+/**
+ * flow_offload_alloc - set up a flow for an established connection
+ * @ct: conntrack entry of the connection
+ * @dst: output routes of both directions, indexed by conntrack direction
+ *
+ * Takes references on @ct and both routes.
+ */
+struct flow_offload *flow_offload_alloc(struct nf_conn *ct,
+					struct dst_entry *dst[FLOW_OFFLOAD_DIR_MAX])
+{
+	struct flow_offload *flow;
+
+	if (unlikely(nf_ct_is_dying(ct) ||
+		     !atomic_inc_not_zero(&ct->ct_general.use)))
+		return NULL;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow)
+		goto err_ct_refcnt;
+
+	dst_hold(dst[FLOW_OFFLOAD_DIR_ORIGINAL]);
+	dst_hold(dst[FLOW_OFFLOAD_DIR_REPLY]);
+	flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_cache =
+		dst[FLOW_OFFLOAD_DIR_ORIGINAL];
+	flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_cache =
+		dst[FLOW_OFFLOAD_DIR_REPLY];
+
+	flow->ct = ct;
+	flow_offload_fill_dir(flow, ct, dst[FLOW_OFFLOAD_DIR_REPLY],
+			      FLOW_OFFLOAD_DIR_ORIGINAL);
+	flow_offload_fill_dir(flow, ct, dst[FLOW_OFFLOAD_DIR_ORIGINAL],
+			      FLOW_OFFLOAD_DIR_REPLY);
+
+	if (ct->status & IPS_SRC_NAT)
+		flow->flags |= FLOW_OFFLOAD_SNAT;
+	if (ct->status & IPS_DST_NAT)
+		flow->flags |= FLOW_OFFLOAD_DNAT;
+
+	/* the slow path just restarted the timer with the full timeout of
+	 * the connection's state, keep doing the same
+	 */
+	flow->ct_timeout = max_t(long, ct->timeout.expires - jiffies,
+				 2 * NF_FLOW_TIMEOUT);
+
+	return flow;
+
+err_ct_refcnt:
+	nf_ct_put(ct);
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(flow_offload_alloc);
+
+static void flow_offload_free_rcu(struct rcu_head *head)
+{
+	struct flow_offload *flow = container_of(head, struct flow_offload,
+						 rcu_head);
+
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_cache);
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_cache);
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+void flow_offload_free(struct flow_offload *flow)
+{
+	call_rcu(&flow->rcu_head, flow_offload_free_rcu);
+}
+EXPORT_SYMBOL_GPL(flow_offload_free);
+
+static u32 flow_offload_hash(const void *data, u32 len, u32 seed)
+{
+	const struct flow_offload_tuple *tuple = data;
+
+	return jhash(tuple, offsetof(struct flow_offload_tuple, __hash), seed);
+}
+
+static u32 flow_offload_hash_obj(const void *data, u32 len, u32 seed)
+{
+	const struct flow_offload_tuple_rhash *tuplehash = data;
+
+	return jhash(&tuplehash->tuple,
+		     offsetof(struct flow_offload_tuple, __hash), seed);
+}
+
+static int flow_offload_hash_cmp(struct rhashtable_compare_arg *arg,
+				 const void *ptr)
+{
+	const struct flow_offload_tuple_rhash *x = ptr;
+	const struct flow_offload_tuple *tuple = arg->key;
+
+	if (memcmp(&x->tuple, tuple, offsetof(struct flow_offload_tuple,
+					      __hash)))
+		return 1;
+
+	return 0;
+}
+
+static const struct rhashtable_params flow_offload_rhash_params = {
+	.head_offset		= offsetof(struct flow_offload_tuple_rhash, node),
+	.hashfn			= flow_offload_hash,
+	.obj_hashfn		= flow_offload_hash_obj,
+	.obj_cmpfn		= flow_offload_hash_cmp,
+	.automatic_shrinking	= true,
+};
+
+int flow_offload_add(struct flow_offload *flow)
+{
+	int err;
+
+	flow->timeout = jiffies + NF_FLOW_TIMEOUT;
+
+	err = rhashtable_insert_fast(&flow_table,
+				     &flow->tuplehash[0].node,
+				     flow_offload_rhash_params);
+	if (err)
+		return err;
+
+	err = rhashtable_insert_fast(&flow_table,
+				     &flow->tuplehash[1].node,
+				     flow_offload_rhash_params);
+	if (err) {
+		rhashtable_remove_fast(&flow_table,
+				       &flow->tuplehash[0].node,
+				       flow_offload_rhash_params);
+		return err;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(flow_offload_add);
+
+/* Conntrack did not see the packets of the flow, let TCP window tracking
+ * pick the connection up again rather than find them out of window.
+ */
+static void flow_offload_fixup_ct_state(struct nf_conn *ct)
+{
+	if (nf_ct_protonum(ct) != IPPROTO_TCP)
+		return;
+
+	spin_lock_bh(&ct->lock);
+	ct->proto.tcp.seen[0].td_maxwin = 0;
+	ct->proto.tcp.seen[1].td_maxwin = 0;
+	spin_unlock_bh(&ct->lock);
+}
+
+static void flow_offload_sync(struct flow_offload *flow)
+{
+	struct nf_conn *ct = flow->ct;
+	struct nf_conn_acct *acct;
+	long packets = 0, bytes;
+	int dir;
+
+	acct = nf_conn_acct_find(ct);
+	for (dir = 0; dir < FLOW_OFFLOAD_DIR_MAX; dir++) {
+		long n = atomic_long_xchg(&flow->counter[dir].packets, 0);
+
+		if (!n)
+			continue;
+		packets += n;
+		bytes = atomic_long_xchg(&flow->counter[dir].bytes, 0);
+		if (acct) {
+			atomic64_add(n, &acct->counter[dir].packets);
+			atomic64_add(bytes, &acct->counter[dir].bytes);
+		}
+	}
+
+	/* what nf_ct_refresh() would have done for the last packet */
+	if (packets && !test_bit(IPS_FIXED_TIMEOUT_BIT, &ct->status))
+		mod_timer_pending(&ct->timeout, jiffies + flow->ct_timeout);
+}
+
+static void flow_offload_del(struct flow_offload *flow)
+{
+	rhashtable_remove_fast(&flow_table,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].node,
+			       flow_offload_rhash_params);
+	rhashtable_remove_fast(&flow_table,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].node,
+			       flow_offload_rhash_params);
+
+	flow_offload_sync(flow);
+	flow_offload_fixup_ct_state(flow->ct);
+	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
+
+	flow_offload_free(flow);
+}
+
+void flow_offload_teardown(struct flow_offload *flow)
+{
+	flow->flags |= FLOW_OFFLOAD_TEARDOWN;
+}
+EXPORT_SYMBOL_GPL(flow_offload_teardown);
+
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(const struct flow_offload_tuple *tuple)
+{
+	return rhashtable_lookup_fast(&flow_table, tuple,
+				      flow_offload_rhash_params);
+}
+EXPORT_SYMBOL_GPL(flow_offload_lookup);
+
+static inline bool flow_offload_expired(const struct flow_offload *flow)
+{
+	return time_after(jiffies, flow->timeout);
+}
+
+/* Sync the counters of live flows, remove stale ones.  @dev, if set,
+ * makes every flow that goes through it stale, @flush all of them.
+ */
+static int nf_flow_table_gc(const struct net_device *dev, bool flush)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct rhashtable_iter hti;
+	struct flow_offload *flow;
+	int err;
+
+	err = rhashtable_walk_init(&flow_table, &hti);
+	if (err)
+		return err;
+
+	mutex_lock(&flow_gc_mutex);
+
+	rhashtable_walk_start(&hti);
+
+	while ((tuplehash = rhashtable_walk_next(&hti))) {
+		if (IS_ERR(tuplehash)) {
+			err = PTR_ERR(tuplehash);
+			if (err != -EAGAIN)
+				break;
+			continue;
+		}
+		if (tuplehash->tuple.dir)
+			continue;
+
+		flow = container_of(tuplehash, struct flow_offload,
+				    tuplehash[0]);
+
+		if (flush ||
+		    (dev && net_eq(nf_ct_net(flow->ct), dev_net(dev)) &&
+		     (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
+		      flow->tuplehash[1].tuple.iifidx == dev->ifindex)))
+			flow_offload_teardown(flow);
+
+		if (flow_offload_expired(flow) ||
+		    flow->flags & FLOW_OFFLOAD_TEARDOWN ||
+		    nf_ct_is_dying(flow->ct))
+			flow_offload_del(flow);
+		else
+			flow_offload_sync(flow);
+	}
+
+	rhashtable_walk_stop(&hti);
+	mutex_unlock(&flow_gc_mutex);
+	rhashtable_walk_exit(&hti);
+
+	return err == -EAGAIN ? 0 : err;
+}
+
+static void nf_flow_offload_work_gc(struct work_struct *work)
+{
+	nf_flow_table_gc(NULL, false);
+	queue_delayed_work(system_power_efficient_wq, &flow_gc_work, HZ);
+}
+
+static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
+			    struct flow_offload_tuple *tuple)
+{
+	struct flow_ports {
+		__be16 source, dest;
+	} *ports;
+	unsigned int thoff;
+	struct iphdr *iph;
+
+	if (skb->pkt_type != PACKET_HOST ||
+	    !pskb_may_pull(skb, sizeof(*iph)))
+		return -1;
+
+	iph = ip_hdr(skb);
+	thoff = iph->ihl * 4;
+
+	/* leave anything unusual to the slow path */
+	if (thoff != sizeof(*iph) || ip_is_fragment(iph) || iph->ttl <= 1 ||
+	    ntohs(iph->tot_len) > skb->len || ntohs(iph->tot_len) < thoff)
+		return -1;
+
+	if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP)
+		return -1;
+
+	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
+		return -1;
+
+	iph = ip_hdr(skb);
+	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+
+	tuple->src_v4		= iph->saddr;
+	tuple->dst_v4		= iph->daddr;
+	tuple->src_port		= ports->source;
+	tuple->dst_port		= ports->dest;
+	tuple->l4proto		= iph->protocol;
+	tuple->iifidx		= dev->ifindex;
+
+	return 0;
+}
+
+static int nf_flow_state_check(struct flow_offload *flow, int proto,
+			       struct sk_buff *skb, unsigned int thoff)
+{
+	struct tcphdr *tcph;
+
+	if (proto != IPPROTO_TCP)
+		return 0;
+
+	if (!pskb_may_pull(skb, thoff + sizeof(*tcph)))
+		return -1;
+
+	tcph = (void *)(skb_network_header(skb) + thoff);
+	if (unlikely(tcph->fin || tcph->rst)) {
+		flow_offload_teardown(flow);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int nf_flow_nat_ip_l4proto(struct sk_buff *skb, struct iphdr *iph,
+				  unsigned int thoff, __be32 addr,
+				  __be32 new_addr)
+{
+	struct tcphdr *tcph;
+	struct udphdr *udph;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		if (skb_ensure_writable(skb, thoff + sizeof(*tcph)))
+			return -1;
+
+		tcph = (void *)(skb_network_header(skb) + thoff);
+		inet_proto_csum_replace4(&tcph->check, skb, addr, new_addr,
+					 true);
+		break;
+	case IPPROTO_UDP:
+		if (skb_ensure_writable(skb, thoff + sizeof(*udph)))
+			return -1;
+
+		udph = (void *)(skb_network_header(skb) + thoff);
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL) {
+			inet_proto_csum_replace4(&udph->check, skb, addr,
+						 new_addr, true);
+			if (!udph->check)
+				udph->check = CSUM_MANGLED_0;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static int nf_flow_snat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, struct iphdr *iph,
+			   unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	__be32 addr, new_addr;
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		addr = iph->saddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_v4;
+		iph->saddr = new_addr;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		addr = iph->daddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.src_v4;
+		iph->daddr = new_addr;
+		break;
+	default:
+		return -1;
+	}
+	csum_replace4(&iph->check, addr, new_addr);
+
+	return nf_flow_nat_ip_l4proto(skb, iph, thoff, addr, new_addr);
+}
+
+static int nf_flow_dnat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, struct iphdr *iph,
+			   unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	__be32 addr, new_addr;
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		addr = iph->daddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.src_v4;
+		iph->daddr = new_addr;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		addr = iph->saddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_v4;
+		iph->saddr = new_addr;
+		break;
+	default:
+		return -1;
+	}
+	csum_replace4(&iph->check, addr, new_addr);
+
+	return nf_flow_nat_ip_l4proto(skb, iph, thoff, addr, new_addr);
+}
+
+static int nf_flow_nat_port(struct sk_buff *skb, unsigned int thoff,
+			    u8 protocol, __be16 *port, __be16 new_port)
+{
+	struct tcphdr *tcph;
+	struct udphdr *udph;
+	__be16 old_port = *port;
+
+	*port = new_port;
+	switch (protocol) {
+	case IPPROTO_TCP:
+		tcph = (void *)(skb_network_header(skb) + thoff);
+		inet_proto_csum_replace2(&tcph->check, skb, old_port,
+					 new_port, false);
+		break;
+	case IPPROTO_UDP:
+		udph = (void *)(skb_network_header(skb) + thoff);
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL) {
+			inet_proto_csum_replace2(&udph->check, skb, old_port,
+						 new_port, false);
+			if (!udph->check)
+				udph->check = CSUM_MANGLED_0;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static int nf_flow_nat_ports(const struct flow_offload *flow,
+			     struct sk_buff *skb, unsigned int thoff,
+			     u8 protocol, enum flow_offload_tuple_dir dir)
+{
+	const struct flow_offload_tuple *orig, *reply;
+	struct flow_ports {
+		__be16 source, dest;
+	} *ports;
+
+	/* the l4 header was made writable with the address */
+	ports = (void *)(skb_network_header(skb) + thoff);
+	orig = &flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple;
+	reply = &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple;
+
+	if (flow->flags & FLOW_OFFLOAD_SNAT) {
+		if (dir == FLOW_OFFLOAD_DIR_ORIGINAL)
+			nf_flow_nat_port(skb, thoff, protocol, &ports->source,
+					 reply->dst_port);
+		else
+			nf_flow_nat_port(skb, thoff, protocol, &ports->dest,
+					 orig->src_port);
+	}
+	if (flow->flags & FLOW_OFFLOAD_DNAT) {
+		if (dir == FLOW_OFFLOAD_DIR_ORIGINAL)
+			nf_flow_nat_port(skb, thoff, protocol, &ports->dest,
+					 reply->src_port);
+		else
+			nf_flow_nat_port(skb, thoff, protocol, &ports->source,
+					 orig->dst_port);
+	}
+
+	return 0;
+}
+
+static int nf_flow_nat_ip(const struct flow_offload *flow, struct sk_buff *skb,
+			  unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	struct iphdr *iph = ip_hdr(skb);
+
+	if (flow->flags & FLOW_OFFLOAD_SNAT &&
+	    nf_flow_snat_ip(flow, skb, iph, thoff, dir) < 0)
+		return -1;
+	if (flow->flags & FLOW_OFFLOAD_DNAT &&
+	    nf_flow_dnat_ip(flow, skb, ip_hdr(skb), thoff, dir) < 0)
+		return -1;
+
+	return nf_flow_nat_ports(flow, skb, thoff, ip_hdr(skb)->protocol, dir);
+}
+
+static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->len <= mtu)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_network_seglen(skb) <= mtu)
+		return false;
+
+	return true;
+}
+
+unsigned int nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
+				     const struct nf_hook_state *state)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct flow_offload_tuple tuple = {};
+	enum flow_offload_tuple_dir dir;
+	struct flow_offload *flow;
+	struct net_device *outdev;
+	unsigned int thoff, len;
+	struct rtable *rt;
+	struct iphdr *iph;
+	__be32 nexthop;
+
+	if (skb->protocol != htons(ETH_P_IP))
+		return NF_ACCEPT;
+
+	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+		return NF_ACCEPT;
+
+	tuplehash = flow_offload_lookup(&tuple);
+	if (!tuplehash)
+		return NF_ACCEPT;
+
+	dir = tuplehash->tuple.dir;
+	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
+
+	if (unlikely(flow->flags & FLOW_OFFLOAD_TEARDOWN ||
+		     !net_eq(nf_ct_net(flow->ct), state->net)))
+		return NF_ACCEPT;
+
+	if (unlikely(nf_ct_is_dying(flow->ct) || !dst_check(&rt->dst, 0))) {
+		flow_offload_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	len = ntohs(ip_hdr(skb)->tot_len);
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+		return NF_ACCEPT;
+
+	thoff = ip_hdr(skb)->ihl * 4;
+	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
+		return NF_ACCEPT;
+
+	/* from here on the packet is ours: whatever fails drops it */
+	if (pskb_trim_rcsum(skb, len) ||
+	    skb_ensure_writable(skb, thoff))
+		return NF_DROP;
+
+	skb_forward_csum(skb);
+	if (flow->flags & (FLOW_OFFLOAD_SNAT | FLOW_OFFLOAD_DNAT) &&
+	    nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
+		return NF_DROP;
+
+	flow->timeout = jiffies + NF_FLOW_TIMEOUT;
+	atomic_long_inc(&flow->counter[dir].packets);
+	atomic_long_add(len, &flow->counter[dir].bytes);
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+
+	outdev = rt->dst.dev;
+	if (skb_cow_head(skb, LL_RESERVED_SPACE(outdev)))
+		return NF_DROP;
+
+	skb->dev = outdev;
+	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4);
+	skb_dst_set_noref(skb, &rt->dst);
+	neigh_xmit(NEIGH_ARP_TABLE, outdev, &nexthop, skb);
+
+	return NF_STOLEN;
+}
+EXPORT_SYMBOL_GPL(nf_flow_offload_ip_hook);
+
+static void nf_flow_table_unhook(struct flow_offload_hook *hook)
+{
+	if (hook->registered)
+		nf_unregister_net_hook(dev_net(hook->dev), &hook->ops);
+	dev_put(hook->dev);
+	kfree(hook);
+}
+
+/* Only the device notifier removes hooks, and it runs under rtnl too */
+static void nf_flow_table_hook_work(struct work_struct *work)
+{
+	struct flow_offload_hook *hook, *found;
+
+	rtnl_lock();
+	for (;;) {
+		found = NULL;
+		spin_lock_bh(&flow_hooks_lock);
+		list_for_each_entry(hook, &flow_hooks, list) {
+			if (!hook->registered) {
+				found = hook;
+				break;
+			}
+		}
+		spin_unlock_bh(&flow_hooks_lock);
+		if (!found)
+			break;
+
+		if (found->dev->reg_state == NETREG_REGISTERED &&
+		    !nf_register_net_hook(dev_net(found->dev), &found->ops)) {
+			found->registered = true;
+			continue;
+		}
+
+		spin_lock_bh(&flow_hooks_lock);
+		list_del(&found->list);
+		spin_unlock_bh(&flow_hooks_lock);
+		nf_flow_table_unhook(found);
+	}
+	rtnl_unlock();
+}
+
+static DECLARE_WORK(flow_hook_work, nf_flow_table_hook_work);
+
+/**
+ * nf_flow_table_hook_dev - make sure the fast path sees packets from @dev
+ * @dev: input device of offloaded flows
+ *
+ * May be called from softirq; the hook is registered from a work item, so
+ * the first packets after this still take the slow path.
+ */
+int nf_flow_table_hook_dev(struct net_device *dev)
+{
+	struct flow_offload_hook *hook;
+
+	spin_lock_bh(&flow_hooks_lock);
+	list_for_each_entry(hook, &flow_hooks, list) {
+		if (hook->dev == dev) {
+			spin_unlock_bh(&flow_hooks_lock);
+			return 0;
+		}
+	}
+
+	hook = kzalloc(sizeof(*hook), GFP_ATOMIC);
+	if (!hook) {
+		spin_unlock_bh(&flow_hooks_lock);
+		return -ENOMEM;
+	}
+	hook->dev = dev;
+	hook->ops.hook = nf_flow_offload_ip_hook;
+	hook->ops.pf = NFPROTO_NETDEV;
+	hook->ops.hooknum = NF_NETDEV_INGRESS;
+	hook->ops.priority = 0;
+	hook->ops.dev = dev;
+	dev_hold(dev);
+	list_add(&hook->list, &flow_hooks);
+	spin_unlock_bh(&flow_hooks_lock);
+
+	schedule_work(&flow_hook_work);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nf_flow_table_hook_dev);
+
+static int nf_flow_table_netdev_event(struct notifier_block *this,
+				      unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	struct flow_offload_hook *hook, *found = NULL;
+
+	if (event != NETDEV_DOWN && event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	/* flows through the device drop their routes, and with them their
+	 * references to it
+	 */
+	nf_flow_table_gc(dev, false);
+
+	if (event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	spin_lock_bh(&flow_hooks_lock);
+	list_for_each_entry(hook, &flow_hooks, list) {
+		if (hook->dev == dev) {
+			list_del(&hook->list);
+			found = hook;
+			break;
+		}
+	}
+	spin_unlock_bh(&flow_hooks_lock);
+
+	if (found)
+		nf_flow_table_unhook(found);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_flow_table_netdev_notifier = {
+	.notifier_call	= nf_flow_table_netdev_event,
+};
+
+static int __init nf_flow_table_module_init(void)
+{
+	int err;
+
+	err = rhashtable_init(&flow_table, &flow_offload_rhash_params);
+	if (err < 0)
+		return err;
+
+	err = register_netdevice_notifier(&nf_flow_table_netdev_notifier);
+	if (err < 0) {
+		rhashtable_destroy(&flow_table);
+		return err;
+	}
+
+	INIT_DEFERRABLE_WORK(&flow_gc_work, nf_flow_offload_work_gc);
+	queue_delayed_work(system_power_efficient_wq, &flow_gc_work, HZ);
+
+	return 0;
+}
+
+static void __exit nf_flow_table_module_exit(void)
+{
+	struct flow_offload_hook *hook, *next;
+
+	cancel_work_sync(&flow_hook_work);
+	unregister_netdevice_notifier(&nf_flow_table_netdev_notifier);
+
+	rtnl_lock();
+	list_for_each_entry_safe(hook, next, &flow_hooks, list) {
+		list_del(&hook->list);
+		nf_flow_table_unhook(hook);
+	}
+	rtnl_unlock();
+
+	cancel_delayed_work_sync(&flow_gc_work);
+
+	/* with the hooks gone, tear everything down */
+	nf_flow_table_gc(NULL, true);
+
+	rcu_barrier();
+	rhashtable_destroy(&flow_table);
+}
+
+module_init(nf_flow_table_module_init);
+module_exit(nf_flow_table_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Netfilter software flow table fast path");
@@ -0,0 +1,162 @@
+/*
+ * xt_FLOWOFFLOAD - offload established connections to the flow table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/x_tables.h>
+#include <net/route.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_flow_table.h>
+
+/* The packet we are looking at gives us the route of its own direction;
+ * the other one is looked up, and has to leave through the device this
+ * packet came in on, or policy routing sends the two directions different
+ * ways and we had better stay out of it.
+ */
+static int flowoffload_route(struct sk_buff *skb, const struct nf_conn *ct,
+			     const struct xt_action_param *par,
+			     struct dst_entry *route[FLOW_OFFLOAD_DIR_MAX],
+			     enum ip_conntrack_dir dir)
+{
+	struct dst_entry *this_dst = skb_dst(skb);
+	struct flowi4 fl4 = {
+		.daddr		= ct->tuplehash[dir].tuple.src.u3.ip,
+		.flowi4_mark	= skb->mark,
+	};
+	struct rtable *rt;
+
+	if (!this_dst || dst_xfrm(this_dst))
+		return -ENOENT;
+
+	rt = ip_route_output_key(par->net, &fl4);
+	if (IS_ERR(rt))
+		return PTR_ERR(rt);
+
+	if (dst_xfrm(&rt->dst) || rt->dst.dev != par->in ||
+	    rt->rt_flags & (RTCF_LOCAL | RTCF_BROADCAST | RTCF_MULTICAST)) {
+		ip_rt_put(rt);
+		return -ENOENT;
+	}
+
+	route[dir] = this_dst;
+	route[!dir] = &rt->dst;
+
+	return 0;
+}
+
+static bool flowoffload_ct_ok(const struct nf_conn *ct)
+{
+	/* helpers need to see the packets, sequence adjustment to mangle
+	 * them
+	 */
+	if (nfct_help(ct) || test_bit(IPS_SEQ_ADJUST_BIT, &ct->status))
+		return false;
+
+	if (!nf_ct_is_confirmed(ct) || !test_bit(IPS_ASSURED_BIT, &ct->status))
+		return false;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		return ct->proto.tcp.state == TCP_CONNTRACK_ESTABLISHED;
+	case IPPROTO_UDP:
+		return true;
+	}
+
+	return false;
+}
+
+static unsigned int
+flowoffload_tg(struct sk_buff *skb, const struct xt_action_param *par)
+{
+	struct dst_entry *route[FLOW_OFFLOAD_DIR_MAX];
+	enum ip_conntrack_info ctinfo;
+	enum ip_conntrack_dir dir;
+	struct flow_offload *flow;
+	struct nf_conn *ct;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || nf_ct_is_untracked(ct) || !flowoffload_ct_ok(ct))
+		return XT_CONTINUE;
+
+	if (test_and_set_bit(IPS_OFFLOAD_BIT, &ct->status))
+		return XT_CONTINUE;
+
+	dir = CTINFO2DIR(ctinfo);
+	if (flowoffload_route(skb, ct, par, route, dir) < 0)
+		goto err_route;
+
+	flow = flow_offload_alloc(ct, route);
+	if (!flow)
+		goto err_flow_alloc;
+
+	if (flow_offload_add(flow) < 0)
+		goto err_flow_add;
+
+	/* both directions are looked up at ingress */
+	nf_flow_table_hook_dev(route[FLOW_OFFLOAD_DIR_ORIGINAL]->dev);
+	nf_flow_table_hook_dev(route[FLOW_OFFLOAD_DIR_REPLY]->dev);
+
+	dst_release(route[!dir]);
+
+	return XT_CONTINUE;
+
+err_flow_add:
+	flow_offload_free(flow);
+err_flow_alloc:
+	dst_release(route[!dir]);
+err_route:
+	clear_bit(IPS_OFFLOAD_BIT, &ct->status);
+
+	return XT_CONTINUE;
+}
+
+static int flowoffload_chk(const struct xt_tgchk_param *par)
+{
+	int ret;
+
+	ret = nf_ct_l3proto_try_module_get(par->family);
+	if (ret < 0)
+		pr_info("cannot load conntrack support for proto=%u\n",
+			par->family);
+
+	return ret;
+}
+
+static void flowoffload_destroy(const struct xt_tgdtor_param *par)
+{
+	nf_ct_l3proto_module_put(par->family);
+}
+
+static struct xt_target flowoffload_tg_reg __read_mostly = {
+	.name		= "FLOWOFFLOAD",
+	.family		= NFPROTO_IPV4,
+	.hooks		= 1 << NF_INET_FORWARD,
+	.checkentry	= flowoffload_chk,
+	.destroy	= flowoffload_destroy,
+	.target		= flowoffload_tg,
+	.me		= THIS_MODULE,
+};
+
+static int __init xt_flowoffload_tg_init(void)
+{
+	return xt_register_target(&flowoffload_tg_reg);
+}
+
+static void __exit xt_flowoffload_tg_exit(void)
+{
+	xt_unregister_target(&flowoffload_tg_reg);
+}
+
+module_init(xt_flowoffload_tg_init);
+module_exit(xt_flowoffload_tg_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Xtables: offload established connections to the flow table");
+MODULE_ALIAS("ipt_FLOWOFFLOAD");
@@ -0,0 +1,122 @@
+#!/bin/bash
+# Checks the bfq.class cgroup file and the bfq knobs that go with it on a
+# legacy null_blk device: background groups are held to bg_max_rate,
+# foreground groups are weight-raised, and class_latency shows the
+# completion latency of each class.
+
+dev=nullb0
+queue=/sys/block/$dev/queue
+cg=/sys/fs/cgroup/blkio
+rate=1024	# KiB/s
+
+cleanup()
+{
+	rmdir $cg/bfq_fg $cg/bfq_bg 2>/dev/null
+	modprobe -r null_blk 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -d $cg ]; then
+		echo $msg blkio cgroup hierarchy not mounted at $cg >&2
+		exit 0
+	fi
+
+	if ! modprobe null_blk queue_mode=1 irqmode=2 completion_nsec=50000 \
+	     nr_devices=1 2>/dev/null || [ ! -e $queue/scheduler ]; then
+		echo $msg null_blk not available >&2
+		exit 0
+	fi
+
+	modprobe -q bfq-iosched
+	if ! echo bfq > $queue/scheduler 2>/dev/null ||
+	   [ ! -e $queue/iosched/class_latency ] ||
+	   ! mkdir $cg/bfq_fg $cg/bfq_bg 2>/dev/null ||
+	   [ ! -e $cg/bfq_fg/blkio.bfq.class ]; then
+		echo $msg bfq with group scheduling not available >&2
+		exit 0
+	fi
+}
+
+# Run dd reading from the device for $2 seconds in cgroup $1, print KiB/s.
+read_rate()
+{
+	local bytes
+
+	bytes=$(sh -c "echo \$\$ > $cg/$1/tasks; exec timeout -s INT $2 \
+		dd if=/dev/$dev of=/dev/null bs=64k iflag=direct" 2>&1 | \
+		awk '/bytes/ { print $1 }')
+	echo $(( ${bytes:-0} / 1024 / $2 ))
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+
+if echo foreground > $cg/bfq_fg/blkio.bfq.class &&
+   echo background > $cg/bfq_bg/blkio.bfq.class &&
+   grep -q '\[foreground\]' $cg/bfq_fg/blkio.bfq.class &&
+   ! echo bogus > $cg/bfq_bg/blkio.bfq.class 2>/dev/null; then
+	echo "bfq: set group class: [PASS]"
+else
+	echo "bfq: set group class: [FAIL]"
+	ret=1
+fi
+
+echo $rate > $queue/iosched/bg_max_rate
+got=$(read_rate bfq_bg 3)
+# one window of slack
+if [ $got -gt 0 ] && [ $got -le $(( rate * 11 / 10 )) ]; then
+	echo "bfq: background capped at ${got} KiB/s of $rate: [PASS]"
+else
+	echo "bfq: background capped at ${got} KiB/s of $rate: [FAIL]"
+	ret=1
+fi
+echo 0 > $queue/iosched/bg_max_rate
+
+echo 0 > $queue/iosched/class_latency
+echo 0 > $queue/iosched/low_latency
+read_rate bfq_fg 1 >/dev/null
+# columns: bucket none foreground background
+fg=$(awk 'NR > 1 { n += $3 } END { print n + 0 }' $queue/iosched/class_latency)
+if [ $fg -gt 0 ]; then
+	echo "bfq: foreground latency histogram ($fg requests): [PASS]"
+else
+	echo "bfq: foreground latency histogram: [FAIL]"
+	ret=1
+fi
+
+# raised even with low_latency off, weights are at most 100 otherwise
+sh -c "echo \$\$ > $cg/bfq_fg/tasks; exec dd if=/dev/$dev of=/dev/null \
+	bs=4k count=100000 iflag=direct" 2>/dev/null &
+sleep 0.2
+if awk '/^Active/ { a = 1 } /^Idle/ { a = 0 }
+	a && /weight/ && $3 + 0 > 1000 { f = 1 } END { exit !f }' \
+	$queue/iosched/weights; then
+	echo "bfq: foreground raised with low_latency off: [PASS]"
+else
+	echo "bfq: foreground raised with low_latency off: [FAIL]"
+	ret=1
+fi
+kill $! 2>/dev/null
+wait
+echo 1 > $queue/iosched/low_latency
+
+if echo 1 > $queue/iosched/class_latency &&
+   [ $(awk 'NR > 1 { n += $2 + $3 + $4 } END { print n + 0 }' \
+	$queue/iosched/class_latency) -eq 0 ]; then
+	echo "bfq: reset latency histogram: [PASS]"
+else
+	echo "bfq: reset latency histogram: [FAIL]"
+	ret=1
+fi
+
+exit $ret
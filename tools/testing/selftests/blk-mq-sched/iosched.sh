@@ -0,0 +1,95 @@
+#!/bin/bash
+# Checks that blk-mq devices can switch between no scheduler, mq-deadline
+# and kyber, also while I/O is running, and compares random read latency
+# next to a streaming writer on a null_blk device with each of them.
+
+dev=nullb0
+sched=/sys/block/$dev/queue/scheduler
+
+cleanup()
+{
+	modprobe -r null_blk 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if ! which fio >/dev/null 2>&1; then
+		echo $msg fio not found >&2
+		exit 0
+	fi
+
+	# timer completions, so the device has a latency to protect
+	if ! modprobe null_blk queue_mode=2 irqmode=2 completion_nsec=50000 \
+	     hw_queue_depth=64 nr_devices=1 2>/dev/null || [ ! -e $sched ]; then
+		echo $msg null_blk not available >&2
+		exit 0
+	fi
+}
+
+set_sched()
+{
+	modprobe -q $1-iosched
+	echo $1 > $sched 2>/dev/null && grep -q "\[$1\]" $sched
+}
+
+# Print the 99th percentile read completion latency in usec.
+read_p99()
+{
+	# terse v3: field 30 is the 99th clat percentile, "99.000000%=usec"
+	fio --output-format=terse --terse-version=3 --filename=/dev/$dev \
+		mixed.fio | awk -F';' '$3 == "reader" { print $30 }' | \
+		cut -d= -f2
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+for s in mq-deadline kyber none; do
+	if ! grep -qw "$s" $sched && ! modprobe -q $s-iosched; then
+		echo "blk-mq-sched: $s not available, skipping"
+		continue
+	fi
+	if set_sched $s; then
+		echo "blk-mq-sched: switch to $s: [PASS]"
+	else
+		echo "blk-mq-sched: switch to $s: [FAIL]"
+		ret=1
+	fi
+done
+
+# switching has to drain the old scheduler's requests
+dd if=/dev/$dev of=/dev/null bs=4k count=200000 iflag=direct 2>/dev/null &
+for i in $(seq 20); do
+	for s in mq-deadline kyber none; do
+		set_sched $s
+	done
+done
+if wait $!; then
+	echo "blk-mq-sched: switch under I/O: [PASS]"
+else
+	echo "blk-mq-sched: switch under I/O: [FAIL]"
+	ret=1
+fi
+
+result="bench: 4k randread p99 with a streaming writer:"
+for s in none mq-deadline kyber; do
+	set_sched $s || continue
+	p99=$(read_p99)
+	if [ -z "$p99" ]; then
+		echo "blk-mq-sched: fio with $s: [FAIL]"
+		ret=1
+		continue
+	fi
+	result="$result $s ${p99}us"
+done
+echo "$result"
+
+exit $ret
@@ -0,0 +1,118 @@
+/*
+ * Synchronous O_DIRECT reads through preadv2(), with RWF_HIPRI so the
+ * completions get polled for if the queue allows it.  Prints the mean
+ * read latency and the CPU time spent per read, for comparing interrupt,
+ * classic and hybrid polling.
+ *
+ * Usage: hipri_read <device> [reads] [block size]
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#ifndef __NR_preadv2
+# define __NR_preadv2	286
+#endif
+
+#ifndef RWF_HIPRI
+# define RWF_HIPRI	0x00000001
+#endif
+
+static ssize_t sys_preadv2(int fd, const struct iovec *iov, int iovcnt,
+			   off_t offset, int flags)
+{
+	unsigned long pos = offset;
+
+	return syscall(__NR_preadv2, fd, iov, iovcnt, pos,
+		       (unsigned long)((uint64_t)offset >> 32), flags);
+}
+
+static uint64_t ts_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cpu_ns(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long i, reads = 20000;
+	size_t bs = 4096;
+	uint64_t start, cpu, lat = 0;
+	struct iovec iov;
+	off_t size;
+	void *buf;
+	int fd;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <device> [reads] [block size]\n",
+			argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		reads = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		bs = strtoul(argv[3], NULL, 0);
+
+	fd = open(argv[1], O_RDONLY | O_DIRECT);
+	if (fd < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	size = lseek(fd, 0, SEEK_END);
+	if (size < (off_t)bs) {
+		fprintf(stderr, "%s: too small\n", argv[1]);
+		return 1;
+	}
+	if (posix_memalign(&buf, 4096, bs))
+		return 1;
+	iov.iov_base = buf;
+	iov.iov_len = bs;
+
+	/* an unknown flag has to be refused */
+	if (sys_preadv2(fd, &iov, 1, 0, ~RWF_HIPRI) >= 0 ||
+	    errno != EOPNOTSUPP) {
+		fprintf(stderr, "preadv2: bad flags not refused\n");
+		return 1;
+	}
+
+	srandom(1);
+	cpu = cpu_ns();
+	for (i = 0; i < reads; i++) {
+		off_t pos = (random() % (size / bs)) * bs;
+		ssize_t ret;
+
+		start = ts_ns(CLOCK_MONOTONIC);
+		ret = sys_preadv2(fd, &iov, 1, pos, RWF_HIPRI);
+		lat += ts_ns(CLOCK_MONOTONIC) - start;
+		if (ret != (ssize_t)bs) {
+			fprintf(stderr, "preadv2: %s\n",
+				ret < 0 ? strerror(errno) : "short read");
+			return 1;
+		}
+	}
+	cpu = cpu_ns() - cpu;
+
+	/* mean latency and cpu time per read, in nsecs */
+	printf("%llu %llu\n", (unsigned long long)(lat / reads),
+	       (unsigned long long)(cpu / reads));
+	return 0;
+}
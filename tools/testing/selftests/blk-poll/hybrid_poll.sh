@@ -0,0 +1,103 @@
+#!/bin/bash
+# Compares interrupt completions, classic polling and hybrid polling on a
+# blk-mq null_blk device with fixed timer completions: mean read latency
+# and CPU time per read, through preadv2(RWF_HIPRI) O_DIRECT reads.
+# Polling should not be slower than interrupts, and hybrid polling should
+# burn less CPU than spinning for the whole wait.
+
+dev=nullb0
+queue=/sys/block/$dev/queue
+reads=20000
+# completion time of every command, in nsecs
+lat=50000
+
+cleanup()
+{
+	modprobe -r null_blk 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./hipri_read ]; then
+		echo $msg hipri_read not built >&2
+		exit 0
+	fi
+
+	if ! modprobe null_blk queue_mode=2 irqmode=2 \
+	     completion_nsec=$lat nr_devices=1 2>/dev/null; then
+		echo $msg null_blk not available >&2
+		exit 0
+	fi
+	if [ ! -e $queue/io_poll_delay ]; then
+		echo $msg io_poll_delay not available >&2
+		exit 0
+	fi
+}
+
+# run <io_poll> <io_poll_delay>: prints "latency cpu" per read in nsecs
+run()
+{
+	echo $1 > $queue/io_poll
+	echo $2 > $queue/io_poll_delay
+	./hipri_read /dev/$dev $reads
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+
+irq=$(run 0 -1) || exit 1
+classic=$(run 1 -1) || exit 1
+hybrid=$(run 1 0) || exit 1
+
+printf "%-10s %12s %12s\n" mode "lat ns" "cpu ns"
+for m in irq classic hybrid; do
+	printf "%-10s %12s %12s\n" $m ${!m}
+done
+
+set -- $irq $classic $hybrid
+irq_lat=$1 irq_cpu=$2 classic_lat=$3 classic_cpu=$4 hybrid_lat=$5 hybrid_cpu=$6
+
+invoked=$(sed -n 's/invoked=\([0-9]*\),.*/\1/p' \
+	/sys/block/$dev/mq/0/io_poll 2>/dev/null)
+if [ ${invoked:-0} -gt 0 ]; then
+	echo "blk-poll: completions polled for: [PASS]"
+else
+	echo "blk-poll: completions polled for: [FAIL]"
+	ret=1
+fi
+
+# allow for a bit of noise against interrupts
+if [ $classic_lat -le $((irq_lat + irq_lat / 10)) ]; then
+	echo "blk-poll: classic polling latency: [PASS]"
+else
+	echo "blk-poll: classic polling latency: [FAIL]"
+	ret=1
+fi
+
+if [ $hybrid_cpu -lt $classic_cpu ]; then
+	echo "blk-poll: hybrid polling cpu usage: [PASS]"
+else
+	echo "blk-poll: hybrid polling cpu usage: [FAIL]"
+	ret=1
+fi
+
+# a fixed sleep of half the completion time
+echo $((lat / 2000)) > $queue/io_poll_delay
+if [ "$(cat $queue/io_poll_delay)" = "$((lat / 2000))" ] &&
+   ! echo -2 > $queue/io_poll_delay 2>/dev/null; then
+	echo "blk-poll: io_poll_delay: [PASS]"
+else
+	echo "blk-poll: io_poll_delay: [FAIL]"
+	ret=1
+fi
+
+exit $ret
@@ -0,0 +1,107 @@
+#!/bin/bash
+# Checks the per-operation latency histograms in queue/stats on legacy
+# and blk-mq null_blk devices, and the per-cgroup inflight counts while
+# a reader is stuck behind a slow device.
+
+dev=nullb0
+stats=/sys/block/$dev/queue/stats
+
+cleanup()
+{
+	[ -n "$cgdir" ] && rmdir $cgdir 2>/dev/null
+	modprobe -r null_blk 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if ! modprobe null_blk nr_devices=1 2>/dev/null; then
+		echo $msg null_blk not available >&2
+		exit 0
+	fi
+	if [ ! -e $stats ]; then
+		echo $msg queue/stats not available >&2
+		exit 0
+	fi
+	modprobe -r null_blk
+}
+
+# Print the number of samples in column $1 (2 = read, 3 = write).
+samples()
+{
+	awk -v c=$1 '$1 ~ /^[0-9]+$/ || $1 == "inf" { n += $c }
+		END { print n + 0 }' $stats
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+
+# legacy request path and blk-mq, bio-based null_blk has no requests
+for mode in 1 2; do
+	modprobe null_blk queue_mode=$mode irqmode=2 completion_nsec=200000 \
+		nr_devices=1
+
+	echo 1 > $stats
+	# udev may read the new device too
+	dd if=/dev/$dev of=/dev/null bs=4k count=100 iflag=direct 2>/dev/null
+	dd if=/dev/zero of=/dev/$dev bs=4k count=50 oflag=direct 2>/dev/null
+	reads=$(samples 2)
+	writes=$(samples 3)
+	# 200us completions land below 256us, or 512us with some overhead
+	slot=$(awk '$1 == 256 || $1 == 512 { n += $2 } END { print n + 0 }' \
+		$stats)
+	if [ $reads -ge 100 ] && [ $writes -eq 50 ] && [ ${slot:-0} -gt 0 ]; then
+		echo "blk-stat: queue_mode=$mode $reads reads $writes writes: [PASS]"
+	else
+		echo "blk-stat: queue_mode=$mode $reads reads $writes writes: [FAIL]"
+		ret=1
+	fi
+
+	echo 1 > $stats
+	if [ $(samples 2) -eq 0 ] && [ $(samples 3) -eq 0 ]; then
+		echo "blk-stat: queue_mode=$mode clear: [PASS]"
+	else
+		echo "blk-stat: queue_mode=$mode clear: [FAIL]"
+		ret=1
+	fi
+
+	modprobe -r null_blk
+done
+
+cg=$(awk '$3 == "cgroup" && $4 ~ /blkio/ { print $2; exit }' /proc/mounts)
+if [ -z "$cg" ] || [ ! -e $cg/blkio.inflight ]; then
+	echo "blk-stat: blkio cgroup not mounted, skipping inflight test"
+	exit $ret
+fi
+
+# one second completions keep the reads in flight
+modprobe null_blk queue_mode=2 irqmode=2 completion_nsec=1000000000 \
+	nr_devices=1
+cgdir=$cg/blk_stat
+mkdir $cgdir
+sh -c "echo \$\$ > $cgdir/tasks; exec dd if=/dev/$dev of=/dev/null \
+	bs=4k count=2 iflag=direct" 2>/dev/null &
+sleep 0.5
+if grep -q "read=1 write=0" $cgdir/blkio.inflight; then
+	echo "blk-stat: cgroup inflight: [PASS]"
+else
+	echo "blk-stat: cgroup inflight: [FAIL]"
+	ret=1
+fi
+wait
+if [ -z "$(cat $cgdir/blkio.inflight)" ]; then
+	echo "blk-stat: cgroup inflight drained: [PASS]"
+else
+	echo "blk-stat: cgroup inflight drained: [FAIL]"
+	ret=1
+fi
+
+exit $ret
@@ -0,0 +1,132 @@
+#!/bin/bash
+# Checks io.low on a null_blk device: a group without a low limit is let
+# past the token rate once the group with one is idle, and the group with
+# a low limit keeps the larger share while both run fio readers under a
+# parent capped by io.max.
+
+dev=nullb0
+devno=
+cg=
+parent=
+
+cleanup()
+{
+	[ -n "$parent" ] && rmdir $parent/a $parent/b $parent 2>/dev/null
+	modprobe -r null_blk 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if ! which fio >/dev/null 2>&1; then
+		echo $msg fio not found >&2
+		exit 0
+	fi
+
+	cg=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+	if [ -z "$cg" ] || ! grep -qw io $cg/cgroup.controllers; then
+		echo $msg cgroup2 with the io controller not mounted >&2
+		exit 0
+	fi
+
+	if ! modprobe null_blk queue_mode=2 irqmode=2 completion_nsec=50000 \
+	     nr_devices=1 2>/dev/null || [ ! -e /sys/block/$dev/dev ]; then
+		echo $msg null_blk not available >&2
+		exit 0
+	fi
+	devno=$(cat /sys/block/$dev/dev)
+
+	parent=$cg/throtl_low
+	echo +io > $cg/cgroup.subtree_control
+	if ! mkdir $parent 2>/dev/null ||
+	   ! echo +io > $parent/cgroup.subtree_control ||
+	   ! mkdir $parent/a $parent/b 2>/dev/null ||
+	   [ ! -e $parent/a/io.low ]; then
+		echo $msg io.low not available >&2
+		exit 0
+	fi
+}
+
+# Start a reader in cgroup $1, its read bandwidth in KiB/s goes to $2.
+start_reader()
+{
+	# terse v3: field 7 is the read bandwidth in KiB/s
+	sh -c "echo \$\$ > $parent/$1/cgroup.procs; exec fio \
+		--output-format=terse --terse-version=3 \
+		--filename=/dev/$dev reader.fio" | \
+		awk -F';' '$3 == "reader" { print $7 }' > $2 &
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+mib=$(( 1024 * 1024 ))
+
+echo "$devno rbps=$(( 40 * mib ))" > $parent/io.max
+echo "$devno rbps=$(( 50 * mib )) idle=2000 latency=0" > $parent/a/io.low
+if grep -q "^$devno rbps=$(( 50 * mib )) .* idle=2000 latency=0" \
+	$parent/a/io.low; then
+	echo "blk-throttle: set io.low: [PASS]"
+else
+	echo "blk-throttle: set io.low: [FAIL]"
+	ret=1
+fi
+echo "$devno rbps=$(( 20 * mib ))" > $parent/a/io.low
+echo "$devno rbps=$(( 10 * mib ))" > $parent/a/io.max
+if grep -q "^$devno rbps=$(( 10 * mib )) " $parent/a/io.low; then
+	echo "blk-throttle: io.low clamped to io.max: [PASS]"
+else
+	echo "blk-throttle: io.low clamped to io.max: [FAIL]"
+	ret=1
+fi
+echo "$devno rbps=max" > $parent/a/io.max
+echo "$devno rbps=$(( 20 * mib ))" > $parent/a/io.low
+
+# a idle: b gets past the 320 KiB/s given to groups without a low limit
+b_alone=$(mktemp)
+start_reader b $b_alone
+wait
+got=$(cat $b_alone)
+if [ ${got:-0} -gt $(( 4 * 1024 )) ]; then
+	echo "blk-throttle: b alone at ${got} KiB/s: [PASS]"
+else
+	echo "blk-throttle: b alone at ${got:-0} KiB/s: [FAIL]"
+	ret=1
+fi
+
+# both busy: a is held near its low limit, b gets what is left
+a_both=$(mktemp)
+b_both=$(mktemp)
+start_reader a $a_both
+start_reader b $b_both
+wait
+a=$(cat $a_both)
+b=$(cat $b_both)
+if [ ${a:-0} -gt ${b:-0} ] && [ ${a:-0} -gt $(( 20 * 1024 / 2 )) ]; then
+	echo "blk-throttle: a ${a} KiB/s, b ${b} KiB/s: [PASS]"
+else
+	echo "blk-throttle: a ${a:-0} KiB/s, b ${b:-0} KiB/s: [FAIL]"
+	ret=1
+fi
+
+# removing the last low limit lifts the token rate
+echo "$devno rbps=0" > $parent/a/io.low
+start_reader b $b_alone
+wait
+got=$(cat $b_alone)
+if [ ${got:-0} -gt $(( 20 * 1024 )) ]; then
+	echo "blk-throttle: b at ${got} KiB/s without low limits: [PASS]"
+else
+	echo "blk-throttle: b at ${got:-0} KiB/s without low limits: [FAIL]"
+	ret=1
+fi
+
+rm -f $b_alone $a_both $b_both
+exit $ret
@@ -0,0 +1,327 @@
+/*
+ * copy_file_range selftest and throughput test
+ *
+ * Checks argument handling, offset updates, block aligned, unaligned and
+ * sparse copies, and then compares the throughput of copy_file_range()
+ * against a plain read()/write() loop. Files are created in the directory
+ * given as the first argument (default: the current directory), so the
+ * filesystem specific paths can be exercised by pointing it at an f2fs or
+ * ext4 mount.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#ifndef __NR_copy_file_range
+# if defined(__x86_64__)
+#  define __NR_copy_file_range	326
+# elif defined(__i386__)
+#  define __NR_copy_file_range	377
+# else
+#  define __NR_copy_file_range	285
+# endif
+#endif
+
+#define BLOCK_SIZE	4096
+#define BENCH_SIZE	(64 << 20)
+#define BENCH_CHUNK	(1 << 20)
+
+static const char *dir = ".";
+
+static ssize_t sys_copy_file_range(int fd_in, loff_t *off_in, int fd_out,
+				   loff_t *off_out, size_t len,
+				   unsigned int flags)
+{
+	return syscall(__NR_copy_file_range, fd_in, off_in, fd_out, off_out,
+		       len, flags);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int tmpfile_in_dir(void)
+{
+	char path[4096];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/copy_file_range.XXXXXX", dir);
+	fd = mkstemp(path);
+	if (fd >= 0)
+		unlink(path);
+	return fd;
+}
+
+static void fill(char *buf, size_t len, unsigned int seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (char)(seed + i * 7);
+}
+
+/* copy everything, looping over short copies like cp(1) would */
+static int copy_all(int in, loff_t pos_in, int out, loff_t pos_out,
+		    size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = sys_copy_file_range(in, &pos_in, out, &pos_out, len, 0);
+		if (ret < 0)
+			return -errno;
+		if (ret == 0)
+			break;
+		len -= ret;
+	}
+	return len ? -EIO : 0;
+}
+
+static int check_range(int fd, loff_t pos, const char *expect, size_t len)
+{
+	char *buf = malloc(len);
+	int ret = 0;
+
+	if (!buf)
+		return -ENOMEM;
+	if (pread(fd, buf, len, pos) != (ssize_t)len ||
+	    memcmp(buf, expect, len))
+		ret = -EINVAL;
+	free(buf);
+	return ret;
+}
+
+static int test_args(void)
+{
+	char buf[BLOCK_SIZE];
+	loff_t off_in = 0, off_out = 0;
+	int in, out, ret = 0;
+
+	in = tmpfile_in_dir();
+	out = tmpfile_in_dir();
+	if (in < 0 || out < 0)
+		return -errno;
+	fill(buf, sizeof(buf), 1);
+	if (write(in, buf, sizeof(buf)) != sizeof(buf))
+		return -EIO;
+
+	if (sys_copy_file_range(in, &off_in, out, &off_out, 1, 1) != -1 ||
+	    errno != EINVAL) {
+		printf("args: nonzero flags accepted\n");
+		ret = -EINVAL;
+	}
+
+	/* overlapping ranges within the same file */
+	off_in = 0;
+	off_out = 100;
+	if (sys_copy_file_range(in, &off_in, in, &off_out, 1000, 0) != -1 ||
+	    errno != EINVAL) {
+		printf("args: overlapping copy accepted\n");
+		ret = -EINVAL;
+	}
+
+	/* explicit offsets are advanced, the file positions are not */
+	off_in = 0;
+	off_out = 0;
+	if (sys_copy_file_range(in, &off_in, out, &off_out, 100, 0) != 100 ||
+	    off_in != 100 || off_out != 100 ||
+	    lseek(in, 0, SEEK_CUR) != sizeof(buf) ||
+	    lseek(out, 0, SEEK_CUR) != 0) {
+		printf("args: explicit offsets not handled\n");
+		ret = -EINVAL;
+	}
+
+	/* NULL offsets use and advance the file positions */
+	lseek(in, 200, SEEK_SET);
+	lseek(out, 0, SEEK_SET);
+	if (sys_copy_file_range(in, NULL, out, NULL, 100, 0) != 100 ||
+	    lseek(in, 0, SEEK_CUR) != 300 || lseek(out, 0, SEEK_CUR) != 100 ||
+	    check_range(out, 0, buf + 200, 100)) {
+		printf("args: file positions not handled\n");
+		ret = -EINVAL;
+	}
+
+	/* nothing to copy at EOF */
+	off_in = sizeof(buf);
+	if (sys_copy_file_range(in, &off_in, out, NULL, 100, 0) != 0) {
+		printf("args: copy past EOF returned data\n");
+		ret = -EINVAL;
+	}
+
+	close(in);
+	close(out);
+	return ret;
+}
+
+static int test_copy(size_t size, loff_t pos_in, loff_t pos_out,
+		     size_t len, const char *what)
+{
+	char *buf, *dst;
+	int in, out, ret;
+
+	buf = malloc(size);
+	dst = malloc(pos_out + len);
+	in = tmpfile_in_dir();
+	out = tmpfile_in_dir();
+	if (!buf || !dst || in < 0 || out < 0)
+		return -ENOMEM;
+
+	fill(buf, size, 3);
+	fill(dst, pos_out + len, 5);
+	if (pwrite(in, buf, size, 0) != (ssize_t)size ||
+	    pwrite(out, dst, pos_out + len, 0) != (ssize_t)(pos_out + len))
+		return -EIO;
+	/* the destination must not see stale cached data either */
+	fsync(out);
+
+	ret = copy_all(in, pos_in, out, pos_out, len);
+	if (!ret)
+		ret = check_range(out, pos_out, buf + pos_in, len);
+	if (!ret)
+		ret = check_range(out, 0, dst, pos_out);
+	if (ret)
+		printf("copy: %s failed\n", what);
+
+	close(in);
+	close(out);
+	free(buf);
+	free(dst);
+	return ret;
+}
+
+static int test_sparse(void)
+{
+	char buf[BLOCK_SIZE], zero[BLOCK_SIZE * 4];
+	int in, out, ret;
+
+	in = tmpfile_in_dir();
+	out = tmpfile_in_dir();
+	if (in < 0 || out < 0)
+		return -errno;
+
+	/* data, three block hole, data */
+	fill(buf, sizeof(buf), 9);
+	memset(zero, 0, sizeof(zero));
+	if (pwrite(in, buf, sizeof(buf), 0) != sizeof(buf) ||
+	    pwrite(in, buf, sizeof(buf), 4 * BLOCK_SIZE) != sizeof(buf))
+		return -EIO;
+
+	/* the hole has to overwrite existing destination data */
+	fill(zero, sizeof(zero), 11);
+	if (pwrite(out, zero, sizeof(zero), BLOCK_SIZE) != sizeof(zero))
+		return -EIO;
+	memset(zero, 0, sizeof(zero));
+
+	ret = copy_all(in, 0, out, 0, 5 * BLOCK_SIZE);
+	if (!ret)
+		ret = check_range(out, 0, buf, sizeof(buf));
+	if (!ret)
+		ret = check_range(out, BLOCK_SIZE, zero, 3 * BLOCK_SIZE);
+	if (!ret)
+		ret = check_range(out, 4 * BLOCK_SIZE, buf, sizeof(buf));
+	if (ret)
+		printf("copy: sparse source failed\n");
+
+	close(in);
+	close(out);
+	return ret;
+}
+
+static int bench(void)
+{
+	char *buf = malloc(BENCH_CHUNK);
+	uint64_t start, rw_ns, cfr_ns;
+	loff_t pos;
+	int in, out, ret;
+
+	in = tmpfile_in_dir();
+	out = tmpfile_in_dir();
+	if (!buf || in < 0 || out < 0)
+		return -ENOMEM;
+
+	for (pos = 0; pos < BENCH_SIZE; pos += BENCH_CHUNK) {
+		fill(buf, BENCH_CHUNK, pos);
+		if (pwrite(in, buf, BENCH_CHUNK, pos) != BENCH_CHUNK)
+			return -EIO;
+	}
+	fsync(in);
+
+	start = now_ns();
+	for (pos = 0; pos < BENCH_SIZE; pos += BENCH_CHUNK) {
+		if (pread(in, buf, BENCH_CHUNK, pos) != BENCH_CHUNK ||
+		    pwrite(out, buf, BENCH_CHUNK, pos) != BENCH_CHUNK)
+			return -EIO;
+	}
+	fsync(out);
+	rw_ns = now_ns() - start;
+
+	ftruncate(out, 0);
+	fsync(out);
+
+	start = now_ns();
+	ret = copy_all(in, 0, out, 0, BENCH_SIZE);
+	fsync(out);
+	cfr_ns = now_ns() - start;
+	if (ret)
+		return ret;
+
+	printf("bench: %d MiB, read/write %llu MiB/s, copy_file_range %llu MiB/s\n",
+	       BENCH_SIZE >> 20,
+	       (unsigned long long)((BENCH_SIZE >> 20) * 1000000000ULL / rw_ns),
+	       (unsigned long long)((BENCH_SIZE >> 20) * 1000000000ULL / cfr_ns));
+
+	close(in);
+	close(out);
+	free(buf);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret, fail = 0;
+
+	if (argc > 1)
+		dir = argv[1];
+
+	if (sys_copy_file_range(-1, NULL, -1, NULL, 0, 0) < 0 &&
+	    errno == ENOSYS) {
+		printf("copy_file_range not supported, skipping test\n");
+		return 0;
+	}
+
+	ret = test_args();
+	printf("copy_file_range: arguments: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_copy(16 * BLOCK_SIZE, 0, 0, 16 * BLOCK_SIZE, "aligned");
+	ret = ret ?: test_copy(16 * BLOCK_SIZE, BLOCK_SIZE, 3 * BLOCK_SIZE,
+			       8 * BLOCK_SIZE, "aligned, offset");
+	ret = ret ?: test_copy(16 * BLOCK_SIZE + 123, 0, 0,
+			       16 * BLOCK_SIZE + 123, "unaligned tail");
+	ret = ret ?: test_copy(16 * BLOCK_SIZE, 100, 5000, 9000, "unaligned");
+	printf("copy_file_range: data: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_sparse();
+	printf("copy_file_range: sparse: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = bench();
+	printf("copy_file_range: throughput: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	return fail;
+}
@@ -0,0 +1,146 @@
+#!/bin/bash
+# Compares the cpuidle governors on the same idle pattern: periodic timers
+# with a share of early, non-timer wakeups (idle_load). For every governor
+# that can be selected through current_governor (boot with
+# cpuidle_sysfs_switch; under QEMU use a machine with PSCI idle states in
+# its device tree), prints per idle state how often it was entered, its
+# mean residency from the cpu_idle tracepoint, and how often it turned out
+# too deep ("above") or too shallow ("below"). Checks that the above and
+# below counters exist and that the governors could be switched.
+
+cpuidle=/sys/devices/system/cpu/cpuidle
+tracing=/sys/kernel/debug/tracing
+seconds=10
+
+saved_gov=
+
+cleanup()
+{
+	[ -n "$saved_gov" ] && echo $saved_gov > $cpuidle/current_governor
+	[ -e $tracing/events/power/cpu_idle/enable ] &&
+		echo 0 > $tracing/events/power/cpu_idle/enable
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./idle_load ]; then
+		echo $msg idle_load not built >&2
+		exit 0
+	fi
+
+	if [ ! -d /sys/devices/system/cpu/cpu0/cpuidle/state0 ]; then
+		echo $msg no cpuidle states >&2
+		exit 0
+	fi
+
+	if [ ! -w $cpuidle/current_governor ]; then
+		echo $msg governors cannot be switched, boot with cpuidle_sysfs_switch >&2
+		exit 0
+	fi
+
+	if [ ! -e $tracing/events/power/cpu_idle/enable ]; then
+		echo $msg cpu_idle tracepoint not available >&2
+		exit 0
+	fi
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "governor_eval: $1: [PASS]"
+	else
+		echo "governor_eval: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# sum <attr> <state>: attribute of an idle state summed over all cpus
+sum()
+{
+	cat /sys/devices/system/cpu/cpu*/cpuidle/state$2/$1 2>/dev/null |
+		awk '{ s += $1 } END { print s + 0 }'
+}
+
+# run <governor>: one line per idle state,
+# "state entries mean_residency_us above below"
+run()
+{
+	local gov=$1 st nstates
+	local -a usage above below
+
+	echo $gov > $cpuidle/current_governor
+	nstates=$(ls -d /sys/devices/system/cpu/cpu0/cpuidle/state* | wc -l)
+
+	for st in $(seq 0 $((nstates - 1))); do
+		usage[$st]=$(sum usage $st)
+		above[$st]=$(sum above $st)
+		below[$st]=$(sum below $st)
+	done
+
+	echo > $tracing/trace
+	echo 1 > $tracing/events/power/cpu_idle/enable
+	./idle_load -s $seconds > /dev/null
+	echo 0 > $tracing/events/power/cpu_idle/enable
+
+	# residency per state from the enter/exit pairs of every cpu
+	awk '/cpu_idle:/ {
+		match($0, /[0-9]+\.[0-9]+: cpu_idle/);
+		t = substr($0, RSTART, RLENGTH - 10);
+		match($0, /state=[0-9]+/);
+		st = substr($0, RSTART + 6, RLENGTH - 6);
+		match($0, /cpu_id=[0-9]+/);
+		cpu = substr($0, RSTART + 7, RLENGTH - 7);
+		if (st == "4294967295") {
+			if (cpu in enter) {
+				res[cur[cpu]] += t - enter[cpu];
+				n[cur[cpu]]++;
+				delete enter[cpu];
+			}
+		} else {
+			enter[cpu] = t;
+			cur[cpu] = st;
+		}
+	}
+	END { for (s in n) printf "%d %d\n", s, res[s] * 1000000 / n[s] }' \
+		$tracing/trace > /tmp/governor_eval.$$
+
+	for st in $(seq 0 $((nstates - 1))); do
+		echo $st $(($(sum usage $st) - usage[$st])) \
+			$(awk -v s=$st '$1 == s { print $2 }' /tmp/governor_eval.$$) \
+			$(($(sum above $st) - above[$st])) \
+			$(($(sum below $st) - below[$st]))
+	done
+	rm -f /tmp/governor_eval.$$
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+saved_gov=$(cat $cpuidle/current_governor)
+
+pass "above/below counters" \
+	"[ -e /sys/devices/system/cpu/cpu0/cpuidle/state0/above ] &&
+	 [ -e /sys/devices/system/cpu/cpu0/cpuidle/state0/below ]"
+
+for gov in $(cat $cpuidle/available_governors); do
+	[ $gov = ladder ] && continue
+
+	printf "%s\n%-6s %10s %12s %10s %10s\n" "$gov:" state entries \
+		residency_us above below
+	run $gov | while read st entries res above below; do
+		printf "%-6s %10s %12s %10s %10s\n" $st $entries ${res:-0} \
+			$above $below
+	done
+	pass "$gov selected" "[ \$(cat $cpuidle/current_governor) = $gov ]"
+done
+
+exit $ret
@@ -0,0 +1,143 @@
+/*
+ * Idle pattern generator for comparing cpuidle governors. Every thread
+ * sleeps on a periodic timer and, with the given probability, is woken
+ * up early by another thread writing to its pipe at a random point of the
+ * period, the way an interrupt-driven wakeup would. A governor that trusts
+ * the timer too much pays for the early wakeups with wasted exit latency,
+ * one that does not trust it enough stays in shallow states.
+ *
+ * Usage: idle_load [-t threads] [-p period_us] [-e early_pct] [-s seconds]
+ */
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned int nr_threads = 2;
+static unsigned int period_us = 4000;
+static unsigned int early_pct = 30;
+static unsigned int seconds = 10;
+
+static volatile int stop;
+
+struct sleeper {
+	int pipe[2];
+	unsigned int seed;
+	unsigned long timer_wakeups;
+	unsigned long early_wakeups;
+};
+
+static void *sleeper(void *arg)
+{
+	struct sleeper *s = arg;
+	struct pollfd pfd = { .fd = s->pipe[0], .events = POLLIN };
+	char buf[64];
+
+	while (!stop) {
+		if (poll(&pfd, 1, period_us / 1000 ? period_us / 1000 : 1) > 0) {
+			if (read(s->pipe[0], buf, sizeof(buf)) < 0)
+				break;
+			s->early_wakeups++;
+		} else {
+			s->timer_wakeups++;
+		}
+	}
+
+	return NULL;
+}
+
+static void *waker(void *arg)
+{
+	struct sleeper *s = arg;
+	struct timespec ts;
+	unsigned int delay;
+
+	while (!stop) {
+		delay = rand_r(&s->seed) % period_us;
+		ts.tv_sec = 0;
+		ts.tv_nsec = delay * 1000L;
+		nanosleep(&ts, NULL);
+
+		if (rand_r(&s->seed) % 100 < early_pct &&
+		    write(s->pipe[1], "", 1) < 0)
+			break;
+
+		ts.tv_nsec = (period_us - delay) * 1000L;
+		nanosleep(&ts, NULL);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long timer = 0, early = 0;
+	struct sleeper *s;
+	pthread_t *t;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "e:p:s:t:")) != -1) {
+		switch (c) {
+		case 'e':
+			early_pct = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nr_threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (!nr_threads || !period_us || period_us >= 1000000)
+		goto usage;
+
+	s = calloc(nr_threads, sizeof(*s));
+	t = calloc(nr_threads * 2, sizeof(*t));
+	if (!s || !t) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pipe(s[i].pipe)) {
+			perror("pipe");
+			return 1;
+		}
+		s[i].seed = i + 1;
+		pthread_create(&t[2 * i], NULL, sleeper, &s[i]);
+		pthread_create(&t[2 * i + 1], NULL, waker, &s[i]);
+	}
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		/* kick the sleeper out of poll */
+		if (write(s[i].pipe[1], "", 1) < 0)
+			perror("write");
+		pthread_join(t[2 * i], NULL);
+		pthread_join(t[2 * i + 1], NULL);
+		timer += s[i].timer_wakeups;
+		early += s[i].early_wakeups;
+	}
+
+	/* timer wakeups, early wakeups */
+	printf("%lu %lu\n", timer, early);
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-t threads] [-p period_us] [-e early_pct] "
+		"[-s seconds]\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,427 @@
+/*
+ * epoll wakeup selftest and stress benchmark
+ *
+ * Checks level/edge triggered and one-shot delivery across the batch size
+ * used to copy events out, fault handling on a bad event buffer, and then
+ * hammers a single epoll set from several producer threads:
+ *
+ *  - ping-pong: one waiter, one waker, measures the wakeup round trip and
+ *    fails on a lost wakeup;
+ *  - waiters: several threads in epoll_wait() on the same set, each event
+ *    has to wake one of them;
+ *  - storm: producers signal eventfds as fast as they can while a consumer
+ *    drains them, and the counts read back must match the counts written.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#define NR_FDS		40	/* more than one copy-out batch */
+#define NR_PRODUCERS	8
+#define FDS_PER_PRODUCER 16
+#define PINGPONG_LOOPS	20000
+#define NR_WAITERS	8
+#define WAITER_ROUNDS	50
+#define STORM_SECONDS	2
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int efd_signal(int fd)
+{
+	uint64_t v = 1;
+
+	return write(fd, &v, sizeof(v)) == sizeof(v) ? 0 : -errno;
+}
+
+static uint64_t efd_drain(int fd)
+{
+	uint64_t v;
+
+	return read(fd, &v, sizeof(v)) == sizeof(v) ? v : 0;
+}
+
+static int ep_add(int epfd, int fd, uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.fd = fd };
+
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) ? -errno : 0;
+}
+
+static int test_level(void)
+{
+	struct epoll_event evs[64];
+	int epfd, fds[NR_FDS];
+	int i, n, ret = 0;
+
+	epfd = epoll_create1(0);
+	if (epfd < 0)
+		return -errno;
+	for (i = 0; i < NR_FDS; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0 || ep_add(epfd, fds[i], EPOLLIN))
+			return -EINVAL;
+		efd_signal(fds[i]);
+	}
+
+	/* all of them, twice, since they stay ready */
+	for (i = 0; i < 2; i++) {
+		n = epoll_wait(epfd, evs, 64, 0);
+		if (n != NR_FDS) {
+			printf("level: got %d events, expected %d\n", n, NR_FDS);
+			ret = -EINVAL;
+		}
+	}
+
+	/* partial reads must not lose the rest */
+	n = epoll_wait(epfd, evs, 10, 0);
+	if (n != 10) {
+		printf("level: got %d events, expected 10\n", n);
+		ret = -EINVAL;
+	}
+	n = epoll_wait(epfd, evs, 64, 0);
+	if (n != NR_FDS) {
+		printf("level: got %d events after partial read\n", n);
+		ret = -EINVAL;
+	}
+
+	for (i = 0; i < NR_FDS; i++)
+		close(fds[i]);
+	close(epfd);
+	return ret;
+}
+
+static int test_edge_oneshot(void)
+{
+	struct epoll_event ev;
+	int epfd, et, os, n, ret = 0;
+
+	epfd = epoll_create1(0);
+	et = eventfd(0, EFD_NONBLOCK);
+	os = eventfd(0, EFD_NONBLOCK);
+	if (epfd < 0 || et < 0 || os < 0)
+		return -errno;
+	if (ep_add(epfd, et, EPOLLIN | EPOLLET) ||
+	    ep_add(epfd, os, EPOLLIN | EPOLLONESHOT))
+		return -EINVAL;
+
+	efd_signal(et);
+	n = epoll_wait(epfd, &ev, 1, 0);
+	if (n != 1 || ev.data.fd != et)
+		ret = -EINVAL;
+	if (epoll_wait(epfd, &ev, 1, 0) != 0)
+		ret = -EINVAL;
+
+	efd_signal(os);
+	n = epoll_wait(epfd, &ev, 1, 0);
+	if (n != 1 || ev.data.fd != os)
+		ret = -EINVAL;
+	efd_signal(os);
+	if (epoll_wait(epfd, &ev, 1, 0) != 0)
+		ret = -EINVAL;
+
+	if (ret)
+		printf("edge/oneshot: unexpected event delivery\n");
+	close(et);
+	close(os);
+	close(epfd);
+	return ret;
+}
+
+static int test_fault(void)
+{
+	struct epoll_event evs[NR_FDS], *bad;
+	int epfd, fds[NR_FDS];
+	int i, n, ret = 0;
+
+	bad = mmap(NULL, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	epfd = epoll_create1(0);
+	if (bad == MAP_FAILED || epfd < 0)
+		return -errno;
+	for (i = 0; i < NR_FDS; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0 || ep_add(epfd, fds[i], EPOLLIN | EPOLLET))
+			return -EINVAL;
+		efd_signal(fds[i]);
+	}
+
+	n = epoll_wait(epfd, bad, NR_FDS, 0);
+	if (n != -1 || errno != EFAULT) {
+		printf("fault: got %d, expected EFAULT\n", n);
+		ret = -EINVAL;
+	}
+
+	/* edge triggered events must survive the failed copy */
+	n = epoll_wait(epfd, evs, NR_FDS, 0);
+	if (n != NR_FDS) {
+		printf("fault: got %d events after EFAULT, expected %d\n",
+		       n, NR_FDS);
+		ret = -EINVAL;
+	}
+
+	for (i = 0; i < NR_FDS; i++)
+		close(fds[i]);
+	close(epfd);
+	munmap(bad, 4096);
+	return ret;
+}
+
+struct pingpong {
+	int ping, pong;
+	int epfd;
+	int lost;
+};
+
+static void *pingpong_waker(void *arg)
+{
+	struct pingpong *pp = arg;
+	struct epoll_event ev;
+	int i;
+
+	for (i = 0; i < PINGPONG_LOOPS && !pp->lost; i++) {
+		efd_signal(pp->ping);
+		if (epoll_wait(pp->epfd, &ev, 1, 1000) != 1) {
+			pp->lost = 1;
+			break;
+		}
+		efd_drain(pp->pong);
+	}
+	return NULL;
+}
+
+static int test_pingpong(void)
+{
+	struct pingpong pp = { 0 };
+	struct epoll_event ev;
+	pthread_t thread;
+	uint64_t start, elapsed;
+	int epfd, i, ret = 0;
+
+	epfd = epoll_create1(0);
+	pp.ping = eventfd(0, EFD_NONBLOCK);
+	pp.pong = eventfd(0, EFD_NONBLOCK);
+	pp.epfd = epoll_create1(0);
+	if (epfd < 0 || pp.epfd < 0 || pp.ping < 0 || pp.pong < 0)
+		return -errno;
+	if (ep_add(epfd, pp.ping, EPOLLIN) || ep_add(pp.epfd, pp.pong, EPOLLIN))
+		return -EINVAL;
+
+	start = now_ns();
+	pthread_create(&thread, NULL, pingpong_waker, &pp);
+	for (i = 0; i < PINGPONG_LOOPS && !pp.lost; i++) {
+		if (epoll_wait(epfd, &ev, 1, 1000) != 1) {
+			pp.lost = 1;
+			break;
+		}
+		efd_drain(pp.ping);
+		efd_signal(pp.pong);
+	}
+	pthread_join(thread, NULL);
+	elapsed = now_ns() - start;
+
+	if (pp.lost) {
+		printf("pingpong: lost wakeup after %d round trips\n", i);
+		ret = -ETIMEDOUT;
+	} else {
+		printf("pingpong: %d round trips, %llu ns each\n", i,
+		       (unsigned long long)(elapsed / i));
+	}
+
+	close(pp.ping);
+	close(pp.pong);
+	close(pp.epfd);
+	close(epfd);
+	return ret;
+}
+
+struct waiters {
+	int epfd;
+	int woken;
+};
+
+static void *waiter(void *arg)
+{
+	struct waiters *w = arg;
+	struct epoll_event ev;
+
+	if (epoll_wait(w->epfd, &ev, 1, 1000) == 1)
+		__atomic_add_fetch(&w->woken, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+/*
+ * NR_WAITERS threads sleep in epoll_wait() for one event each and as many
+ * edge triggered eventfds fire at once.  A thread which has been woken
+ * and is still copying its event out must not take the wakeup of one of
+ * the others, so all of them have to return with an event.
+ */
+static int test_waiters(void)
+{
+	pthread_t threads[NR_WAITERS];
+	int fds[NR_WAITERS];
+	struct waiters w;
+	int round, i, lost = 0;
+
+	w.epfd = epoll_create1(0);
+	if (w.epfd < 0)
+		return -errno;
+	for (i = 0; i < NR_WAITERS; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0 || ep_add(w.epfd, fds[i], EPOLLIN | EPOLLET))
+			return -EINVAL;
+	}
+
+	for (round = 0; round < WAITER_ROUNDS; round++) {
+		w.woken = 0;
+		for (i = 0; i < NR_WAITERS; i++)
+			pthread_create(&threads[i], NULL, waiter, &w);
+		/* let them all go to sleep */
+		usleep(10000);
+		for (i = 0; i < NR_WAITERS; i++)
+			efd_signal(fds[i]);
+		for (i = 0; i < NR_WAITERS; i++)
+			pthread_join(threads[i], NULL);
+		lost += NR_WAITERS - w.woken;
+	}
+
+	for (i = 0; i < NR_WAITERS; i++)
+		close(fds[i]);
+	close(w.epfd);
+
+	if (lost) {
+		printf("waiters: %d of %d wakeups lost\n", lost,
+		       NR_WAITERS * WAITER_ROUNDS);
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+struct producer {
+	pthread_t thread;
+	int fds[FDS_PER_PRODUCER];
+	uint64_t written;
+};
+
+static volatile int storm_stop;
+
+static void *storm_producer(void *arg)
+{
+	struct producer *p = arg;
+	int i = 0;
+
+	while (!storm_stop) {
+		if (!efd_signal(p->fds[i]))
+			p->written++;
+		i = (i + 1) % FDS_PER_PRODUCER;
+	}
+	return NULL;
+}
+
+static int test_storm(void)
+{
+	struct producer producers[NR_PRODUCERS];
+	struct epoll_event evs[64];
+	uint64_t written = 0, read = 0, waits = 0, events = 0;
+	uint64_t start, elapsed;
+	int epfd, i, j, n;
+
+	epfd = epoll_create1(0);
+	if (epfd < 0)
+		return -errno;
+	for (i = 0; i < NR_PRODUCERS; i++) {
+		producers[i].written = 0;
+		for (j = 0; j < FDS_PER_PRODUCER; j++) {
+			producers[i].fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (producers[i].fds[j] < 0 ||
+			    ep_add(epfd, producers[i].fds[j], EPOLLIN | EPOLLET))
+				return -EINVAL;
+		}
+	}
+
+	storm_stop = 0;
+	for (i = 0; i < NR_PRODUCERS; i++)
+		pthread_create(&producers[i].thread, NULL, storm_producer,
+			       &producers[i]);
+
+	start = now_ns();
+	while (now_ns() - start < STORM_SECONDS * 1000000000ULL) {
+		n = epoll_wait(epfd, evs, 64, 100);
+		waits++;
+		for (j = 0; j < n; j++)
+			read += efd_drain(evs[j].data.fd);
+		events += n > 0 ? n : 0;
+	}
+	storm_stop = 1;
+	for (i = 0; i < NR_PRODUCERS; i++) {
+		pthread_join(producers[i].thread, NULL);
+		written += producers[i].written;
+	}
+	elapsed = now_ns() - start;
+
+	/* whatever is still pending has to be reported */
+	while ((n = epoll_wait(epfd, evs, 64, 100)) > 0)
+		for (j = 0; j < n; j++)
+			read += efd_drain(evs[j].data.fd);
+
+	printf("storm: %d producers, %llu signals, %llu events in %llu waits, %llu events/s\n",
+	       NR_PRODUCERS, (unsigned long long)written,
+	       (unsigned long long)events, (unsigned long long)waits,
+	       (unsigned long long)(events * 1000000000ULL / elapsed));
+
+	for (i = 0; i < NR_PRODUCERS; i++)
+		for (j = 0; j < FDS_PER_PRODUCER; j++)
+			close(producers[i].fds[j]);
+	close(epfd);
+
+	if (read != written) {
+		printf("storm: read %llu, written %llu\n",
+		       (unsigned long long)read, (unsigned long long)written);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int ret, fail = 0;
+
+	ret = test_level();
+	printf("epoll: level triggered: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_edge_oneshot();
+	printf("epoll: edge triggered/oneshot: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_fault();
+	printf("epoll: bad event buffer: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_pingpong();
+	printf("epoll: pingpong wakeups: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_waiters();
+	printf("epoll: several waiters: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_storm();
+	printf("epoll: wakeup storm: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	return fail;
+}
@@ -0,0 +1,178 @@
+/*
+ * Read benchmark for comparing read-only filesystem images of the same
+ * tree. Walks a directory and either reads every regular file from start
+ * to end (-m seq), reporting throughput, or issues random 4KiB preads at
+ * random files and offsets (-m rand), reporting the latency distribution.
+ * Caches are left to the caller, which drops them before each run.
+ *
+ * Usage: read_bench [-m seq|rand] [-n reads] [-s seed] dir
+ */
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEQ_BUF		(128 * 1024)
+#define RAND_SIZE	4096
+
+struct file_ent {
+	char *path;
+	off_t size;
+};
+
+static struct file_ent *files;
+static size_t nr_files, max_files;
+
+static uint64_t ts_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int add_file(const char *path, const struct stat *st, int type,
+		    struct FTW *ftw)
+{
+	if (type != FTW_F || !S_ISREG(st->st_mode) || !st->st_size)
+		return 0;
+
+	if (nr_files == max_files) {
+		max_files = max_files ? max_files * 2 : 256;
+		files = realloc(files, max_files * sizeof(*files));
+		if (!files)
+			return -1;
+	}
+	files[nr_files].path = strdup(path);
+	files[nr_files].size = st->st_size;
+	nr_files++;
+
+	return 0;
+}
+
+static int seq_read(void)
+{
+	static char buf[SEQ_BUF];
+	uint64_t bytes = 0, start, ns;
+	ssize_t ret;
+	size_t i;
+	int fd;
+
+	start = ts_ns();
+	for (i = 0; i < nr_files; i++) {
+		fd = open(files[i].path, O_RDONLY);
+		if (fd < 0) {
+			perror(files[i].path);
+			return 1;
+		}
+		while ((ret = read(fd, buf, sizeof(buf))) > 0)
+			bytes += ret;
+		close(fd);
+		if (ret < 0) {
+			perror(files[i].path);
+			return 1;
+		}
+	}
+	ns = ts_ns() - start;
+
+	/* files bytes MB/s */
+	printf("seq %zu %llu %llu\n", nr_files, (unsigned long long)bytes,
+	       (unsigned long long)(bytes * 1000 / (ns ? ns : 1)));
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int rand_read(unsigned int reads, unsigned int seed)
+{
+	char buf[RAND_SIZE];
+	uint64_t *lat, start;
+	struct file_ent *f;
+	unsigned int i;
+	off_t off;
+	int fd;
+
+	lat = calloc(reads, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		return 1;
+	}
+
+	srand(seed);
+	for (i = 0; i < reads; i++) {
+		f = &files[rand() % nr_files];
+		off = f->size > RAND_SIZE ?
+			((off_t)rand() % (f->size / RAND_SIZE)) * RAND_SIZE : 0;
+
+		start = ts_ns();
+		fd = open(f->path, O_RDONLY);
+		if (fd < 0 || pread(fd, buf, sizeof(buf), off) < 0) {
+			perror(f->path);
+			return 1;
+		}
+		close(fd);
+		lat[i] = ts_ns() - start;
+	}
+
+	qsort(lat, reads, sizeof(*lat), cmp_u64);
+
+	/* reads p50 p99 max (usec) */
+	printf("rand %u %llu %llu %llu\n", reads,
+	       (unsigned long long)lat[reads / 2] / 1000,
+	       (unsigned long long)lat[reads * 99 / 100] / 1000,
+	       (unsigned long long)lat[reads - 1] / 1000);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int reads = 2000, seed = 1;
+	const char *mode = "seq";
+	int c;
+
+	while ((c = getopt(argc, argv, "m:n:s:")) != -1) {
+		switch (c) {
+		case 'm':
+			mode = optarg;
+			break;
+		case 'n':
+			reads = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !reads)
+		goto usage;
+
+	if (nftw(argv[optind], add_file, 64, FTW_PHYS)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (!nr_files) {
+		fprintf(stderr, "%s: no files\n", argv[optind]);
+		return 1;
+	}
+
+	if (!strcmp(mode, "seq"))
+		return seq_read();
+	if (!strcmp(mode, "rand"))
+		return rand_read(reads, seed);
+
+usage:
+	fprintf(stderr, "usage: %s [-m seq|rand] [-n reads] [-s seed] dir\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,152 @@
+#!/bin/bash
+# Compares cold-cache read throughput and random read latency of the same
+# tree stored as EROFS (lz4), squashfs and ext4 images on loop devices.
+# The tree defaults to a generated mix of small and large, partly
+# compressible files; pass a directory (e.g. an unpacked system image) to
+# use that instead. Each filesystem is skipped if the kernel or its mkfs
+# tool is missing. mkfs.erofs options can be overridden with
+# MKFS_EROFS_OPTS; the images need lz4 0padding and the full (legacy)
+# index layout.
+#
+# Usage: read_bench.sh [dir]
+
+src=$1
+reads=2000
+work=
+mnt=
+
+cleanup()
+{
+	[ -n "$mnt" ] && mountpoint -q $mnt && umount $mnt
+	[ -n "$work" ] && rm -rf $work
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./read_bench ]; then
+		echo $msg read_bench not built >&2
+		exit 0
+	fi
+
+	if ! grep -qw erofs /proc/filesystems; then
+		echo $msg erofs not available >&2
+		exit 0
+	fi
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "read_bench: $1: [PASS]"
+	else
+		echo "read_bench: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# gen_tree <dir>: ~55MiB of files from 4KiB to 4MiB, text-like content that
+# compresses about 2:1
+gen_tree()
+{
+	local i size
+
+	mkdir -p $1
+	for i in $(seq 0 63); do
+		mkdir -p $1/d$((i % 8))
+		size=$((4096 << (i % 11)))
+		head -c $((size / 2)) /dev/urandom | base64 -w 0 |
+			head -c $size > $1/d$((i % 8))/f$i
+	done
+	for i in $(seq 0 9); do
+		head -c 2097152 /dev/urandom | base64 -w 0 |
+			head -c 4194304 > $1/big$i
+	done
+}
+
+# mkimage <fs> <src> <image>
+mkimage()
+{
+	case $1 in
+	erofs)
+		which mkfs.erofs > /dev/null &&
+			mkfs.erofs ${MKFS_EROFS_OPTS:--zlz4hc} $3 $2 > /dev/null
+		;;
+	squashfs)
+		grep -qw squashfs /proc/filesystems &&
+			which mksquashfs > /dev/null &&
+			mksquashfs $2 $3 -noappend -no-progress > /dev/null
+		;;
+	ext4)
+		local kb=$(du -sk $2 | cut -f1)
+
+		grep -qw ext4 /proc/filesystems &&
+			which mkfs.ext4 > /dev/null &&
+			truncate -s $((kb * 13 / 10 + 16384))k $3 &&
+			mkfs.ext4 -q -d $2 $3 > /dev/null 2>&1
+		;;
+	esac
+}
+
+# run <fs> <image>: prints "fs image_kb MB/s p50 p99 max"
+run()
+{
+	local seq rand
+
+	mount -t $1 -o loop,ro $2 $mnt 2>/dev/null || return 1
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	seq=$(./read_bench -m seq $mnt) || return 1
+
+	echo 3 > /proc/sys/vm/drop_caches
+	rand=$(./read_bench -m rand -n $reads $mnt) || return 1
+
+	umount $mnt
+	echo $1 $(du -k $2 | cut -f1) $(echo $seq | cut -d' ' -f4) \
+		$(echo $rand | cut -d' ' -f3-5)
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+work=$(mktemp -d)
+mnt=$work/mnt
+mkdir $mnt
+
+if [ -z "$src" ]; then
+	src=$work/tree
+	gen_tree $src
+fi
+
+printf "%-9s %10s %8s %8s %8s %8s\n" fs image_kb MB/s p50_us p99_us max_us
+for fs in erofs squashfs ext4; do
+	if ! mkimage $fs $src $work/$fs.img; then
+		echo "$fs: cannot build an image, skipped"
+		continue
+	fi
+
+	line=$(run $fs $work/$fs.img)
+	if [ -z "$line" ]; then
+		echo "$fs: mount or read failed"
+		[ $fs = erofs ] && ret=1
+		continue
+	fi
+	printf "%-9s %10s %8s %8s %8s %8s\n" $line
+
+	if [ $fs = erofs ]; then
+		mount -t erofs -o loop,ro $work/erofs.img $mnt
+		pass "erofs contents match" "diff -r -q $src $mnt > /dev/null"
+		umount $mnt
+	fi
+done
+
+exit $ret
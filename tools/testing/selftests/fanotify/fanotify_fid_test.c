@@ -0,0 +1,348 @@
+/*
+ * fanotify file handle reporting selftest and benchmark
+ *
+ * Puts a single FAN_MARK_FILESYSTEM mark with FAN_REPORT_FID on the
+ * filesystem of the directory given as the first argument (default: the
+ * current directory) and checks that:
+ *
+ *  - directory entry events deep below the marked directory are reported
+ *    with the fsid and file handle of the directory that changed;
+ *  - no fd is opened for the listener;
+ *  - invalid combinations of flags and events are refused.
+ *
+ * It then creates and removes files in a tree of directories and reports
+ * the cost of the mark and how many events were read, next to the number
+ * of inotify watches the same coverage would need.
+ *
+ * Needs CAP_SYS_ADMIN; skips if the kernel or the filesystem can't report
+ * file handles.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+
+#ifndef FAN_REPORT_FID
+#define FAN_REPORT_FID		0x00000200
+#define FAN_MARK_FILESYSTEM	0x00000100
+#define FAN_ATTRIB		0x00000004
+#define FAN_MOVED_FROM		0x00000040
+#define FAN_MOVED_TO		0x00000080
+#define FAN_CREATE		0x00000100
+#define FAN_DELETE		0x00000200
+#define FAN_EVENT_INFO_TYPE_FID	1
+
+struct fanotify_event_info_header {
+	__u8 info_type;
+	__u8 pad;
+	__u16 len;
+};
+
+struct fanotify_event_info_fid {
+	struct fanotify_event_info_header hdr;
+	__kernel_fsid_t fsid;
+	unsigned char handle[0];
+};
+#endif
+
+#define DIRENT_EVENTS	(FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | \
+			 FAN_MOVED_TO | FAN_ONDIR)
+#define BENCH_DIRS	64
+#define BENCH_FILES	256
+
+static char base[4096];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int fid_group(void)
+{
+	return fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_FID | FAN_NONBLOCK,
+			     O_RDONLY);
+}
+
+static int get_handle(const char *path, struct file_handle *fh)
+{
+	int mount_id;
+
+	fh->handle_bytes = MAX_HANDLE_SZ;
+	return name_to_handle_at(AT_FDCWD, path, fh, &mount_id, 0) ? -errno : 0;
+}
+
+/*
+ * Read all queued events, and count how many of them were about the
+ * directory @fh with one of @mask set.  Fails on malformed events.
+ */
+static int read_events(int fd, struct file_handle *fh, __kernel_fsid_t *fsid,
+		       uint64_t mask, int *total, int *match)
+{
+	char buf[8192] __attribute__((aligned(8)));
+	struct fanotify_event_metadata *md;
+	struct fanotify_event_info_fid *fid;
+	struct file_handle *efh;
+	ssize_t len;
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (md = (void *)buf; FAN_EVENT_OK(md, len);
+		     md = FAN_EVENT_NEXT(md, len)) {
+			(*total)++;
+			if (md->fd != FAN_NOFD ||
+			    md->event_len <= md->metadata_len)
+				return -EINVAL;
+			fid = (void *)md + md->metadata_len;
+			efh = (void *)fid->handle;
+			if (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_FID ||
+			    md->metadata_len + fid->hdr.len != md->event_len ||
+			    sizeof(*fid) + sizeof(*efh) + efh->handle_bytes >
+			    fid->hdr.len)
+				return -EINVAL;
+			if (fh && (md->mask & mask) &&
+			    !memcmp(&fid->fsid, fsid, sizeof(*fsid)) &&
+			    efh->handle_type == fh->handle_type &&
+			    efh->handle_bytes == fh->handle_bytes &&
+			    !memcmp(efh->f_handle, fh->f_handle,
+				    fh->handle_bytes))
+				(*match)++;
+		}
+	}
+	return len < 0 && errno != EAGAIN ? -errno : 0;
+}
+
+static int test_flags(void)
+{
+	int fd, ret = 0;
+
+	fd = fanotify_init(FAN_CLASS_CONTENT | FAN_REPORT_FID, O_RDONLY);
+	if (fd >= 0 || errno != EINVAL) {
+		printf("flags: FAN_REPORT_FID accepted for permission class\n");
+		ret = -EINVAL;
+	}
+
+	/* inode events need file handles */
+	fd = fanotify_init(FAN_CLASS_NOTIF, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	if (!fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_CREATE,
+			   AT_FDCWD, base) || errno != EINVAL) {
+		printf("flags: FAN_CREATE accepted without FAN_REPORT_FID\n");
+		ret = -EINVAL;
+	}
+	close(fd);
+
+	/* ... and can't be filtered by mount */
+	fd = fid_group();
+	if (fd < 0)
+		return -errno;
+	if (!fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_MOUNT, FAN_CREATE,
+			   AT_FDCWD, base) || errno != EINVAL) {
+		printf("flags: FAN_CREATE accepted on a mount mark\n");
+		ret = -EINVAL;
+	}
+	if (!fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_MOUNT |
+			   FAN_MARK_FILESYSTEM, FAN_OPEN, AT_FDCWD, base) ||
+	    errno != EINVAL) {
+		printf("flags: mount and filesystem mark accepted together\n");
+		ret = -EINVAL;
+	}
+	close(fd);
+	return ret;
+}
+
+static int test_dirent(void)
+{
+	char dir[4096 + 16], path[4096 + 32], path2[4096 + 32];
+	struct file_handle *fh = malloc(sizeof(*fh) + MAX_HANDLE_SZ);
+	struct statfs sfs;
+	int fd, tmp, total = 0, match = 0, ret;
+
+	snprintf(dir, sizeof(dir), "%s/a", base);
+	mkdir(dir, 0755);
+	snprintf(dir, sizeof(dir), "%s/a/b", base);
+	mkdir(dir, 0755);
+	if (!fh || statfs(base, &sfs) || get_handle(dir, fh))
+		return -errno;
+
+	fd = fid_group();
+	if (fd < 0)
+		return -errno;
+	if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+			  DIRENT_EVENTS, AT_FDCWD, base)) {
+		ret = -errno;
+		goto out;
+	}
+
+	/* one create, one rename (two events), one delete, all in a/b */
+	snprintf(path, sizeof(path), "%s/file", dir);
+	snprintf(path2, sizeof(path2), "%s/moved", dir);
+	tmp = open(path, O_CREAT | O_WRONLY, 0644);
+	if (tmp < 0 || rename(path, path2) || unlink(path2)) {
+		ret = -errno;
+		goto out;
+	}
+	close(tmp);
+
+	ret = read_events(fd, fh, (__kernel_fsid_t *)&sfs.f_fsid,
+			  FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM |
+			  FAN_MOVED_TO, &total, &match);
+	if (!ret && !match) {
+		printf("dirent: no event with the handle of the changed directory\n");
+		ret = -EINVAL;
+	}
+
+	/* a subdirectory is only reported with FAN_ONDIR */
+	snprintf(path, sizeof(path), "%s/sub", dir);
+	total = match = 0;
+	if (!ret && (mkdir(path, 0755) || rmdir(path)))
+		ret = -errno;
+	if (!ret)
+		ret = read_events(fd, fh, (__kernel_fsid_t *)&sfs.f_fsid,
+				  FAN_ONDIR, &total, &match);
+	if (!ret && !match) {
+		printf("dirent: mkdir/rmdir not reported\n");
+		ret = -EINVAL;
+	}
+out:
+	close(fd);
+	free(fh);
+	return ret;
+}
+
+static void bench_tree(int create)
+{
+	char path[4096 + 64];
+	int d, f, fd;
+
+	for (d = 0; d < BENCH_DIRS; d++) {
+		snprintf(path, sizeof(path), "%s/bench/%d", base, d);
+		if (create)
+			mkdir(path, 0755);
+		for (f = 0; f < BENCH_FILES / BENCH_DIRS; f++) {
+			snprintf(path, sizeof(path), "%s/bench/%d/%d",
+				 base, d, f);
+			if (!create) {
+				unlink(path);
+				continue;
+			}
+			fd = open(path, O_CREAT | O_WRONLY, 0644);
+			if (fd >= 0)
+				close(fd);
+		}
+		snprintf(path, sizeof(path), "%s/bench/%d", base, d);
+		if (!create)
+			rmdir(path);
+	}
+}
+
+static int bench(void)
+{
+	char path[4096 + 16];
+	uint64_t start, bare_ns, marked_ns;
+	int fd, total = 0, match = 0, ret;
+
+	snprintf(path, sizeof(path), "%s/bench", base);
+	mkdir(path, 0755);
+
+	start = now_ns();
+	bench_tree(1);
+	bench_tree(0);
+	bare_ns = now_ns() - start;
+
+	fd = fid_group();
+	if (fd < 0)
+		return -errno;
+	if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+			  DIRENT_EVENTS, AT_FDCWD, base)) {
+		close(fd);
+		return -errno;
+	}
+
+	start = now_ns();
+	bench_tree(1);
+	ret = read_events(fd, NULL, NULL, 0, &total, &match);
+	bench_tree(0);
+	ret = ret ?: read_events(fd, NULL, NULL, 0, &total, &match);
+	marked_ns = now_ns() - start;
+	close(fd);
+	rmdir(path);
+	if (ret)
+		return ret;
+
+	printf("bench: %d dirs, %d files: no mark %llu us, filesystem mark %llu us, %d events read, 1 mark (inotify: %d watches)\n",
+	       BENCH_DIRS, BENCH_FILES,
+	       (unsigned long long)bare_ns / 1000,
+	       (unsigned long long)marked_ns / 1000, total, BENCH_DIRS + 1);
+	return total ? 0 : -EINVAL;
+}
+
+static void cleanup(void)
+{
+	char cmd[4096 + 16];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", base);
+	if (system(cmd))
+		perror("rm");
+}
+
+int main(int argc, char **argv)
+{
+	struct file_handle *fh;
+	int fd, ret, fail = 0;
+
+	if (getuid() != 0) {
+		printf("fanotify: need root, skipping test\n");
+		return 0;
+	}
+
+	snprintf(base, sizeof(base), "%s/fanotify_fid.XXXXXX",
+		 argc > 1 ? argv[1] : ".");
+	if (!mkdtemp(base)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	fd = fid_group();
+	if (fd < 0) {
+		printf("fanotify: FAN_REPORT_FID not supported, skipping test\n");
+		goto out;
+	}
+	fh = malloc(sizeof(*fh) + MAX_HANDLE_SZ);
+	if (!fh || get_handle(base, fh) ||
+	    fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_CREATE,
+			  AT_FDCWD, base)) {
+		printf("fanotify: filesystem can't report file handles, skipping test\n");
+		close(fd);
+		free(fh);
+		goto out;
+	}
+	close(fd);
+	free(fh);
+
+	ret = test_flags();
+	printf("fanotify: flag checks: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_dirent();
+	printf("fanotify: directory entry events: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = bench();
+	printf("fanotify: filesystem mark cost: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+out:
+	cleanup();
+	return fail;
+}
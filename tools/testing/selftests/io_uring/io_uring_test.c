@@ -0,0 +1,495 @@
+/*
+ * io_uring selftest
+ *
+ * Sets up a ring the same way liburing does (io_uring_setup() + three
+ * mmaps at the IORING_OFF_* offsets) and checks NOP, READV/WRITEV,
+ * READ_FIXED/WRITE_FIXED with registered buffers and files, FSYNC and
+ * POLL_ADD/POLL_REMOVE. Also checks that a failed setup leaves no fd behind
+ * and that closing a ring cancels a read that would never complete.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <linux/io_uring.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup	425
+#define __NR_io_uring_enter	426
+#define __NR_io_uring_register	427
+#endif
+
+#define RING_ENTRIES	8
+#define BUF_SIZE	4096
+
+#define barrier()	__asm__ __volatile__("" ::: "memory")
+#define read_barrier()	__sync_synchronize()
+#define write_barrier()	__sync_synchronize()
+
+struct sq_ring {
+	unsigned *head;
+	unsigned *tail;
+	unsigned *ring_mask;
+	unsigned *ring_entries;
+	unsigned *array;
+	struct io_uring_sqe *sqes;
+};
+
+struct cq_ring {
+	unsigned *head;
+	unsigned *tail;
+	unsigned *ring_mask;
+	unsigned *ring_entries;
+	struct io_uring_cqe *cqes;
+};
+
+struct ring {
+	int fd;
+	struct sq_ring sq;
+	struct cq_ring cq;
+};
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+			  unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg,
+			     unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int ring_init(struct ring *ring)
+{
+	struct io_uring_params p;
+	void *ptr;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = io_uring_setup(RING_ENTRIES, &p);
+	if (ring->fd < 0)
+		return -errno;
+
+	ptr = mmap(NULL, p.sq_off.array + p.sq_entries * sizeof(unsigned),
+		   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		   ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		return -errno;
+	ring->sq.head = ptr + p.sq_off.head;
+	ring->sq.tail = ptr + p.sq_off.tail;
+	ring->sq.ring_mask = ptr + p.sq_off.ring_mask;
+	ring->sq.ring_entries = ptr + p.sq_off.ring_entries;
+	ring->sq.array = ptr + p.sq_off.array;
+
+	ring->sq.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			     PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQES);
+	if (ring->sq.sqes == MAP_FAILED)
+		return -errno;
+
+	ptr = mmap(NULL, p.cq_off.cqes +
+		   p.cq_entries * sizeof(struct io_uring_cqe),
+		   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		   ring->fd, IORING_OFF_CQ_RING);
+	if (ptr == MAP_FAILED)
+		return -errno;
+	ring->cq.head = ptr + p.cq_off.head;
+	ring->cq.tail = ptr + p.cq_off.tail;
+	ring->cq.ring_mask = ptr + p.cq_off.ring_mask;
+	ring->cq.ring_entries = ptr + p.cq_off.ring_entries;
+	ring->cq.cqes = ptr + p.cq_off.cqes;
+
+	return 0;
+}
+
+static struct io_uring_sqe *get_sqe(struct ring *ring)
+{
+	struct sq_ring *sq = &ring->sq;
+	unsigned tail = *sq->tail;
+	unsigned index = tail & *sq->ring_mask;
+	struct io_uring_sqe *sqe = &sq->sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sq->array[index] = index;
+	write_barrier();
+	*sq->tail = tail + 1;
+	write_barrier();
+	return sqe;
+}
+
+static int submit_and_wait(struct ring *ring, unsigned nr,
+			   struct io_uring_cqe *cqe)
+{
+	struct cq_ring *cq = &ring->cq;
+	unsigned head;
+	int ret;
+
+	ret = io_uring_enter(ring->fd, nr, 1, IORING_ENTER_GETEVENTS);
+	if (ret < 0)
+		return -errno;
+
+	head = *cq->head;
+	read_barrier();
+	if (head == *cq->tail)
+		return -EAGAIN;
+
+	*cqe = cq->cqes[head & *cq->ring_mask];
+	*cq->head = head + 1;
+	write_barrier();
+	return 0;
+}
+
+static int test_nop(struct ring *ring)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	int ret;
+
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = 0x1234;
+
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		return ret;
+	if (cqe.user_data != 0x1234 || cqe.res != 0)
+		return -EINVAL;
+	return 0;
+}
+
+static int test_rw(struct ring *ring, int fd)
+{
+	static char wbuf[BUF_SIZE], rbuf[BUF_SIZE];
+	struct iovec iov;
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	int ret;
+
+	memset(wbuf, 0x5a, sizeof(wbuf));
+	iov.iov_base = wbuf;
+	iov.iov_len = sizeof(wbuf);
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long) &iov;
+	sqe->len = 1;
+	sqe->user_data = 1;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		return ret;
+	if (cqe.res != BUF_SIZE)
+		return cqe.res < 0 ? cqe.res : -EIO;
+
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = fd;
+	sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	sqe->user_data = 2;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		return ret;
+	if (cqe.res)
+		return cqe.res;
+
+	iov.iov_base = rbuf;
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long) &iov;
+	sqe->len = 1;
+	sqe->user_data = 3;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		return ret;
+	if (cqe.res != BUF_SIZE)
+		return cqe.res < 0 ? cqe.res : -EIO;
+
+	return memcmp(wbuf, rbuf, BUF_SIZE) ? -EIO : 0;
+}
+
+static int test_fixed(struct ring *ring, int fd)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	struct iovec iov;
+	char *buf;
+	int ret;
+
+	if (posix_memalign((void **) &buf, BUF_SIZE, 2 * BUF_SIZE))
+		return -ENOMEM;
+
+	iov.iov_base = buf;
+	iov.iov_len = 2 * BUF_SIZE;
+	ret = io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1);
+	if (ret)
+		goto out;
+	ret = io_uring_register(ring->fd, IORING_REGISTER_FILES, &fd, 1);
+	if (ret)
+		goto out;
+
+	memset(buf, 0xa5, BUF_SIZE);
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 0;
+	sqe->addr = (unsigned long) buf;
+	sqe->len = BUF_SIZE;
+	sqe->buf_index = 0;
+	sqe->user_data = 4;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		goto out;
+	if (cqe.res != BUF_SIZE) {
+		ret = cqe.res < 0 ? cqe.res : -EIO;
+		goto out;
+	}
+
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_READ_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 0;
+	sqe->addr = (unsigned long) buf + BUF_SIZE;
+	sqe->len = BUF_SIZE;
+	sqe->buf_index = 0;
+	sqe->user_data = 5;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (ret)
+		goto out;
+	if (cqe.res != BUF_SIZE) {
+		ret = cqe.res < 0 ? cqe.res : -EIO;
+		goto out;
+	}
+	ret = memcmp(buf, buf + BUF_SIZE, BUF_SIZE) ? -EIO : 0;
+
+	/* buffers outside of the registered range must be refused */
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_READ_FIXED;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long) buf + BUF_SIZE;
+	sqe->len = 2 * BUF_SIZE;
+	sqe->user_data = 6;
+	if (!ret)
+		ret = submit_and_wait(ring, 1, &cqe);
+	if (!ret && cqe.res != -EFAULT)
+		ret = -EINVAL;
+
+	io_uring_register(ring->fd, IORING_UNREGISTER_FILES, NULL, 0);
+	io_uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+out:
+	free(buf);
+	return ret;
+}
+
+static int test_poll(struct ring *ring)
+{
+	struct io_uring_cqe cqe;
+	struct io_uring_sqe *sqe;
+	int fds[2], ret;
+
+	if (pipe(fds))
+		return -errno;
+
+	/* nothing to read yet, so this one has to wait */
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fds[0];
+	sqe->poll_events = POLLIN;
+	sqe->user_data = 7;
+	ret = io_uring_enter(ring->fd, 1, 0, 0);
+	if (ret != 1) {
+		ret = ret < 0 ? -errno : -EIO;
+		goto out;
+	}
+
+	if (write(fds[1], "x", 1) != 1) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = submit_and_wait(ring, 0, &cqe);
+	if (ret)
+		goto out;
+	if (cqe.user_data != 7 || !(cqe.res & POLLIN)) {
+		ret = -EIO;
+		goto out;
+	}
+
+	/* removing a poll request that doesn't exist */
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = 7;
+	sqe->user_data = 8;
+	ret = submit_and_wait(ring, 1, &cqe);
+	if (!ret && cqe.res != -ENOENT)
+		ret = -EINVAL;
+out:
+	close(fds[0]);
+	close(fds[1]);
+	return ret;
+}
+
+/* params the kernel can read but not write back: setup must fail cleanly */
+static int test_setup_fault(void)
+{
+	struct io_uring_params *p;
+	int fd, next, ret = 0;
+
+	p = mmap(NULL, sizeof(*p), PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+		 -1, 0);
+	if (p == MAP_FAILED)
+		return -errno;
+
+	/* the lowest free fd, which a leaked ring fd would take */
+	next = dup(0);
+	if (next < 0) {
+		ret = -errno;
+		goto out;
+	}
+	close(next);
+
+	fd = io_uring_setup(RING_ENTRIES, p);
+	if (fd >= 0) {
+		close(fd);
+		ret = -EINVAL;
+	} else if (errno != EFAULT) {
+		ret = -errno;
+	} else {
+		fd = dup(0);
+		if (fd != next)
+			ret = -EBADFD;
+		close(fd);
+	}
+out:
+	munmap(p, sizeof(*p));
+	return ret;
+}
+
+/*
+ * A read on an empty pipe gets punted to a worker and blocks there. Once
+ * the ring is gone it must not be left waiting: data written afterwards has
+ * to stay in the pipe.
+ */
+static int test_exit_cancel(void)
+{
+	struct ring ring;
+	struct io_uring_sqe *sqe;
+	struct iovec iov;
+	char buf[16];
+	int fds[2], status, ret;
+	pid_t pid;
+
+	if (pipe(fds))
+		return -errno;
+
+	pid = fork();
+	if (pid < 0) {
+		ret = -errno;
+		goto out;
+	}
+	if (!pid) {
+		if (ring_init(&ring))
+			_exit(1);
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		sqe = get_sqe(&ring);
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = fds[0];
+		sqe->addr = (unsigned long)&iov;
+		sqe->len = 1;
+		if (io_uring_enter(ring.fd, 1, 0, 0) != 1)
+			_exit(1);
+		/* give the worker time to block in the read */
+		usleep(100000);
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		ret = -ECHILD;
+		goto out;
+	}
+
+	usleep(100000);
+	if (write(fds[1], "x", 1) != 1) {
+		ret = -errno;
+		goto out;
+	}
+	usleep(100000);
+
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	ret = read(fds[0], buf, sizeof(buf)) == 1 ? 0 : -EBUSY;
+out:
+	close(fds[0]);
+	close(fds[1]);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/io_uring_test.XXXXXX";
+	struct ring ring;
+	int fd, ret, fail = 0;
+
+	ret = ring_init(&ring);
+	if (ret == -ENOSYS) {
+		printf("io_uring not supported, skipping test\n");
+		return 0;
+	} else if (ret) {
+		printf("ring setup failed: %s\n", strerror(-ret));
+		return 1;
+	}
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	unlink(path);
+
+	ret = test_nop(&ring);
+	printf("io_uring: nop: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_rw(&ring, fd);
+	printf("io_uring: readv/writev/fsync: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_fixed(&ring, fd);
+	printf("io_uring: fixed buffers and files: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_poll(&ring);
+	printf("io_uring: poll: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_setup_fault();
+	printf("io_uring: setup fault: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_exit_cancel();
+	printf("io_uring: exit cancels punted reads: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	close(fd);
+	close(ring.fd);
+	return fail;
+}
@@ -0,0 +1,66 @@
+#!/bin/bash
+# Compares fsync throughput of ext4 on a loop device with the default
+# synchronous journal commit and with journal_async_commit, where the commit
+# record's flush overlaps the ordered data writeback of the next
+# transaction, and checks that data=ordered can be mounted with
+# journal_async_commit.
+
+img=$(mktemp /tmp/jbd2_async.XXXXXX)
+mnt=$(mktemp -d /tmp/jbd2_mnt.XXXXXX)
+
+cleanup()
+{
+	umount $mnt 2>/dev/null
+	rmdir $mnt
+	rm -f $img
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	for tool in fio mkfs.ext4; do
+		if ! which $tool >/dev/null 2>&1; then
+			echo $msg $tool not found >&2
+			exit 0
+		fi
+	done
+}
+
+# Print the write IOPS of the fsync job on a fresh filesystem.
+run_fio()
+{
+	local opts="$1"
+
+	mkfs.ext4 -q -F -O metadata_csum $img || return 1
+	mount -o loop,data=ordered$opts $img $mnt || return 1
+	# terse v3: field 49 is write IOPS
+	fio --output-format=terse --terse-version=3 --directory=$mnt \
+		fsync.fio | cut -d';' -f49
+	umount $mnt
+}
+
+check_prereqs
+trap cleanup EXIT
+truncate -s 1G $img
+
+sync_iops=$(run_fio "")
+if [ -z "$sync_iops" ]; then
+	echo "jbd2: sync commit: [FAIL]"
+	exit 1
+fi
+
+async_iops=$(run_fio ",journal_async_commit")
+if [ -z "$async_iops" ]; then
+	echo "jbd2: journal_async_commit with data=ordered: [FAIL]"
+	exit 1
+fi
+echo "jbd2: journal_async_commit with data=ordered: [PASS]"
+
+echo "bench: fsync 4k randwrite, 8 jobs: sync commit $sync_iops IOPS, async commit $async_iops IOPS"
+exit 0
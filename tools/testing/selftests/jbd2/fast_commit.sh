@@ -0,0 +1,103 @@
+#!/bin/bash
+# Compares fsync latency of ext4 on a loop device with full journal commits
+# and with journal_fast_commit, for small overwrites of an allocated file.
+# Checks that fast commits were actually used and that the file survives a
+# remount.
+
+img=$(mktemp /tmp/jbd2_fc.XXXXXX)
+mnt=$(mktemp -d /tmp/jbd2_mnt.XXXXXX)
+fsyncs=2000
+
+cleanup()
+{
+	umount $mnt 2>/dev/null
+	rmdir $mnt
+	rm -f $img
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./fsync_lat ]; then
+		echo $msg fsync_lat not built >&2
+		exit 0
+	fi
+
+	if ! which mkfs.ext4 >/dev/null 2>&1; then
+		echo $msg mkfs.ext4 not found >&2
+		exit 0
+	fi
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "jbd2: $1: [PASS]"
+	else
+		echo "jbd2: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# counter <name>: ext4 sysfs counter of the mounted filesystem
+counter()
+{
+	local dev=$(basename $(findmnt -n -o SOURCE $mnt))
+
+	cat /sys/fs/ext4/$dev/$1 2>/dev/null || echo 0
+}
+
+# run <opts>: prints "p50 p99 max fc_commits full_commits same|differ",
+# the last field comparing the file before and after a remount
+run()
+{
+	local lat commits sum same=differ
+
+	mkfs.ext4 -q -F $img || return 1
+	mount -o loop$1 $img $mnt || return 1
+
+	lat=$(./fsync_lat -n $fsyncs $mnt/file) || return 1
+	commits="$(counter fc_commits) $(counter full_commits)"
+
+	sum=$(md5sum < $mnt/file)
+	umount $mnt
+	mount -o loop$1 $img $mnt || return 1
+	[ "$(md5sum < $mnt/file)" = "$sum" ] && same=same
+	umount $mnt
+
+	echo $(echo $lat | cut -d' ' -f2-4) $commits $same
+}
+
+check_prereqs
+trap cleanup EXIT
+truncate -s 1G $img
+
+ret=0
+full=$(run "")
+if [ -z "$full" ]; then
+	echo "jbd2: full commit run: [FAIL]"
+	exit 1
+fi
+
+fc=$(run ",journal_fast_commit")
+if [ -z "$fc" ]; then
+	echo "jbd2: journal_fast_commit run: [FAIL]"
+	exit 1
+fi
+pass "fast commits used" "[ $(echo $fc | cut -d' ' -f4) -gt 0 ]"
+pass "no fast commits without the option" \
+	"[ $(echo $full | cut -d' ' -f4) -eq 0 ]"
+pass "contents survive remount" "[ $(echo $fc | cut -d' ' -f6) = same ]"
+
+printf "%-12s %8s %8s %8s %10s %12s\n" commit p50_us p99_us max_us \
+	fc_commits full_commits
+printf "%-12s %8s %8s %8s %10s %12s\n" full $(echo $full | cut -d' ' -f1-5)
+printf "%-12s %8s %8s %8s %10s %12s\n" fast $(echo $fc | cut -d' ' -f1-5)
+exit $ret
@@ -0,0 +1,108 @@
+/*
+ * Measure the latency of fsync() after overwriting one block of an
+ * already allocated file.  Such a transaction only dirties the inode, so
+ * ext4 can complete it with a fast commit when journal_fast_commit is on.
+ *
+ * Usage: fsync_lat [-n fsyncs] [-s file_kb] file
+ * Prints: "fsyncs p50_us p99_us max_us"
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLOCK	4096
+
+static int cmp_ul(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static unsigned long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long *lat, blocks, i;
+	unsigned long n = 2000, kb = 1024;
+	char buf[BLOCK];
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			kb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !n || kb < BLOCK / 1024)
+		goto usage;
+	blocks = kb * 1024 / BLOCK;
+
+	lat = calloc(n, sizeof(*lat));
+	if (!lat)
+		return 1;
+
+	fd = open(argv[optind], O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	/* allocate and commit every block up front, no unwritten extents */
+	memset(buf, 'a', sizeof(buf));
+	for (i = 0; i < blocks; i++) {
+		if (write(fd, buf, BLOCK) != BLOCK) {
+			perror("write");
+			return 1;
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		return 1;
+	}
+	sync();
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		unsigned long start;
+
+		buf[0] = i;
+		if (pwrite(fd, buf, BLOCK, (rand() % blocks) * BLOCK) != BLOCK) {
+			perror("pwrite");
+			return 1;
+		}
+		start = now_us();
+		if (fsync(fd)) {
+			perror("fsync");
+			return 1;
+		}
+		lat[i] = now_us() - start;
+	}
+	close(fd);
+
+	qsort(lat, n, sizeof(*lat), cmp_ul);
+	printf("%lu %lu %lu %lu\n", n, lat[n / 2], lat[n * 99 / 100],
+	       lat[n - 1]);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n fsyncs] [-s file_kb] file\n", argv[0]);
+	return 2;
+}
@@ -0,0 +1,152 @@
+#!/bin/bash
+# Streams TCP from a client through a NATing router namespace to a
+# server, all linked by veth pairs, once through the regular forwarding
+# path and once with the connection offloaded to the software flow table
+# by the FLOWOFFLOAD target.  Checks that the connection shows up as
+# offloaded in conntrack while it runs, that everything arrives intact and
+# that conntrack's byte counters keep up with the offloaded traffic;
+# prints the rate of both runs for comparison.
+
+CLI=flow-cli-$$
+RTR=flow-rtr-$$
+SRV=flow-srv-$$
+megabytes=4000
+
+cleanup()
+{
+	ip netns del $CLI 2>/dev/null
+	ip netns del $RTR 2>/dev/null
+	ip netns del $SRV 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./tcp_mmap ]; then
+		echo $msg tcp_mmap not built >&2
+		exit 0
+	fi
+
+	if ! ip netns add $CLI 2>/dev/null ||
+	   ! ip link add veth0 type veth peer name veth1 2>/dev/null; then
+		echo $msg network namespaces or veth not available >&2
+		exit 0
+	fi
+	ip link del veth0
+
+	ip netns add $RTR
+	if ! ip netns exec $RTR iptables -A FORWARD \
+		-m conntrack --ctstate ESTABLISHED -j FLOWOFFLOAD 2>/dev/null; then
+		echo $msg FLOWOFFLOAD target not available >&2
+		exit 0
+	fi
+	ip netns exec $RTR iptables -F FORWARD
+}
+
+setup()
+{
+	ip netns add $SRV
+
+	ip link add eth0 netns $CLI type veth peer name eth0 netns $RTR
+	ip link add eth1 netns $RTR type veth peer name eth0 netns $SRV
+
+	ip -n $CLI addr add 192.168.1.2/24 dev eth0
+	ip -n $RTR addr add 192.168.1.1/24 dev eth0
+	ip -n $RTR addr add 10.0.0.1/24 dev eth1
+	ip -n $SRV addr add 10.0.0.2/24 dev eth0
+
+	for ns in $CLI $RTR $SRV; do
+		ip -n $ns link set lo up
+		ip -n $ns link set eth0 up
+	done
+	ip -n $RTR link set eth1 up
+
+	ip -n $CLI route add default via 192.168.1.1
+
+	ip netns exec $RTR sysctl -qw net.ipv4.ip_forward=1
+	ip netns exec $RTR sysctl -qw net.netfilter.nf_conntrack_acct=1
+	ip netns exec $RTR iptables -t nat -A POSTROUTING -o eth1 \
+		-j MASQUERADE
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "flowoffload: $1: [PASS]"
+	else
+		echo "flowoffload: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# conntrack bytes of the server side direction of the stream
+ct_bytes()
+{
+	ip netns exec $RTR cat /proc/net/nf_conntrack |
+		sed -n 's/.*dport=8001 packets=[0-9]* bytes=\([0-9]*\) .*/\1/p' |
+		head -1
+}
+
+# run <offload>: prints "megabytes bad mbit/s offloaded ct-megabytes"
+run()
+{
+	local offload=$1
+	local out fifo=$(mktemp -u) seen=0 bytes=0
+
+	ip netns exec $RTR iptables -F FORWARD
+	if [ $offload = 1 ]; then
+		ip netns exec $RTR iptables -A FORWARD \
+			-m conntrack --ctstate ESTABLISHED -j FLOWOFFLOAD
+	fi
+
+	mkfifo $fifo
+	ip netns exec $SRV ./tcp_mmap -r > $fifo &
+	exec 3< $fifo
+	rm -f $fifo
+	read -u 3 out
+	ip netns exec $CLI ./tcp_mmap -c 10.0.0.2 -n $megabytes &
+
+	sleep 1
+	if ip netns exec $RTR grep -q '\[OFFLOAD\]' /proc/net/nf_conntrack; then
+		seen=1
+	fi
+	# the counters are synced once a second, and when the flow ends
+	sleep 1.5
+	bytes=$(ct_bytes)
+
+	read -u 3 got bad rate cpu mapped
+	wait
+	exec 3<&-
+
+	echo ${got:-0} ${bad:-1} ${rate:-0} $seen $((${bytes:-0} >> 20))
+}
+
+check_prereqs
+trap cleanup EXIT
+setup
+
+ret=0
+
+slow=($(run 0))
+fast=($(run 1))
+
+printf "%-10s %10s %8s\n" path megabytes Mbit/s
+printf "%-10s %10s %8s\n" forward ${slow[0]} ${slow[2]}
+printf "%-10s %10s %8s\n" offload ${fast[0]} ${fast[2]}
+
+pass "regular forwarding" \
+	"[ ${slow[1]} = 0 ] && [ ${slow[0]} = $megabytes ]"
+pass "not offloaded without the target" "[ ${slow[3]} = 0 ]"
+pass "offloaded forwarding" \
+	"[ ${fast[1]} = 0 ] && [ ${fast[0]} = $megabytes ]"
+pass "connection offloaded" "[ ${fast[3]} = 1 ]"
+pass "conntrack counters synced" "[ ${fast[4]} -gt 0 ]"
+
+exit $ret
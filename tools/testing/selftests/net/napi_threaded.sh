@@ -0,0 +1,144 @@
+#!/bin/bash
+# Sends UDP datagrams between two namespaces over a veth pair whose
+# receiving end polls through NAPI (rx-gro-list puts it behind GRO
+# cells), once with NAPI polled from the NET_RX softirq and once with it
+# polled from per-instance kthreads (/sys/class/net/<dev>/threaded).
+# Prints softirq time against payload rate for both modes; checks that
+# the kthreads come and go with the device, that traffic gets through
+# in both modes and that switching modes under load loses nothing but
+# UDP's usual drops.
+
+CLI=napi-cli-$$
+SRV=napi-srv-$$
+count=200000
+size=1000
+
+cleanup()
+{
+	ip netns del $CLI 2>/dev/null
+	ip netns del $SRV 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./udpgro_fwd ]; then
+		echo $msg udpgro_fwd not built >&2
+		exit 0
+	fi
+
+	if ! ethtool --version > /dev/null 2>&1; then
+		echo $msg could not run test without ethtool >&2
+		exit 0
+	fi
+
+	if ! ip netns add $CLI 2>/dev/null ||
+	   ! ip netns add $SRV 2>/dev/null ||
+	   ! ip link add eth0 netns $CLI type veth peer name eth0 \
+		netns $SRV 2>/dev/null; then
+		echo $msg network namespaces or veth not available >&2
+		exit 0
+	fi
+
+	if ! ip netns exec $SRV test -e /sys/class/net/eth0/threaded; then
+		echo $msg threaded napi not available >&2
+		exit 0
+	fi
+}
+
+setup()
+{
+	ip -n $CLI addr add 192.168.1.1/24 dev eth0
+	ip -n $SRV addr add 192.168.1.2/24 dev eth0
+	ip -n $CLI link set eth0 up
+	ip -n $SRV link set eth0 up
+	ip netns exec $SRV ethtool -K eth0 rx-gro-list on
+}
+
+# softirq time of all cpus, in USER_HZ
+softirq_time()
+{
+	awk '/^cpu / { print $8 }' /proc/stat
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "napi_threaded: $1: [PASS]"
+	else
+		echo "napi_threaded: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# run <threaded> [toggle]: prints "datagrams bad mbit/s softirq-time"
+run()
+{
+	local threaded=$1 toggle=$2
+	local out fifo=$(mktemp -u) start
+
+	ip netns exec $SRV sh -c "echo $threaded > /sys/class/net/eth0/threaded"
+
+	mkfifo $fifo
+	ip netns exec $SRV ./udpgro_fwd -r -n $count -s $size > $fifo &
+	exec 3< $fifo
+	rm -f $fifo
+	read -u 3 out
+
+	start=$(softirq_time)
+	if [ -n "$toggle" ]; then
+		(
+			for i in $(seq 20); do
+				ip netns exec $SRV sh -c \
+				   "echo $((i % 2)) > /sys/class/net/eth0/threaded"
+				sleep 0.05
+			done
+		) &
+	fi
+	ip netns exec $CLI ./udpgro_fwd -c 192.168.1.2 -n $count -s $size
+	read -u 3 got bad rate
+	wait
+	exec 3<&-
+
+	echo ${got:-0} ${bad:-1} ${rate:-0} $(($(softirq_time) - start))
+}
+
+check_prereqs
+trap cleanup EXIT
+setup
+
+ret=0
+
+ip netns exec $SRV sh -c "echo 1 > /sys/class/net/eth0/threaded"
+pass "kthreads created" "pgrep '^napi/eth0-' > /dev/null"
+pass "mode reported" \
+	"[ \$(ip netns exec $SRV cat /sys/class/net/eth0/threaded) = 1 ]"
+
+softirq=($(run 0))
+threaded=($(run 1))
+toggled=($(run 1 toggle))
+
+printf "%-10s %10s %8s %10s\n" mode datagrams Mbit/s softirq
+printf "%-10s %10s %8s %10s\n" softirq ${softirq[0]} ${softirq[2]} \
+	${softirq[3]}
+printf "%-10s %10s %8s %10s\n" threaded ${threaded[0]} ${threaded[2]} \
+	${threaded[3]}
+
+pass "softirq mode traffic" "[ ${softirq[1]} = 0 ] && [ ${softirq[0]} -gt 0 ]"
+pass "threaded mode traffic" \
+	"[ ${threaded[1]} = 0 ] && [ ${threaded[0]} -gt 0 ]"
+pass "mode switch under load" \
+	"[ ${toggled[1]} = 0 ] && [ ${toggled[0]} -gt 0 ]"
+
+ip netns del $SRV
+sleep 1
+pass "kthreads stopped" "! pgrep '^napi/eth0-' > /dev/null"
+
+exit $ret
@@ -0,0 +1,297 @@
+/*
+ * TCP receiver and sender for the receive zerocopy test.  The sender
+ * streams a pattern derived from the byte offset with sendfile() from a
+ * temporary file, so that every payload frag is a whole page cache page
+ * at offset 0 (a plain send() copies into larger page fragments, which
+ * cannot be mapped page by page); the receiver either
+ * reads it with recv() or maps whole payload pages into an mmap() of the
+ * socket with getsockopt(TCP_ZEROCOPY_RECEIVE) and reads only the bytes
+ * the kernel asks it to skip.  Either way it checks every byte, and
+ * prints how many megabytes arrived, at what rate, how much cpu time it
+ * spent per megabyte and how much of the data was mapped.
+ *
+ * Usage: tcp_mmap -r [-z] [-6] [-p port] [-M mss]
+ *        tcp_mmap -c <address> [-p port] [-n megabytes] [-M mss]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#ifndef TCP_ZEROCOPY_RECEIVE
+#define TCP_ZEROCOPY_RECEIVE 35
+#endif
+
+#define CHUNK		(512 * 1024)
+
+static unsigned long megabytes = 1000;
+static unsigned int port = 8001;
+static int mss;
+
+static uint64_t ts_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL +
+	       ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/* repeats every CHUNK bytes, the size of the file the sender streams */
+static inline unsigned char pattern(uint64_t off)
+{
+	off &= CHUNK - 1;
+	return (unsigned char)(off ^ (off >> 12));
+}
+
+static void fill(unsigned char *buf, size_t len, uint64_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(off + i);
+}
+
+static int check(const unsigned char *buf, size_t len, uint64_t off)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != pattern(off + i))
+			return -1;
+	return 0;
+}
+
+static void set_mss(int fd)
+{
+	if (mss && setsockopt(fd, IPPROTO_TCP, TCP_MAXSEG, &mss,
+			      sizeof(mss)) < 0)
+		perror("TCP_MAXSEG");
+}
+
+static int receiver(int family, int zerocopy)
+{
+	struct sockaddr_storage ss = { .ss_family = family };
+	uint64_t total = 0, mapped = 0, start, cpu;
+	unsigned char *buf, *addr = MAP_FAILED;
+	int lfd, fd, bad = 0, one = 1;
+
+	if (family == AF_INET6)
+		((struct sockaddr_in6 *)&ss)->sin6_port = htons(port);
+	else
+		((struct sockaddr_in *)&ss)->sin_port = htons(port);
+
+	buf = malloc(CHUNK);
+	lfd = socket(family, SOCK_STREAM, 0);
+	if (!buf || lfd < 0) {
+		perror("receiver");
+		return 1;
+	}
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	set_mss(lfd);
+	if (bind(lfd, (struct sockaddr *)&ss, sizeof(ss)) < 0 ||
+	    listen(lfd, 1) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	/* tell the script we are ready */
+	printf("ready\n");
+	fflush(stdout);
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		return 1;
+	}
+
+	if (zerocopy) {
+		addr = mmap(NULL, CHUNK, PROT_READ, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+	}
+
+	start = ts_ns();
+	cpu = cpu_us();
+	for (;;) {
+		size_t skip = CHUNK;
+		ssize_t len;
+
+		if (zerocopy) {
+			struct tcp_zerocopy_receive zc = {
+				.address = (uintptr_t)addr,
+				.length = CHUNK,
+			};
+			socklen_t zc_len = sizeof(zc);
+
+			if (getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE,
+				       &zc, &zc_len) < 0) {
+				perror("TCP_ZEROCOPY_RECEIVE");
+				return 1;
+			}
+			if (zc.length) {
+				if (check(addr, zc.length, total))
+					bad = 1;
+				total += zc.length;
+				mapped += zc.length;
+			}
+			/* whatever was not page sized has to be copied */
+			skip = zc.recv_skip_hint;
+			if (!skip) {
+				if (zc.length)
+					continue;
+				skip = CHUNK;
+			}
+			if (skip > CHUNK)
+				skip = CHUNK;
+		}
+
+		len = recv(fd, buf, skip, 0);
+		if (len < 0) {
+			perror("recv");
+			return 1;
+		}
+		if (!len)
+			break;
+		if (check(buf, len, total))
+			bad = 1;
+		total += len;
+	}
+	start = ts_ns() - start;
+	cpu = cpu_us() - cpu;
+
+	/* megabytes, bad, mbit/s, cpu usec per megabyte, percent mapped */
+	printf("%llu %d %llu %llu %llu\n",
+	       (unsigned long long)(total >> 20), bad,
+	       start ? (unsigned long long)(total * 8000 / start) : 0,
+	       total >> 20 ? (unsigned long long)(cpu / (total >> 20)) : 0,
+	       total ? (unsigned long long)(mapped * 100 / total) : 0);
+	return bad;
+}
+
+static int sender(const char *host)
+{
+	struct sockaddr_in6 sin6 = { .sin6_family = AF_INET6 };
+	struct sockaddr_in sin = { .sin_family = AF_INET };
+	uint64_t off = 0, end = (uint64_t)megabytes << 20;
+	struct sockaddr *sa;
+	char path[] = "/tmp/tcp_mmap.XXXXXX";
+	unsigned char *buf;
+	socklen_t salen;
+	int fd, file;
+
+	if (inet_pton(AF_INET, host, &sin.sin_addr) == 1) {
+		sin.sin_port = htons(port);
+		sa = (struct sockaddr *)&sin;
+		salen = sizeof(sin);
+	} else if (inet_pton(AF_INET6, host, &sin6.sin6_addr) == 1) {
+		sin6.sin6_port = htons(port);
+		sa = (struct sockaddr *)&sin6;
+		salen = sizeof(sin6);
+	} else {
+		fprintf(stderr, "bad address %s\n", host);
+		return 1;
+	}
+
+	buf = malloc(CHUNK);
+	file = mkstemp(path);
+	fd = socket(sa->sa_family, SOCK_STREAM, 0);
+	if (!buf || file < 0 || fd < 0) {
+		perror("sender");
+		return 1;
+	}
+	unlink(path);
+	fill(buf, CHUNK, 0);
+	if (write(file, buf, CHUNK) != CHUNK) {
+		perror("write");
+		return 1;
+	}
+	set_mss(fd);
+	if (connect(fd, sa, salen) < 0) {
+		perror("connect");
+		return 1;
+	}
+
+	while (off < end) {
+		off_t pos = off & (CHUNK - 1);
+		ssize_t len;
+
+		len = sendfile(fd, file, &pos, CHUNK - (off & (CHUNK - 1)));
+		if (len < 0) {
+			perror("sendfile");
+			return 1;
+		}
+		/* the pattern follows the offset, so a short send is fine */
+		off += len;
+	}
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *host = NULL;
+	int family = AF_INET;
+	int zerocopy = 0;
+	int rx = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "6c:M:n:p:rz")) != -1) {
+		switch (c) {
+		case '6':
+			family = AF_INET6;
+			break;
+		case 'c':
+			host = optarg;
+			break;
+		case 'M':
+			mss = atoi(optarg);
+			break;
+		case 'n':
+			megabytes = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rx = 1;
+			break;
+		case 'z':
+			zerocopy = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (rx == !!host)
+		goto usage;
+
+	return rx ? receiver(family, zerocopy) : sender(host);
+
+usage:
+	fprintf(stderr,
+		"usage: %s -r [-z] [-6] [-p port] [-M mss]\n"
+		"       %s -c <address> [-p port] [-n megabytes] [-M mss]\n",
+		argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,75 @@
+#!/bin/bash
+# Streams TCP over loopback (MTU 65536) with an MSS that is a multiple of
+# the page size, so the payload lands in whole-page frags, and receives it
+# once with recv() and once by mapping the pages into an mmap() of the
+# socket with TCP_ZEROCOPY_RECEIVE, over IPv4 and IPv6.  All data has to
+# arrive intact; the rate and the receiver's cpu time per megabyte are
+# printed for comparison.
+
+NS=tcp-mmap-$$
+megabytes=2000
+mss=$((4096 * 15))
+
+cleanup()
+{
+	ip netns del $NS 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./tcp_mmap ]; then
+		echo $msg tcp_mmap not built >&2
+		exit 0
+	fi
+
+	if ! ip netns add $NS 2>/dev/null; then
+		echo $msg network namespaces not available >&2
+		exit 0
+	fi
+}
+
+# run <name> <address> <receiver options>
+run()
+{
+	local name=$1 addr=$2 opts=$3
+	local out fifo=$(mktemp -u)
+
+	mkfifo $fifo
+	ip netns exec $NS ./tcp_mmap -r $opts -M $mss > $fifo &
+	exec 3< $fifo
+	rm -f $fifo
+	read -u 3 out
+	ip netns exec $NS ./tcp_mmap -c $addr -n $megabytes -M $mss
+	read -u 3 got bad rate cpu mapped
+	wait
+	exec 3<&-
+
+	if [ "${bad:-1}" = 0 ] && [ "${got:-0}" = $megabytes ]; then
+		printf "%-30s %8s Mbit/s %6s us/MB %3s%% mapped [PASS]\n" \
+			"$name" $rate $cpu $mapped
+	else
+		printf "%-30s %8s MB received [FAIL]\n" "$name" "${got:-0}"
+		ret=1
+	fi
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ip -n $NS link set lo mtu 65536 up
+
+ret=0
+
+run "tcp_mmap: ipv4 recvmsg" 127.0.0.1
+run "tcp_mmap: ipv4 zerocopy" 127.0.0.1 -z
+run "tcp_mmap: ipv6 recvmsg" ::1 -6
+run "tcp_mmap: ipv6 zerocopy" ::1 "-6 -z"
+
+exit $ret
@@ -0,0 +1,103 @@
+#!/bin/bash
+# Sends UDP datagrams over many flows (source ports) from one namespace
+# to an unconnected socket in another, over a veth pair, with early demux
+# of unconnected sockets (net.ipv4.udp_early_demux_unconnected) off and
+# on, and to an SO_REUSEPORT group balanced by flow hash, with and
+# without each socket tied to a cpu through SO_INCOMING_CPU.  Whatever
+# arrives has to be intact; the payload rate of each run is printed for
+# comparison.
+
+CLI=udp-demux-cli-$$
+SRV=udp-demux-srv-$$
+count=200000
+size=200
+flows=256
+socks=4
+
+cleanup()
+{
+	ip netns del $CLI 2>/dev/null
+	ip netns del $SRV 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./udpgro_fwd ]; then
+		echo $msg udpgro_fwd not built >&2
+		exit 0
+	fi
+
+	if ! ip netns add $CLI 2>/dev/null ||
+	   ! ip netns add $SRV 2>/dev/null ||
+	   ! ip link add eth0 netns $CLI type veth peer name eth0 \
+		netns $SRV 2>/dev/null; then
+		echo $msg network namespaces or veth not available >&2
+		exit 0
+	fi
+
+	if [ ! -e /proc/sys/net/ipv4/udp_early_demux_unconnected ]; then
+		echo $msg early demux of unconnected sockets not available >&2
+		exit 0
+	fi
+}
+
+setup()
+{
+	ip -n $CLI addr add 192.168.1.1/24 dev eth0
+	ip -n $SRV addr add 192.168.1.2/24 dev eth0
+	ip -n $CLI link set eth0 up
+	ip -n $SRV link set eth0 up
+}
+
+# run <name> <early demux> [receiver options]
+run()
+{
+	local name=$1 demux=$2 opts=$3
+	local out fifo=$(mktemp -u)
+
+	sysctl -qw net.ipv4.udp_early_demux_unconnected=$demux
+
+	mkfifo $fifo
+	ip netns exec $SRV ./udpgro_fwd -r -n $count -s $size $opts > $fifo &
+	exec 3< $fifo
+	rm -f $fifo
+	read -u 3 out
+	ip netns exec $CLI ./udpgro_fwd -c 192.168.1.2 -n $count -s $size \
+		-f $flows
+	read -u 3 got bad rate used
+	wait
+	exec 3<&-
+
+	# UDP may drop under load, but whatever arrives has to be intact
+	if [ "${bad:-1}" = 0 ] && [ ${got:-0} -gt 0 ]; then
+		printf "%-40s %8s datagrams %6s Mbit/s %s [PASS]\n" \
+			"$name" $got $rate "${used:+($used sockets)}"
+	else
+		printf "%-40s %8s datagrams %6s Mbit/s [FAIL]\n" \
+			"$name" "${got:-0}" "${rate:-0}"
+		ret=1
+	fi
+}
+
+check_prereqs
+trap cleanup EXIT
+setup
+
+ret=0
+saved=$(sysctl -n net.ipv4.udp_early_demux_unconnected)
+
+run "udp_demux: unconnected, early demux off" 0
+run "udp_demux: unconnected, early demux on" 1
+run "udp_demux: reuseport by flow hash" 1 "-R $socks"
+run "udp_demux: reuseport by incoming cpu" 1 "-R $socks -C"
+
+sysctl -qw net.ipv4.udp_early_demux_unconnected=$saved
+
+exit $ret
@@ -0,0 +1,253 @@
+/*
+ * UDP sender and receiver for the fraglist GRO forwarding test.  The
+ * sender numbers its datagrams and fills them with a pattern derived
+ * from the number; the receiver checks the length and the pattern of
+ * every datagram it gets, and prints how many arrived and at what rate.
+ * The sender can spread its datagrams over several flows (source ports),
+ * the receiver over an SO_REUSEPORT group of sockets, optionally each
+ * with its own SO_INCOMING_CPU; it then also prints how many of the
+ * sockets got datagrams.
+ *
+ * Usage: udpgro_fwd -r [-6] [-p port] [-n count] [-s size] [-R socks [-C]]
+ *        udpgro_fwd -c <address> [-p port] [-n count] [-s size] [-f flows]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static unsigned long count = 100000;
+static unsigned int port = 8000;
+static size_t size = 1000;
+static int flows = 1;
+static int socks = 1;
+static int incoming_cpu;
+
+static uint64_t ts_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fill(unsigned char *buf, uint32_t seq)
+{
+	size_t i;
+
+	memcpy(buf, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < size; i++)
+		buf[i] = (unsigned char)(seq + i);
+}
+
+static int check(const unsigned char *buf, ssize_t len)
+{
+	uint32_t seq;
+	size_t i;
+
+	if (len != (ssize_t)size)
+		return -1;
+	memcpy(&seq, buf, sizeof(seq));
+	for (i = sizeof(seq); i < size; i++)
+		if (buf[i] != (unsigned char)(seq + i))
+			return -1;
+	return 0;
+}
+
+static int receiver(int family)
+{
+	struct sockaddr_storage ss = { .ss_family = family };
+	unsigned long got = 0, bad = 0, *hits;
+	uint64_t first = 0, last = 0;
+	int i, used = 0, one = 1;
+	unsigned char *buf;
+	struct pollfd *pfd;
+
+	if (family == AF_INET6)
+		((struct sockaddr_in6 *)&ss)->sin6_port = htons(port);
+	else
+		((struct sockaddr_in *)&ss)->sin_port = htons(port);
+
+	buf = malloc(size + 1);
+	pfd = calloc(socks, sizeof(*pfd));
+	hits = calloc(socks, sizeof(*hits));
+	if (!buf || !pfd || !hits) {
+		perror("receiver");
+		return 1;
+	}
+	for (i = 0; i < socks; i++) {
+		int fd = socket(family, SOCK_DGRAM, 0);
+
+		if (fd < 0 ||
+		    (socks > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+					     &one, sizeof(one)) < 0) ||
+		    (incoming_cpu && setsockopt(fd, SOL_SOCKET,
+						SO_INCOMING_CPU, &i,
+						sizeof(i)) < 0) ||
+		    bind(fd, (struct sockaddr *)&ss, sizeof(ss)) < 0) {
+			perror("receiver");
+			return 1;
+		}
+		pfd[i].fd = fd;
+		pfd[i].events = POLLIN;
+	}
+
+	/* tell the script we are ready */
+	printf("ready\n");
+	fflush(stdout);
+
+	while (got + bad < count) {
+		int n;
+
+		/* wait long for the first datagram, not for stragglers */
+		n = poll(pfd, socks, got + bad ? 1000 : 10000);
+		if (n <= 0)
+			break;
+		for (i = 0; i < socks; i++) {
+			ssize_t len;
+
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+			len = recv(pfd[i].fd, buf, size + 1, MSG_DONTWAIT);
+			if (len < 0) {
+				if (errno == EAGAIN)
+					continue;
+				perror("recv");
+				return 1;
+			}
+			last = ts_ns();
+			if (!first)
+				first = last;
+			if (check(buf, len))
+				bad++;
+			else
+				got++;
+			hits[i]++;
+		}
+	}
+
+	for (i = 0; i < socks; i++)
+		used += !!hits[i];
+
+	/* datagrams, bad ones, mbit/s of payload[, sockets used] */
+	printf("%lu %lu %llu", got, bad,
+	       last > first ?
+	       (unsigned long long)(got * size * 8000 / (last - first)) : 0);
+	if (socks > 1)
+		printf(" %d", used);
+	printf("\n");
+	return bad ? 1 : 0;
+}
+
+static int sender(const char *addr)
+{
+	struct sockaddr_in6 sin6 = { .sin6_family = AF_INET6 };
+	struct sockaddr_in sin = { .sin_family = AF_INET };
+	struct sockaddr *sa;
+	unsigned char *buf;
+	socklen_t salen;
+	unsigned long i;
+	int f, *fd;
+
+	if (inet_pton(AF_INET, addr, &sin.sin_addr) == 1) {
+		sin.sin_port = htons(port);
+		sa = (struct sockaddr *)&sin;
+		salen = sizeof(sin);
+	} else if (inet_pton(AF_INET6, addr, &sin6.sin6_addr) == 1) {
+		sin6.sin6_port = htons(port);
+		sa = (struct sockaddr *)&sin6;
+		salen = sizeof(sin6);
+	} else {
+		fprintf(stderr, "bad address %s\n", addr);
+		return 1;
+	}
+
+	buf = malloc(size);
+	fd = calloc(flows, sizeof(*fd));
+	if (!buf || !fd) {
+		perror("sender");
+		return 1;
+	}
+	/* one connected socket, hence one source port, per flow */
+	for (f = 0; f < flows; f++) {
+		fd[f] = socket(sa->sa_family, SOCK_DGRAM, 0);
+		if (fd[f] < 0 || connect(fd[f], sa, salen) < 0) {
+			perror("sender");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		fill(buf, i);
+		/* a full socket buffer just means we went too fast */
+		if (send(fd[i % flows], buf, size, 0) < 0 &&
+		    errno != ENOBUFS) {
+			perror("send");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *addr = NULL;
+	int family = AF_INET;
+	int rx = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "6c:Cf:n:p:rR:s:")) != -1) {
+		switch (c) {
+		case '6':
+			family = AF_INET6;
+			break;
+		case 'c':
+			addr = optarg;
+			break;
+		case 'C':
+			incoming_cpu = 1;
+			break;
+		case 'f':
+			flows = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rx = 1;
+			break;
+		case 'R':
+			socks = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (rx == !!addr || size < sizeof(uint32_t) || size > 65000 ||
+	    flows < 1 || socks < 1)
+		goto usage;
+
+	return rx ? receiver(family) : sender(addr);
+
+usage:
+	fprintf(stderr,
+		"usage: %s -r [-6] [-p port] [-n count] [-s size] "
+		"[-R socks [-C]]\n"
+		"       %s -c <address> [-p port] [-n count] [-s size] "
+		"[-f flows]\n",
+		argv[0], argv[0]);
+	return 1;
+}
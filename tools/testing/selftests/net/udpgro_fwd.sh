@@ -0,0 +1,133 @@
+#!/bin/bash
+# Forwards UDP datagrams from a client to a server through a router
+# namespace, all linked by veth pairs, with and without fraglist GRO
+# (rx-gro-list) on the router's ingress device, over IPv4 and IPv6.
+# Every datagram has to arrive intact; the payload rate of each run is
+# printed for comparison.  Datagrams chained by fraglist GRO on the
+# server's own device have to be split up again for the local socket.
+
+CLI=udpgro-cli-$$
+RTR=udpgro-rtr-$$
+SRV=udpgro-srv-$$
+count=100000
+size=1000
+
+cleanup()
+{
+	ip netns del $CLI 2>/dev/null
+	ip netns del $RTR 2>/dev/null
+	ip netns del $SRV 2>/dev/null
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./udpgro_fwd ]; then
+		echo $msg udpgro_fwd not built >&2
+		exit 0
+	fi
+
+	if ! ethtool --version > /dev/null 2>&1; then
+		echo $msg could not run test without ethtool >&2
+		exit 0
+	fi
+
+	if ! ip netns add $CLI 2>/dev/null ||
+	   ! ip link add veth0 type veth peer name veth1 2>/dev/null; then
+		echo $msg network namespaces or veth not available >&2
+		exit 0
+	fi
+	ip link del veth0
+}
+
+setup()
+{
+	ip netns add $RTR
+	ip netns add $SRV
+
+	ip link add eth0 netns $CLI type veth peer name eth0 netns $RTR
+	ip link add eth1 netns $RTR type veth peer name eth0 netns $SRV
+
+	ip -n $CLI addr add 192.168.1.2/24 dev eth0
+	ip -n $CLI addr add 2001:db8:1::2/64 dev eth0 nodad
+	ip -n $RTR addr add 192.168.1.1/24 dev eth0
+	ip -n $RTR addr add 2001:db8:1::1/64 dev eth0 nodad
+	ip -n $RTR addr add 192.168.2.1/24 dev eth1
+	ip -n $RTR addr add 2001:db8:2::1/64 dev eth1 nodad
+	ip -n $SRV addr add 192.168.2.2/24 dev eth0
+	ip -n $SRV addr add 2001:db8:2::2/64 dev eth0 nodad
+
+	for ns in $CLI $RTR $SRV; do
+		ip -n $ns link set lo up
+		ip -n $ns link set eth0 up
+	done
+	ip -n $RTR link set eth1 up
+
+	ip -n $CLI route add default via 192.168.1.1
+	ip -n $CLI route add default via 2001:db8:1::1
+	ip -n $SRV route add default via 192.168.2.1
+	ip -n $SRV route add default via 2001:db8:2::1
+
+	ip netns exec $RTR sysctl -qw net.ipv4.ip_forward=1
+	ip netns exec $RTR sysctl -qw net.ipv6.conf.all.forwarding=1
+}
+
+# run <name> <ns> <dev> <rx-gro-list> <server address> [-6]
+run()
+{
+	local name=$1 ns=$2 dev=$3 gro=$4 addr=$5 family=$6
+	local out fifo=$(mktemp -u)
+
+	ip netns exec $ns ethtool -K $dev rx-gro-list $gro
+	if [ "$(ip netns exec $ns ethtool -k $dev |
+		sed -n 's/^rx-gro-list: \([a-z]*\).*/\1/p')" != $gro ]; then
+		printf "%-36s [FAIL]\n" "$name"
+		ret=1
+		return
+	fi
+
+	mkfifo $fifo
+	ip netns exec $SRV ./udpgro_fwd -r $family -n $count -s $size > $fifo &
+	exec 3< $fifo
+	rm -f $fifo
+	read -u 3 out
+	ip netns exec $CLI ./udpgro_fwd -c $addr -n $count -s $size
+	read -u 3 got bad rate
+	wait
+	exec 3<&-
+
+	# UDP may drop under load, but whatever arrives has to be intact
+	if [ "${bad:-1}" = 0 ] && [ ${got:-0} -gt 0 ]; then
+		printf "%-36s %8s datagrams %6s Mbit/s [PASS]\n" \
+			"$name" $got $rate
+	else
+		printf "%-36s %8s datagrams %6s Mbit/s [FAIL]\n" \
+			"$name" "${got:-0}" "${rate:-0}"
+		ret=1
+	fi
+}
+
+check_prereqs
+trap cleanup EXIT
+setup
+
+ret=0
+
+for gro in off on; do
+	run "udpgro_fwd: ipv4 forward, gro-list $gro" \
+		$RTR eth0 $gro 192.168.2.2
+	run "udpgro_fwd: ipv6 forward, gro-list $gro" \
+		$RTR eth0 $gro 2001:db8:2::2 -6
+done
+ip netns exec $RTR ethtool -K eth0 rx-gro-list off
+
+run "udpgro_fwd: ipv4 local, gro-list on" $SRV eth0 on 192.168.2.2
+run "udpgro_fwd: ipv6 local, gro-list on" $SRV eth0 on 2001:db8:2::2 -6
+
+exit $ret
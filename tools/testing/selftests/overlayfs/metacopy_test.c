@@ -0,0 +1,293 @@
+/*
+ * overlayfs metadata-only copy up selftest and benchmark
+ *
+ * Sets up a tmpfs with lower, upper and work directories, and compares a
+ * chmod() of a large lower file with metacopy=off and metacopy=on: the
+ * copy-up latency and the bytes that end up allocated in the upper layer.
+ * With metacopy=on it also checks that:
+ *
+ *  - the data is still read from the lower layer after the chmod;
+ *  - the redirect survives a rename and a remount;
+ *  - the first open for write copies the data and keeps mtime;
+ *  - O_TRUNC drops the redirect without copying anything.
+ *
+ * Needs CAP_SYS_ADMIN; skips if overlayfs or metacopy is unavailable.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/xattr.h>
+
+#define BIG_SIZE	(64 << 20)
+#define CHUNK		(1 << 20)
+#define METACOPY_XATTR	"trusted.overlay.metacopy"
+
+static char base[] = "/tmp/ovl_metacopy.XXXXXX";
+static char lower[64], upper[64], work[64], merged[64];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fill(char *buf, size_t len, unsigned int seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (char)(seed + i * 13);
+}
+
+static int write_file(const char *path, size_t size)
+{
+	char *buf = malloc(CHUNK);
+	size_t pos;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (!buf || fd < 0)
+		return -errno;
+	for (pos = 0; pos < size; pos += CHUNK) {
+		fill(buf, CHUNK, pos / CHUNK);
+		if (write(fd, buf, CHUNK) != CHUNK)
+			return -EIO;
+	}
+	close(fd);
+	free(buf);
+	return 0;
+}
+
+static int check_file(const char *path, size_t size)
+{
+	char *buf = malloc(CHUNK), *expect = malloc(CHUNK);
+	size_t pos;
+	int fd, ret = 0;
+
+	fd = open(path, O_RDONLY);
+	if (!buf || !expect || fd < 0)
+		return -errno;
+	for (pos = 0; pos < size && !ret; pos += CHUNK) {
+		fill(expect, CHUNK, pos / CHUNK);
+		if (read(fd, buf, CHUNK) != CHUNK || memcmp(buf, expect, CHUNK))
+			ret = -EINVAL;
+	}
+	close(fd);
+	free(buf);
+	free(expect);
+	return ret;
+}
+
+static int ovl_mount(int metacopy)
+{
+	char opts[512];
+
+	snprintf(opts, sizeof(opts),
+		 "lowerdir=%s,upperdir=%s,workdir=%s,metacopy=%s",
+		 lower, upper, work, metacopy ? "on" : "off");
+	return mount("overlay", merged, "overlay", 0, opts) ? -errno : 0;
+}
+
+static void reset_upper(void)
+{
+	char cmd[256];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s/* %s/*", upper, work);
+	if (system(cmd))
+		perror("rm");
+}
+
+static int has_metacopy(const char *path)
+{
+	return getxattr(path, METACOPY_XATTR, NULL, 0) >= 0;
+}
+
+/* chmod a large lower file through the overlay, report the copy-up cost */
+static int bench(int metacopy, uint64_t *ns, uint64_t *bytes)
+{
+	char path[128];
+	struct stat st;
+	uint64_t start;
+	int ret;
+
+	reset_upper();
+	ret = ovl_mount(metacopy);
+	if (ret)
+		return ret;
+
+	snprintf(path, sizeof(path), "%s/big", merged);
+	start = now_ns();
+	ret = chmod(path, 0600) ? -errno : 0;
+	*ns = now_ns() - start;
+	if (!ret)
+		ret = check_file(path, BIG_SIZE);
+
+	snprintf(path, sizeof(path), "%s/big", upper);
+	if (!ret && stat(path, &st))
+		ret = -errno;
+	if (!ret && (st.st_size != BIG_SIZE || (st.st_mode & 07777) != 0600))
+		ret = -EINVAL;
+	*bytes = st.st_blocks * 512ULL;
+
+	if (!ret && has_metacopy(path) != metacopy) {
+		printf("bench: metacopy xattr %s\n",
+		       metacopy ? "missing" : "unexpected");
+		ret = -EINVAL;
+	}
+
+	umount(merged);
+	return ret;
+}
+
+static int test_metacopy(void)
+{
+	char mpath[128], upath[128], mnew[128], unew[128];
+	struct stat before, after;
+	int fd, ret;
+
+	reset_upper();
+	ret = ovl_mount(1);
+	if (ret)
+		return ret;
+
+	snprintf(mpath, sizeof(mpath), "%s/dir/file", merged);
+	snprintf(upath, sizeof(upath), "%s/dir/file", upper);
+	snprintf(mnew, sizeof(mnew), "%s/moved", merged);
+	snprintf(unew, sizeof(unew), "%s/moved", upper);
+
+	if (chown(mpath, 1, 1) || !has_metacopy(upath)) {
+		printf("metacopy: chown did not do a metadata-only copy up\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* the redirect is absolute, so it has to survive a rename */
+	if (rename(mpath, mnew) || check_file(mnew, CHUNK * 4)) {
+		printf("metacopy: data lost after rename\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* ... and a fresh lookup */
+	umount(merged);
+	ret = ovl_mount(1);
+	if (ret)
+		return ret;
+	if (check_file(mnew, CHUNK * 4)) {
+		printf("metacopy: data lost after remount\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* first open for write copies the data up, keeping mtime */
+	stat(mnew, &before);
+	fd = open(mnew, O_RDWR);
+	if (fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+	close(fd);
+	stat(mnew, &after);
+	if (has_metacopy(unew) || check_file(unew, CHUNK * 4) ||
+	    before.st_mtime != after.st_mtime) {
+		printf("metacopy: data copy up on open for write failed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* O_TRUNC needs no data at all */
+	snprintf(mpath, sizeof(mpath), "%s/big", merged);
+	snprintf(upath, sizeof(upath), "%s/big", upper);
+	if (utimes(mpath, NULL) || !has_metacopy(upath)) {
+		printf("metacopy: utimes did not do a metadata-only copy up\n");
+		ret = -EINVAL;
+		goto out;
+	}
+	fd = open(mpath, O_WRONLY | O_TRUNC);
+	if (fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+	close(fd);
+	if (has_metacopy(upath) || stat(upath, &after) || after.st_size) {
+		printf("metacopy: O_TRUNC open left a metacopy behind\n");
+		ret = -EINVAL;
+	}
+out:
+	umount(merged);
+	return ret;
+}
+
+int main(void)
+{
+	uint64_t full_ns, full_bytes, meta_ns, meta_bytes;
+	char path[128];
+	int ret, fail = 0;
+
+	if (getuid() != 0) {
+		printf("metacopy: need root, skipping test\n");
+		return 0;
+	}
+	if (!mkdtemp(base) || mount("tmpfs", base, "tmpfs", 0, NULL)) {
+		perror("tmpfs");
+		return 1;
+	}
+	snprintf(lower, sizeof(lower), "%s/lower", base);
+	snprintf(upper, sizeof(upper), "%s/upper", base);
+	snprintf(work, sizeof(work), "%s/work", base);
+	snprintf(merged, sizeof(merged), "%s/merged", base);
+	mkdir(lower, 0755);
+	mkdir(upper, 0755);
+	mkdir(work, 0755);
+	mkdir(merged, 0755);
+
+	snprintf(path, sizeof(path), "%s/dir", lower);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/dir/file", lower);
+	ret = write_file(path, CHUNK * 4);
+	snprintf(path, sizeof(path), "%s/big", lower);
+	ret = ret ?: write_file(path, BIG_SIZE);
+	if (ret) {
+		printf("metacopy: setup failed: %s\n", strerror(-ret));
+		fail = 1;
+		goto out;
+	}
+
+	ret = ovl_mount(1);
+	if (ret) {
+		printf("metacopy: overlayfs with metacopy not supported, skipping test\n");
+		goto out;
+	}
+	umount(merged);
+
+	ret = bench(0, &full_ns, &full_bytes);
+	ret = ret ?: bench(1, &meta_ns, &meta_bytes);
+	if (!ret)
+		printf("bench: chmod of %d MiB file: full copy up %llu us, %llu KiB; metacopy %llu us, %llu KiB\n",
+		       BIG_SIZE >> 20,
+		       (unsigned long long)full_ns / 1000,
+		       (unsigned long long)full_bytes >> 10,
+		       (unsigned long long)meta_ns / 1000,
+		       (unsigned long long)meta_bytes >> 10);
+	printf("metacopy: copy up cost: %s\n", ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+
+	ret = test_metacopy();
+	printf("metacopy: lazy data copy up: %s\n",
+	       ret ? strerror(-ret) : "[PASS]");
+	fail |= !!ret;
+out:
+	umount(base);
+	rmdir(base);
+	return fail;
+}
@@ -0,0 +1,252 @@
+/*
+ * Synthetic frame pipeline: a vsync thread releases a frame every period,
+ * and three stage threads (ui, render, compose) each spin for their share
+ * of the frame's work and hand it on to the next stage, the way an app's
+ * UI thread, its RenderThread and the compositor do. With -g the stages
+ * put themselves into a related thread group through
+ * /proc/<pid>/task/<tid>/sched_group_id, so that the scheduler places and
+ * clocks them as one unit.
+ *
+ * Prints the number of frames, the 50th, 90th and 99th percentile and the
+ * maximum frame completion latency in microseconds (vsync to end of the
+ * compose stage), and the number of frames that missed their deadline
+ * either by completing late or by still being in the pipeline at the next
+ * vsync.
+ *
+ * Usage: frame_pipeline [-g group_id] [-n frames] [-p period_us]
+ *                       [-w ui_us,render_us,compose_us]
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#define NR_STAGES	3
+
+static const char * const stage_name[NR_STAGES] = {
+	"ui", "render", "compose",
+};
+
+static unsigned int work_us[NR_STAGES] = { 4000, 6000, 3000 };
+static unsigned int period_us = 16666;
+static unsigned int nr_frames = 600;
+static int group_id;
+
+static sem_t stage_sem[NR_STAGES];
+static volatile int stop;
+static volatile int in_flight;
+static uint64_t frame_start;
+static uint64_t *latency;
+static unsigned int completed;
+static int group_err;
+
+static uint64_t ts_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* spin rather than sleep: the stages are cpu bound, like real frame work */
+static void spin(unsigned int us)
+{
+	uint64_t end = ts_ns() + us * 1000ULL;
+
+	while (ts_ns() < end)
+		;
+}
+
+static int set_group(int id)
+{
+	char path[64], buf[16];
+	FILE *f;
+	int got = -1;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%ld/sched_group_id",
+		 (long)syscall(SYS_gettid));
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	if (fprintf(f, "%d\n", id) < 0 || fclose(f)) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fgets(buf, sizeof(buf), f))
+		got = atoi(buf);
+	fclose(f);
+
+	return got == id ? 0 : -1;
+}
+
+static void *stage(void *arg)
+{
+	long i = (long)arg;
+
+	prctl(PR_SET_NAME, stage_name[i]);
+	if (group_id && set_group(group_id))
+		group_err = 1;
+
+	for (;;) {
+		sem_wait(&stage_sem[i]);
+		if (stop)
+			break;
+
+		spin(work_us[i]);
+
+		if (i + 1 < NR_STAGES) {
+			sem_post(&stage_sem[i + 1]);
+			continue;
+		}
+
+		latency[completed++] = ts_ns() - frame_start;
+		__sync_synchronize();
+		in_flight = 0;
+	}
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int parse_work(char *arg)
+{
+	char *tok;
+	int i;
+
+	for (i = 0; i < NR_STAGES; i++) {
+		tok = strsep(&arg, ",");
+		if (!tok || !*tok)
+			return -1;
+		work_us[i] = strtoul(tok, NULL, 0);
+	}
+
+	return arg ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thread[NR_STAGES];
+	unsigned int frame, missed = 0;
+	struct timespec next;
+	uint64_t period_ns;
+	long i;
+	int c;
+
+	while ((c = getopt(argc, argv, "g:n:p:w:")) != -1) {
+		switch (c) {
+		case 'g':
+			group_id = atoi(optarg);
+			break;
+		case 'n':
+			nr_frames = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			if (parse_work(optarg))
+				goto usage;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (!nr_frames || !period_us)
+		goto usage;
+
+	latency = calloc(nr_frames, sizeof(*latency));
+	if (!latency) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (i = 0; i < NR_STAGES; i++)
+		sem_init(&stage_sem[i], 0, 0);
+
+	for (i = 0; i < NR_STAGES; i++) {
+		if (pthread_create(&thread[i], NULL, stage, (void *)i)) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	period_ns = period_us * 1000ULL;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (frame = 0; frame < nr_frames; frame++) {
+		next.tv_nsec += period_ns;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		/* the previous frame is still in the pipeline: this one drops */
+		if (in_flight) {
+			missed++;
+			continue;
+		}
+
+		in_flight = 1;
+		frame_start = ts_ns();
+		sem_post(&stage_sem[0]);
+	}
+
+	/* let the last frame drain */
+	while (in_flight)
+		usleep(1000);
+
+	stop = 1;
+	for (i = 0; i < NR_STAGES; i++) {
+		sem_post(&stage_sem[i]);
+		pthread_join(thread[i], NULL);
+	}
+
+	if (group_err) {
+		fprintf(stderr, "could not join group %d\n", group_id);
+		return 1;
+	}
+
+	if (!completed) {
+		fprintf(stderr, "no frame completed\n");
+		return 1;
+	}
+
+	for (frame = 0; frame < completed; frame++)
+		if (latency[frame] > period_ns)
+			missed++;
+
+	qsort(latency, completed, sizeof(*latency), cmp_u64);
+
+	/* frames p50 p90 p99 max (usec) missed */
+	printf("%u %llu %llu %llu %llu %u\n", completed,
+	       (unsigned long long)latency[completed / 2] / 1000,
+	       (unsigned long long)latency[completed * 90 / 100] / 1000,
+	       (unsigned long long)latency[completed * 99 / 100] / 1000,
+	       (unsigned long long)latency[completed - 1] / 1000,
+	       missed);
+
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-g group_id] [-n frames] [-p period_us] "
+		"[-w ui_us,render_us,compose_us]\n", argv[0]);
+	return 1;
+}
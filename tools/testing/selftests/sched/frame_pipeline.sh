@@ -0,0 +1,80 @@
+#!/bin/bash
+# Runs the synthetic frame pipeline (ui -> render -> compose, one frame per
+# vsync) with its stages scheduled one by one and with them in a related
+# thread group, and prints frame completion latency and missed frames for
+# both. Checks that the stages join and leave the group, and that the
+# sched_group_update tracepoint reports it.
+
+group=2
+frames=600
+work=4000,6000,3000
+tracing=/sys/kernel/debug/tracing
+
+cleanup()
+{
+	[ -e $tracing/events/sched/sched_group_update/enable ] &&
+		echo 0 > $tracing/events/sched/sched_group_update/enable
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -x ./frame_pipeline ]; then
+		echo $msg frame_pipeline not built >&2
+		exit 0
+	fi
+
+	if [ ! -e /proc/self/sched_group_id ]; then
+		echo $msg related thread groups not available >&2
+		exit 0
+	fi
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "frame_pipeline: $1: [PASS]"
+	else
+		echo "frame_pipeline: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+
+trace=0
+if [ -e $tracing/events/sched/sched_group_update/enable ]; then
+	echo > $tracing/trace
+	echo 1 > $tracing/events/sched/sched_group_update/enable
+	trace=1
+fi
+
+single=($(./frame_pipeline -n $frames -w $work))
+grouped=($(./frame_pipeline -n $frames -w $work -g $group))
+
+printf "%-8s %8s %8s %8s %8s %8s %8s\n" mode frames p50_us p90_us p99_us \
+	max_us missed
+printf "%-8s %8s %8s %8s %8s %8s %8s\n" single ${single[@]}
+printf "%-8s %8s %8s %8s %8s %8s %8s\n" grouped ${grouped[@]}
+
+pass "ungrouped pipeline" "[ ${single[0]:-0} -gt 0 ]"
+pass "grouped pipeline" "[ ${grouped[0]:-0} -gt 0 ]"
+
+if [ $trace = 1 ]; then
+	pass "group join traced" \
+		"[ \$(grep -c 'group_id $group add' $tracing/trace) -ge 3 ]"
+	pass "group leave traced" \
+		"[ \$(grep -c 'group_id $group remove' $tracing/trace) -ge 3 ]"
+fi
+
+exit $ret
@@ -0,0 +1,154 @@
+/*
+ * RT wakeup placement: SCHED_OTHER hogs are pinned to half of the cpus,
+ * the other half is idle and kept in its shallowest C-state through
+ * /dev/cpu_dma_latency. A periodic SCHED_FIFO thread, free to run on any
+ * cpu, has to wake on the idle cpus rather than preempt the hogs. Fails if
+ * more than 5% of its wakeups land on a hog cpu.
+ *
+ * Usage: rt_placement [-i interval_us] [-n loops]
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned int interval_us = 1000;
+static unsigned int loops = 5000;
+
+static volatile int stop;
+static cpu_set_t hog_cpus;
+static unsigned int on_hog_cpu, wakeups;
+
+static void *hog(void *arg)
+{
+	while (!stop)
+		;
+	return NULL;
+}
+
+static void *rt_thread(void *arg)
+{
+	struct timespec next;
+	unsigned int i;
+	int cpu;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < loops; i++) {
+		next.tv_nsec += interval_us * 1000;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		cpu = sched_getcpu();
+		if (cpu >= 0 && CPU_ISSET(cpu, &hog_cpus))
+			on_hog_cpu++;
+		wakeups++;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	pthread_t rt, *hogs;
+	cpu_set_t online;
+	int32_t qos = 0;
+	int c, err, fd, cpu, nr_cpus, nr_hogs = 0, i;
+
+	while ((c = getopt(argc, argv, "i:n:")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (!loops || !interval_us || interval_us >= 1000000)
+		goto usage;
+
+	if (sched_getaffinity(0, sizeof(online), &online)) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+	nr_cpus = CPU_COUNT(&online);
+	if (nr_cpus < 2) {
+		printf("rt_placement: needs two cpus, skipping\n");
+		return 0;
+	}
+
+	/* keep idle cpus out of deep C-states while the fd is open */
+	fd = open("/dev/cpu_dma_latency", O_WRONLY);
+	if (fd < 0 || write(fd, &qos, sizeof(qos)) != sizeof(qos)) {
+		printf("rt_placement: cannot set cpu_dma_latency, skipping\n");
+		return 0;
+	}
+
+	/* every other online cpu gets a hog */
+	hogs = calloc(nr_cpus, sizeof(*hogs));
+	if (!hogs) {
+		perror("calloc");
+		return 1;
+	}
+	CPU_ZERO(&hog_cpus);
+	for (cpu = 0, i = 0; i < nr_cpus; cpu++) {
+		cpu_set_t mask;
+
+		if (!CPU_ISSET(cpu, &online))
+			continue;
+		if (i++ % 2)
+			continue;
+		CPU_ZERO(&mask);
+		CPU_SET(cpu, &mask);
+		CPU_SET(cpu, &hog_cpus);
+		pthread_create(&hogs[nr_hogs], NULL, hog, NULL);
+		pthread_setaffinity_np(hogs[nr_hogs++], sizeof(mask), &mask);
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = 80;
+	pthread_attr_setschedparam(&attr, &param);
+
+	err = pthread_create(&rt, &attr, rt_thread, NULL);
+	if (err == EPERM) {
+		printf("rt_placement: SCHED_FIFO not permitted, skipping\n");
+		stop = 1;
+		return 0;
+	} else if (err) {
+		fprintf(stderr, "pthread_create: %s\n", strerror(err));
+		return 1;
+	}
+	pthread_join(rt, NULL);
+
+	stop = 1;
+	for (i = 0; i < nr_hogs; i++)
+		pthread_join(hogs[i], NULL);
+	close(fd);
+
+	printf("rt_placement: %u of %u wakeups on the %d busy cpus\n",
+	       on_hog_cpu, wakeups, nr_hogs);
+	if (on_hog_cpu * 20 > wakeups) {
+		printf("rt_placement: RT task preempts busy cpus: [FAIL]\n");
+		return 1;
+	}
+	printf("rt_placement: RT task prefers idle cpus: [PASS]\n");
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-i interval_us] [-n loops]\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,214 @@
+/*
+ * RT wakeup latency, cyclictest style: SCHED_FIFO threads, free to run on
+ * any cpu, wake up on an absolute periodic timer and record how late they
+ * got to run. Optional SCHED_OTHER hogs keep cpus busy so that placement
+ * has to choose between preempting them and waking idle cpus. Prints a
+ * histogram of the latencies in microsecond buckets, the number of
+ * wakeups on each cpu, and min/avg/p99/max.
+ *
+ * Usage: rt_wakeup [-t threads] [-l hogs] [-i interval_us] [-n loops]
+ *                  [-p prio] [-b bucket_us]
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_BUCKETS	32
+#define MAX_CPUS	64
+
+static unsigned int nr_threads = 2;
+static unsigned int nr_hogs;
+static unsigned int interval_us = 1000;
+static unsigned int loops = 10000;
+static unsigned int bucket_us = 10;
+static int prio = 80;
+
+static volatile int stop;
+
+struct result {
+	uint64_t hist[NR_BUCKETS + 1];
+	uint64_t cpu_count[MAX_CPUS];
+	uint64_t min, max, sum, count;
+	uint64_t *samples;
+};
+
+static uint64_t ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void *hog(void *arg)
+{
+	while (!stop)
+		;
+	return NULL;
+}
+
+static void *rt_thread(void *arg)
+{
+	struct result *res = arg;
+	struct timespec next, now;
+	unsigned int i;
+	uint64_t lat;
+	int cpu;
+
+	res->min = ~0ULL;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < loops; i++) {
+		next.tv_nsec += interval_us * 1000;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		cpu = sched_getcpu();
+
+		lat = ts_ns(&now) - ts_ns(&next);
+		res->samples[res->count++] = lat;
+		res->sum += lat;
+		if (lat < res->min)
+			res->min = lat;
+		if (lat > res->max)
+			res->max = lat;
+		lat /= bucket_us * 1000;
+		res->hist[lat < NR_BUCKETS ? lat : NR_BUCKETS]++;
+		if (cpu >= 0 && cpu < MAX_CPUS)
+			res->cpu_count[cpu]++;
+	}
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	struct sched_param param;
+	struct result *res, total;
+	pthread_t *rt, *hogs;
+	pthread_attr_t attr;
+	uint64_t *all;
+	unsigned int i, j;
+	int c, err;
+
+	while ((c = getopt(argc, argv, "b:i:l:n:p:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			bucket_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			nr_hogs = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			prio = atoi(optarg);
+			break;
+		case 't':
+			nr_threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (!nr_threads || !loops || !bucket_us || !interval_us ||
+	    interval_us >= 1000000)
+		goto usage;
+
+	res = calloc(nr_threads, sizeof(*res));
+	rt = calloc(nr_threads, sizeof(*rt));
+	hogs = calloc(nr_hogs + 1, sizeof(*hogs));
+	all = calloc((size_t)nr_threads * loops, sizeof(*all));
+	if (!res || !rt || !hogs || !all) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (i = 0; i < nr_hogs; i++)
+		pthread_create(&hogs[i], NULL, hog, NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = prio;
+	pthread_attr_setschedparam(&attr, &param);
+
+	for (i = 0; i < nr_threads; i++) {
+		res[i].samples = all + (size_t)i * loops;
+		err = pthread_create(&rt[i], &attr, rt_thread, &res[i]);
+		if (err == EPERM) {
+			printf("rt_wakeup: SCHED_FIFO not permitted, skipping\n");
+			return 0;
+		} else if (err) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(err));
+			return 1;
+		}
+	}
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(rt[i], NULL);
+	stop = 1;
+	for (i = 0; i < nr_hogs; i++)
+		pthread_join(hogs[i], NULL);
+
+	memset(&total, 0, sizeof(total));
+	total.min = ~0ULL;
+	for (i = 0; i < nr_threads; i++) {
+		for (j = 0; j <= NR_BUCKETS; j++)
+			total.hist[j] += res[i].hist[j];
+		for (j = 0; j < MAX_CPUS; j++)
+			total.cpu_count[j] += res[i].cpu_count[j];
+		total.sum += res[i].sum;
+		total.count += res[i].count;
+		if (res[i].min < total.min)
+			total.min = res[i].min;
+		if (res[i].max > total.max)
+			total.max = res[i].max;
+	}
+	qsort(all, total.count, sizeof(*all), cmp_u64);
+
+	printf("# latency histogram, %u us buckets\n", bucket_us);
+	for (j = 0; j < NR_BUCKETS; j++)
+		if (total.hist[j])
+			printf("%6u %llu\n", j * bucket_us,
+			       (unsigned long long)total.hist[j]);
+	if (total.hist[NR_BUCKETS])
+		printf(">%5u %llu\n", NR_BUCKETS * bucket_us,
+		       (unsigned long long)total.hist[NR_BUCKETS]);
+
+	printf("# wakeups per cpu\n");
+	for (j = 0; j < MAX_CPUS; j++)
+		if (total.cpu_count[j])
+			printf("cpu%-3u %llu\n", j,
+			       (unsigned long long)total.cpu_count[j]);
+
+	printf("min %llu avg %llu p99 %llu max %llu (us)\n",
+	       (unsigned long long)total.min / 1000,
+	       (unsigned long long)(total.sum / total.count) / 1000,
+	       (unsigned long long)all[total.count * 99 / 100] / 1000,
+	       (unsigned long long)total.max / 1000);
+
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-t threads] [-l hogs] [-i interval_us] [-n loops] "
+		"[-p prio] [-b bucket_us]\n", argv[0]);
+	return 1;
+}
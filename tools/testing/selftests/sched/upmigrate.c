@@ -0,0 +1,203 @@
+/*
+ * Up-migration latency, rt-app style: a task runs a light periodic load
+ * (1ms busy every 10ms) pinned to a little cpu, long enough for its
+ * history to say it is small, then is allowed on every cpu and turns
+ * cpu bound. The time from that switch until it first runs on a big cpu
+ * is how long a task that suddenly became heavy is left on a little one.
+ *
+ * Big and little are told apart by cpuinfo_max_freq. Prints the latency
+ * of every round in microseconds, the median and the maximum, and how
+ * many misfit kicks and up-migrations /proc/schedstat counted meanwhile.
+ * Fails if the task did not reach a big cpu within the timeout.
+ *
+ * Usage: upmigrate [-n rounds] [-t timeout_ms]
+ */
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CPUS	64
+
+static unsigned int max_freq[MAX_CPUS];
+static int nr_cpus;
+
+static uint64_t ts_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void spin(unsigned int us)
+{
+	uint64_t end = ts_ns() + us * 1000ULL;
+
+	while (ts_ns() < end)
+		;
+}
+
+static unsigned int read_max_freq(int cpu)
+{
+	char path[96];
+	unsigned int freq = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%u", &freq) != 1)
+		freq = 0;
+	fclose(f);
+
+	return freq;
+}
+
+/* misfit kicks and up-migrations of all cpus, -1 if not available */
+static int read_misfit_stats(unsigned long *kicks, unsigned long *ups)
+{
+	char line[256];
+	unsigned int k, u;
+	int found = 0;
+	FILE *f;
+
+	*kicks = *ups = 0;
+	f = fopen("/proc/schedstat", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "misfit %u %u", &k, &u) == 2) {
+			*kicks += k;
+			*ups += u;
+			found = 1;
+		}
+	}
+	fclose(f);
+
+	return found ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long kicks0, ups0, kicks1, ups1;
+	unsigned int rounds = 10, timeout_ms = 1000;
+	unsigned int little_freq = ~0U, big_freq = 0;
+	int little = -1, cpu, c, stats;
+	uint64_t *latency, start, now;
+	cpu_set_t all, one;
+	unsigned int i;
+
+	while ((c = getopt(argc, argv, "n:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout_ms = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n rounds] [-t timeout_ms]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (!rounds)
+		rounds = 1;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	CPU_ZERO(&all);
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		max_freq[cpu] = read_max_freq(cpu);
+		if (!max_freq[cpu])
+			continue;
+		CPU_SET(cpu, &all);
+		if (max_freq[cpu] < little_freq) {
+			little_freq = max_freq[cpu];
+			little = cpu;
+		}
+		if (max_freq[cpu] > big_freq)
+			big_freq = max_freq[cpu];
+	}
+
+	if (little < 0 || little_freq == big_freq) {
+		printf("upmigrate: no big.LITTLE cpus, skipping\n");
+		return 0;
+	}
+
+	latency = calloc(rounds, sizeof(*latency));
+	if (!latency) {
+		perror("calloc");
+		return 1;
+	}
+
+	stats = read_misfit_stats(&kicks0, &ups0);
+
+	for (i = 0; i < rounds; i++) {
+		CPU_ZERO(&one);
+		CPU_SET(little, &one);
+		if (sched_setaffinity(0, sizeof(one), &one)) {
+			perror("sched_setaffinity");
+			return 1;
+		}
+
+		/* 10% duty cycle for half a second: a small task */
+		start = ts_ns();
+		while (ts_ns() - start < 500000000ULL) {
+			spin(1000);
+			usleep(9000);
+		}
+
+		start = ts_ns();
+		if (sched_setaffinity(0, sizeof(all), &all)) {
+			perror("sched_setaffinity");
+			return 1;
+		}
+
+		/* now cpu bound until we land on a big cpu */
+		do {
+			now = ts_ns();
+			cpu = sched_getcpu();
+			if (cpu >= 0 && cpu < nr_cpus &&
+			    max_freq[cpu] == big_freq)
+				break;
+		} while (now - start < timeout_ms * 1000000ULL);
+
+		if (max_freq[cpu] != big_freq) {
+			printf("upmigrate: round %u: still on cpu%d after %ums [FAIL]\n",
+			       i, cpu, timeout_ms);
+			return 1;
+		}
+
+		latency[i] = now - start;
+		printf("upmigrate: round %u: cpu%d -> cpu%d in %llu us\n",
+		       i, little, cpu, (unsigned long long)latency[i] / 1000);
+	}
+
+	qsort(latency, rounds, sizeof(*latency), cmp_u64);
+	printf("upmigrate: median %llu us max %llu us\n",
+	       (unsigned long long)latency[rounds / 2] / 1000,
+	       (unsigned long long)latency[rounds - 1] / 1000);
+
+	if (!stats && !read_misfit_stats(&kicks1, &ups1))
+		printf("upmigrate: misfit kicks %lu up-migrations %lu\n",
+		       kicks1 - kicks0, ups1 - ups0);
+
+	printf("upmigrate: [PASS]\n");
+	return 0;
+}
@@ -0,0 +1,119 @@
+#!/bin/bash
+# Measures device resume time with synchronous and with asynchronous
+# suspend/resume (/sys/power/pm_async), using the pm_test "platform" level:
+# devices go all the way through noirq suspend and straight back, so no
+# wakeup source is needed. The resume times are the ones suspend_test
+# prints (CONFIG_PM_TEST_SUSPEND). Also prints the devices with the
+# slowest resume callbacks from debugfs suspend_device_times, and checks
+# that asynchronous resume is not slower than synchronous resume.
+
+power=/sys/power
+times=/sys/kernel/debug/suspend_device_times
+delay=/sys/module/suspend/parameters/pm_test_delay
+rounds=3
+
+saved_async=
+saved_delay=
+
+cleanup()
+{
+	echo none > $power/pm_test
+	[ -n "$saved_async" ] && echo $saved_async > $power/pm_async
+	[ -n "$saved_delay" ] && echo $saved_delay > $delay
+}
+
+check_prereqs()
+{
+	local msg="skip all tests:"
+
+	if [ $UID != 0 ]; then
+		echo $msg must be run as root >&2
+		exit 0
+	fi
+
+	if [ ! -w $power/pm_test ] || ! grep -qw platform $power/pm_test; then
+		echo $msg pm_test not available, needs CONFIG_PM_DEBUG >&2
+		exit 0
+	fi
+
+	if ! grep -qw mem $power/state; then
+		echo $msg suspend to ram not supported >&2
+		exit 0
+	fi
+
+	if [ ! -r $times ]; then
+		echo $msg $times not available >&2
+		exit 0
+	fi
+}
+
+# pass <name> <condition>
+pass()
+{
+	if eval "$2"; then
+		echo "resume_time: $1: [PASS]"
+	else
+		echo "resume_time: $1: [FAIL]"
+		ret=1
+	fi
+}
+
+# cycle: one test suspend, prints the total device resume time in usecs,
+# or nothing if suspend_test did not report it
+cycle()
+{
+	local before
+
+	before=$(dmesg | wc -l)
+	echo mem > $power/state || return
+	dmesg | tail -n +$((before + 1)) |
+		awk '/PM: resume .*devices took/ {
+			sub(/.*\(/, ""); us += $1; n++
+		}
+		END { if (n) print us }'
+}
+
+# run <pm_async>: median device resume time over the rounds
+run()
+{
+	local i
+
+	echo $1 > $power/pm_async
+	for i in $(seq $rounds); do
+		cycle
+	done | sort -n | awk '{ t[NR] = $1 } END { if (NR) print t[int((NR + 1) / 2)] }'
+}
+
+check_prereqs
+trap cleanup EXIT
+
+ret=0
+saved_async=$(cat $power/pm_async)
+[ -w $delay ] && saved_delay=$(cat $delay) && echo 0 > $delay
+echo platform > $power/pm_test
+
+sync_us=$(run 0)
+async_us=$(run 1)
+
+if [ -z "$sync_us" ] || [ -z "$async_us" ]; then
+	echo "resume_time: no resume times in the log, needs CONFIG_PM_TEST_SUSPEND"
+else
+	echo "resume_time: sync ${sync_us} us async ${async_us} us"
+	# allow for noise between rounds
+	pass "async resume not slower" \
+		"[ $async_us -le $((sync_us + sync_us / 5)) ]"
+fi
+
+echo "resume_time: slowest resume callbacks (usecs):"
+awk 'NR == 1 {
+		for (i = 3; i <= NF; i++) col[$i] = i
+		next
+	}
+	{
+		print $col["resume_noirq"] + $col["resume_early"] + \
+			$col["resume"], $1, $2 ? "async" : "sync"
+	}' $times | sort -rn | head -10
+
+pass "per-device times reported" "[ \$(wc -l < $times) -gt 1 ]"
+
+exit $ret